@@ -32,6 +32,8 @@
 #include <time.h>
 #include <SPI.h>
 #include <Ethernet.h>
+#include <fl_protection.h>
+#include <fl_tariff.h>
 
 /* ================= USER CONFIG ================= */
 
@@ -97,6 +99,7 @@ char AP_NAME[32] = "";
 char TOPIC_TELEMETRY[64] = "";
 char TOPIC_COMMAND[64] = "";
 char TOPIC_STATUS[64] = "";     // Online/offline status (LWT)
+char TOPIC_ACK[64] = "";        // Command acknowledgements
 char TOPIC_SUBSCRIBE[64] = "";  // Wildcard for subscriptions
 
 // RS485
@@ -154,11 +157,8 @@ bool dryRunProtectionEnabled = true;
 uint32_t overcurrentDelayS = 0;  // 0 = immediate, range 0-30
 uint32_t dryrunDelayS = 0;
 
-// Fault delay timers
-unsigned long overcurrentStartTime = 0;
-bool overcurrentConditionActive = false;
-unsigned long dryrunStartTime = 0;
-bool dryrunConditionActive = false;
+// Protection engine state (pickup timers, debounce) — FieldLinkCore fl_protection
+fl_protection_t protection;
 
 // Contactor feedback (DI4 monitors aux contact)
 bool contactorConfirmed = false;
@@ -172,10 +172,11 @@ uint8_t scheduleEndMinute = 0;
 uint8_t scheduleDays = 0x7F;  // Bitmask: bit0=Sun, bit1=Mon...bit6=Sat (0x7F = all days)
 bool wasWithinSchedule = false;  // Track previous state for auto-start detection
 
-// Ruraflex TOU settings (Eskom South Africa)
-// When enabled, pump runs ONLY during off-peak hours
-// Season auto-detected: June-Aug = High Demand, Sept-May = Low Demand
+// TOU tariff settings (Eskom Ruraflex 2025/26 unless SET_TARIFF replaced it)
+// When enabled, pump runs ONLY in the tariff's allowed bands (off-peak)
 bool ruraflexEnabled = false;
+fl_tariff_t tariff;
+fl_tariff_map_t tariffMap;  // Compiled week bitmaps, one bit per minute
 
 /* =============================================== */
 
@@ -203,18 +204,15 @@ float Ia = 0, Ib = 0, Ic = 0;
 float Va = 0, Vb = 0, Vc = 0;
 
 // State machine
-enum PumpState { STOPPED, RUNNING, FAULT };
-enum FaultType { NO_FAULT, OVERCURRENT, DRY_RUN, SENSOR_FAULT };
+enum PumpState { STOPPED = FL_MOTOR_STOPPED, RUNNING = FL_MOTOR_RUNNING, FAULT = FL_MOTOR_FAULT };
+enum FaultType { NO_FAULT = FL_FAULT_NONE, OVERCURRENT = FL_FAULT_OVERCURRENT,
+                 DRY_RUN = FL_FAULT_DRY_RUN, SENSOR_FAULT = FL_FAULT_SENSOR };
 
 PumpState state = STOPPED;
-PumpState pendingState = STOPPED;
 FaultType faultType = NO_FAULT;
 bool startCommand = false;
 unsigned long startCommandTime = 0;
 
-// State debouncing
-int stateDebounceCounter = 0;
-
 // Fault tracking
 unsigned long faultTimestamp = 0;
 float faultCurrentA = 0, faultCurrentB = 0, faultCurrentC = 0;
@@ -740,32 +738,20 @@ bool readCurrents() {
 void saveProtectionConfig();
 void saveScheduleConfig();
 void saveRuraflexConfig();
+void loadTariff();
 
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  if (length >= MAX_PAYLOAD_SIZE) {
-    Serial.println("MQTT payload too large, ignoring");
-    return;
-  }
-
-  // Only process command topic
-  if (strcmp(topic, TOPIC_COMMAND) != 0) {
-    return;
-  }
-
-  // Update activity tracker - we received a valid message
-  lastMqttActivity = millis();
-
-  char cmd[MAX_PAYLOAD_SIZE];
-  memcpy(cmd, payload, length);
-  cmd[length] = '\0';
-
-  Serial.print("MQTT CMD: "); Serial.println(cmd);
-
+// START/STOP/RESET/STATUS, sent plain ("START") or as JSON with an id
+// ({"command":"START","id":"w1"}). False if 'cmd' is none of them;
+// 'refused' says why a known command was not carried out.
+bool runBasicCommand(const char* cmd, const char*& refused) {
+  refused = nullptr;
   if (strcmp(cmd, "START") == 0) {
     if (!remoteMode) {
       Serial.println("MQTT START ignored - in LOCAL mode");
+      refused = "local mode";
     } else if (state == FAULT) {
       Serial.println("Cannot START while in FAULT state. Send RESET first.");
+      refused = "pump in fault";
     } else {
       startCommand = true;
       startCommandTime = millis();
@@ -794,14 +780,60 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
     lastTelemetryTime = 0;
   }
   else {
+    return false;
+  }
+  return true;
+}
+
+// {"id":...,"ok":...,"err":...,"us":...} on TOPIC_ACK, as FieldLinkCore
+// devices answer; nothing for a command without an id
+void publishAck(JsonVariantConst id, const char* error, uint32_t receivedUs) {
+  if (id.isNull()) return;
+  StaticJsonDocument<256> ack;
+  ack["id"] = id;
+  ack["ok"] = error == nullptr;
+  if (error) ack["err"] = error;
+  ack["us"] = micros() - receivedUs;
+  char buf[256];
+  serializeJson(ack, buf);
+  mqtt.publish(TOPIC_ACK, buf);
+}
+
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  if (length >= MAX_PAYLOAD_SIZE) {
+    Serial.println("MQTT payload too large, ignoring");
+    return;
+  }
+
+  // Only process command topic
+  if (strcmp(topic, TOPIC_COMMAND) != 0) {
+    return;
+  }
+
+  // Update activity tracker - we received a valid message
+  lastMqttActivity = millis();
+  uint32_t receivedUs = micros();
+
+  char cmd[MAX_PAYLOAD_SIZE];
+  memcpy(cmd, payload, length);
+  cmd[length] = '\0';
+
+  Serial.print("MQTT CMD: "); Serial.println(cmd);
+
+  // Plain text has no id: nothing to acknowledge
+  const char* refused = nullptr;
+  if (!runBasicCommand(cmd, refused)) {
     // Try parsing as JSON for complex commands
-    StaticJsonDocument<256> doc;
+    static StaticJsonDocument<2048> doc;  // static: sized for SET_TARIFF, too big for the callback stack
     DeserializationError error = deserializeJson(doc, cmd);
 
     if (!error) {
       const char* command = doc["command"];
 
-      if (command && strcmp(command, "UPDATE_FIRMWARE") == 0) {
+      if (command && runBasicCommand(command, refused)) {
+        // Acked below
+      }
+      else if (command && strcmp(command, "UPDATE_FIRMWARE") == 0) {
         const char* firmwareUrl = doc["url"];
 
         if (firmwareUrl) {
@@ -812,12 +844,14 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
           setDO(DO_CONTACTOR_CH, false);
 
           // Publish update status
+          publishAck(doc["id"], nullptr, receivedUs);
           mqtt.publish(TOPIC_TELEMETRY, "{\"status\":\"updating\"}");
 
           // Perform update (will restart device on success)
           performRemoteFirmwareUpdate(firmwareUrl);
         } else {
           Serial.println("UPDATE_FIRMWARE command missing 'url' parameter");
+          refused = "'url' missing";
         }
       }
       else if (command && strcmp(command, "SET_PROTECTION") == 0) {
@@ -879,6 +913,24 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
         saveRuraflexConfig();
         Serial.println("Ruraflex updated via MQTT");
       }
+      else if (command && strcmp(command, "SET_TARIFF") == 0) {
+        // Tariff definition (see fl_tariff.h), or {"command":"SET_TARIFF","default":true}
+        if (doc["default"] | false) {
+          fl_tariffErase(preferences);
+          loadTariff();
+        } else {
+          static fl_tariff_t parsed;
+          const char* err = fl_tariffFromJson(doc.as<JsonVariantConst>(), parsed);
+          if (err) {
+            Serial.printf("SET_TARIFF rejected: %s\n", err);
+          } else {
+            tariff = parsed;
+            fl_tariffCompile(tariff, tariffMap);
+            fl_tariffSave(preferences, tariff);
+            Serial.printf("Tariff '%s' saved (%u seasons)\n", tariff.name, tariff.seasonCount);
+          }
+        }
+      }
       else if (command && strcmp(command, "GET_SETTINGS") == 0) {
         // Respond with current schedule, ruraflex and protection settings
         StaticJsonDocument<512> resp;
@@ -890,6 +942,7 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
         resp["schedule_end_minute"] = scheduleEndMinute;
         resp["schedule_days"] = scheduleDays;
         resp["ruraflex_enabled"] = ruraflexEnabled;
+        resp["tariff"] = tariff.name;
         resp["overcurrent_protection"] = overcurrentProtectionEnabled;
         resp["dryrun_protection"] = dryRunProtectionEnabled;
         resp["max_current"] = maxCurrentThreshold;
@@ -907,6 +960,11 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
         mqtt.publish(TOPIC_TELEMETRY, buf);
         Serial.println("Settings sent via MQTT");
       }
+      else {
+        Serial.printf("Unrecognized command: %s\n", command ? command : cmd);
+        refused = command ? "unknown command" : "no command";
+      }
+      publishAck(doc["id"], refused, receivedUs);
     }
   }
 }
@@ -914,12 +972,8 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
 /* ================= STATE ================= */
 
 const char* faultTypeToString(FaultType ft) {
-  switch (ft) {
-    case OVERCURRENT:   return "OVERCURRENT";
-    case DRY_RUN:       return "DRY_RUN";
-    case SENSOR_FAULT:  return "SENSOR_FAULT";
-    default:            return "NONE";
-  }
+  // This firmware has always reported "NONE" rather than an empty string
+  return ft == NO_FAULT ? "NONE" : fl_faultToString((fl_fault_t)ft);
 }
 
 // Send fault notification via HTTP webhook (for Telegram alerts)
@@ -1082,8 +1136,7 @@ void resetFault() {
     Serial.printf("Clearing fault: %s\n", faultTypeToString(faultType));
     state = STOPPED;
     faultType = NO_FAULT;
-    pendingState = STOPPED;
-    stateDebounceCounter = 0;
+    fl_protectionReset(protection);
     startCommand = false;
     setDO(DO_FAULT_CH, false);  // Deactivate fault alarm output (DO5)
     Serial.println("Fault cleared. Ready to restart.");
@@ -1097,117 +1150,65 @@ float getMaxCurrent() {
   return maxI;
 }
 
-PumpState evaluateState() {
-  float maxCurrent = getMaxCurrent();
-  unsigned long now = millis();
-
-  // Overcurrent detection with configurable delay
-  if (overcurrentProtectionEnabled && (Ia > maxCurrentThreshold || Ib > maxCurrentThreshold || Ic > maxCurrentThreshold)) {
-    if (!overcurrentConditionActive) {
-      overcurrentConditionActive = true;
-      overcurrentStartTime = now;
-      Serial.printf("Overcurrent condition started (delay=%lus)\n", overcurrentDelayS);
-    }
-    // Check if delay has elapsed (convert seconds to ms)
-    if (overcurrentDelayS == 0 || (now - overcurrentStartTime) >= (overcurrentDelayS * 1000)) {
-      return FAULT;
-    }
-  } else {
-    // Condition cleared before delay elapsed
-    if (overcurrentConditionActive) {
-      Serial.println("Overcurrent condition cleared");
-      overcurrentConditionActive = false;
-    }
-  }
-
-  #if !BENCH_TEST_MODE
-  // Dry run detection with configurable delay
-  if (dryRunProtectionEnabled && dryCurrentThreshold > 0 && startCommand && state == RUNNING) {
-    if (maxCurrent < dryCurrentThreshold) {
-      if (!dryrunConditionActive) {
-        dryrunConditionActive = true;
-        dryrunStartTime = now;
-        Serial.printf("Dry run condition started (delay=%lus)\n", dryrunDelayS);
-      }
-      // Check if delay has elapsed (convert seconds to ms)
-      if (dryrunDelayS == 0 || (now - dryrunStartTime) >= (dryrunDelayS * 1000)) {
-        return FAULT;
-      }
-    } else {
-      // Condition cleared before delay elapsed
-      if (dryrunConditionActive) {
-        Serial.println("Dry run condition cleared");
-        dryrunConditionActive = false;
-      }
-    }
-  } else {
-    // Reset dry run condition when not in running state or protection disabled
-    dryrunConditionActive = false;
-  }
-
-  if (START_TIMEOUT > 0 && startCommand && state != RUNNING) {
-    if (millis() - startCommandTime > START_TIMEOUT) {
-      Serial.println("Start failure timeout - pump did not start");
-      return FAULT;
-    }
-  }
-  #endif
-
-  if (state == RUNNING) {
-    if (maxCurrent < (RUN_THRESHOLD - HYSTERESIS_CURRENT)) {
-      return STOPPED;
-    }
-    return RUNNING;
-  } else {
-    if (maxCurrent > RUN_THRESHOLD) {
-      return RUNNING;
-    }
-    return STOPPED;
-  }
+fl_protection_config_t protectionConfig() {
+  fl_protection_config_t cfg = {};
+  cfg.overcurrentEnabled = overcurrentProtectionEnabled;
+  cfg.maxCurrent = maxCurrentThreshold;
+  cfg.overcurrentDelayMs = overcurrentDelayS * 1000;
+  // Bench test mode runs without a pump: no dry-run or start-failure trips
+  cfg.dryRunEnabled = dryRunProtectionEnabled && !BENCH_TEST_MODE;
+  cfg.dryCurrent = dryCurrentThreshold;
+  cfg.dryRunDelayMs = dryrunDelayS * 1000;
+  cfg.startTimeoutMs = BENCH_TEST_MODE ? 0 : START_TIMEOUT;
+  cfg.inrushBlankMs = 0;
+  cfg.runThreshold = RUN_THRESHOLD;
+  cfg.hysteresis = HYSTERESIS_CURRENT;
+  cfg.debounceCount = STATE_DEBOUNCE_COUNT;
+  cfg.faultAutoResetMs = FAULT_AUTO_RESET_MS;
+  // Thermal model and 3-phase checks stay off (zero-initialised)
+  return cfg;
 }
 
 void updateState() {
-  if (state == FAULT) {
-    if (FAULT_AUTO_RESET_MS > 0 && (millis() - faultTimestamp) > FAULT_AUTO_RESET_MS) {
-      Serial.println("Auto-resetting fault after timeout");
-      resetFault();
-    }
+  fl_protection_input_t in = {};
+  in.nowMs = millis();
+  in.state = (fl_motor_state_t)state;
+  in.current = getMaxCurrent();   // Any phase over the limit trips
+  in.sensorFault = !sensorOnline && modbusFailCount >= MAX_MODBUS_FAILURES;
+  in.startCommand = startCommand;
+  in.startCommandMs = startCommandTime;
+  in.contactorClosed = false;
+  in.contactorCloseMs = 0;
+
+  fl_protection_decision_t d = fl_protectionStep(protection, protectionConfig(), in);
+
+  if (d.events & FL_PROT_EV_OC_START)
+    Serial.printf("Overcurrent condition started (delay=%lus)\n", overcurrentDelayS);
+  if (d.events & FL_PROT_EV_OC_CLEAR)
+    Serial.println("Overcurrent condition cleared");
+  if (d.events & FL_PROT_EV_DR_START)
+    Serial.printf("Dry run condition started (delay=%lus)\n", dryrunDelayS);
+  if (d.events & FL_PROT_EV_DR_CLEAR)
+    Serial.println("Dry run condition cleared");
+
+  if (d.events & FL_PROT_EV_AUTO_RESET) {
+    Serial.println("Auto-resetting fault after timeout");
+    resetFault();
     return;
   }
 
-  if (!sensorOnline && modbusFailCount >= MAX_MODBUS_FAILURES) {
-    triggerFault(SENSOR_FAULT);
-    return;
-  }
-
-  PumpState targetState = evaluateState();
-
-  if (targetState == FAULT) {
-    float maxCurrent = getMaxCurrent();
-    if (maxCurrent > maxCurrentThreshold) {
-      triggerFault(OVERCURRENT);
-    } else {
-      triggerFault(DRY_RUN);
-    }
+  if (d.events & FL_PROT_EV_TRIP) {
+    // Start timeout reports as DRY_RUN, as before (see fl_faultFromTrip)
+    if (d.trip == FL_TRIP_START_TIMEOUT)
+      Serial.println("Start failure timeout - pump did not start");
+    triggerFault((FaultType)fl_faultFromTrip(d.trip));
     return;
   }
 
-  if (targetState != state) {
-    if (targetState == pendingState) {
-      stateDebounceCounter++;
-      if (stateDebounceCounter >= STATE_DEBOUNCE_COUNT) {
-        state = targetState;
-        stateDebounceCounter = 0;
-        Serial.printf("State changed to: %s\n",
-          state == RUNNING ? "RUNNING" : "STOPPED");
-      }
-    } else {
-      pendingState = targetState;
-      stateDebounceCounter = 1;
-    }
-  } else {
-    stateDebounceCounter = 0;
-    pendingState = state;
+  if (d.events & FL_PROT_EV_STATE) {
+    state = (PumpState)d.state;
+    Serial.printf("State changed to: %s\n",
+      state == RUNNING ? "RUNNING" : "STOPPED");
   }
 }
 
@@ -1623,6 +1624,7 @@ void generateDeviceId() {
   snprintf(TOPIC_TELEMETRY, sizeof(TOPIC_TELEMETRY), "fieldlink/%s/telemetry", DEVICE_ID);
   snprintf(TOPIC_COMMAND, sizeof(TOPIC_COMMAND), "fieldlink/%s/command", DEVICE_ID);
   snprintf(TOPIC_STATUS, sizeof(TOPIC_STATUS), "fieldlink/%s/status", DEVICE_ID);
+  snprintf(TOPIC_ACK, sizeof(TOPIC_ACK), "fieldlink/%s/ack", DEVICE_ID);
   snprintf(TOPIC_SUBSCRIBE, sizeof(TOPIC_SUBSCRIBE), "fieldlink/%s/#", DEVICE_ID);  // Wildcard
 }
 
@@ -1774,81 +1776,23 @@ void saveRuraflexConfig() {
   Serial.println("Ruraflex config saved");
 }
 
-// Ruraflex TOU time checking (Eskom South Africa 2025/26)
-// Returns true if pump is allowed to run based on current TOU period
-bool isWithinRuraflex() {
-  if (!ruraflexEnabled) return true;  // Not enabled = always allowed
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo, 10)) return true;  // NTP failed = allow
-
-  int month = timeinfo.tm_mon + 1;  // tm_mon is 0-11
-  int dayOfWeek = timeinfo.tm_wday; // 0=Sun, 1=Mon...6=Sat
-  int hour = timeinfo.tm_hour;
-  int mins = timeinfo.tm_min;
-  int nowMins = hour * 60 + mins;
-
-  // Determine season: High Demand = June-August, Low Demand = Sept-May
-  bool isHighDemandSeason = (month >= 6 && month <= 8);
-
-  // Determine day type: 0=Sunday, 1-5=Weekday, 6=Saturday
-  bool isWeekday = (dayOfWeek >= 1 && dayOfWeek <= 5);
-  bool isSaturday = (dayOfWeek == 6);
-  bool isSunday = (dayOfWeek == 0);
-
-  // Define time periods (in minutes from midnight)
-  // High Demand Season (Winter: June-August)
-  // Peak: 06:00-08:00 (360-480), 17:00-20:00 (1020-1200) - Weekdays only
-  // Standard: 08:00-17:00 (480-1020), 20:00-22:00 (1200-1320) weekdays
-  //           07:00-12:00 (420-720), 18:00-20:00 (1080-1200) weekends
-  // Off-peak: 22:00-06:00 (1320-360) weekdays, rest of weekends
-
-  // Low Demand Season (Summer: Sept-May)
-  // Peak: 07:00-09:00 (420-540), 17:00-20:00 (1020-1200) - Weekdays only
-  // Standard: 06:00-07:00 (360-420), 09:00-17:00 (540-1020), 20:00-22:00 (1200-1320) weekdays
-  //           07:00-12:00 (420-720), 18:00-20:00 (1080-1200) weekends
-  // Off-peak: 22:00-06:00 (1320-360) weekdays, rest of weekends
-
-  bool isPeak = false;
-  bool isStandard = false;
-
-  if (isWeekday) {
-    if (isHighDemandSeason) {
-      // High demand weekday peaks: 06:00-08:00 and 17:00-20:00
-      isPeak = (nowMins >= 360 && nowMins < 480) || (nowMins >= 1020 && nowMins < 1200);
-      // Standard: 08:00-17:00 and 20:00-22:00
-      isStandard = (nowMins >= 480 && nowMins < 1020) || (nowMins >= 1200 && nowMins < 1320);
-    } else {
-      // Low demand weekday peaks: 07:00-09:00 and 17:00-20:00
-      isPeak = (nowMins >= 420 && nowMins < 540) || (nowMins >= 1020 && nowMins < 1200);
-      // Standard: 06:00-07:00, 09:00-17:00, and 20:00-22:00
-      isStandard = (nowMins >= 360 && nowMins < 420) || (nowMins >= 540 && nowMins < 1020) || (nowMins >= 1200 && nowMins < 1320);
-    }
-  } else {
-    // Weekend (Saturday and Sunday) - no peak periods
-    isPeak = false;
-    // Standard: 07:00-12:00 and 18:00-20:00
-    isStandard = (nowMins >= 420 && nowMins < 720) || (nowMins >= 1080 && nowMins < 1200);
-  }
-
-  // Off-peak is everything else (not peak and not standard)
-  bool isOffPeak = !isPeak && !isStandard;
-
-  // Pump runs ONLY during off-peak hours
-  return isOffPeak;
+void loadTariff() {
+  bool stored = fl_tariffLoad(preferences, tariff);
+  fl_tariffCompile(tariff, tariffMap);
+  Serial.printf("Tariff: %s (%s)\n", tariff.name, stored ? "NVS" : "built-in");
 }
 
 bool isWithinSchedule() {
-  // Ruraflex takes priority over custom schedule
-  if (ruraflexEnabled) {
-    return isWithinRuraflex();
-  }
-
-  if (!scheduleEnabled) return true;  // No schedule = always allowed
+  if (!scheduleEnabled && !ruraflexEnabled) return true;  // No schedule = always allowed
 
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo, 10)) return true;  // NTP failed = allow (10ms timeout)
 
+  // Tariff takes priority over custom schedule: one bit lookup
+  if (ruraflexEnabled) {
+    return fl_tariffAllows(tariffMap, timeinfo);
+  }
+
   // Check if today is an allowed day (tm_wday: 0=Sun, 1=Mon...6=Sat)
   if (!(scheduleDays & (1 << timeinfo.tm_wday))) {
     return false;  // Today is not a scheduled day
@@ -2528,8 +2472,9 @@ void setup() {
   // Load schedule config from NVS
   loadScheduleConfig();
 
-  // Load Ruraflex config from NVS
+  // Load Ruraflex enable and tariff from NVS
   loadRuraflexConfig();
+  loadTariff();
 
   // Initialize schedule state and auto-start if booting within schedule window
   wasWithinSchedule = isWithinSchedule();
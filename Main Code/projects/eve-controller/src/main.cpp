@@ -32,88 +32,26 @@
 #define NUM_PUMPS 3
 
 // Timing intervals (non-blocking)
-#define TELEMETRY_INTERVAL_MS   2000
-#define SENSOR_READ_INTERVAL_MS 500
+#define SENSOR_READ_INTERVAL_MS 500     // Normal cadence; the controller adapts it to pump state
 
-// State detection hysteresis
-#define HYSTERESIS_CURRENT      1.0
-#define STATE_DEBOUNCE_COUNT    3
+// Protection timing and defaults: fl_controller_config_t
 
-// Fault handling
-#define FAULT_AUTO_RESET_MS     0
+/* ================= PUMP LAYOUT ================= */
 
-// Protection
-#define RUN_THRESHOLD   5.0
-#define START_TIMEOUT   10000
+// L1 (Va/Ia) = Pump 1, L2 (Vb/Ib) = Pump 2, L3 (Vc/Ic) = Pump 3
+using EveMeter = fl_meter_per_phase<0, 1, 2>;
 
-/* ================= PUMP STATE ================= */
-
-enum PumpState { STOPPED, RUNNING, FAULT };
-enum FaultType { NO_FAULT, OVERCURRENT, DRY_RUN, SENSOR_FAULT };
-
-struct Pump {
-  uint8_t id;              // 1, 2, 3
-
-  // DO channels
-  uint8_t doContactor;     // DO0, DO1, DO2
-  uint8_t doFaultAlarm;    // DO4, DO5, DO6
-
-  // DI feedback
-  uint8_t diFeedbackBit;   // bit position in fl_diStatus
-
-  // Sensor pointers (to fl_Va/Ia, fl_Vb/Ib, fl_Vc/Ic)
-  float* voltage;
-  float* current;
-
-  // State machine
-  PumpState state;
-  PumpState pendingState;
-  FaultType faultType;
-  bool startCommand;
-  unsigned long startCommandTime;
-  int stateDebounceCounter;
-  bool contactorConfirmed;
-  bool lastDOState;
-
-  // Fault tracking
-  unsigned long faultTimestamp;
-  float faultCurrent;
-
-  // Per-pump protection thresholds (NVS-stored)
-  float maxCurrentThreshold;
-  float dryCurrentThreshold;
-  bool overcurrentEnabled;
-  bool dryRunEnabled;
-  uint32_t overcurrentDelayS;
-  uint32_t dryrunDelayS;
-
-  // Fault delay timers
-  unsigned long overcurrentStartTime;
-  bool overcurrentConditionActive;
-  unsigned long dryrunStartTime;
-  bool dryrunConditionActive;
-
-  // NVS namespace
-  char nvsNamespace[8];    // "prot_p1", "prot_p2", "prot_p3"
-
-  // Per-pump schedule
-  bool scheduleEnabled;
-  uint8_t scheduleStartHour;
-  uint8_t scheduleStartMinute;
-  uint8_t scheduleEndHour;
-  uint8_t scheduleEndMinute;
-  uint8_t scheduleDays;       // Bitmask: bit0=Sun...bit6=Sat (0x7F = all days)
-  bool wasWithinSchedule;
+// DO0-DO2 contactors, DO4-DO6 fault alarms, DI1-DI3 contactor feedback
+struct EveIo {
+  static constexpr uint8_t contactor[]   = { 0, 1, 2 };
+  static constexpr uint8_t faultAlarm[]  = { 4, 5, 6 };
+  static constexpr uint8_t feedbackBit[] = { 0, 1, 2 };
 };
 
-Pump pumps[NUM_PUMPS];
-
-// Ruraflex TOU settings (Eskom South Africa) - global, overrides all pump schedules
-bool ruraflexEnabled = false;
+fl_controller_t<NUM_PUMPS, EveMeter, EveIo> eve;
 
-// Non-blocking timing
-unsigned long lastTelemetryTime = 0;
-unsigned long lastSensorReadTime = 0;
+// DO3 and DO7 unused
+static_assert(decltype(eve)::kUnusedDo == 0x88, "Eve DO layout");
 
 /* ================= DASHBOARD HTML ================= */
 
@@ -430,788 +368,14 @@ const char DASHBOARD_HTML[] PROGMEM = R"rawliteral(
 </html>
 )rawliteral";
 
-/* ================= FORWARD DECLARATIONS ================= */
-
-void initPumps();
-void triggerFault(Pump& p, FaultType type);
-void resetFault(Pump& p);
-const char* faultTypeToString(FaultType ft);
-const char* stateToString(PumpState s);
-
-// Deferred Telegram notifications — avoid blocking the main loop
-struct PendingNotification {
-  int pump;
-  char faultType[20];
-  float current;
-  bool pending;
-};
-static PendingNotification pendingNotifications[3] = {};
-PumpState evaluatePumpState(Pump& p);
-void updatePumpState(Pump& p);
-void loadPumpProtection(Pump& p);
-void savePumpProtection(Pump& p);
-void loadPumpSchedule(Pump& p);
-void savePumpSchedule(Pump& p);
-void loadRuraflexConfig();
-void saveRuraflexConfig();
-bool isWithinSchedule(const Pump& p);
-
-/* ================= PUMP INITIALIZATION ================= */
-
-static void initPump(Pump& p, uint8_t id, uint8_t doCont, uint8_t doFault,
-                     uint8_t diBit, float* volt, float* curr, const char* nvs) {
-  p.id = id;
-  p.doContactor = doCont;
-  p.doFaultAlarm = doFault;
-  p.diFeedbackBit = diBit;
-  p.voltage = volt;
-  p.current = curr;
-  p.state = STOPPED;
-  p.pendingState = STOPPED;
-  p.faultType = NO_FAULT;
-  p.startCommand = false;
-  p.startCommandTime = 0;
-  p.stateDebounceCounter = 0;
-  p.contactorConfirmed = false;
-  p.lastDOState = false;
-  p.faultTimestamp = 0;
-  p.faultCurrent = 0;
-  p.maxCurrentThreshold = 120.0;
-  p.dryCurrentThreshold = 0.5;
-  p.overcurrentEnabled = true;
-  p.dryRunEnabled = true;
-  p.overcurrentDelayS = 0;
-  p.dryrunDelayS = 0;
-  p.overcurrentStartTime = 0;
-  p.overcurrentConditionActive = false;
-  p.dryrunStartTime = 0;
-  p.dryrunConditionActive = false;
-  strncpy(p.nvsNamespace, nvs, sizeof(p.nvsNamespace) - 1);
-  p.nvsNamespace[sizeof(p.nvsNamespace) - 1] = '\0';
-  p.scheduleEnabled = false;
-  p.scheduleStartHour = 6;
-  p.scheduleStartMinute = 0;
-  p.scheduleEndHour = 18;
-  p.scheduleEndMinute = 0;
-  p.scheduleDays = 0x7F;
-  p.wasWithinSchedule = false;
-}
-
-void initPumps() {
-  // Pump 1: L1 = Va/Ia, DO0 contactor, DO4 fault alarm, DI1 feedback (bit 0)
-  initPump(pumps[0], 1, 0, 4, 0, &fl_Va, &fl_Ia, "prot_p1");
-  // Pump 2: L2 = Vb/Ib, DO1 contactor, DO5 fault alarm, DI2 feedback (bit 1)
-  initPump(pumps[1], 2, 1, 5, 1, &fl_Vb, &fl_Ib, "prot_p2");
-  // Pump 3: L3 = Vc/Ic, DO2 contactor, DO6 fault alarm, DI3 feedback (bit 2)
-  initPump(pumps[2], 3, 2, 6, 2, &fl_Vc, &fl_Ic, "prot_p3");
-}
-
-/* ================= STATE FUNCTIONS ================= */
-
-const char* faultTypeToString(FaultType ft) {
-  switch (ft) {
-    case OVERCURRENT:   return "OVERCURRENT";
-    case DRY_RUN:       return "DRY_RUN";
-    case SENSOR_FAULT:  return "SENSOR_FAULT";
-    default:            return "";
-  }
-}
-
-const char* stateToString(PumpState s) {
-  switch (s) {
-    case RUNNING: return "RUNNING";
-    case FAULT:   return "FAULT";
-    default:      return "STOPPED";
-  }
-}
-
-void triggerFault(Pump& p, FaultType type) {
-  if (p.state != FAULT) {
-    p.state = FAULT;
-    p.faultType = type;
-    p.faultTimestamp = millis();
-    p.faultCurrent = *(p.current);
-
-    p.startCommand = false;
-    fl_setDO(p.doContactor, false);
-    fl_setDO(p.doFaultAlarm, true);
-
-    Serial.printf("!!! PUMP %d FAULT: %s (I=%.2fA) !!!\n", p.id, faultTypeToString(type), p.faultCurrent);
-    // Only send Telegram for protection faults (overcurrent/dry-run) —
-    // these mean a pump was running and something went wrong.
-    // SENSOR_FAULT is a system status (e.g. no meter at boot), not actionable.
-    if (type == OVERCURRENT || type == DRY_RUN) {
-      int idx = p.id - 1;
-      if (idx >= 0 && idx < 3) {
-        pendingNotifications[idx].pump = p.id;
-        strncpy(pendingNotifications[idx].faultType, faultTypeToString(type), sizeof(pendingNotifications[idx].faultType) - 1);
-        pendingNotifications[idx].current = p.faultCurrent;
-        pendingNotifications[idx].pending = true;
-      }
-    }
-  }
-}
-
-void resetFault(Pump& p) {
-  if (p.state == FAULT) {
-    Serial.printf("Pump %d: Clearing fault: %s\n", p.id, faultTypeToString(p.faultType));
-    p.state = STOPPED;
-    p.faultType = NO_FAULT;
-    p.pendingState = STOPPED;
-    p.stateDebounceCounter = 0;
-    p.startCommand = false;
-    fl_setDO(p.doFaultAlarm, false);
-    Serial.printf("Pump %d: Fault cleared. Ready to restart.\n", p.id);
-  }
-}
-
-PumpState evaluatePumpState(Pump& p) {
-  float current = *(p.current);
-  unsigned long now = millis();
-
-  // Overcurrent detection with configurable delay
-  if (p.overcurrentEnabled && current > p.maxCurrentThreshold) {
-    if (!p.overcurrentConditionActive) {
-      p.overcurrentConditionActive = true;
-      p.overcurrentStartTime = now;
-      Serial.printf("Pump %d: Overcurrent condition started (delay=%lus)\n", p.id, p.overcurrentDelayS);
-    }
-    if (p.overcurrentDelayS == 0 || (now - p.overcurrentStartTime) >= (p.overcurrentDelayS * 1000)) {
-      return FAULT;
-    }
-  } else {
-    if (p.overcurrentConditionActive) {
-      Serial.printf("Pump %d: Overcurrent condition cleared\n", p.id);
-      p.overcurrentConditionActive = false;
-    }
-  }
-
-  // Dry run detection with configurable delay
-  if (p.dryRunEnabled && p.dryCurrentThreshold > 0 && p.startCommand && p.state == RUNNING) {
-    if (current < p.dryCurrentThreshold) {
-      if (!p.dryrunConditionActive) {
-        p.dryrunConditionActive = true;
-        p.dryrunStartTime = now;
-        Serial.printf("Pump %d: Dry run condition started (delay=%lus)\n", p.id, p.dryrunDelayS);
-      }
-      if (p.dryrunDelayS == 0 || (now - p.dryrunStartTime) >= (p.dryrunDelayS * 1000)) {
-        return FAULT;
-      }
-    } else {
-      if (p.dryrunConditionActive) {
-        Serial.printf("Pump %d: Dry run condition cleared\n", p.id);
-        p.dryrunConditionActive = false;
-      }
-    }
-  } else {
-    p.dryrunConditionActive = false;
-  }
-
-  // Start failure timeout
-  if (START_TIMEOUT > 0 && p.startCommand && p.state != RUNNING) {
-    if (millis() - p.startCommandTime > START_TIMEOUT) {
-      Serial.printf("Pump %d: Start failure timeout\n", p.id);
-      return FAULT;
-    }
-  }
-
-  if (p.state == RUNNING) {
-    if (current < (RUN_THRESHOLD - HYSTERESIS_CURRENT)) {
-      return STOPPED;
-    }
-    return RUNNING;
-  } else {
-    if (current > RUN_THRESHOLD) {
-      return RUNNING;
-    }
-    return STOPPED;
-  }
-}
-
-void updatePumpState(Pump& p) {
-  if (p.state == FAULT) {
-    if (FAULT_AUTO_RESET_MS > 0 && (millis() - p.faultTimestamp) > FAULT_AUTO_RESET_MS) {
-      Serial.printf("Pump %d: Auto-resetting fault\n", p.id);
-      resetFault(p);
-    }
-    return;
-  }
-
-  // Sensor fault is shared — one Modbus sensor for all 3
-  if (!fl_sensorOnline && fl_modbusFailCount >= FL_MAX_MODBUS_FAILURES) {
-    triggerFault(p, SENSOR_FAULT);
-    return;
-  }
-
-  PumpState targetState = evaluatePumpState(p);
-
-  if (targetState == FAULT) {
-    float current = *(p.current);
-    if (current > p.maxCurrentThreshold) {
-      triggerFault(p, OVERCURRENT);
-    } else {
-      triggerFault(p, DRY_RUN);
-    }
-    return;
-  }
-
-  if (targetState != p.state) {
-    if (targetState == p.pendingState) {
-      p.stateDebounceCounter++;
-      if (p.stateDebounceCounter >= STATE_DEBOUNCE_COUNT) {
-        p.state = targetState;
-        p.stateDebounceCounter = 0;
-        Serial.printf("Pump %d: State changed to %s\n", p.id, stateToString(p.state));
-      }
-    } else {
-      p.pendingState = targetState;
-      p.stateDebounceCounter = 1;
-    }
-  } else {
-    p.stateDebounceCounter = 0;
-    p.pendingState = p.state;
-  }
-}
-
-/* ================= PROTECTION CONFIG (per-pump NVS) ================= */
-
-void loadPumpProtection(Pump& p) {
-  fl_preferences.begin(p.nvsNamespace, true);
-  p.overcurrentEnabled = fl_preferences.getBool("oc_en", true);
-  p.dryRunEnabled = fl_preferences.getBool("dr_en", true);
-  p.maxCurrentThreshold = fl_preferences.getFloat("max_i", 120.0);
-  p.dryCurrentThreshold = fl_preferences.getFloat("dry_i", 0.5);
-  p.overcurrentDelayS = fl_preferences.getULong("oc_delay", 0);
-  p.dryrunDelayS = fl_preferences.getULong("dr_delay", 0);
-  fl_preferences.end();
-  Serial.printf("Pump %d protection: max=%.1fA, dry=%.1fA, oc_delay=%lus, dr_delay=%lus\n",
-                p.id, p.maxCurrentThreshold, p.dryCurrentThreshold, p.overcurrentDelayS, p.dryrunDelayS);
-}
-
-void savePumpProtection(Pump& p) {
-  fl_preferences.begin(p.nvsNamespace, false);
-  fl_preferences.putBool("oc_en", p.overcurrentEnabled);
-  fl_preferences.putBool("dr_en", p.dryRunEnabled);
-  fl_preferences.putFloat("max_i", p.maxCurrentThreshold);
-  fl_preferences.putFloat("dry_i", p.dryCurrentThreshold);
-  fl_preferences.putULong("oc_delay", p.overcurrentDelayS);
-  fl_preferences.putULong("dr_delay", p.dryrunDelayS);
-  fl_preferences.end();
-  Serial.printf("Pump %d protection saved\n", p.id);
-}
-
-/* ================= SCHEDULE CONFIG (per-pump) ================= */
-
-void loadPumpSchedule(Pump& p) {
-  char ns[12];
-  snprintf(ns, sizeof(ns), "sched_p%d", p.id);
-  fl_preferences.begin(ns, true);
-  p.scheduleEnabled = fl_preferences.getBool("en", false);
-  p.scheduleStartHour = fl_preferences.getUChar("sH", 6);
-  p.scheduleStartMinute = fl_preferences.getUChar("sM", 0);
-  p.scheduleEndHour = fl_preferences.getUChar("eH", 18);
-  p.scheduleEndMinute = fl_preferences.getUChar("eM", 0);
-  p.scheduleDays = fl_preferences.getUChar("days", 0x7F);
-  fl_preferences.end();
-  Serial.printf("Pump %d schedule loaded\n", p.id);
-}
-
-void savePumpSchedule(Pump& p) {
-  char ns[12];
-  snprintf(ns, sizeof(ns), "sched_p%d", p.id);
-  fl_preferences.begin(ns, false);
-  fl_preferences.putBool("en", p.scheduleEnabled);
-  fl_preferences.putUChar("sH", p.scheduleStartHour);
-  fl_preferences.putUChar("sM", p.scheduleStartMinute);
-  fl_preferences.putUChar("eH", p.scheduleEndHour);
-  fl_preferences.putUChar("eM", p.scheduleEndMinute);
-  fl_preferences.putUChar("days", p.scheduleDays);
-  fl_preferences.end();
-  Serial.printf("Pump %d schedule saved\n", p.id);
-}
-
-/* ================= RURAFLEX CONFIG ================= */
-
-void loadRuraflexConfig() {
-  fl_preferences.begin("ruraflex", true);
-  ruraflexEnabled = fl_preferences.getBool("enabled", false);
-  fl_preferences.end();
-  Serial.println("Ruraflex config loaded");
-}
-
-void saveRuraflexConfig() {
-  fl_preferences.begin("ruraflex", false);
-  fl_preferences.putBool("enabled", ruraflexEnabled);
-  fl_preferences.end();
-  Serial.println("Ruraflex config saved");
-}
-
-// Ruraflex TOU time checking (Eskom South Africa 2025/26)
-bool isWithinRuraflex() {
-  if (!ruraflexEnabled) return true;
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo, 10)) return true;
-
-  int month = timeinfo.tm_mon + 1;
-  int dayOfWeek = timeinfo.tm_wday;
-  int hour = timeinfo.tm_hour;
-  int mins = timeinfo.tm_min;
-  int nowMins = hour * 60 + mins;
-
-  bool isHighDemandSeason = (month >= 6 && month <= 8);
-  bool isWeekday = (dayOfWeek >= 1 && dayOfWeek <= 5);
-
-  bool isPeak = false;
-  bool isStandard = false;
-
-  if (isWeekday) {
-    if (isHighDemandSeason) {
-      isPeak = (nowMins >= 360 && nowMins < 480) || (nowMins >= 1020 && nowMins < 1200);
-      isStandard = (nowMins >= 480 && nowMins < 1020) || (nowMins >= 1200 && nowMins < 1320);
-    } else {
-      isPeak = (nowMins >= 420 && nowMins < 540) || (nowMins >= 1020 && nowMins < 1200);
-      isStandard = (nowMins >= 360 && nowMins < 420) || (nowMins >= 540 && nowMins < 1020) || (nowMins >= 1200 && nowMins < 1320);
-    }
-  } else {
-    isPeak = false;
-    isStandard = (nowMins >= 420 && nowMins < 720) || (nowMins >= 1080 && nowMins < 1200);
-  }
+/* ================= CALLBACKS ================= */
 
-  bool isOffPeak = !isPeak && !isStandard;
-  return isOffPeak;
+fl_cmd_status_t eveCommand(fl_cmd_call_t& call) {
+  return eve.handleCommand(call);
 }
 
-bool isWithinSchedule(const Pump& p) {
-  if (ruraflexEnabled) {
-    return isWithinRuraflex();
-  }
-
-  if (!p.scheduleEnabled) return true;
-
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo, 10)) return true;
-
-  if (!(p.scheduleDays & (1 << timeinfo.tm_wday))) {
-    return false;
-  }
-
-  int nowMins = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-  int startMins = p.scheduleStartHour * 60 + p.scheduleStartMinute;
-  int endMins = p.scheduleEndHour * 60 + p.scheduleEndMinute;
-
-  if (startMins <= endMins) {
-    return nowMins >= startMins && nowMins < endMins;
-  } else {
-    return nowMins >= startMins || nowMins < endMins;
-  }
-}
-
-/* ================= MQTT CALLBACK ================= */
-
-// Deferred settings publish — set in callback, executed in loop()
-static volatile bool pendingSettingsPublish = false;
-
-void publishSettings() {
-  static StaticJsonDocument<1024> resp;
-  resp.clear();
-  resp["type"] = "settings";
-
-  for (int i = 0; i < NUM_PUMPS; i++) {
-    char key[8];
-    snprintf(key, sizeof(key), "p%d", i + 1);
-    JsonObject pObj = resp.createNestedObject(key);
-    pObj["overcurrent_enabled"] = pumps[i].overcurrentEnabled;
-    pObj["dryrun_enabled"] = pumps[i].dryRunEnabled;
-    pObj["max_current"] = pumps[i].maxCurrentThreshold;
-    pObj["dry_current"] = pumps[i].dryCurrentThreshold;
-    pObj["overcurrent_delay_s"] = pumps[i].overcurrentDelayS;
-    pObj["dryrun_delay_s"] = pumps[i].dryrunDelayS;
-    pObj["sch_en"] = pumps[i].scheduleEnabled;
-    pObj["sch_sH"] = pumps[i].scheduleStartHour;
-    pObj["sch_sM"] = pumps[i].scheduleStartMinute;
-    pObj["sch_eH"] = pumps[i].scheduleEndHour;
-    pObj["sch_eM"] = pumps[i].scheduleEndMinute;
-    pObj["sch_days"] = pumps[i].scheduleDays;
-  }
-
-  resp["ruraflex_enabled"] = ruraflexEnabled;
-
-  struct tm timeinfo;
-  if (getLocalTime(&timeinfo, 10)) {
-    char timeStr[9];
-    strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-    resp["current_time"] = timeStr;
-  }
-
-  static char buf[1024];
-  size_t len = serializeJson(resp, buf);
-  bool ok = fl_mqtt.publish(fl_TOPIC_TELEMETRY, buf);
-  Serial.printf("Settings published (%d bytes, %s)\n", len, ok ? "OK" : "FAILED");
-}
-
-void eveMqttCallback(const char* cmd, unsigned int length) {
-  // Handle UPDATE_FIRMWARE notification (library handles actual update)
-  {
-    static StaticJsonDocument<512> doc;  // static to avoid stack overflow in TLS callback chain
-    doc.clear();
-    DeserializationError error = deserializeJson(doc, cmd);
-    if (!error) {
-      const char* command = doc["command"];
-      if (!command) goto not_json;
-
-      if (strcmp(command, "UPDATE_FIRMWARE") == 0) {
-        // Stop all pumps for safety during update
-        for (int i = 0; i < NUM_PUMPS; i++) {
-          pumps[i].startCommand = false;
-          fl_setDO(pumps[i].doContactor, false);
-        }
-        return;
-      }
-
-      // Per-pump commands
-      if (strcmp(command, "START") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          Pump& p = pumps[pump - 1];
-          if (p.state == FAULT) {
-            Serial.printf("Pump %d: Cannot START while in FAULT\n", p.id);
-          } else {
-            p.startCommand = true;
-            p.startCommandTime = millis();
-            Serial.printf("Pump %d: Start command accepted\n", p.id);
-          }
-        }
-        return;
-      }
-
-      if (strcmp(command, "STOP") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          Pump& p = pumps[pump - 1];
-          p.startCommand = false;
-          fl_setDO(p.doContactor, false);
-          if (p.state != FAULT) p.state = STOPPED;
-          Serial.printf("Pump %d: Stop command accepted\n", p.id);
-        }
-        return;
-      }
-
-      if (strcmp(command, "RESET") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          resetFault(pumps[pump - 1]);
-        }
-        return;
-      }
-
-      // Aggregate commands
-      if (strcmp(command, "START_ALL") == 0) {
-        for (int i = 0; i < NUM_PUMPS; i++) {
-          if (pumps[i].state != FAULT) {
-            pumps[i].startCommand = true;
-            pumps[i].startCommandTime = millis();
-          }
-        }
-        Serial.println("START_ALL accepted");
-        return;
-      }
-
-      if (strcmp(command, "STOP_ALL") == 0) {
-        for (int i = 0; i < NUM_PUMPS; i++) {
-          pumps[i].startCommand = false;
-          fl_setDO(pumps[i].doContactor, false);
-          if (pumps[i].state != FAULT) pumps[i].state = STOPPED;
-        }
-        Serial.println("STOP_ALL accepted");
-        return;
-      }
-
-      if (strcmp(command, "RESET_ALL") == 0) {
-        for (int i = 0; i < NUM_PUMPS; i++) {
-          resetFault(pumps[i]);
-        }
-        Serial.println("RESET_ALL accepted");
-        return;
-      }
-
-      // Per-pump threshold settings
-      if (strcmp(command, "SET_THRESHOLDS") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          Pump& p = pumps[pump - 1];
-          if (doc.containsKey("max_current")) {
-            float val = doc["max_current"];
-            if (val >= 1.0 && val <= 500.0) p.maxCurrentThreshold = val;
-          }
-          if (doc.containsKey("dry_current")) {
-            float val = doc["dry_current"];
-            if (val >= 0.0 && val <= 50.0) p.dryCurrentThreshold = val;
-          }
-          savePumpProtection(p);
-          Serial.printf("Pump %d: Thresholds updated max=%.1fA dry=%.1fA\n",
-                        p.id, p.maxCurrentThreshold, p.dryCurrentThreshold);
-        }
-        return;
-      }
-
-      if (strcmp(command, "SET_PROTECTION") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          Pump& p = pumps[pump - 1];
-          if (doc.containsKey("overcurrent_enabled"))
-            p.overcurrentEnabled = doc["overcurrent_enabled"];
-          if (doc.containsKey("dryrun_enabled"))
-            p.dryRunEnabled = doc["dryrun_enabled"];
-          savePumpProtection(p);
-          Serial.printf("Pump %d: Protection updated\n", p.id);
-        }
-        return;
-      }
-
-      if (strcmp(command, "SET_DELAYS") == 0) {
-        int pump = doc["pump"] | 0;
-        if (pump >= 1 && pump <= NUM_PUMPS) {
-          Pump& p = pumps[pump - 1];
-          if (doc.containsKey("overcurrent_delay_s")) {
-            uint32_t val = doc["overcurrent_delay_s"];
-            if (val <= 30) p.overcurrentDelayS = val;
-          }
-          if (doc.containsKey("dryrun_delay_s")) {
-            uint32_t val = doc["dryrun_delay_s"];
-            if (val <= 30) p.dryrunDelayS = val;
-          }
-          savePumpProtection(p);
-          Serial.printf("Pump %d: Delays updated oc=%lus dr=%lus\n",
-                        p.id, p.overcurrentDelayS, p.dryrunDelayS);
-        }
-        return;
-      }
-
-      // Per-pump schedule commands (optional "pump" field: 1/2/3, omit = all pumps)
-      if (strcmp(command, "SET_SCHEDULE") == 0) {
-        int pumpIdx = -1;  // -1 = all pumps
-        if (doc.containsKey("pump")) {
-          int pn = doc["pump"];
-          if (pn >= 1 && pn <= NUM_PUMPS) pumpIdx = pn - 1;
-        }
-        for (int i = 0; i < NUM_PUMPS; i++) {
-          if (pumpIdx >= 0 && i != pumpIdx) continue;
-          Pump& p = pumps[i];
-          if (doc.containsKey("enabled"))      p.scheduleEnabled = doc["enabled"];
-          if (doc.containsKey("start_hour"))   p.scheduleStartHour = doc["start_hour"];
-          if (doc.containsKey("start_minute")) p.scheduleStartMinute = doc["start_minute"];
-          if (doc.containsKey("end_hour"))     p.scheduleEndHour = doc["end_hour"];
-          if (doc.containsKey("end_minute"))   p.scheduleEndMinute = doc["end_minute"];
-          if (doc.containsKey("days"))         p.scheduleDays = doc["days"];
-          savePumpSchedule(p);
-        }
-        Serial.println("Schedule updated via MQTT");
-        return;
-      }
-
-      if (strcmp(command, "SET_RURAFLEX") == 0) {
-        if (doc.containsKey("enabled"))
-          ruraflexEnabled = doc["enabled"];
-        saveRuraflexConfig();
-        Serial.println("Ruraflex updated via MQTT");
-        return;
-      }
-
-      // Query settings — defer to main loop (publishing inside MQTT callback
-      // is unreliable with PubSubClient + TLS)
-      if (strcmp(command, "GET_SETTINGS") == 0) {
-        pendingSettingsPublish = true;
-        Serial.println("GET_SETTINGS queued for main loop");
-        return;
-      }
-
-      if (strcmp(command, "STATUS") == 0) {
-        lastTelemetryTime = 0;
-        return;
-      }
-    }
-  }
-
-not_json:
-  // Simple string commands not wrapped in JSON (fallback)
-  Serial.printf("MQTT: Unrecognized command: %s\n", cmd);
-}
-
-/* ================= SERIAL CALLBACK ================= */
-
 void eveSerialCallback(const String& input) {
-  if (input == "STATUS") {
-    Serial.println("\n--- Eve 3-Pump Status ---");
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      Pump& p = pumps[i];
-      Serial.printf("Pump %d: %s | V=%.1f I=%.2f | cmd=%s | cf=%s",
-                    p.id, stateToString(p.state), *(p.voltage), *(p.current),
-                    p.startCommand ? "ON" : "OFF",
-                    p.contactorConfirmed ? "YES" : "NO");
-      if (p.state == FAULT) {
-        Serial.printf(" | fault=%s", faultTypeToString(p.faultType));
-      }
-      Serial.println();
-    }
-    Serial.printf("Sensor: %s | Ruraflex: %s | Schedule: P1=%s P2=%s P3=%s\n",
-                  fl_sensorOnline ? "ONLINE" : "OFFLINE",
-                  ruraflexEnabled ? "ON" : "OFF",
-                  pumps[0].scheduleEnabled ? "ON" : "OFF",
-                  pumps[1].scheduleEnabled ? "ON" : "OFF",
-                  pumps[2].scheduleEnabled ? "ON" : "OFF");
-  }
-  else if (input == "HELP") {
-    Serial.println("START1/2/3   - Start individual pump");
-    Serial.println("STOP1/2/3    - Stop individual pump");
-    Serial.println("FAULT_RESET1/2/3 - Clear pump fault");
-    Serial.println("STARTALL     - Start all pumps");
-    Serial.println("STOPALL      - Stop all pumps");
-    Serial.println("RESETALL     - Reset all faults");
-    Serial.println("STATUS       - Show all pump states");
-  }
-  else if (input.startsWith("START") && input.length() == 6) {
-    int n = input.charAt(5) - '0';
-    if (n >= 1 && n <= NUM_PUMPS) {
-      Pump& p = pumps[n - 1];
-      if (p.state == FAULT) {
-        Serial.printf("Pump %d: Cannot start while in FAULT\n", p.id);
-      } else {
-        p.startCommand = true;
-        p.startCommandTime = millis();
-        Serial.printf("Pump %d: Start command issued\n", p.id);
-      }
-    }
-  }
-  else if (input.startsWith("STOP") && input.length() == 5) {
-    int n = input.charAt(4) - '0';
-    if (n >= 1 && n <= NUM_PUMPS) {
-      Pump& p = pumps[n - 1];
-      p.startCommand = false;
-      fl_setDO(p.doContactor, false);
-      Serial.printf("Pump %d: Stop command issued\n", p.id);
-    }
-  }
-  else if (input.startsWith("FAULT_RESET") && input.length() == 12) {
-    int n = input.charAt(11) - '0';
-    if (n >= 1 && n <= NUM_PUMPS) {
-      resetFault(pumps[n - 1]);
-    }
-  }
-  else if (input == "STARTALL") {
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      if (pumps[i].state != FAULT) {
-        pumps[i].startCommand = true;
-        pumps[i].startCommandTime = millis();
-      }
-    }
-    Serial.println("All pumps: Start command issued");
-  }
-  else if (input == "STOPALL") {
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      pumps[i].startCommand = false;
-      fl_setDO(pumps[i].doContactor, false);
-    }
-    Serial.println("All pumps: Stop command issued");
-  }
-  else if (input == "RESETALL") {
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      resetFault(pumps[i]);
-    }
-    Serial.println("All pump faults reset");
-  }
-}
-
-/* ================= EVE WEB ROUTES ================= */
-
-void setupEveWebRoutes() {
-  // API endpoint for 3-pump status
-  fl_server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (!fl_checkAuth(request)) return;
-    StaticJsonDocument<512> doc;
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      Pump& p = pumps[i];
-      char vk[4], ik[4], sk[4], ck[4], fk[4], cfk[4];
-      snprintf(vk, sizeof(vk), "V%d", p.id);
-      snprintf(ik, sizeof(ik), "I%d", p.id);
-      snprintf(sk, sizeof(sk), "s%d", p.id);
-      snprintf(ck, sizeof(ck), "c%d", p.id);
-      snprintf(fk, sizeof(fk), "f%d", p.id);
-      snprintf(cfk, sizeof(cfk), "cf%d", p.id);
-      doc[vk] = round(*(p.voltage) * 10) / 10.0;
-      doc[ik] = round(*(p.current) * 100) / 100.0;
-      doc[sk] = stateToString(p.state);
-      doc[ck] = p.startCommand;
-      doc[fk] = faultTypeToString(p.faultType);
-      doc[cfk] = p.contactorConfirmed;
-    }
-    doc["sensor"] = fl_sensorOnline;
-    doc["uptime"] = millis() / 1000;
-    doc["network"] = fl_useEthernet ? "ETH" : "WiFi";
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
-  });
-
-  // API endpoint for commands (forwards to MQTT handler)
-  fl_server.on("/api/command", HTTP_POST, [](AsyncWebServerRequest *request){
-    if (!fl_checkAuth(request)) return;
-    if (request->hasParam("cmd", true)) {
-      String cmd = request->getParam("cmd", true)->value();
-      eveMqttCallback(cmd.c_str(), cmd.length());
-      request->send(200, "text/plain", "OK");
-    } else {
-      request->send(400, "text/plain", "Missing cmd parameter");
-    }
-  });
-
-  // Per-pump protection settings API
-  fl_server.on("/api/protection", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (!fl_checkAuth(request)) return;
-    StaticJsonDocument<512> doc;
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      char key[4];
-      snprintf(key, sizeof(key), "p%d", pumps[i].id);
-      JsonObject pObj = doc.createNestedObject(key);
-      pObj["overcurrent_enabled"] = pumps[i].overcurrentEnabled;
-      pObj["dryrun_enabled"] = pumps[i].dryRunEnabled;
-      pObj["max_current"] = pumps[i].maxCurrentThreshold;
-      pObj["dry_current"] = pumps[i].dryCurrentThreshold;
-      pObj["overcurrent_delay_s"] = pumps[i].overcurrentDelayS;
-      pObj["dryrun_delay_s"] = pumps[i].dryrunDelayS;
-    }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
-  });
-
-  // Per-pump schedule settings API
-  fl_server.on("/api/schedule", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (!fl_checkAuth(request)) return;
-    StaticJsonDocument<512> doc;
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      char key[4];
-      snprintf(key, sizeof(key), "p%d", i + 1);
-      JsonObject pObj = doc.createNestedObject(key);
-      pObj["enabled"] = pumps[i].scheduleEnabled;
-      pObj["start_hour"] = pumps[i].scheduleStartHour;
-      pObj["start_minute"] = pumps[i].scheduleStartMinute;
-      pObj["end_hour"] = pumps[i].scheduleEndHour;
-      pObj["end_minute"] = pumps[i].scheduleEndMinute;
-      pObj["days"] = pumps[i].scheduleDays;
-    }
-    doc["ruraflex_enabled"] = ruraflexEnabled;
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo, 10)) {
-      char timeStr[9];
-      strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-      doc["current_time"] = timeStr;
-      doc["current_day"] = timeinfo.tm_wday;
-    }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
-  });
+  eve.handleSerial(input);
 }
 
 /* ================= SETUP ================= */
@@ -1225,8 +389,12 @@ void setup() {
   Serial.printf("Version: %s\n", FW_VERSION);
   Serial.flush();
 
-  // Initialize pump structs
-  initPumps();
+  // Pump defaults (NVS loaded once the network is up)
+  eve.begin();
+
+  // Sensor acquisition in its own task, independent of network stalls
+  fl_setMeterQuantities(FL_QMASK_VI);
+  fl_startSensorTask(SENSOR_READ_INTERVAL_MS);
 
   // Set secrets via setters (library never includes secrets.h)
   fl_setMqttDefaults(DEFAULT_MQTT_HOST, DEFAULT_MQTT_PORT, DEFAULT_MQTT_USER, DEFAULT_MQTT_PASS);
@@ -1247,39 +415,22 @@ void setup() {
   // NTP for South Africa (GMT+2)
   fl_initNTP(2 * 3600);
 
-  // Load configs from NVS
+  // Load configs from NVS; pumps booting within their window start
   fl_loadMqttConfig();
-  for (int i = 0; i < NUM_PUMPS; i++) {
-    loadPumpProtection(pumps[i]);
-  }
-  for (int i = 0; i < NUM_PUMPS; i++) {
-    loadPumpSchedule(pumps[i]);
-  }
-  loadRuraflexConfig();
-
-  // Initialize per-pump schedule state and auto-start if booting within schedule window
-  for (int i = 0; i < NUM_PUMPS; i++) {
-    Pump& p = pumps[i];
-    p.wasWithinSchedule = isWithinSchedule(p);
-    Serial.printf("Pump %d schedule init: %s window\n", p.id, p.wasWithinSchedule ? "within" : "outside");
-    if ((p.scheduleEnabled || ruraflexEnabled) && p.wasWithinSchedule) {
-      p.startCommand = true;
-      Serial.printf("Pump %d: Boot within allowed hours, starting\n", p.id);
-    }
-  }
+  eve.load();
 
   // Set callbacks
-  fl_setMqttCallback(eveMqttCallback);
+  fl_setCommandHandler(eveCommand);
   fl_setSerialCallback(eveSerialCallback);
 
-  // Web server: library routes + eve routes + start
+  // Web server: library routes + pump routes + start
   fl_setDashboardHtml(DASHBOARD_HTML);
   fl_setupWebRoutes();
-  setupEveWebRoutes();
+  eve.setupWebRoutes();
   fl_server.begin();
   Serial.println("Web server started on port 80");
 
-  // Connect to cloud MQTT
+  // Connect to cloud MQTT (in the background, on the connection task)
   fl_connectMQTT();
 
   // Setup ArduinoOTA
@@ -1291,150 +442,14 @@ void setup() {
 /* ================= LOOP ================= */
 
 void loop() {
-  unsigned long now = millis();
-
-  // Library tick: OTA, serial, MQTT reconnect+loop, DI read
+  // Library tick: OTA, serial and queued commands (MQTT, web, serial), DI read
   fl_tick();
 
-  // Deferred settings publish (cannot publish reliably inside MQTT callback)
-  if (pendingSettingsPublish) {
-    pendingSettingsPublish = false;
-    publishSettings();
-  }
+  // Deferred publishes, contactor feedback, state machine per sensor snapshot
+  eve.tick();
 
-  // Deferred Telegram notifications — send one per loop, but yield to
-  // settings requests (Telegram HTTP calls block for ~2s each)
-  if (!pendingSettingsPublish) {
-    for (int i = 0; i < 3; i++) {
-      if (pendingNotifications[i].pending) {
-        pendingNotifications[i].pending = false;
-        fl_sendFaultNotification(pendingNotifications[i].pump,
-                                 pendingNotifications[i].faultType,
-                                 pendingNotifications[i].current);
-        break;  // Only one per loop iteration
-      }
-    }
-  }
-
-  // ===== CONTACTOR FEEDBACK (DI1-DI3) =====
-  for (int i = 0; i < NUM_PUMPS; i++) {
-    Pump& p = pumps[i];
-    bool diFeedback = (fl_diStatus & (1 << p.diFeedbackBit)) != 0;
-    bool contactorOn = (fl_do_state & (1 << p.doContactor)) == 0;  // Active low
-    p.contactorConfirmed = contactorOn && diFeedback;
-  }
-
-  // ===== FORCE UNUSED DO OFF =====
-  // DO mask 0x88 = bits 3 and 7 forced OFF (set to 1 = inactive)
-  // Preserves bits 0,1,2 (contactors) and 4,5,6 (fault alarms)
-  fl_do_state |= 0x88;
-  fl_writeDO();
-
-  // ===== SENSOR READ + STATE MACHINE (every 500ms) =====
-  if (now - lastSensorReadTime >= SENSOR_READ_INTERVAL_MS) {
-    lastSensorReadTime = now;
-    fl_readSensors();
-
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      updatePumpState(pumps[i]);
-    }
-
-    // Check per-pump schedule/Ruraflex
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      Pump& p = pumps[i];
-      bool scheduleAllows = isWithinSchedule(p);
-      if (p.scheduleEnabled || ruraflexEnabled) {
-        if (scheduleAllows && !p.wasWithinSchedule) {
-          if (p.state != FAULT) {
-            p.startCommand = true;
-          }
-          Serial.printf("Schedule: Pump %d entering allowed hours\n", p.id);
-        }
-        if (!scheduleAllows && p.wasWithinSchedule) {
-          p.startCommand = false;
-          Serial.printf("Schedule: Pump %d outside allowed hours\n", p.id);
-        }
-      }
-      // Always track schedule state — even when schedule is disabled.
-      // Prevents stale wasWithinSchedule causing unexpected auto-start
-      // if schedule is re-enabled while outside the window.
-      p.wasWithinSchedule = scheduleAllows;
-    }
-
-    // Update DO outputs per pump
-    // Uses scheduleAllows already computed above (avoids redundant isWithinSchedule call)
-    for (int i = 0; i < NUM_PUMPS; i++) {
-      Pump& p = pumps[i];
-      bool desiredDO = (p.startCommand && p.state != FAULT && p.wasWithinSchedule);
-      // Always enforce contactor state — don't rely on lastDOState tracking
-      // to catch edge cases (fault clear, schedule toggle, etc.)
-      fl_setDO(p.doContactor, desiredDO);
-      if (desiredDO != p.lastDOState) {
-        Serial.printf("Pump %d contactor: %s\n", p.id, desiredDO ? "ON" : "OFF");
-        p.lastDOState = desiredDO;
-      }
-    }
-  }
-
-  // ===== TELEMETRY PUBLISH (every 2000ms) =====
-  if (now - lastTelemetryTime >= TELEMETRY_INTERVAL_MS) {
-    lastTelemetryTime = now;
-
-    if (fl_mqttConnected && fl_mqtt.connected()) {
-      StaticJsonDocument<768> doc;
-
-      for (int i = 0; i < NUM_PUMPS; i++) {
-        Pump& p = pumps[i];
-        char vk[4], ik[4], sk[4], ck[4], fk[4], cfk[4];
-        snprintf(vk, sizeof(vk), "V%d", p.id);
-        snprintf(ik, sizeof(ik), "I%d", p.id);
-        snprintf(sk, sizeof(sk), "s%d", p.id);
-        snprintf(ck, sizeof(ck), "c%d", p.id);
-        snprintf(fk, sizeof(fk), "f%d", p.id);
-        snprintf(cfk, sizeof(cfk), "cf%d", p.id);
-        doc[vk] = round(*(p.voltage) * 10) / 10.0;
-        doc[ik] = round(*(p.current) * 100) / 100.0;
-        doc[sk] = stateToString(p.state);
-        doc[ck] = p.startCommand;
-        doc[fk] = faultTypeToString(p.faultType);
-        doc[cfk] = p.contactorConfirmed;
-      }
-
-      doc["sensor"] = fl_sensorOnline;
-      doc["uptime"] = now / 1000;
-      doc["network"] = fl_useEthernet ? "ETH" : "WiFi";
-      doc["di"] = fl_diStatus;
-      doc["do"] = fl_do_state;
-      doc["hardware_type"] = HW_TYPE;
-      doc["firmware_version"] = FW_VERSION;
-
-      struct tm timeinfo;
-      if (getLocalTime(&timeinfo, 10)) {
-        char timeStr[9];
-        strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-        doc["time"] = timeStr;
-      }
-
-      char buf[1024];
-      size_t len = serializeJson(doc, buf);
-
-      bool published = fl_mqtt.publish(fl_TOPIC_TELEMETRY, buf);
-      if (published) {
-        fl_mqttPublishFailCount = 0;
-        fl_lastMqttActivity = now;
-      } else {
-        fl_mqttPublishFailCount++;
-        Serial.printf("MQTT publish failed (count=%d, len=%d)\n", fl_mqttPublishFailCount, len);
-
-        if (fl_mqttPublishFailCount >= FL_MAX_MQTT_PUBLISH_FAILURES) {
-          Serial.println("Too many publish failures - forcing MQTT reconnect");
-          fl_mqtt.disconnect();
-          fl_mqttConnected = false;
-          fl_mqttPublishFailCount = 0;
-        }
-      }
-    }
-  }
+  // ===== TELEMETRY PUBLISH (on change, deadband or heartbeat; see SET_TELEMETRY) =====
+  eve.reportTelemetry(HW_TYPE, FW_VERSION);
 
   delay(10);
 }
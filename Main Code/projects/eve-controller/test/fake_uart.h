@@ -0,0 +1,67 @@
+#ifndef FAKE_UART_H
+#define FAKE_UART_H
+
+// Fake RS485 UART for the Modbus suites: RX bytes become readable at their
+// scheduled time on a fake clock, and a reply generator runs when the
+// master finishes writing a request. Include after unity.h and the RTU
+// master.
+
+#define RX_CAP 8192
+
+static uint32_t fakeNowUs;
+static uint8_t rxData[RX_CAP];
+static uint32_t rxAtUs[RX_CAP];
+static size_t rxHead, rxTail;
+static uint8_t txData[64];
+static size_t txLen;
+static bool txDrained;
+static bool deOn;
+static bool deAtWrite;
+static uint32_t readsThisPoll;
+
+// Reply generator, run when the master finishes writing a request
+static void (*onRequest)(const uint8_t* req, size_t len);
+
+static int fakeAvailable() {
+  size_t n = 0;
+  for (size_t i = rxHead; i < rxTail && rxAtUs[i] <= fakeNowUs; i++) n++;
+  return (int)n;
+}
+
+static int fakeRead() {
+  if (rxHead >= rxTail || rxAtUs[rxHead] > fakeNowUs) return -1;
+  readsThisPoll++;
+  return rxData[rxHead++];
+}
+
+static size_t fakeWrite(const uint8_t* data, size_t len) {
+  deAtWrite = deOn;
+  memcpy(txData, data, len);
+  txLen = len;
+  txDrained = false;
+  if (onRequest) onRequest(data, len);
+  return len;
+}
+
+static bool fakeTxDone() {
+  // Drains on the poll after the write
+  bool done = txDrained;
+  txDrained = true;
+  return done;
+}
+
+static void fakeSetDE(bool on) { deOn = on; }
+
+static const fl_rtu_port_t fakePort = {
+  fakeAvailable, fakeRead, fakeWrite, fakeTxDone, fakeSetDE
+};
+
+static void rxPush(uint8_t b, uint32_t atUs) {
+  if (rxHead == rxTail) rxHead = rxTail = 0;   // Everything read: start over
+  TEST_ASSERT_LESS_THAN(RX_CAP, rxTail);
+  rxData[rxTail] = b;
+  rxAtUs[rxTail] = atUs;
+  rxTail++;
+}
+
+#endif
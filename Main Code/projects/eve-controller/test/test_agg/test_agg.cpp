@@ -0,0 +1,99 @@
+// Host tests for the streaming aggregates: empty windows, NaN readings
+// skipped, min/max/mean, RMS against closed forms, and the precision of the
+// longest window.
+
+#include <unity.h>
+#include <math.h>
+#include "fl_agg.cpp"
+
+static fl_agg_t a;
+
+void setUp(void) {
+  fl_aggReset(a);
+}
+
+void tearDown(void) {}
+
+void test_empty_window_is_nan(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, a.n);
+  TEST_ASSERT_TRUE(isnan(fl_aggMin(a)));
+  TEST_ASSERT_TRUE(isnan(fl_aggMax(a)));
+  TEST_ASSERT_TRUE(isnan(fl_aggMean(a)));
+  TEST_ASSERT_TRUE(isnan(fl_aggRms(a)));
+}
+
+void test_nan_samples_skipped(void) {
+  fl_aggAdd(a, NAN);
+  TEST_ASSERT_EQUAL_UINT32(0, a.n);
+  TEST_ASSERT_TRUE(isnan(fl_aggMean(a)));
+
+  // A dropout between readings leaves every statistic as if it never came
+  const float x[] = { 3.0f, NAN, -1.0f, NAN, NAN, 4.0f };
+  for (float v : x) fl_aggAdd(a, v);
+  TEST_ASSERT_EQUAL_UINT32(3, a.n);
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, fl_aggMin(a));
+  TEST_ASSERT_EQUAL_FLOAT(4.0f, fl_aggMax(a));
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, fl_aggMean(a));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, sqrtf(26.0f / 3), fl_aggRms(a));
+}
+
+void test_first_sample_sets_min_and_max(void) {
+  // A zeroed aggregate must not report 0 as the minimum of positive readings
+  fl_aggAdd(a, 230.5f);
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, fl_aggMin(a));
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, fl_aggMax(a));
+  fl_aggAdd(a, 229.0f);
+  fl_aggAdd(a, 231.0f);
+  TEST_ASSERT_EQUAL_FLOAT(229.0f, fl_aggMin(a));
+  TEST_ASSERT_EQUAL_FLOAT(231.0f, fl_aggMax(a));
+}
+
+void test_rms_of_dc_and_sine(void) {
+  for (int k = 0; k < 100; k++) fl_aggAdd(a, -12.5f);
+  TEST_ASSERT_EQUAL_FLOAT(12.5f, fl_aggRms(a));
+  TEST_ASSERT_EQUAL_FLOAT(-12.5f, fl_aggMean(a));
+
+  // Whole periods of a sine: RMS is peak / sqrt(2), mean zero
+  fl_aggReset(a);
+  const int perPeriod = 40;
+  for (int k = 0; k < 10 * perPeriod; k++) fl_aggAdd(a, 325.0f * sinf(2 * M_PI * k / perPeriod));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 325.0f / sqrtf(2), fl_aggRms(a));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, fl_aggMean(a));
+
+  // DC offset plus ripple: RMS^2 = mean^2 + ripple^2 / 2
+  fl_aggReset(a);
+  for (int k = 0; k < 10 * perPeriod; k++) fl_aggAdd(a, 10.0f + 2.0f * sinf(2 * M_PI * k / perPeriod));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, sqrtf(100.0f + 2.0f), fl_aggRms(a));
+}
+
+void test_longest_window_keeps_precision(void) {
+  // The longest window at 100 samples a second, 230 V with some ripple.
+  // A float sum drifts by a few tenths of a volt over this many samples.
+  const uint32_t samples = FL_AGG_MAX_WINDOW_S * 100;
+  for (uint32_t k = 0; k < samples; k++) fl_aggAdd(a, 230.0f + 0.37f * sinf(k * 0.61f));
+  TEST_ASSERT_EQUAL_UINT32(samples, a.n);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 230.0f, fl_aggMean(a));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, sqrtf(230.0f * 230.0f + 0.37f * 0.37f / 2), fl_aggRms(a));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 229.63f, fl_aggMin(a));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 230.37f, fl_aggMax(a));
+}
+
+void test_reset_starts_a_new_window(void) {
+  fl_aggAdd(a, 100.0f);
+  fl_aggReset(a);
+  fl_aggAdd(a, 1.0f);
+  TEST_ASSERT_EQUAL_UINT32(1, a.n);
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, fl_aggMax(a));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, fl_aggMean(a));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_window_is_nan);
+  RUN_TEST(test_nan_samples_skipped);
+  RUN_TEST(test_first_sample_sets_min_and_max);
+  RUN_TEST(test_rms_of_dc_and_sine);
+  RUN_TEST(test_longest_window_keeps_precision);
+  RUN_TEST(test_reset_starts_a_new_window);
+  return UNITY_END();
+}
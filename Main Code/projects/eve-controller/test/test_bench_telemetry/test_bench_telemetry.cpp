@@ -0,0 +1,199 @@
+// Telemetry encode benchmark: fl_jsonw straight into a buffer against the
+// ArduinoJson path it replaced (StaticJsonDocument<768> filled with
+// round(x * 10) / 10.0 doubles, then serializeJson into a stack buffer).
+// Reports time per frame and the stack each path touches.
+
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include "fl_jsonw.cpp"
+
+#define PUMPS        3
+#define FRAMES       200000
+#define PAINT_BYTES  16384
+#define PAINT        0xA5
+
+struct frame_t {
+  float V[PUMPS];
+  float I[PUMPS];
+  const char* state[PUMPS];
+  const char* fault[PUMPS];
+  bool cmd[PUMPS];
+  bool confirmed[PUMPS];
+  float thermal[PUMPS];
+  bool sensor;
+  uint32_t uptime;
+  uint8_t di, dout;
+};
+
+static const char* const kV[PUMPS]  = { "V1", "V2", "V3" };
+static const char* const kI[PUMPS]  = { "I1", "I2", "I3" };
+static const char* const kS[PUMPS]  = { "S1", "S2", "S3" };
+static const char* const kC[PUMPS]  = { "C1", "C2", "C3" };
+static const char* const kF[PUMPS]  = { "F1", "F2", "F3" };
+static const char* const kCf[PUMPS] = { "CF1", "CF2", "CF3" };
+static const char* const kTh[PUMPS] = { "TH1", "TH2", "TH3" };
+
+static frame_t frame;
+static volatile size_t sink;
+
+static void makeFrame(uint32_t n) {
+  for (uint8_t i = 0; i < PUMPS; i++) {
+    frame.V[i] = 228.0f + (float)((n + i * 7) % 50) * 0.137f;
+    frame.I[i] = 9.5f + (float)((n * 3 + i) % 40) * 0.0731f;
+    frame.state[i] = i == 2 ? "STOPPED" : "RUNNING";
+    frame.fault[i] = "";
+    frame.cmd[i] = i != 2;
+    frame.confirmed[i] = i != 2;
+    frame.thermal[i] = 40.0f + i;
+  }
+  frame.sensor = true;
+  frame.uptime = 86400 + n;
+  frame.di = 0x05;
+  frame.dout = 0x03;
+}
+
+// ---- The two encoders, noinline so each owns its own stack frame ----
+
+__attribute__((noinline)) static size_t encodeJsonw(char* buf, size_t cap) {
+  fl_jsonw_t w;
+  fl_jsonwBegin(w, buf, cap);
+  for (uint8_t i = 0; i < PUMPS; i++) {
+    fl_jsonwFixed(w, kV[i], frame.V[i], 1);
+    fl_jsonwFixed(w, kI[i], frame.I[i], 2);
+    fl_jsonwStr(w, kS[i], frame.state[i]);
+    fl_jsonwBool(w, kC[i], frame.cmd[i]);
+    fl_jsonwStr(w, kF[i], frame.fault[i]);
+    fl_jsonwBool(w, kCf[i], frame.confirmed[i]);
+    fl_jsonwFixed(w, kTh[i], frame.thermal[i], 0);
+  }
+  fl_jsonwBool(w, "sensor", frame.sensor);
+  fl_jsonwUInt(w, "uptime", frame.uptime);
+  fl_jsonwStr(w, "network", "ETH");
+  fl_jsonwUInt(w, "di", frame.di);
+  fl_jsonwUInt(w, "do", frame.dout);
+  fl_jsonwStr(w, "hardware_type", "EVE");
+  fl_jsonwStr(w, "firmware_version", "2.11.0");
+  fl_jsonwStr(w, "time", "12:34:56");
+  return fl_jsonwEnd(w);
+}
+
+__attribute__((noinline)) static size_t encodeArduinoJson(char* out, size_t cap) {
+  StaticJsonDocument<768> doc;
+  for (uint8_t i = 0; i < PUMPS; i++) {
+    doc[kV[i]] = round(frame.V[i] * 10) / 10.0;
+    doc[kI[i]] = round(frame.I[i] * 100) / 100.0;
+    doc[kS[i]] = frame.state[i];
+    doc[kC[i]] = frame.cmd[i];
+    doc[kF[i]] = frame.fault[i];
+    doc[kCf[i]] = frame.confirmed[i];
+    doc[kTh[i]] = round(frame.thermal[i]);
+  }
+  doc["sensor"] = frame.sensor;
+  doc["uptime"] = frame.uptime;
+  doc["network"] = "ETH";
+  doc["di"] = frame.di;
+  doc["do"] = frame.dout;
+  doc["hardware_type"] = "EVE";
+  doc["firmware_version"] = "2.11.0";
+  doc["time"] = "12:34:56";
+
+  char buf[1024];
+  size_t len = serializeJson(doc, buf);
+  if (len >= cap) return 0;
+  memcpy(out, buf, len + 1);
+  return len;
+}
+
+// ---- Stack high-water mark by painting ----
+// paintStack() and stackUsed() share a call depth, so their arrays cover
+// the same addresses; whatever the encoder wrote below its caller shows up
+// as overwritten paint. Approximate (frame layout is the compiler's), but
+// plenty to compare two paths that differ by kilobytes. Reading the
+// "uninitialised" array is the whole point.
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+
+__attribute__((noinline)) static void paintStack() {
+  volatile uint8_t area[PAINT_BYTES];
+  for (size_t i = 0; i < PAINT_BYTES; i++) area[i] = PAINT;
+}
+
+__attribute__((noinline)) static size_t stackUsed() {
+  volatile uint8_t area[PAINT_BYTES];
+  size_t untouched = 0;
+  while (untouched < PAINT_BYTES && area[untouched] == PAINT) untouched++;
+  return PAINT_BYTES - untouched;
+}
+
+#pragma GCC diagnostic pop
+
+static char out[1024];
+
+template <typename F>
+static size_t measureStack(F encode) {
+  paintStack();
+  sink = encode(out, sizeof(out));
+  return stackUsed();
+}
+
+template <typename F>
+static double measureNs(F encode) {
+  auto begin = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < FRAMES; n++) {
+    makeFrame(n);
+    sink = encode(out, sizeof(out));
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() / FRAMES;
+}
+
+void setUp(void) { makeFrame(0); }
+void tearDown(void) {}
+
+void test_both_paths_encode_the_frame(void) {
+  char a[1024];
+  TEST_ASSERT_GREATER_THAN(0, encodeJsonw(a, sizeof(a)));
+  TEST_ASSERT_GREATER_THAN(0, encodeArduinoJson(out, sizeof(out)));
+  TEST_MESSAGE(a);
+}
+
+void test_overflow_reports_zero(void) {
+  char small[64];
+  TEST_ASSERT_EQUAL(0, encodeJsonw(small, sizeof(small)));
+}
+
+void test_benchmark_encode_time(void) {
+  double jsonw = measureNs(encodeJsonw);
+  double aj = measureNs(encodeArduinoJson);
+  char msg[128];
+  snprintf(msg, sizeof(msg), "encode: fl_jsonw %.0f ns/frame, ArduinoJson %.0f ns/frame (%.1fx)",
+           jsonw, aj, aj / jsonw);
+  TEST_MESSAGE(msg);
+}
+
+void test_benchmark_stack_use(void) {
+  size_t jsonw = measureStack(encodeJsonw);
+  size_t aj = measureStack(encodeArduinoJson);
+  char msg[128];
+  snprintf(msg, sizeof(msg), "stack: fl_jsonw ~%u bytes, ArduinoJson ~%u bytes",
+           (unsigned)jsonw, (unsigned)aj);
+  TEST_MESSAGE(msg);
+  // The document and its serialisation buffer alone are 1.8 KB
+  TEST_ASSERT_LESS_THAN(aj, jsonw);
+  TEST_ASSERT_LESS_THAN(512, jsonw);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_both_paths_encode_the_frame);
+  RUN_TEST(test_overflow_reports_zero);
+  RUN_TEST(test_benchmark_encode_time);
+  RUN_TEST(test_benchmark_stack_use);
+  return UNITY_END();
+}
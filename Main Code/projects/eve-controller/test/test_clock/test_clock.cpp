@@ -0,0 +1,154 @@
+// Host tests for the wall-clock bookkeeping: the unset clock at boot, the
+// first NTP set, steps against free-running drift, the drift recorded at
+// each sync, and the sync age behind SYNCED and STALE.
+
+#include <unity.h>
+#include <stdlib.h>
+#include "fl_clock.cpp"
+
+// Tuesday 14 July 2026 10:00:00 SAST
+#define SET_EPOCH  1784016000LL
+
+static fl_clock_t c;
+static fl_clock_ref_t ref;
+
+// Boot: the system clock starts at 1970 alongside millis()
+static int64_t wall;
+static uint32_t ms;
+
+static void tick(uint32_t dt) {
+  wall += dt;
+  ms += dt;
+  fl_clockUpdate(c, ref, wall, ms);
+}
+
+// SNTP sets the system clock to 'to' and reports it
+static void ntpSet(int64_t to) {
+  wall = to;
+  fl_clockSynced(c, ref, wall, ms);
+  fl_clockUpdate(c, ref, wall, ms);
+}
+
+void setUp(void) {
+  setenv("TZ", "SAST-2", 1);
+  tzset();
+  c = {};
+  ref = {};
+  wall = 0;
+  ms = 0;
+}
+
+void tearDown(void) {}
+
+void test_unset_at_boot(void) {
+  tick(1500);
+  tick(1000);
+  TEST_ASSERT_FALSE(c.valid);
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_UNSET, c.sync);
+  TEST_ASSERT_EQUAL_STRING("", c.hms);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, c.syncAgeS);
+  TEST_ASSERT_EQUAL_UINT32(0, c.steps);
+  TEST_ASSERT_EQUAL_STRING("unset", fl_clockSyncToString(c.sync));
+}
+
+void test_first_sync_sets_the_clock(void) {
+  tick(4000);
+  ntpSet(SET_EPOCH * 1000 + 250);
+  TEST_ASSERT_TRUE(c.valid);
+  TEST_ASSERT_EQUAL_UINT32(1, c.steps);
+  TEST_ASSERT_EQUAL_UINT32(1, c.syncs);
+  TEST_ASSERT_EQUAL_INT32(0, c.driftMs);      // Nothing to compare against yet
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_SYNCED, c.sync);
+  TEST_ASSERT_EQUAL_UINT32(0, c.syncAgeS);
+  TEST_ASSERT_EQUAL_INT64(SET_EPOCH, c.epoch);
+  TEST_ASSERT_EQUAL_STRING("10:00:00", c.hms);
+  TEST_ASSERT_EQUAL_UINT16(600, c.minuteOfDay);
+  TEST_ASSERT_EQUAL_UINT16(2 * 1440 + 600, c.minuteOfWeek);
+}
+
+void test_steps_and_drift(void) {
+  ntpSet(SET_EPOCH * 1000);
+  uint32_t steps = c.steps;
+  // Free-running seconds, and a slow drift, are not steps
+  for (int k = 0; k < 60; k++) tick(1000);
+  wall += 1500;
+  tick(1000);
+  wall -= 1999;
+  tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(steps, c.steps);
+  // Past FL_CLOCK_STEP_MS either way they are
+  wall += FL_CLOCK_STEP_MS + 1;
+  tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(steps + 1, c.steps);
+  wall -= FL_CLOCK_STEP_MS + 1;
+  tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(steps + 2, c.steps);
+  // Exactly the limit is not
+  wall += FL_CLOCK_STEP_MS;
+  tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(steps + 2, c.steps);
+}
+
+void test_sync_records_drift(void) {
+  ntpSet(SET_EPOCH * 1000);
+  for (int k = 0; k < 3600; k++) tick(1000);
+  // The local clock fell 800 ms behind over the hour
+  uint32_t steps = c.steps;
+  ntpSet(wall + 800);
+  TEST_ASSERT_EQUAL_INT32(800, c.driftMs);
+  TEST_ASSERT_EQUAL_UINT32(2, c.syncs);
+  TEST_ASSERT_EQUAL_UINT32(steps, c.steps);
+  // And ran 5 s ahead before the next: a step as well as a drift
+  for (int k = 0; k < 3600; k++) tick(1000);
+  ntpSet(wall - 5000);
+  TEST_ASSERT_EQUAL_INT32(-5000, c.driftMs);
+  TEST_ASSERT_EQUAL_UINT32(steps + 1, c.steps);
+}
+
+void test_sync_age_and_stale(void) {
+  ntpSet(SET_EPOCH * 1000);
+  for (uint32_t k = 0; k < FL_CLOCK_STALE_S - 1; k++) tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(FL_CLOCK_STALE_S - 1, c.syncAgeS);
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_SYNCED, c.sync);
+  tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(FL_CLOCK_STALE_S, c.syncAgeS);
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_STALE, c.sync);
+  TEST_ASSERT_EQUAL_STRING("stale", fl_clockSyncToString(c.sync));
+  // The next sync brings it back
+  ntpSet(wall);
+  TEST_ASSERT_EQUAL_UINT32(0, c.syncAgeS);
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_SYNCED, c.sync);
+}
+
+void test_set_without_ntp_is_stale(void) {
+  // Set by hand (serial or a command), never synced
+  tick(1000);
+  wall = SET_EPOCH * 1000;
+  tick(1000);
+  TEST_ASSERT_TRUE(c.valid);
+  TEST_ASSERT_EQUAL_UINT32(1, c.steps);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, c.syncAgeS);
+  TEST_ASSERT_EQUAL_UINT8(FL_CLOCK_STALE, c.sync);
+}
+
+void test_millis_wrap(void) {
+  ms = 0xFFFFFFFFu - 30000;
+  ref.atMillis = ms;
+  ntpSet(SET_EPOCH * 1000);
+  uint32_t steps = c.steps;
+  for (int k = 0; k < 60; k++) tick(1000);
+  TEST_ASSERT_EQUAL_UINT32(steps, c.steps);
+  TEST_ASSERT_EQUAL_UINT32(60, c.syncAgeS);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unset_at_boot);
+  RUN_TEST(test_first_sync_sets_the_clock);
+  RUN_TEST(test_steps_and_drift);
+  RUN_TEST(test_sync_records_drift);
+  RUN_TEST(test_sync_age_and_stale);
+  RUN_TEST(test_set_without_ntp_is_stale);
+  RUN_TEST(test_millis_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,242 @@
+// Host tests for the command registry: the compile-time perfect hash,
+// schema validation and handler refusal through fl_cmdDispatch, and the
+// id parsing and recent-id memory behind duplicate suppression.
+
+#include <unity.h>
+#include "fl_command_check.cpp"
+
+struct ctx_t {
+  uint32_t runs;
+  long pump;
+  float limit;
+};
+
+static bool accept(ctx_t& c, fl_cmd_call_t&) {
+  c.runs++;
+  return true;
+}
+
+// The Eve controller's command names, plus the library's
+static constexpr auto names = fl_cmdTable<ctx_t>({
+  { "UPDATE_FIRMWARE", {}, accept }, { "START", {}, accept },          { "STOP", {}, accept },
+  { "RESET", {}, accept },           { "START_ALL", {}, accept },      { "STOP_ALL", {}, accept },
+  { "RESET_ALL", {}, accept },       { "SET_THRESHOLDS", {}, accept }, { "SET_PROTECTION", {}, accept },
+  { "SET_DELAYS", {}, accept },      { "SET_THERMAL", {}, accept },    { "SET_SCHEDULE", {}, accept },
+  { "SET_RURAFLEX", {}, accept },    { "SET_TARIFF", {}, accept },     { "SET_INRUSH", {}, accept },
+  { "SET_TELEMETRY", {}, accept },   { "SET_METER", {}, accept },      { "GET_SETTINGS", {}, accept },
+  { "STATUS", {}, accept },
+});
+
+static constexpr size_t kNames = sizeof(names.defs) / sizeof(names.defs[0]);
+
+// Checked by the compiler; a duplicate name in a table does not compile at all
+static_assert(fl_cmdSlots(16) == 32 && fl_cmdSlots(19) == 64, "at least twice the commands, a power of two");
+static_assert(fl_cmdSameName("START", "START") && !fl_cmdSameName("START", "START_ALL"), "name compare");
+static_assert(names.seed != 0, "table built at compile time");
+
+static constexpr auto table = fl_cmdTable<ctx_t>({
+  { "SET_LIMIT", { fl_argInt("pump", 1, 3, true), fl_argNum("limit", 0.5f, 500), fl_argBool("enabled"),
+                   fl_argStr("label"), fl_argObj("cfg"), fl_argArr("days") },
+    [](ctx_t& c, fl_cmd_call_t& call) {
+      c.runs++;
+      c.pump = call.args["pump"];
+      c.limit = call.args["limit"] | -1.0f;
+      return true;
+    } },
+  { "REFUSE", {}, [](ctx_t& c, fl_cmd_call_t&) {
+      c.runs++;
+      return false;
+    } },
+  { "REFUSE_WHY", {}, [](ctx_t& c, fl_cmd_call_t& call) {
+      c.runs++;
+      call.error = "pump in fault";
+      return false;
+    } },
+});
+
+static StaticJsonDocument<FL_CMD_ARENA_BYTES> doc;
+static fl_cmd_call_t call;
+static ctx_t ctx;
+
+static void parse(const char* json) {
+  TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  call = { nullptr, doc.as<JsonObjectConst>(), FL_CMD_MQTT, nullptr, nullptr, 0, false };
+  call.name = call.args["command"];
+}
+
+static fl_cmd_status_t run(const char* json) {
+  parse(json);
+  return fl_cmdDispatch(table, ctx, call);
+}
+
+void setUp(void) {
+  ctx = ctx_t{};
+}
+
+void tearDown(void) {}
+
+void test_table_finds_every_name(void) {
+  uint8_t used = 0;
+  for (uint8_t k = 0; k < names.kSlots; k++) used += names.slot[k] != 0;
+  TEST_ASSERT_EQUAL_UINT8(kNames, used);
+  for (size_t i = 0; i < kNames; i++) {
+    const fl_cmd_def_t<ctx_t>* def = fl_cmdFind(names, names.defs[i].name);
+    TEST_ASSERT_NOT_NULL(def);
+    TEST_ASSERT_EQUAL_STRING(names.defs[i].name, def->name);
+  }
+}
+
+void test_table_misses_near_names(void) {
+  const char* misses[] = { "", "start", "STAR", "STARTS", "START_ALL ", "SET_", "GET_SETTING",
+                           "UPDATE_FIRMWARE_", "STATUS\n", "SET_LIMIT" };
+  for (const char* name : misses) TEST_ASSERT_NULL(fl_cmdFind(names, name));
+
+  // Every string landing in an occupied slot is still compared in full
+  char name[8];
+  uint32_t hits = 0;
+  for (uint32_t n = 0; n < 100000; n++) {
+    snprintf(name, sizeof(name), "C%05lu", (unsigned long)n);
+    if (fl_cmdFind(names, name)) hits++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, hits);
+}
+
+void test_dispatch_valid_command(void) {
+  TEST_ASSERT_EQUAL(FL_CMD_DONE, run("{\"command\":\"SET_LIMIT\",\"pump\":2,\"limit\":12.5,\"enabled\":true,"
+                                     "\"label\":\"borehole\",\"cfg\":{\"a\":1},\"days\":[1,2]}"));
+  TEST_ASSERT_EQUAL_UINT32(1, ctx.runs);
+  TEST_ASSERT_EQUAL_INT32(2, ctx.pump);
+  TEST_ASSERT_EQUAL_FLOAT(12.5f, ctx.limit);
+  TEST_ASSERT_NULL(call.error);
+}
+
+void test_optional_args_may_be_absent(void) {
+  TEST_ASSERT_EQUAL(FL_CMD_DONE, run("{\"command\":\"SET_LIMIT\",\"pump\":1}"));
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, ctx.limit);
+  TEST_ASSERT_EQUAL(FL_CMD_DONE, run("{\"command\":\"SET_LIMIT\",\"pump\":1,\"limit\":null}"));
+  // An integer is a number; 0 and 1 are booleans
+  TEST_ASSERT_EQUAL(FL_CMD_DONE, run("{\"command\":\"SET_LIMIT\",\"pump\":3,\"limit\":20,\"enabled\":0}"));
+  TEST_ASSERT_EQUAL(FL_CMD_DONE, run("{\"command\":\"SET_LIMIT\",\"pump\":3,\"enabled\":1}"));
+}
+
+void test_unknown_command(void) {
+  TEST_ASSERT_EQUAL(FL_CMD_UNKNOWN, run("{\"command\":\"SET_LIMITS\",\"pump\":1}"));
+  TEST_ASSERT_EQUAL_UINT32(0, ctx.runs);
+}
+
+void test_schema_rejections(void) {
+  struct {
+    const char* json;
+    const char* error;
+  } cases[] = {
+    { "{\"command\":\"SET_LIMIT\"}", "'pump' missing" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":\"2\"}", "'pump' not an integer" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":2.5}", "'pump' not an integer" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":0}", "'pump' out of range" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":4}", "'pump' out of range" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":-1}", "'pump' out of range" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"limit\":\"12\"}", "'limit' not a number" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"limit\":0.4}", "'limit' out of range" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"limit\":500.5}", "'limit' out of range" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"enabled\":2}", "'enabled' not a boolean" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"enabled\":\"true\"}", "'enabled' not a boolean" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"label\":5}", "'label' not a string" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"cfg\":[]}", "'cfg' not an object" },
+    { "{\"command\":\"SET_LIMIT\",\"pump\":1,\"days\":{}}", "'days' not an array" },
+  };
+  for (auto& c : cases) {
+    TEST_ASSERT_EQUAL(FL_CMD_REJECTED, run(c.json));
+    TEST_ASSERT_EQUAL_STRING(c.error, call.error);
+  }
+  // The handler never saw any of them
+  TEST_ASSERT_EQUAL_UINT32(0, ctx.runs);
+}
+
+void test_handler_refusal(void) {
+  TEST_ASSERT_EQUAL(FL_CMD_REJECTED, run("{\"command\":\"REFUSE\"}"));
+  TEST_ASSERT_EQUAL_STRING("refused", call.error);
+  TEST_ASSERT_EQUAL(FL_CMD_REJECTED, run("{\"command\":\"REFUSE_WHY\"}"));
+  TEST_ASSERT_EQUAL_STRING("pump in fault", call.error);
+  TEST_ASSERT_EQUAL_UINT32(2, ctx.runs);
+}
+
+static bool readId(const char* json, fl_cmd_id_t& id) {
+  if (deserializeJson(doc, json)) return false;
+  return fl_cmdReadId(doc.as<JsonObjectConst>(), id);
+}
+
+void test_read_id(void) {
+  fl_cmd_id_t id;
+  TEST_ASSERT_TRUE(readId("{\"command\":\"STOP\"}", id));
+  TEST_ASSERT_EQUAL_STRING("", id.text);
+
+  TEST_ASSERT_TRUE(readId("{\"id\":-42}", id));
+  TEST_ASSERT_TRUE(id.numeric);
+  TEST_ASSERT_EQUAL_INT32(-42, id.number);
+  TEST_ASSERT_EQUAL_STRING("-42", id.text);
+
+  TEST_ASSERT_TRUE(readId("{\"id\":\"a1\"}", id));
+  TEST_ASSERT_FALSE(id.numeric);
+  TEST_ASSERT_EQUAL_STRING("a1", id.text);
+
+  // FL_CMD_ID_MAX characters fit; one more does not
+  TEST_ASSERT_TRUE(readId("{\"id\":\"0123456789012345678901234567890123456789\"}", id));
+  TEST_ASSERT_FALSE(readId("{\"id\":\"01234567890123456789012345678901234567890\"}", id));
+
+  const char* bad[] = { "{\"id\":\"\"}", "{\"id\":1.5}", "{\"id\":true}", "{\"id\":{}}",
+                        "{\"id\":3000000000}" };
+  for (const char* json : bad) TEST_ASSERT_FALSE(readId(json, id));
+}
+
+void test_recent_ids(void) {
+  fl_cmd_recent_t recent = {};
+  fl_cmd_id_t seven, sevenText, other;
+  TEST_ASSERT_TRUE(readId("{\"id\":7}", seven));
+  TEST_ASSERT_TRUE(readId("{\"id\":\"7\"}", sevenText));
+  TEST_ASSERT_TRUE(readId("{\"id\":\"b2\"}", other));
+
+  TEST_ASSERT_NULL(fl_cmdRecentFind(recent, seven));
+  fl_cmdRecentAdd(recent, seven, true);
+  fl_cmdRecentAdd(recent, other, false);
+
+  const fl_cmd_seen_t* s = fl_cmdRecentFind(recent, seven);
+  TEST_ASSERT_NOT_NULL(s);
+  TEST_ASSERT_TRUE(s->ok);
+  // Same text, different type: a different command
+  TEST_ASSERT_NULL(fl_cmdRecentFind(recent, sevenText));
+  // A refused command is answered as refused again
+  s = fl_cmdRecentFind(recent, other);
+  TEST_ASSERT_NOT_NULL(s);
+  TEST_ASSERT_FALSE(s->ok);
+}
+
+void test_recent_ids_forget_oldest(void) {
+  fl_cmd_recent_t recent = {};
+  fl_cmd_id_t id = {};
+  for (int32_t n = 0; n < FL_CMD_RECENT_IDS + 4; n++) {
+    id.numeric = true;
+    id.number = n;
+    snprintf(id.text, sizeof(id.text), "%ld", (long)n);
+    fl_cmdRecentAdd(recent, id, true);
+  }
+  for (int32_t n = 0; n < FL_CMD_RECENT_IDS + 4; n++) {
+    snprintf(id.text, sizeof(id.text), "%ld", (long)n);
+    if (n < 4) TEST_ASSERT_NULL(fl_cmdRecentFind(recent, id));
+    else TEST_ASSERT_NOT_NULL(fl_cmdRecentFind(recent, id));
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_finds_every_name);
+  RUN_TEST(test_table_misses_near_names);
+  RUN_TEST(test_dispatch_valid_command);
+  RUN_TEST(test_optional_args_may_be_absent);
+  RUN_TEST(test_unknown_command);
+  RUN_TEST(test_schema_rejections);
+  RUN_TEST(test_handler_refusal);
+  RUN_TEST(test_read_id);
+  RUN_TEST(test_recent_ids);
+  RUN_TEST(test_recent_ids_forget_oldest);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+// Host tests for the broker connection state machine: the backoff doubling,
+// its cap and jitter bounds, the reset on reaching UP, per-state timeouts
+// and time accounting, and a session lost in UP.
+
+#include <unity.h>
+#include "fl_conn.cpp"
+
+static fl_conn_t c;
+
+// One full attempt from LINK to UP, 'step' ms per state
+static uint32_t connect(uint32_t now, uint32_t step) {
+  for (uint8_t s = FL_CONN_DHCP; s <= FL_CONN_UP; s++) {
+    if (s == FL_CONN_TLS) continue;       // Plain TCP broker
+    now += step;
+    fl_connEnter(c, (fl_conn_state_t)s, now);
+  }
+  return now;
+}
+
+void setUp(void) {
+  fl_connInit(c, 0);
+}
+
+void tearDown(void) {}
+
+/* ---- Backoff ---- */
+
+void test_backoff_doubles_to_cap(void) {
+  // Mid-range jitter (random = base / 4) gives the unjittered base
+  const uint32_t expect[] = { 1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000, 60000 };
+  uint32_t now = 0;
+  for (uint32_t base : expect) {
+    fl_connFail(c, now, base / 4);
+    TEST_ASSERT_EQUAL_UINT8(FL_CONN_BACKOFF, fl_connState(c));
+    TEST_ASSERT_EQUAL_UINT32(base, c.backoffMs);
+    now += c.backoffMs;
+    TEST_ASSERT_TRUE(fl_connExpired(c, now));
+    fl_connEnter(c, FL_CONN_LINK, now);
+  }
+  TEST_ASSERT_EQUAL_UINT8(9, c.attempts);
+}
+
+void test_backoff_jitter_bounds(void) {
+  // Every attempt count, extreme and arbitrary random words: always within
+  // +/-25 % of the base, and the extremes reach both ends
+  uint32_t base = FL_CONN_BACKOFF_MIN_MS;
+  for (uint8_t attempt = 1; attempt <= 12; attempt++) {
+    const uint32_t words[] = { 0, 1, base / 2, base / 2 + 1, 0x9E3779B9u, UINT32_MAX };
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint32_t r : words) {
+      c.attempts = attempt - 1;
+      fl_connFail(c, 0, r);
+      if (c.backoffMs < lo) lo = c.backoffMs;
+      if (c.backoffMs > hi) hi = c.backoffMs;
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(base - base / 4, c.backoffMs);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(base + base / 4, c.backoffMs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(base - base / 4, lo);
+    TEST_ASSERT_EQUAL_UINT32(base + base / 4, hi);
+    if (base < FL_CONN_BACKOFF_MAX_MS) base = base * 2 > FL_CONN_BACKOFF_MAX_MS ? FL_CONN_BACKOFF_MAX_MS : base * 2;
+  }
+}
+
+void test_attempts_saturate(void) {
+  for (uint32_t k = 0; k < 300; k++) fl_connFail(c, k, 0);
+  TEST_ASSERT_EQUAL_UINT8(255, c.attempts);
+  TEST_ASSERT_EQUAL_UINT32(FL_CONN_BACKOFF_MAX_MS - FL_CONN_BACKOFF_MAX_MS / 4, c.backoffMs);
+}
+
+void test_up_resets_backoff(void) {
+  for (uint8_t k = 0; k < 5; k++) fl_connFail(c, 0, 0);
+  TEST_ASSERT_EQUAL_UINT8(5, c.attempts);
+  fl_connEnter(c, FL_CONN_LINK, 20000);
+  connect(20000, 100);
+  TEST_ASSERT_EQUAL_UINT8(FL_CONN_UP, fl_connState(c));
+  TEST_ASSERT_EQUAL_UINT8(0, c.attempts);
+  TEST_ASSERT_EQUAL_UINT32(1, c.sessions);
+  // The next failure starts again from the minimum
+  fl_connLost(c, 30000);
+  fl_connFail(c, 30000, FL_CONN_BACKOFF_MIN_MS / 4);
+  TEST_ASSERT_EQUAL_UINT32(FL_CONN_BACKOFF_MIN_MS, c.backoffMs);
+}
+
+/* ---- Timeouts ---- */
+
+void test_state_timeouts(void) {
+  const fl_conn_state_t steps[] = { FL_CONN_LINK, FL_CONN_DHCP, FL_CONN_DNS, FL_CONN_TCP,
+                                    FL_CONN_TLS, FL_CONN_MQTT, FL_CONN_SUBSCRIBE };
+  uint32_t now = 1000;
+  for (fl_conn_state_t s : steps) {
+    fl_connEnter(c, s, now);
+    uint32_t limit = fl_connTimeoutMs(s);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, limit);
+    TEST_ASSERT_FALSE(fl_connExpired(c, now + limit - 1));
+    TEST_ASSERT_TRUE(fl_connExpired(c, now + limit));
+    now += limit;
+  }
+  // UP never times out
+  fl_connEnter(c, FL_CONN_UP, now);
+  TEST_ASSERT_FALSE(fl_connExpired(c, now + 0x7FFFFFFF));
+}
+
+void test_expiry_across_millis_wrap(void) {
+  uint32_t now = 0xFFFFF000u;
+  fl_connEnter(c, FL_CONN_DNS, now);
+  TEST_ASSERT_FALSE(fl_connExpired(c, now + FL_CONN_DNS_TIMEOUT_MS - 1));
+  TEST_ASSERT_TRUE(fl_connExpired(c, now + FL_CONN_DNS_TIMEOUT_MS));
+}
+
+/* ---- Accounting ---- */
+
+void test_per_state_accounting(void) {
+  // First attempt: DNS times out after 5 s
+  uint32_t now = 0;
+  fl_connEnter(c, FL_CONN_DHCP, now += 2000);
+  fl_connEnter(c, FL_CONN_DNS, now += 300);
+  fl_connFail(c, now += FL_CONN_DNS_TIMEOUT_MS, 0);
+  TEST_ASSERT_EQUAL_UINT8(FL_CONN_DNS, c.failedIn);
+  // Second attempt gets through after the backoff
+  now += c.backoffMs;
+  fl_connEnter(c, FL_CONN_LINK, now);
+  now = connect(now, 700);
+
+  const fl_conn_stats_t& link = c.stats[FL_CONN_LINK];
+  TEST_ASSERT_EQUAL_UINT32(2, link.entries);
+  TEST_ASSERT_EQUAL_UINT32(2000 + 700, link.totalMs);
+  TEST_ASSERT_EQUAL_UINT32(700, link.lastMs);
+  TEST_ASSERT_EQUAL_UINT32(2000, link.maxMs);
+
+  const fl_conn_stats_t& dns = c.stats[FL_CONN_DNS];
+  TEST_ASSERT_EQUAL_UINT32(2, dns.entries);
+  TEST_ASSERT_EQUAL_UINT32(1, dns.failures);
+  TEST_ASSERT_EQUAL_UINT32(FL_CONN_DNS_TIMEOUT_MS + 700, dns.totalMs);
+  TEST_ASSERT_EQUAL_UINT32(FL_CONN_DNS_TIMEOUT_MS, dns.maxMs);
+
+  TEST_ASSERT_EQUAL_UINT32(1, c.stats[FL_CONN_BACKOFF].entries);
+  TEST_ASSERT_EQUAL_UINT32(c.backoffMs, c.stats[FL_CONN_BACKOFF].totalMs);
+  TEST_ASSERT_EQUAL_UINT32(0, c.stats[FL_CONN_TLS].entries);
+  // The open UP visit is not in the totals yet
+  TEST_ASSERT_EQUAL_UINT32(1, c.stats[FL_CONN_UP].entries);
+  TEST_ASSERT_EQUAL_UINT32(0, c.stats[FL_CONN_UP].totalMs);
+  TEST_ASSERT_EQUAL_UINT32(0, fl_connElapsed(c, now));
+}
+
+void test_lost_in_up(void) {
+  uint32_t now = connect(0, 100);
+  uint32_t upAt = now;
+  now += 3600000;
+  fl_connLost(c, now);
+  // Straight back to LINK: no backoff, attempts untouched
+  TEST_ASSERT_EQUAL_UINT8(FL_CONN_LINK, fl_connState(c));
+  TEST_ASSERT_EQUAL_UINT8(0, c.attempts);
+  TEST_ASSERT_EQUAL_UINT8(FL_CONN_UP, c.failedIn);
+  TEST_ASSERT_EQUAL_UINT32(0, c.stats[FL_CONN_BACKOFF].entries);
+  const fl_conn_stats_t& up = c.stats[FL_CONN_UP];
+  TEST_ASSERT_EQUAL_UINT32(1, up.failures);
+  TEST_ASSERT_EQUAL_UINT32(now - upAt, up.totalMs);
+  TEST_ASSERT_EQUAL_UINT32(now - upAt, up.lastMs);
+  TEST_ASSERT_EQUAL_UINT32(2, c.stats[FL_CONN_LINK].entries);
+
+  // A second session counts as one more
+  connect(now, 100);
+  TEST_ASSERT_EQUAL_UINT32(2, c.sessions);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_to_cap);
+  RUN_TEST(test_backoff_jitter_bounds);
+  RUN_TEST(test_attempts_saturate);
+  RUN_TEST(test_up_resets_backoff);
+  RUN_TEST(test_state_timeouts);
+  RUN_TEST(test_expiry_across_millis_wrap);
+  RUN_TEST(test_per_state_accounting);
+  RUN_TEST(test_lost_in_up);
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+// Host tests for the lifetime counters: run time with its sub-second carry,
+// energy integration (gaps, dropouts, an open contactor), the time, energy
+// and contactor-open checkpoints, and the x100 telemetry units.
+
+#include <unity.h>
+#include <math.h>
+#include "fl_counters.cpp"
+
+static fl_counters_t c;
+
+void setUp(void) {
+  fl_countersRestore(c, 0, 0, 0, 0, 0);
+}
+
+void tearDown(void) {}
+
+/* ---- Run time ---- */
+
+void test_run_time_carries_sub_seconds(void) {
+  // 333 ms loop passes for ten minutes: nothing lost to the remainders
+  uint32_t now = 0;
+  fl_countersRun(c, now, true);       // First pass only takes the reference
+  for (uint32_t k = 0; k < 1800; k++) fl_countersRun(c, now += 333, true);
+  TEST_ASSERT_EQUAL_UINT32(599, c.runS);
+  TEST_ASSERT_EQUAL_UINT16(400, c.runMs);
+  fl_countersRun(c, now += 600, true);
+  TEST_ASSERT_EQUAL_UINT32(600, c.runS);
+  TEST_ASSERT_EQUAL_UINT16(0, c.runMs);
+}
+
+void test_run_time_only_while_running(void) {
+  uint32_t now = 1000;
+  fl_countersRun(c, now, false);
+  fl_countersRun(c, now += 5000, true);   // The stopped stretch before this pass is not run time
+  TEST_ASSERT_EQUAL_UINT32(5, c.runS);
+  fl_countersRun(c, now += 5000, false);
+  fl_countersRun(c, now += 5000, false);
+  TEST_ASSERT_EQUAL_UINT32(5, c.runS);
+  fl_countersRun(c, now += 2000, true);
+  TEST_ASSERT_EQUAL_UINT32(7, c.runS);
+}
+
+void test_run_time_across_millis_wrap(void) {
+  uint32_t now = 0xFFFFF000u;
+  fl_countersRun(c, now, true);
+  for (uint32_t k = 0; k < 100; k++) fl_countersRun(c, now += 100, true);
+  TEST_ASSERT_EQUAL_UINT32(10, c.runS);
+}
+
+/* ---- Energy ---- */
+
+void test_energy_integrates_samples(void) {
+  // 2.3 kW sampled every 200 ms for an hour
+  uint32_t t = 0;
+  for (uint32_t k = 0; k <= 18000; k++, t += 200) fl_countersSample(c, t, 2300.0f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 2300.0f, (float)c.wh);
+}
+
+void test_energy_skips_gaps_and_dropouts(void) {
+  uint32_t t = 0;
+  fl_countersSample(c, t, 3600.0f);
+  fl_countersSample(c, t += 1000, 3600.0f);        // 1 Wh
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f, (float)c.wh);
+  // A gap longer than FL_COUNTERS_MAX_GAP_MS (meter offline) is not guessed at
+  fl_countersSample(c, t += FL_COUNTERS_MAX_GAP_MS + 1, 3600.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f, (float)c.wh);
+  // A NaN reading breaks the chain: the next sample only takes the reference
+  fl_countersSample(c, t += 1000, NAN);
+  fl_countersSample(c, t += 1000, 3600.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f, (float)c.wh);
+  fl_countersSample(c, t += 1000, 3600.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f, (float)c.wh);
+  // Contactor open (0 W) and a negative reading add nothing
+  fl_countersSample(c, t += 1000, 0.0f);
+  fl_countersSample(c, t += 1000, -50.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f, (float)c.wh);
+  // Exactly the longest gap still counts
+  fl_countersSample(c, t += FL_COUNTERS_MAX_GAP_MS, 3600.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f + FL_COUNTERS_MAX_GAP_MS / 1000.0f, (float)c.wh);
+}
+
+/* ---- Checkpoints ---- */
+
+void test_time_checkpoint(void) {
+  uint32_t now = 10000;
+  fl_countersRestore(c, 5000, 100, 3, 1, now);
+  TEST_ASSERT_FALSE(fl_countersDirty(c));
+  // Nothing changed: never due, however long
+  TEST_ASSERT_FALSE(fl_countersSaveDue(c, now + 10 * FL_COUNTERS_SAVE_INTERVAL_S * 1000UL));
+
+  fl_countersRun(c, now, true);
+  fl_countersRun(c, now += 1000, true);
+  TEST_ASSERT_TRUE(fl_countersDirty(c));
+  TEST_ASSERT_FALSE(fl_countersSaveDue(c, 10000 + FL_COUNTERS_SAVE_INTERVAL_S * 1000UL - 1));
+  TEST_ASSERT_TRUE(fl_countersSaveDue(c, 10000 + FL_COUNTERS_SAVE_INTERVAL_S * 1000UL));
+
+  fl_countersSaved(c, now = 10000 + FL_COUNTERS_SAVE_INTERVAL_S * 1000UL);
+  TEST_ASSERT_FALSE(fl_countersDirty(c));
+  TEST_ASSERT_EQUAL_UINT32(101, c.savedRunS);
+}
+
+void test_energy_checkpoint(void) {
+  fl_countersRestore(c, 5000, 0, 0, 0, 0);
+  // 36 kW for 99.9 s is 999 Wh: not yet
+  uint32_t t = 0;
+  for (uint32_t k = 0; k <= 999; k++, t += 100) fl_countersSample(c, t, 36000.0f);
+  TEST_ASSERT_EQUAL_UINT32(5999, (uint32_t)c.wh);
+  TEST_ASSERT_FALSE(fl_countersSaveDue(c, t));
+  fl_countersSample(c, t, 36000.0f);
+  TEST_ASSERT_EQUAL_UINT32(6000, (uint32_t)c.wh);
+  TEST_ASSERT_TRUE(fl_countersSaveDue(c, t));
+  fl_countersSaved(c, t);
+  TEST_ASSERT_EQUAL_UINT32(6000, c.savedWh);
+  TEST_ASSERT_FALSE(fl_countersSaveDue(c, t));
+}
+
+void test_contactor_open_checkpoint(void) {
+  // A short run stays under both thresholds, so only the save the
+  // controller makes when the contactor opens keeps it
+  uint32_t now = 0;
+  fl_countersStart(c);
+  fl_countersRun(c, now, true);
+  for (uint32_t k = 0; k < 1200; k++) {
+    now += 100;
+    fl_countersRun(c, now, true);
+    fl_countersSample(c, now, 1500.0f);
+  }
+  TEST_ASSERT_FALSE(fl_countersSaveDue(c, now));
+  TEST_ASSERT_TRUE(fl_countersDirty(c));
+  fl_countersRun(c, now, false);
+
+  // What the controller writes on open, then a reboot restoring it
+  uint32_t wh = (uint32_t)c.wh, runS = c.runS, starts = c.starts;
+  fl_countersSaved(c, now);
+  TEST_ASSERT_FALSE(fl_countersDirty(c));
+  fl_counters_t after;
+  fl_countersRestore(after, wh, runS, starts, c.faults, 0);
+  TEST_ASSERT_EQUAL_UINT32(120, after.runS);
+  TEST_ASSERT_EQUAL_UINT32(49, (uint32_t)after.wh);     // 50 Wh less the first sample's reference
+  TEST_ASSERT_EQUAL_UINT32(1, after.starts);
+  TEST_ASSERT_FALSE(fl_countersDirty(after));
+}
+
+void test_starts_and_faults_dirty(void) {
+  fl_countersFault(c);
+  TEST_ASSERT_TRUE(fl_countersDirty(c));
+  TEST_ASSERT_TRUE(fl_countersSaveDue(c, FL_COUNTERS_SAVE_INTERVAL_S * 1000UL));
+  fl_countersSaved(c, 0);
+  fl_countersStart(c);
+  TEST_ASSERT_TRUE(fl_countersDirty(c));
+}
+
+/* ---- Telemetry units ---- */
+
+void test_centi_units_truncate(void) {
+  // kWh x100 is whole 10 Wh steps, never rounded up past what is stored
+  c.wh = 9.99;
+  TEST_ASSERT_EQUAL_UINT32(0, fl_countersCentiKwh(c));
+  c.wh = 10.0;
+  TEST_ASSERT_EQUAL_UINT32(1, fl_countersCentiKwh(c));
+  c.wh = 123456.7;
+  TEST_ASSERT_EQUAL_UINT32(12345, fl_countersCentiKwh(c));
+  c.wh = 4.0e9;                   // Near the top of the uint32 Wh kept in NVS
+  TEST_ASSERT_EQUAL_UINT32(400000000u, fl_countersCentiKwh(c));
+
+  c.runS = 35;
+  TEST_ASSERT_EQUAL_UINT32(0, fl_countersCentiHours(c));
+  c.runS = 3599;
+  TEST_ASSERT_EQUAL_UINT32(99, fl_countersCentiHours(c));
+  c.runS = 3600;
+  TEST_ASSERT_EQUAL_UINT32(100, fl_countersCentiHours(c));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_run_time_carries_sub_seconds);
+  RUN_TEST(test_run_time_only_while_running);
+  RUN_TEST(test_run_time_across_millis_wrap);
+  RUN_TEST(test_energy_integrates_samples);
+  RUN_TEST(test_energy_skips_gaps_and_dropouts);
+  RUN_TEST(test_time_checkpoint);
+  RUN_TEST(test_energy_checkpoint);
+  RUN_TEST(test_contactor_open_checkpoint);
+  RUN_TEST(test_starts_and_faults_dirty);
+  RUN_TEST(test_centi_units_truncate);
+  return UNITY_END();
+}
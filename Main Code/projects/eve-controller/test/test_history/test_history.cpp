@@ -0,0 +1,291 @@
+// Host tests for the on-device history: Gorilla codec round trip, range
+// queries and buckets, and the flash ring (flush, remount, overwrite) over
+// a RAM flash fake.
+
+#include <unity.h>
+#include "fl_history.cpp"
+#include <stdio.h>
+
+#define SECTORS  4
+#define SIZE     (SECTORS * FL_HISTORY_BLOCK)
+#define T0       1700000000u
+
+// The device's history region: the 0x170000 spiffs partition less the
+// journal's FL_JOURNAL_REGION (0x70000)
+#define DEVICE_SIZE  0x100000
+
+// ---- RAM flash: writes only clear bits, erase sets a sector to 0xFF ----
+
+static uint8_t flash[DEVICE_SIZE];
+
+static bool ramRead(uint32_t addr, void* dst, size_t len) {
+  if (addr + len > sizeof(flash)) return false;
+  memcpy(dst, flash + addr, len);
+  return true;
+}
+
+static bool ramWrite(uint32_t addr, const void* src, size_t len) {
+  if (addr + len > sizeof(flash)) return false;
+  const uint8_t* s = (const uint8_t*)src;
+  for (size_t k = 0; k < len; k++) flash[addr + k] &= s[k];
+  return true;
+}
+
+static bool ramErase(uint32_t addr) {
+  if (addr % FL_HISTORY_BLOCK || addr >= sizeof(flash)) return false;
+  memset(flash + addr, 0xFF, FL_HISTORY_BLOCK);
+  return true;
+}
+
+static const fl_flash_port_t ramPort = { ramRead, ramWrite, ramErase };
+
+// Mount allocates the open blocks; each test takes a fresh store
+static fl_history_t* h;
+static fl_history_query_t* q;
+
+static fl_history_t& mount(const fl_flash_port_t* port, uint8_t series = 2, uint32_t size = SIZE) {
+  h = new fl_history_t();
+  fl_historyMount(*h, series, port, size);
+  return *h;
+}
+
+// A pump cycling through start, run and stop with a little noise
+static fl_history_point_t pointAt(uint32_t n) {
+  fl_history_point_t p;
+  p.ts = T0 + n * FL_HISTORY_DEFAULT_STEP_S;
+  p.state = (n / 50) % 3;
+  p.v = 229.0f + (float)((n * 7) % 13) * 0.1f;
+  p.i = p.state == 1 ? 10.0f + (float)((n * 5) % 9) * 0.01f : 0.0f;
+  if (n % 97 == 0) p.v = NAN;   // Sensor dropout
+  return p;
+}
+
+static void fill(fl_history_t& hist, uint8_t series, uint32_t from, uint32_t count) {
+  for (uint32_t n = from; n < from + count; n++) {
+    TEST_ASSERT_TRUE(fl_historyAppend(hist, series, pointAt(n)));
+  }
+}
+
+// Query at the recording step, so every row is one point; checks each
+// against the quantised original and counts them
+static void checkRange(const fl_history_t& hist, uint8_t series, uint32_t first, uint32_t last,
+                       uint32_t& rows) {
+  fl_historyQueryBegin(hist, *q, series, T0 + first * FL_HISTORY_DEFAULT_STEP_S,
+                       T0 + last * FL_HISTORY_DEFAULT_STEP_S, FL_HISTORY_DEFAULT_STEP_S);
+  uint32_t n = first;
+  fl_history_row_t row;
+  rows = 0;
+  while (fl_historyQueryNext(hist, *q, row)) {
+    fl_history_point_t p = pointAt(n);
+    TEST_ASSERT_EQUAL_UINT32(p.ts, row.ts);
+    TEST_ASSERT_EQUAL_UINT16(1, row.n);
+    TEST_ASSERT_EQUAL_UINT8(p.state, row.state);
+    if (isnan(p.v)) TEST_ASSERT_TRUE(isnan(row.v));
+    else TEST_ASSERT_EQUAL_FLOAT(quantise(p.v, 10), row.v);
+    TEST_ASSERT_EQUAL_FLOAT(quantise(p.i, 100), row.i);
+    n++;
+    rows++;
+  }
+}
+
+void setUp(void) {
+  memset(flash, 0xFF, sizeof(flash));
+  q = new fl_history_query_t();
+}
+
+void tearDown(void) {
+  delete q;
+}
+
+void test_codec_round_trip_in_ram(void) {
+  fl_history_t& hist = mount(nullptr);
+  TEST_ASSERT_TRUE(hist.ready);
+  fill(hist, 0, 0, 300);
+  uint32_t rows;
+  checkRange(hist, 0, 0, 299, rows);
+  TEST_ASSERT_EQUAL_UINT32(300, rows);
+  // The other series is untouched
+  checkRange(hist, 1, 0, 299, rows);
+  TEST_ASSERT_EQUAL_UINT32(0, rows);
+}
+
+void test_irregular_timestamps_round_trip(void) {
+  fl_history_t& hist = mount(nullptr);
+  // Every delta-of-delta width, including a jump of a day
+  const uint32_t gaps[] = { 10, 10, 11, 9, 70, 10, 300, 10, 2000, 10, 86400, 10, 1 };
+  uint32_t ts = T0;
+  for (uint8_t k = 0; k < sizeof(gaps) / sizeof(gaps[0]); k++) {
+    ts += gaps[k];
+    fl_history_point_t p = { ts, 230.0f, 1.0f + k, (uint8_t)(k & 0xF) };
+    TEST_ASSERT_TRUE(fl_historyAppend(hist, 0, p));
+  }
+  fl_historyQueryBegin(hist, *q, 0, T0, ts, 1);
+  fl_history_row_t row;
+  uint32_t expect = T0;
+  for (uint8_t k = 0; k < sizeof(gaps) / sizeof(gaps[0]); k++) {
+    expect += gaps[k];
+    TEST_ASSERT_TRUE(fl_historyQueryNext(hist, *q, row));
+    TEST_ASSERT_EQUAL_UINT32(expect, row.ts);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f + k, row.i);
+    TEST_ASSERT_EQUAL_UINT8(k & 0xF, row.state);
+  }
+  TEST_ASSERT_FALSE(fl_historyQueryNext(hist, *q, row));
+}
+
+void test_steady_signal_codes_small(void) {
+  fl_history_t& hist = mount(nullptr);
+  for (uint32_t n = 0; n < 1000; n++) {
+    fl_history_point_t p = { T0 + n * 10, 230.0f, 10.5f, 1 };
+    fl_historyAppend(hist, 0, p);
+  }
+  // One bit each for time, V, I and state after the first point
+  TEST_ASSERT_LESS_THAN_FLOAT(4.2f, fl_historyBitsPerPoint(hist));
+}
+
+void test_out_of_order_dropped(void) {
+  fl_history_t& hist = mount(nullptr);
+  fill(hist, 0, 0, 5);
+  TEST_ASSERT_FALSE(fl_historyAppend(hist, 0, pointAt(4)));
+  TEST_ASSERT_FALSE(fl_historyAppend(hist, 0, pointAt(2)));
+  TEST_ASSERT_EQUAL_UINT32(2, hist.dropped);
+  TEST_ASSERT_FALSE(fl_historyAppend(hist, 5, pointAt(9)));
+  uint32_t rows;
+  checkRange(hist, 0, 0, 10, rows);
+  TEST_ASSERT_EQUAL_UINT32(5, rows);
+}
+
+void test_buckets_average_and_peak(void) {
+  fl_history_t& hist = mount(nullptr);
+  // Six points a minute: I 10..15, V alternating 229/231
+  for (uint32_t n = 0; n < 12; n++) {
+    fl_history_point_t p = { T0 + n * 10, n % 2 ? 231.0f : 229.0f, 10.0f + n % 6, (uint8_t)(n / 6) };
+    fl_historyAppend(hist, 0, p);
+  }
+  fl_historyQueryBegin(hist, *q, 0, T0, T0 + 3600, 60);
+  fl_history_row_t row;
+  for (uint8_t b = 0; b < 2; b++) {
+    TEST_ASSERT_TRUE(fl_historyQueryNext(hist, *q, row));
+    TEST_ASSERT_EQUAL_UINT32(T0 + b * 60, row.ts);
+    TEST_ASSERT_EQUAL_UINT16(6, row.n);
+    TEST_ASSERT_EQUAL_FLOAT(230.0f, row.v);
+    TEST_ASSERT_EQUAL_FLOAT(12.5f, row.i);
+    TEST_ASSERT_EQUAL_FLOAT(15.0f, row.iMax);
+    TEST_ASSERT_EQUAL_UINT8(b, row.state);
+  }
+  TEST_ASSERT_FALSE(fl_historyQueryNext(hist, *q, row));
+}
+
+void test_flush_to_flash_and_query_across(void) {
+  fl_history_t& hist = mount(&ramPort);
+  // Enough to fill more than two blocks of series 0
+  const uint32_t points = 2500;
+  fill(hist, 0, 0, points);
+  fill(hist, 1, 0, 10);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, hist.blocks);
+  TEST_ASSERT_EQUAL_UINT32(0, hist.errors);
+  uint32_t rows;
+  checkRange(hist, 0, 0, points - 1, rows);
+  TEST_ASSERT_EQUAL_UINT32(points, rows);
+  // A window in the middle starts from the right block
+  checkRange(hist, 0, 1200, 1300, rows);
+  TEST_ASSERT_EQUAL_UINT32(101, rows);
+
+  char msg[64];
+  snprintf(msg, sizeof(msg), "%.1f bits per point (104 raw)", fl_historyBitsPerPoint(hist));
+  TEST_MESSAGE(msg);
+}
+
+void test_remount_finds_flash_blocks(void) {
+  fl_history_t& before = mount(&ramPort);
+  fill(before, 0, 0, 2500);
+  uint32_t blocks = before.blocks;
+
+  fl_history_t& after = mount(&ramPort);
+  TEST_ASSERT_EQUAL_UINT32(blocks, after.headSeq.load());
+  TEST_ASSERT_EQUAL_UINT32(T0, fl_historyOldest(after, 0));
+  // Only what reached flash survives: whole blocks from the start
+  uint32_t rows;
+  checkRange(after, 0, 0, 2499, rows);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, rows);
+  TEST_ASSERT_LESS_THAN_UINT32(2500, rows);
+  // And recording carries on after it
+  fill(after, 0, 2500, 10);
+  checkRange(after, 0, 2500, 2509, rows);
+  TEST_ASSERT_EQUAL_UINT32(10, rows);
+}
+
+void test_ring_overwrites_oldest_block(void) {
+  fl_history_t& hist = mount(&ramPort, 1);
+  fill(hist, 0, 0, 8000);
+  TEST_ASSERT_GREATER_THAN_UINT32(SECTORS, hist.blocks);
+  uint32_t oldest = fl_historyOldest(hist, 0);
+  TEST_ASSERT_GREATER_THAN_UINT32(T0, oldest);
+
+  // Everything from the oldest surviving point on, without gaps
+  uint32_t first = (oldest - T0) / FL_HISTORY_DEFAULT_STEP_S;
+  uint32_t rows;
+  checkRange(hist, 0, first, 7999, rows);
+  TEST_ASSERT_EQUAL_UINT32(8000 - first, rows);
+  checkRange(hist, 0, 0, first - 1, rows);
+  TEST_ASSERT_EQUAL_UINT32(0, rows);
+}
+
+// Three pumps at the default step on the device's region, run until the
+// ring has wrapped. The span still held must match the coded size per
+// point: region payload / (3 x 8640 points a day x bits per point).
+void test_device_region_holds_a_week(void) {
+  const uint8_t pumps = 3;
+  const uint32_t perDay = 86400 / FL_HISTORY_DEFAULT_STEP_S;
+  const uint32_t days = 10;
+  fl_history_t& hist = mount(&ramPort, pumps, DEVICE_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(256, hist.sectors);
+  for (uint32_t n = 0; n < days * perDay; n++)
+    for (uint8_t s = 0; s < pumps; s++) TEST_ASSERT_TRUE(fl_historyAppend(hist, s, pointAt(n)));
+  TEST_ASSERT_EQUAL_UINT32(0, hist.errors);
+  TEST_ASSERT_GREATER_THAN_UINT32(hist.sectors, hist.blocks);
+
+  float bits = fl_historyBitsPerPoint(hist);
+  float expectDays = (float)hist.sectors * FL_HISTORY_PAYLOAD * 8 / (pumps * perDay * bits);
+  uint32_t newest = T0 + (days * perDay - 1) * FL_HISTORY_DEFAULT_STEP_S;
+  for (uint8_t s = 0; s < pumps; s++) {
+    float heldDays = (float)(newest - fl_historyOldest(hist, s)) / 86400;
+    TEST_ASSERT_FLOAT_WITHIN(0.05f * expectDays, expectDays, heldDays);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(7, (uint32_t)heldDays);
+    TEST_ASSERT_LESS_THAN_UINT32(8, (uint32_t)heldDays);
+  }
+  // Noisy readings code to ~43 bits per point against 104 raw
+  TEST_ASSERT_FLOAT_WITHIN(3.0f, 43.0f, bits);
+
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%.1f bits per point, %.2f days for %u pumps in 1 MB", bits, expectDays, pumps);
+  TEST_MESSAGE(msg);
+}
+
+void test_torn_block_ignored(void) {
+  fl_history_t& hist = mount(&ramPort, 1);
+  fill(hist, 0, 0, 2500);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, hist.blocks);
+  // A power cut before the header went down: the newest block has no magic
+  memset(flash + addrOf(hist, hist.headSeq.load()), 0xFF, sizeof(fl_history_block_t));
+
+  fl_history_t& after = mount(&ramPort, 1);
+  TEST_ASSERT_EQUAL_UINT32(hist.blocks - 1, after.headSeq.load());
+  uint32_t rows;
+  checkRange(after, 0, 0, 2499, rows);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, rows);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_codec_round_trip_in_ram);
+  RUN_TEST(test_irregular_timestamps_round_trip);
+  RUN_TEST(test_steady_signal_codes_small);
+  RUN_TEST(test_out_of_order_dropped);
+  RUN_TEST(test_buckets_average_and_peak);
+  RUN_TEST(test_flush_to_flash_and_query_across);
+  RUN_TEST(test_remount_finds_flash_blocks);
+  RUN_TEST(test_ring_overwrites_oldest_block);
+  RUN_TEST(test_device_region_holds_a_week);
+  RUN_TEST(test_torn_block_ignored);
+  return UNITY_END();
+}
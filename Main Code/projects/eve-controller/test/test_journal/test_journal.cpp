@@ -0,0 +1,251 @@
+// Host tests for the store-and-forward journal over a RAM flash fake:
+// append/peek/ack order, replay resuming after a remount, ring overwrite,
+// torn records, failed writes and wear.
+
+#include <unity.h>
+#include "fl_journal.cpp"
+#include <stdio.h>
+
+#define SECTORS  4
+#define SIZE     (SECTORS * FL_JOURNAL_SECTOR)
+
+// ---- RAM flash: writes only clear bits, erase sets a sector to 0xFF ----
+
+static uint8_t flash[SIZE];
+static uint32_t eraseCount[SECTORS];
+static bool failWrites;
+
+static bool ramRead(uint32_t addr, void* dst, size_t len) {
+  if (addr + len > SIZE) return false;
+  memcpy(dst, flash + addr, len);
+  return true;
+}
+
+static bool ramWrite(uint32_t addr, const void* src, size_t len) {
+  if (failWrites || addr + len > SIZE) return false;
+  const uint8_t* s = (const uint8_t*)src;
+  for (size_t k = 0; k < len; k++) flash[addr + k] &= s[k];
+  return true;
+}
+
+static bool ramErase(uint32_t addr) {
+  if (addr % FL_JOURNAL_SECTOR || addr >= SIZE) return false;
+  memset(flash + addr, 0xFF, FL_JOURNAL_SECTOR);
+  eraseCount[addr / FL_JOURNAL_SECTOR]++;
+  return true;
+}
+
+static const fl_flash_port_t ramPort = { ramRead, ramWrite, ramErase };
+
+static fl_journal_t j;
+static uint8_t buf[FL_JOURNAL_MAX_RECORD];
+
+// Records carry their index so order and loss are visible
+static bool appendIndexed(uint32_t n, uint16_t len = 16) {
+  uint8_t data[FL_JOURNAL_MAX_RECORD];
+  memset(data, (uint8_t)n, len);
+  memcpy(data, &n, sizeof(n));
+  return fl_journalAppend(j, FL_JOURNAL_TELEMETRY, 1700000000 + n, data, len);
+}
+
+// Index of the next record to replay, -1 = none
+static int32_t peekIndex() {
+  fl_journal_record_t rec;
+  if (!fl_journalPeek(j, rec, buf, sizeof(buf))) return -1;
+  uint32_t n;
+  memcpy(&n, buf, sizeof(n));
+  return (int32_t)n;
+}
+
+void setUp(void) {
+  memset(flash, 0xFF, sizeof(flash));
+  memset(eraseCount, 0, sizeof(eraseCount));
+  failWrites = false;
+  fl_journalMount(j, &ramPort, SIZE);
+}
+
+void tearDown(void) {}
+
+void test_mount_empty(void) {
+  TEST_ASSERT_TRUE(j.ready);
+  TEST_ASSERT_EQUAL_UINT16(SECTORS, j.sectors);
+  TEST_ASSERT_EQUAL_UINT32(0, j.pending);
+  TEST_ASSERT_EQUAL_INT32(-1, peekIndex());
+}
+
+void test_mount_rejects_small_partition(void) {
+  fl_journal_t small;
+  TEST_ASSERT_FALSE(fl_journalMount(small, &ramPort, FL_JOURNAL_SECTOR));
+  TEST_ASSERT_FALSE(fl_journalMount(small, nullptr, SIZE));
+}
+
+void test_append_peek_ack_in_order(void) {
+  const char* msg = "{\"V1\":230.1}";
+  TEST_ASSERT_TRUE(fl_journalAppend(j, FL_JOURNAL_FAULT, 42, msg, strlen(msg)));
+  for (uint32_t n = 1; n <= 3; n++) TEST_ASSERT_TRUE(appendIndexed(n));
+  TEST_ASSERT_EQUAL_UINT32(4, j.pending);
+
+  fl_journal_record_t rec;
+  TEST_ASSERT_TRUE(fl_journalPeek(j, rec, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_UINT8(FL_JOURNAL_FAULT, rec.type);
+  TEST_ASSERT_EQUAL_UINT32(42, rec.ts);
+  TEST_ASSERT_EQUAL_UINT16(strlen(msg), rec.len);
+  TEST_ASSERT_EQUAL_MEMORY(msg, buf, rec.len);
+  fl_journalAck(j);
+
+  for (int32_t n = 1; n <= 3; n++) {
+    TEST_ASSERT_EQUAL_INT32(n, peekIndex());
+    fl_journalAck(j);
+  }
+  TEST_ASSERT_EQUAL_INT32(-1, peekIndex());
+  TEST_ASSERT_EQUAL_UINT32(4, j.replayed);
+  TEST_ASSERT_EQUAL_UINT32(0, j.pending);
+}
+
+void test_peek_without_ack_repeats(void) {
+  appendIndexed(7);
+  appendIndexed(8);
+  TEST_ASSERT_EQUAL_INT32(7, peekIndex());
+  TEST_ASSERT_EQUAL_INT32(7, peekIndex());
+  // An ack with nothing peeked is ignored
+  fl_journalAck(j);
+  fl_journalAck(j);
+  TEST_ASSERT_EQUAL_INT32(8, peekIndex());
+}
+
+void test_remount_resumes_replay(void) {
+  for (uint32_t n = 0; n < 10; n++) appendIndexed(n, 300);
+  for (int32_t n = 0; n < 4; n++) {
+    TEST_ASSERT_EQUAL_INT32(n, peekIndex());
+    fl_journalAck(j);
+  }
+
+  TEST_ASSERT_TRUE(fl_journalMount(j, &ramPort, SIZE));
+  TEST_ASSERT_EQUAL_UINT32(6, j.pending);
+  // New records land after the old ones
+  TEST_ASSERT_TRUE(appendIndexed(10, 300));
+  for (int32_t n = 4; n <= 10; n++) {
+    TEST_ASSERT_EQUAL_INT32(n, peekIndex());
+    fl_journalAck(j);
+  }
+  TEST_ASSERT_EQUAL_INT32(-1, peekIndex());
+}
+
+void test_remount_after_full_replay(void) {
+  for (uint32_t n = 0; n < 20; n++) appendIndexed(n, 500);
+  while (peekIndex() >= 0) fl_journalAck(j);
+
+  TEST_ASSERT_TRUE(fl_journalMount(j, &ramPort, SIZE));
+  TEST_ASSERT_EQUAL_UINT32(0, j.pending);
+  TEST_ASSERT_EQUAL_INT32(-1, peekIndex());
+  appendIndexed(99);
+  TEST_ASSERT_EQUAL_INT32(99, peekIndex());
+}
+
+void test_full_ring_drops_oldest(void) {
+  // 1000-byte payloads: four records per sector, sixteen in the ring
+  const uint32_t total = 40;
+  for (uint32_t n = 0; n < total; n++) TEST_ASSERT_TRUE(appendIndexed(n, 1000));
+  TEST_ASSERT_GREATER_THAN_UINT32(0, j.dropped);
+  TEST_ASSERT_EQUAL_UINT32(total, j.pending + j.dropped);
+
+  // What is left is the newest records, oldest first, without gaps
+  int32_t expect = (int32_t)j.dropped;
+  int32_t n;
+  while ((n = peekIndex()) >= 0) {
+    TEST_ASSERT_EQUAL_INT32(expect++, n);
+    fl_journalAck(j);
+  }
+  TEST_ASSERT_EQUAL_INT32((int32_t)total, expect);
+}
+
+void test_torn_record_ends_its_sector(void) {
+  appendIndexed(1, 64);
+  appendIndexed(2, 64);
+  appendIndexed(3, 64);
+  // A power cut mid-write: part of record 2's payload never programmed
+  uint32_t second = sizeof(sector_header_t) + recordSize(64) + sizeof(record_header_t) + 20;
+  memset(flash + second, 0xFF, 8);
+
+  TEST_ASSERT_TRUE(fl_journalMount(j, &ramPort, SIZE));
+  TEST_ASSERT_EQUAL_UINT32(1, j.pending);
+  TEST_ASSERT_EQUAL_INT32(1, peekIndex());
+  fl_journalAck(j);
+  TEST_ASSERT_EQUAL_INT32(-1, peekIndex());
+
+  // The sector is sealed; the next record opens a fresh one
+  TEST_ASSERT_TRUE(appendIndexed(4, 64));
+  TEST_ASSERT_EQUAL_UINT32(2, j.headSeq);
+  TEST_ASSERT_EQUAL_INT32(4, peekIndex());
+}
+
+void test_oversized_for_reader_is_dropped(void) {
+  appendIndexed(1, 200);
+  appendIndexed(2, 8);
+  fl_journal_record_t rec;
+  uint8_t small[16];
+  TEST_ASSERT_TRUE(fl_journalPeek(j, rec, small, sizeof(small)));
+  TEST_ASSERT_EQUAL_UINT16(8, rec.len);
+  TEST_ASSERT_EQUAL_UINT32(1, j.dropped);
+  TEST_ASSERT_FALSE(fl_journalAppend(j, FL_JOURNAL_TELEMETRY, 0, buf, FL_JOURNAL_MAX_RECORD + 1));
+}
+
+void test_failed_write_seals_sector(void) {
+  appendIndexed(1);
+  failWrites = true;
+  TEST_ASSERT_FALSE(appendIndexed(2));
+  TEST_ASSERT_EQUAL_UINT32(1, j.errors);
+  failWrites = false;
+  TEST_ASSERT_TRUE(appendIndexed(3));
+  TEST_ASSERT_EQUAL_UINT32(2, j.headSeq);
+  TEST_ASSERT_EQUAL_INT32(1, peekIndex());
+  fl_journalAck(j);
+  TEST_ASSERT_EQUAL_INT32(3, peekIndex());
+}
+
+void test_wear_is_even(void) {
+  for (uint32_t n = 0; n < 400; n++) {
+    appendIndexed(n, 1000);
+    if (n % 3 == 0) {
+      while (peekIndex() >= 0) fl_journalAck(j);
+    }
+  }
+  uint32_t lo = eraseCount[0], hi = eraseCount[0];
+  for (uint8_t s = 1; s < SECTORS; s++) {
+    if (eraseCount[s] < lo) lo = eraseCount[s];
+    if (eraseCount[s] > hi) hi = eraseCount[s];
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, hi - lo);
+  // Lifetime counts come back from the sector headers
+  TEST_ASSERT_TRUE(fl_journalMount(j, &ramPort, SIZE));
+  TEST_ASSERT_EQUAL_UINT32(hi, j.eraseMax);
+}
+
+void test_write_amplification(void) {
+  for (uint32_t n = 0; n < 100; n++) appendIndexed(n, 400);
+  while (peekIndex() >= 0) fl_journalAck(j);
+  float wa = fl_journalWriteAmplification(j);
+  char msg[64];
+  snprintf(msg, sizeof(msg), "write amplification %.3f at 400-byte records", wa);
+  TEST_MESSAGE(msg);
+  // 12-byte header and one replay mark per record, plus sector headers
+  TEST_ASSERT_GREATER_THAN_FLOAT(1.0f, wa);
+  TEST_ASSERT_LESS_THAN_FLOAT(1.06f, wa);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_mount_empty);
+  RUN_TEST(test_mount_rejects_small_partition);
+  RUN_TEST(test_append_peek_ack_in_order);
+  RUN_TEST(test_peek_without_ack_repeats);
+  RUN_TEST(test_remount_resumes_replay);
+  RUN_TEST(test_remount_after_full_replay);
+  RUN_TEST(test_full_ring_drops_oldest);
+  RUN_TEST(test_torn_record_ends_its_sector);
+  RUN_TEST(test_oversized_for_reader_is_dropped);
+  RUN_TEST(test_failed_write_seals_sector);
+  RUN_TEST(test_wear_is_even);
+  RUN_TEST(test_write_amplification);
+  return UNITY_END();
+}
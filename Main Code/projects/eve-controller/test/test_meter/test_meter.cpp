@@ -0,0 +1,263 @@
+// Host tests for the meter layer: read plans for every built-in map against
+// a brute-force minimum over all quantity masks, hand-checked plans for the
+// SDM630 and ADL400, and decodes of known register words (word order,
+// scaling, float against signed and unsigned integers).
+
+#include <unity.h>
+#include <math.h>
+#include "fl_meter.cpp"
+
+static const fl_meter_driver_t& sdm630 = fl_meterDrivers[FL_METER_SDM630];
+static const fl_meter_driver_t& adl400 = fl_meterDrivers[FL_METER_ADL400];
+static const fl_meter_driver_t& generic = fl_meterDrivers[FL_METER_GENERIC];
+
+// A map with the word order the built-in ones don't use
+struct map_low_first {
+  static constexpr const char* name = "LOWFIRST";
+  static constexpr uint8_t function = FL_RTU_FC_READ_HOLDING;
+  static constexpr uint8_t maxGap = 0;
+  static constexpr fl_reg_def_t regs[] = {
+    { FL_Q_V1,  0x0010, FL_REG_FLOAT32, FL_WORDS_LOW_FIRST, 1.0f  },
+    { FL_Q_KW,  0x0012, FL_REG_INT32,   FL_WORDS_LOW_FIRST, 0.1f  },
+    { FL_Q_KWH, 0x0014, FL_REG_UINT32,  FL_WORDS_LOW_FIRST, 0.01f },
+  };
+};
+
+static constexpr fl_meter_driver_t lowFirst = fl_makeMeterDriver<map_low_first>();
+
+static uint16_t mapMask(const fl_meter_driver_t& d) {
+  uint16_t m = 0;
+  for (uint8_t i = 0; i < d.regCount; i++) m |= FL_QMASK(d.regs[i].quantity);
+  return m;
+}
+
+// Fewest blocks that can cover the wanted registers, trying every split of
+// the address-sorted list
+static uint8_t minBlocks(const fl_meter_driver_t& d, uint16_t wanted) {
+  uint8_t idx[16];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < d.regCount; i++)
+    if (wanted & FL_QMASK(d.regs[i].quantity)) idx[n++] = i;
+  uint8_t best[17];
+  best[0] = 0;
+  for (uint8_t end = 1; end <= n; end++) {
+    best[end] = 255;
+    // Registers start..end-1 as one block
+    for (uint8_t start = end; start-- > 0;) {
+      const fl_reg_def_t& first = d.regs[idx[start]];
+      const fl_reg_def_t& last = d.regs[idx[end - 1]];
+      if (last.address + fl_regWords(last.type) - first.address > FL_METER_MAX_BLOCK_REGS) break;
+      bool gapsOk = true;
+      for (uint8_t k = start + 1; k < end; k++) {
+        const fl_reg_def_t& prev = d.regs[idx[k - 1]];
+        if (d.regs[idx[k]].address > prev.address + fl_regWords(prev.type) + d.maxGap) gapsOk = false;
+      }
+      if (gapsOk && best[start] + 1 < best[end]) best[end] = best[start] + 1;
+    }
+  }
+  return best[n];
+}
+
+// Every block contiguous, within the size cap, in address order; every
+// wanted register in exactly one block and nothing unwanted decoded
+static void checkPlan(const fl_meter_driver_t& d, uint16_t wanted) {
+  fl_meter_plan_t plan = fl_planMeterReads(d, wanted);
+  uint16_t expect = wanted & mapMask(d);
+  TEST_ASSERT_EQUAL_HEX16(expect, plan.mask);
+  TEST_ASSERT_EQUAL_UINT8(minBlocks(d, wanted), plan.blockCount);
+
+  uint16_t covered = 0;
+  for (uint8_t b = 0; b < plan.blockCount; b++) {
+    const fl_meter_block_t& blk = plan.blocks[b];
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(FL_METER_MAX_BLOCK_REGS, blk.count);
+    if (b > 0) {
+      const fl_meter_block_t& prev = plan.blocks[b - 1];
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(prev.address + prev.count, blk.address);
+    }
+    const fl_reg_def_t& first = d.regs[blk.firstReg];
+    const fl_reg_def_t& last = d.regs[blk.lastReg];
+    TEST_ASSERT_EQUAL_UINT16(first.address, blk.address);
+    TEST_ASSERT_EQUAL_UINT32(last.address + fl_regWords(last.type) - blk.address, blk.count);
+    TEST_ASSERT_TRUE(wanted & FL_QMASK(first.quantity));
+    TEST_ASSERT_TRUE(wanted & FL_QMASK(last.quantity));
+    for (uint8_t i = blk.firstReg; i <= blk.lastReg; i++) {
+      if (!(wanted & FL_QMASK(d.regs[i].quantity))) continue;
+      TEST_ASSERT_FALSE(covered & FL_QMASK(d.regs[i].quantity));
+      covered |= FL_QMASK(d.regs[i].quantity);
+    }
+  }
+  TEST_ASSERT_EQUAL_HEX16(expect, covered);
+}
+
+static void checkAllMasks(const fl_meter_driver_t& d) {
+  for (uint16_t wanted = 1; wanted <= FL_QMASK_ALL; wanted++) {
+    checkPlan(d, wanted);
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/* ---- Plans ---- */
+
+void test_plans_minimal_for_every_mask(void) {
+  checkAllMasks(sdm630);
+  checkAllMasks(adl400);
+  checkAllMasks(generic);
+  checkAllMasks(lowFirst);
+}
+
+void test_sdm630_plans(void) {
+  fl_meter_plan_t p = fl_planMeterReads(sdm630, FL_QMASK_VI);
+  TEST_ASSERT_EQUAL_UINT8(1, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT16(0x0000, p.blocks[0].address);
+  TEST_ASSERT_EQUAL_UINT8(12, p.blocks[0].count);
+
+  // Power, PF, frequency and energy sit 40 words past the currents: beyond
+  // the 16-word gap, so a second block, which spans the 8-word hole to PF
+  p = fl_planMeterReads(sdm630, FL_QMASK_ALL);
+  TEST_ASSERT_EQUAL_UINT8(2, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT16(0x0034, p.blocks[1].address);
+  TEST_ASSERT_EQUAL_UINT8(0x4A - 0x34, p.blocks[1].count);
+  TEST_ASSERT_EQUAL_HEX16(FL_QMASK_ALL, p.mask);
+
+  // One quantity reads only its own two words
+  p = fl_planMeterReads(sdm630, FL_QMASK(FL_Q_KWH));
+  TEST_ASSERT_EQUAL_UINT8(1, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT16(0x0048, p.blocks[0].address);
+  TEST_ASSERT_EQUAL_UINT8(2, p.blocks[0].count);
+
+  // V1 and I3 are 10 words apart: one block through the unwanted ones
+  p = fl_planMeterReads(sdm630, FL_QMASK(FL_Q_V1) | FL_QMASK(FL_Q_I3));
+  TEST_ASSERT_EQUAL_UINT8(1, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT8(12, p.blocks[0].count);
+}
+
+void test_adl400_plans(void) {
+  fl_meter_plan_t p = fl_planMeterReads(adl400, FL_QMASK_VI);
+  TEST_ASSERT_EQUAL_UINT8(1, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT16(0x0061, p.blocks[0].address);
+  TEST_ASSERT_EQUAL_UINT8(6, p.blocks[0].count);
+
+  // Energy at 0, V/I/Hz from 0x61, power and PF from 0x16A
+  p = fl_planMeterReads(adl400, FL_QMASK_ALL);
+  TEST_ASSERT_EQUAL_UINT8(3, p.blockCount);
+  TEST_ASSERT_EQUAL_UINT16(0x0000, p.blocks[0].address);
+  TEST_ASSERT_EQUAL_UINT8(2, p.blocks[0].count);
+  TEST_ASSERT_EQUAL_UINT16(0x0061, p.blocks[1].address);
+  TEST_ASSERT_EQUAL_UINT8(0x78 - 0x61, p.blocks[1].count);
+  TEST_ASSERT_EQUAL_UINT16(0x016A, p.blocks[2].address);
+  TEST_ASSERT_EQUAL_UINT8(0x180 - 0x16A, p.blocks[2].count);
+}
+
+void test_generic_never_spans_a_gap(void) {
+  fl_meter_plan_t p = fl_planMeterReads(generic, FL_QMASK(FL_Q_V1) | FL_QMASK(FL_Q_I1));
+  TEST_ASSERT_EQUAL_UINT8(2, p.blockCount);
+  // Quantities the map lacks are left out of the plan's mask
+  p = fl_planMeterReads(generic, FL_QMASK_ALL);
+  TEST_ASSERT_EQUAL_UINT8(1, p.blockCount);
+  TEST_ASSERT_EQUAL_HEX16(FL_QMASK_VI, p.mask);
+}
+
+/* ---- Decodes ---- */
+
+static float values[FL_Q_COUNT];
+
+static uint16_t decode(const fl_meter_driver_t& d, uint16_t wanted, uint8_t block, const uint16_t* words) {
+  fl_meter_plan_t p = fl_planMeterReads(d, wanted);
+  for (float& v : values) v = NAN;
+  return fl_decodeMeterBlock(d, p.blocks[block], wanted, words, values);
+}
+
+void test_sdm630_float_high_first(void) {
+  // 230.5 = 0x43668000, 10.25 = 0x41240000, 0 = 0x00000000
+  const uint16_t vi[12] = { 0x4366, 0x8000, 0x4366, 0x8000, 0x0000, 0x0000,
+                            0x4124, 0x0000, 0x0000, 0x0000, 0x4124, 0x0000 };
+  TEST_ASSERT_EQUAL_HEX16(FL_QMASK_VI, decode(sdm630, FL_QMASK_VI, 0, vi));
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, values[FL_Q_V1]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, values[FL_Q_V3]);
+  TEST_ASSERT_EQUAL_FLOAT(10.25f, values[FL_Q_I1]);
+  TEST_ASSERT_EQUAL_FLOAT(10.25f, values[FL_Q_I3]);
+
+  // Second block: 1500 W -> 1.5 kW, PF 0.5, 50 Hz, 1234.5 kWh
+  uint16_t tail[0x4A - 0x34] = {};
+  tail[0x34 - 0x34] = 0x44BB; tail[0x35 - 0x34] = 0x8000;   // 1500.0
+  tail[0x3E - 0x34] = 0x3F00;                               // 0.5
+  tail[0x46 - 0x34] = 0x4248;                               // 50.0
+  tail[0x48 - 0x34] = 0x449A; tail[0x49 - 0x34] = 0x5000;   // 1234.5
+  uint16_t want = FL_QMASK(FL_Q_KW) | FL_QMASK(FL_Q_PF) | FL_QMASK(FL_Q_HZ) | FL_QMASK(FL_Q_KWH);
+  TEST_ASSERT_EQUAL_HEX16(want, decode(sdm630, FL_QMASK_ALL, 1, tail));
+  TEST_ASSERT_EQUAL_FLOAT(1.5f, values[FL_Q_KW]);
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, values[FL_Q_PF]);
+  TEST_ASSERT_EQUAL_FLOAT(50.0f, values[FL_Q_HZ]);
+  TEST_ASSERT_EQUAL_FLOAT(1234.5f, values[FL_Q_KWH]);
+}
+
+void test_adl400_scaled_integers(void) {
+  // 230.5 V, 0.1 V, 6553.5 V (top of u16), 12.34 A, 0 A, 655.35 A
+  const uint16_t vi[6] = { 2305, 1, 65535, 1234, 0, 65535 };
+  decode(adl400, FL_QMASK_VI, 0, vi);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 230.5f, values[FL_Q_V1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.1f, values[FL_Q_V2]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-2f, 6553.5f, values[FL_Q_V3]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 12.34f, values[FL_Q_I1]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, values[FL_Q_I2]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 655.35f, values[FL_Q_I3]);
+
+  // u32 energy, high word first: 123456 = 0x0001E240 -> 1234.56 kWh
+  const uint16_t kwh[2] = { 0x0001, 0xE240 };
+  decode(adl400, FL_QMASK_ALL, 0, kwh);
+  TEST_ASSERT_FLOAT_WITHIN(1e-2f, 1234.56f, values[FL_Q_KWH]);
+
+  // Signed: -1500 W exporting = 0xFFFFFA24, PF -0.85 = 0xFCAE
+  uint16_t tail[0x180 - 0x16A] = {};
+  tail[0] = 0xFFFF;
+  tail[1] = 0xFA24;
+  tail[0x17F - 0x16A] = 0xFCAE;
+  decode(adl400, FL_QMASK_ALL, 2, tail);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -1.5f, values[FL_Q_KW]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -0.85f, values[FL_Q_PF]);
+}
+
+void test_low_word_first(void) {
+  // 230.5 = 0x43668000; -1234 = 0xFFFFFB2E; 70000 = 0x00011170
+  const uint16_t words[6] = { 0x8000, 0x4366, 0xFB2E, 0xFFFF, 0x1170, 0x0001 };
+  TEST_ASSERT_EQUAL_HEX16(FL_QMASK(FL_Q_V1) | FL_QMASK(FL_Q_KW) | FL_QMASK(FL_Q_KWH),
+                          decode(lowFirst, FL_QMASK_ALL, 0, words));
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, values[FL_Q_V1]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -123.4f, values[FL_Q_KW]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 700.0f, values[FL_Q_KWH]);
+}
+
+void test_decode_only_wanted(void) {
+  const uint16_t vi[12] = { 0x4366, 0x8000, 0x4366, 0x8000, 0x4366, 0x8000,
+                            0x4124, 0x0000, 0x4124, 0x0000, 0x4124, 0x0000 };
+  uint16_t want = FL_QMASK(FL_Q_V1) | FL_QMASK(FL_Q_I3);
+  TEST_ASSERT_EQUAL_HEX16(want, decode(sdm630, want, 0, vi));
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, values[FL_Q_V1]);
+  TEST_ASSERT_EQUAL_FLOAT(10.25f, values[FL_Q_I3]);
+  TEST_ASSERT_TRUE(isnan(values[FL_Q_V2]));
+  TEST_ASSERT_TRUE(isnan(values[FL_Q_I1]));
+}
+
+void test_model_names(void) {
+  TEST_ASSERT_EQUAL_STRING("ADL400", fl_meterModelName(FL_METER_ADL400));
+  TEST_ASSERT_EQUAL_STRING("UNKNOWN", fl_meterModelName(FL_METER_MODEL_COUNT));
+  TEST_ASSERT_EQUAL(FL_METER_SDM630, fl_meterModelFromName("sdm630"));
+  TEST_ASSERT_EQUAL(FL_METER_MODEL_COUNT, fl_meterModelFromName("SDM63"));
+  TEST_ASSERT_EQUAL(FL_METER_MODEL_COUNT, fl_meterModelFromName(nullptr));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_plans_minimal_for_every_mask);
+  RUN_TEST(test_sdm630_plans);
+  RUN_TEST(test_adl400_plans);
+  RUN_TEST(test_generic_never_spans_a_gap);
+  RUN_TEST(test_sdm630_float_high_first);
+  RUN_TEST(test_adl400_scaled_integers);
+  RUN_TEST(test_low_word_first);
+  RUN_TEST(test_decode_only_wanted);
+  RUN_TEST(test_model_names);
+  return UNITY_END();
+}
@@ -0,0 +1,265 @@
+// Host tests for the multi-drop bus scheduler on the fake UART: pick order
+// (priority, open cycles, most overdue), offline demotion, the capped
+// re-probe backoff, recovery, and the achieved period of a critical slave
+// sharing the bus with a dead one.
+
+#include <unity.h>
+#include <stdio.h>
+#include "fl_modbus_rtu.cpp"
+#include "fl_modbus_bus.cpp"
+#include "../fake_uart.h"
+
+#define TIMEOUT_MS   250
+#define POLL_US      1000
+
+// ---- Slaves: every address answers except the dead ones ----
+
+static bool dead[256];
+
+static void slaveReply(const uint8_t* req, size_t len) {
+  TEST_ASSERT_EQUAL(8, len);
+  if (dead[req[0]]) return;
+  uint8_t count = req[5];
+  uint8_t out[FL_RTU_MAX_FRAME];
+  size_t n = 0;
+  out[n++] = req[0];
+  out[n++] = req[1];
+  out[n++] = count * 2;
+  for (uint8_t i = 0; i < count; i++) {
+    out[n++] = req[0];
+    out[n++] = i;
+  }
+  uint16_t crc = fl_rtuCrc16(out, n);
+  out[n++] = crc & 0xFF;
+  out[n++] = crc >> 8;
+  // Answers after 5 ms, one character time per byte at 9600 baud
+  for (size_t i = 0; i < n; i++) rxPush(out[i], fakeNowUs + 5000 + i * 1146);
+}
+
+// ---- Driver: a fixed number of two-register reads per cycle ----
+
+struct dev_ctx_t {
+  uint8_t reads;
+  uint32_t ok, failed;
+  uint32_t dataCalls;
+  uint32_t backoffs[16];         // backoffMs after each failed cycle
+  uint8_t nBackoffs;
+};
+
+static bool nextRead(void* ctx, uint8_t index, fl_bus_read_t& out) {
+  const dev_ctx_t& c = *(const dev_ctx_t*)ctx;
+  if (index >= c.reads) return false;
+  out = { FL_RTU_FC_READ_HOLDING, (uint16_t)(index * 2), 2 };
+  return true;
+}
+
+static void onData(void* ctx, uint8_t, const uint16_t*, uint8_t count) {
+  TEST_ASSERT_EQUAL(2, count);
+  ((dev_ctx_t*)ctx)->dataCalls++;
+}
+
+static void cycleDone(void* ctx, fl_rtu_status_t status, const fl_bus_device_t& dev) {
+  dev_ctx_t& c = *(dev_ctx_t*)ctx;
+  if (status == FL_RTU_OK) {
+    c.ok++;
+    return;
+  }
+  c.failed++;
+  if (c.nBackoffs < 16) c.backoffs[c.nBackoffs++] = dev.backoffMs;
+}
+
+static const fl_bus_driver_t driver = { nextRead, onData, cycleDone };
+
+// ---- Harness ----
+
+static fl_rtu_master_t rtu;
+static fl_bus_t bus;
+static dev_ctx_t ctx[FL_BUS_MAX_DEVICES];
+
+void setUp(void) {
+  fakeNowUs = 1000000;
+  rxHead = rxTail = 0;
+  txLen = 0;
+  txDrained = false;
+  deOn = false;
+  onRequest = slaveReply;
+  memset(dead, 0, sizeof(dead));
+  memset(ctx, 0, sizeof(ctx));
+  fl_rtuInit(rtu, &fakePort, 9600, TIMEOUT_MS);
+  fl_busInit(bus, &rtu);
+  bus.nowMs = fakeNowUs / 1000;
+}
+
+void tearDown(void) {}
+
+static int addDevice(uint8_t slave, fl_bus_priority_t prio, uint32_t periodMs, uint8_t reads) {
+  int id = fl_busAddDevice(bus, "dev", slave, prio, periodMs, &driver, &ctx[bus.deviceCount]);
+  ctx[id].reads = reads;
+  return id;
+}
+
+static void runFor(uint32_t ms) {
+  uint32_t end = fakeNowUs + ms * 1000;
+  while ((int32_t)(end - fakeNowUs) > 0) {
+    fl_busPoll(bus, fakeNowUs / 1000, fakeNowUs);
+    fakeNowUs += POLL_US;
+  }
+}
+
+// ---- Pick order, straight from the scheduler state ----
+
+void test_pick_priority_before_lateness(void) {
+  int low = addDevice(1, FL_BUS_PRIO_LOW, 1000, 1);
+  int crit = addDevice(2, FL_BUS_PRIO_CRITICAL, 1000, 1);
+  int norm = addDevice(3, FL_BUS_PRIO_NORMAL, 1000, 1);
+  bus.nowMs = 10000;
+  bus.devices[low].nextDueMs = 1000;     // Far more overdue
+  bus.devices[norm].nextDueMs = 5000;
+  bus.devices[crit].nextDueMs = 9999;
+  TEST_ASSERT_EQUAL(crit, pickDevice(bus));
+  bus.devices[crit].nextDueMs = 10001;   // Not due yet
+  TEST_ASSERT_EQUAL(norm, pickDevice(bus));
+  bus.devices[norm].nextDueMs = 10001;
+  TEST_ASSERT_EQUAL(low, pickDevice(bus));
+  bus.devices[low].nextDueMs = 10001;
+  TEST_ASSERT_EQUAL(-1, pickDevice(bus));
+}
+
+void test_pick_open_cycle_then_most_overdue(void) {
+  int a = addDevice(1, FL_BUS_PRIO_NORMAL, 1000, 3);
+  int b = addDevice(2, FL_BUS_PRIO_NORMAL, 1000, 3);
+  int c = addDevice(3, FL_BUS_PRIO_NORMAL, 1000, 3);
+  bus.nowMs = 10000;
+  bus.devices[a].nextDueMs = 9000;
+  bus.devices[b].nextDueMs = 8000;
+  bus.devices[c].nextDueMs = 9500;
+  TEST_ASSERT_EQUAL(b, pickDevice(bus));
+  // A cycle already under way finishes first, even if it is not due again
+  bus.devices[c].inCycle = true;
+  bus.devices[c].nextDueMs = 11000;
+  TEST_ASSERT_EQUAL(c, pickDevice(bus));
+  // But not ahead of a higher priority
+  bus.devices[a].priority = FL_BUS_PRIO_CRITICAL;
+  TEST_ASSERT_EQUAL(a, pickDevice(bus));
+}
+
+// ---- Health ----
+
+void test_dead_slave_demoted_and_backed_off(void) {
+  int d = addDevice(9, FL_BUS_PRIO_CRITICAL, 1000, 1);
+  dead[9] = true;
+  const fl_bus_device_t& dev = bus.devices[d];
+  dev_ctx_t& c = ctx[d];
+
+  // Four failures keep the period and the priority
+  runFor(4 * 1000 - 500);
+  TEST_ASSERT_EQUAL_UINT32(4, c.failed);
+  TEST_ASSERT_EQUAL_UINT32(0, dev.backoffMs);
+  TEST_ASSERT_EQUAL(FL_BUS_PRIO_CRITICAL, effectivePriority(dev));
+
+  // The fifth takes it offline: lowest priority, re-probed ever less often
+  runFor(1000);
+  TEST_ASSERT_EQUAL_UINT32(5, c.failed);
+  TEST_ASSERT_FALSE(dev.online);
+  TEST_ASSERT_EQUAL(FL_BUS_PRIO_LOW, effectivePriority(dev));
+  TEST_ASSERT_EQUAL(FL_RTU_TIMEOUT, dev.lastError);
+
+  runFor(120000);
+  const uint32_t expect[] = { 0, 0, 0, 0, 2000, 4000, 8000, 16000, 30000, 30000 };
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(10, c.nBackoffs);
+  for (uint8_t k = 0; k < 10; k++) TEST_ASSERT_EQUAL_UINT32(expect[k], c.backoffs[k]);
+
+  // Each re-probe starts one backoff after the previous failure
+  uint32_t probes = c.failed;
+  runFor(30000);
+  TEST_ASSERT_EQUAL_UINT32(probes + 1, c.failed);
+}
+
+void test_slave_recovers(void) {
+  int d = addDevice(9, FL_BUS_PRIO_NORMAL, 500, 2);
+  dead[9] = true;
+  runFor(40000);
+  const fl_bus_device_t& dev = bus.devices[d];
+  TEST_ASSERT_FALSE(dev.online);
+  TEST_ASSERT_EQUAL_UINT32(FL_BUS_MAX_BACKOFF_MS, dev.backoffMs);
+
+  dead[9] = false;
+  runFor(FL_BUS_MAX_BACKOFF_MS + 1000);
+  TEST_ASSERT_TRUE(dev.online);
+  TEST_ASSERT_EQUAL_UINT32(0, dev.backoffMs);
+  TEST_ASSERT_EQUAL_UINT8(0, dev.consecFails);
+  // Back on its own period straight away, not one backoff later
+  uint32_t ok = ctx[d].ok;
+  runFor(5000);
+  TEST_ASSERT_UINT32_WITHIN(1, ok + 10, ctx[d].ok);
+  TEST_ASSERT_EQUAL_UINT32(ctx[d].ok * 2, ctx[d].dataCalls);
+}
+
+// ---- Rates ----
+
+void test_achieved_period_matches_request(void) {
+  int crit = addDevice(1, FL_BUS_PRIO_CRITICAL, 200, 2);
+  int low = addDevice(2, FL_BUS_PRIO_LOW, 1000, 1);
+  runFor(20000);
+  const fl_bus_device_t& d = bus.devices[crit];
+  TEST_ASSERT_UINT32_WITHIN(2, 200, d.avgIntervalMs);
+  TEST_ASSERT_UINT32_WITHIN(1, 100, ctx[crit].ok);
+  TEST_ASSERT_UINT32_WITHIN(1, 20, ctx[low].ok);
+  TEST_ASSERT_EQUAL_UINT32(0, ctx[crit].failed);
+}
+
+void test_period_beyond_bus_capacity(void) {
+  // Four reads take far longer than 10 ms: the device runs back to back
+  // and the achieved interval shows what the bus can actually do
+  int d = addDevice(1, FL_BUS_PRIO_CRITICAL, 10, 4);
+  runFor(10000);
+  const fl_bus_device_t& dev = bus.devices[d];
+  TEST_ASSERT_GREATER_THAN_UINT32(50, dev.avgIntervalMs);
+  TEST_ASSERT_EQUAL_UINT32(0, ctx[d].failed);
+  TEST_ASSERT_UINT32_WITHIN(2, 10000 / ctx[d].ok, dev.avgIntervalMs);
+}
+
+void test_dead_slave_cannot_starve_critical(void) {
+  // Protection meter every 100 ms, two reads a cycle; a dead I/O module on
+  // the same pair asking for the same rate
+  int crit = addDevice(1, FL_BUS_PRIO_CRITICAL, 100, 2);
+  int io = addDevice(7, FL_BUS_PRIO_NORMAL, 100, 1);
+  dead[7] = true;
+
+  const uint32_t runMs = 120000;
+  runFor(runMs);
+  const fl_bus_device_t& meter = bus.devices[crit];
+  const fl_bus_device_t& module = bus.devices[io];
+
+  TEST_ASSERT_FALSE(module.online);
+  TEST_ASSERT_EQUAL_UINT32(0, ctx[crit].failed);
+  // The module is probed five times at its period, then on a backoff that
+  // doubles from 200 ms: eight more probes by 52 s, then one every 30 s
+  TEST_ASSERT_EQUAL_UINT32(5 + 8 + (runMs - 52000) / FL_BUS_MAX_BACKOFF_MS, ctx[io].failed);
+  // Each probe holds the bus for at most one timeout, so the meter is never
+  // more than that late and loses at most the cycles that fit into it
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TIMEOUT_MS + 10, meter.maxLateMs);
+  uint32_t lost = ctx[io].failed * (TIMEOUT_MS / 100 + 1);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(runMs / 100 - lost, ctx[crit].ok);
+  float achieved = (float)runMs / ctx[crit].ok;
+  TEST_ASSERT_LESS_THAN_FLOAT(105.0f, achieved);
+  // Between probes it holds the requested period
+  TEST_ASSERT_UINT32_WITHIN(2, 100, meter.avgIntervalMs);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "critical: %.1f ms achieved of 100 requested, worst %lu ms late",
+           achieved, (unsigned long)meter.maxLateMs);
+  TEST_MESSAGE(msg);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pick_priority_before_lateness);
+  RUN_TEST(test_pick_open_cycle_then_most_overdue);
+  RUN_TEST(test_dead_slave_demoted_and_backed_off);
+  RUN_TEST(test_slave_recovers);
+  RUN_TEST(test_achieved_period_matches_request);
+  RUN_TEST(test_period_beyond_bus_capacity);
+  RUN_TEST(test_dead_slave_cannot_starve_critical);
+  return UNITY_END();
+}
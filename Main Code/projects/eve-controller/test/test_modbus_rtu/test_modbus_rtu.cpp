@@ -0,0 +1,287 @@
+// Host tests for the non-blocking Modbus RTU master against a fake UART:
+// a clean transaction, timeout, CRC error, exception, a slave that trickles
+// its reply, and a bus flooded with noise. Every poll is timed and its UART
+// reads counted — the loop-latency budget is 5 ms per call.
+
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "fl_modbus_rtu.cpp"
+#include "../fake_uart.h"
+
+#define POLL_BUDGET_US  5000
+
+// ---- Slave behaviours ----
+
+static uint32_t replyDelayUs;
+static uint32_t replyByteUs;     // Spacing between reply bytes
+static bool corruptCrc;
+static bool replyException;
+
+static void buildReply(const uint8_t* req, uint8_t* out, size_t& len) {
+  uint8_t count = req[5];
+  out[0] = req[0];
+  if (replyException) {
+    out[1] = req[1] | 0x80;
+    out[2] = 0x02;
+    len = 3;
+  } else {
+    out[1] = req[1];
+    out[2] = count * 2;
+    for (uint8_t i = 0; i < count; i++) {
+      out[3 + i * 2] = 0x12;
+      out[4 + i * 2] = i;
+    }
+    len = 3 + count * 2;
+  }
+  uint16_t crc = fl_rtuCrc16(out, len);
+  if (corruptCrc) crc ^= 0x0101;
+  out[len++] = crc & 0xFF;
+  out[len++] = crc >> 8;
+}
+
+static void slaveReply(const uint8_t* req, size_t len) {
+  TEST_ASSERT_EQUAL(8, len);
+  uint8_t out[FL_RTU_MAX_FRAME];
+  size_t n;
+  buildReply(req, out, n);
+  for (size_t i = 0; i < n; i++) rxPush(out[i], fakeNowUs + replyDelayUs + i * replyByteUs);
+}
+
+// ---- Harness ----
+
+static fl_rtu_master_t rtu;
+static int doneCount;
+static fl_rtu_status_t lastStatus;
+static uint16_t lastRegs[FL_RTU_MAX_REGS];
+static uint8_t lastCount;
+static uint32_t maxPollUs;
+static uint32_t worstPollUs;     // Across all tests
+static uint32_t maxReadsPerPoll;
+
+static void onDone(fl_rtu_status_t status, const uint16_t* regs, uint8_t count, void*) {
+  doneCount++;
+  lastStatus = status;
+  lastCount = count;
+  memcpy(lastRegs, regs, count * sizeof(uint16_t));
+}
+
+void setUp(void) {
+  fakeNowUs = 1000000;
+  rxHead = rxTail = 0;
+  txLen = 0;
+  txDrained = false;
+  deOn = false;
+  onRequest = slaveReply;
+  replyDelayUs = 5000;
+  replyByteUs = 1146;            // One character at 9600 baud
+  corruptCrc = false;
+  replyException = false;
+  doneCount = 0;
+  lastStatus = FL_RTU_OK;
+  lastCount = 0;
+  maxPollUs = 0;
+  maxReadsPerPoll = 0;
+  fl_rtuInit(rtu, &fakePort, 9600, 250);
+}
+
+void tearDown(void) {}
+
+static void timedPoll() {
+  readsThisPoll = 0;
+  auto begin = std::chrono::steady_clock::now();
+  fl_rtuPoll(rtu, fakeNowUs);
+  auto end = std::chrono::steady_clock::now();
+  uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+  if (us > maxPollUs) maxPollUs = us;
+  if (us > worstPollUs) worstPollUs = us;
+  if (readsThisPoll > maxReadsPerPoll) maxReadsPerPoll = readsThisPoll;
+}
+
+// Poll every stepUs until the callback fires or limitUs of fake time passes
+static void runUntilDone(uint32_t stepUs, uint32_t limitUs) {
+  uint32_t end = fakeNowUs + limitUs;
+  while (doneCount == 0 && (int32_t)(end - fakeNowUs) > 0) {
+    timedPoll();
+    fakeNowUs += stepUs;
+  }
+}
+
+static void assertPollBudget() {
+  TEST_ASSERT_LESS_THAN(POLL_BUDGET_US, maxPollUs);
+  TEST_ASSERT_LESS_OR_EQUAL(FL_RTU_MAX_BYTES_PER_POLL, maxReadsPerPoll);
+}
+
+// ---- Tests ----
+
+void test_crc16_reference(void) {
+  // Read 2 holding registers from slave 1 at 0x0000: 01 03 00 00 00 02 C4 0B
+  const uint8_t req[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x02 };
+  TEST_ASSERT_EQUAL_HEX16(0x0BC4, fl_rtuCrc16(req, sizeof(req)));
+}
+
+void test_read_ok(void) {
+  TEST_ASSERT_TRUE(fl_rtuRequest(rtu, 7, FL_RTU_FC_READ_HOLDING, 0x0100, 4, onDone, nullptr, fakeNowUs));
+  TEST_ASSERT_FALSE(fl_rtuRequest(rtu, 7, FL_RTU_FC_READ_HOLDING, 0x0100, 4, onDone, nullptr, fakeNowUs));
+  runUntilDone(500, 1000000);
+
+  TEST_ASSERT_EQUAL(1, doneCount);
+  TEST_ASSERT_EQUAL(FL_RTU_OK, lastStatus);
+  TEST_ASSERT_EQUAL(4, lastCount);
+  TEST_ASSERT_EQUAL_HEX16(0x1203, lastRegs[3]);
+  TEST_ASSERT_EQUAL(8, txLen);
+  TEST_ASSERT_EQUAL_HEX8(7, txData[0]);
+  TEST_ASSERT_TRUE(deAtWrite);
+  TEST_ASSERT_FALSE(deOn);
+  TEST_ASSERT_FALSE(fl_rtuBusy(rtu));
+  assertPollBudget();
+}
+
+void test_timeout_without_reply(void) {
+  onRequest = nullptr;
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_INPUT, 0, 2, onDone, nullptr, fakeNowUs);
+  uint32_t start = fakeNowUs;
+  runUntilDone(1000, 2000000);
+
+  TEST_ASSERT_EQUAL(1, doneCount);
+  TEST_ASSERT_EQUAL(FL_RTU_TIMEOUT, lastStatus);
+  // First-byte timeout of 250 ms, plus the gap and TX drain
+  TEST_ASSERT_LESS_THAN(270000, fakeNowUs - start);
+  TEST_ASSERT_GREATER_OR_EQUAL(250000, fakeNowUs - start);
+  TEST_ASSERT_EQUAL(1, rtu.errors);
+  assertPollBudget();
+}
+
+void test_timeout_on_stalled_reply(void) {
+  // Slave sends the header and goes quiet
+  onRequest = [](const uint8_t* req, size_t) {
+    rxPush(req[0], fakeNowUs + 5000);
+    rxPush(req[1], fakeNowUs + 6000);
+    rxPush(4, fakeNowUs + 7000);
+  };
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 2, onDone, nullptr, fakeNowUs);
+  runUntilDone(1000, 1000000);
+
+  TEST_ASSERT_EQUAL(FL_RTU_TIMEOUT, lastStatus);
+  assertPollBudget();
+}
+
+void test_crc_error(void) {
+  corruptCrc = true;
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 8, onDone, nullptr, fakeNowUs);
+  runUntilDone(500, 1000000);
+
+  TEST_ASSERT_EQUAL(FL_RTU_CRC_ERROR, lastStatus);
+  TEST_ASSERT_EQUAL(0, lastCount);
+  assertPollBudget();
+}
+
+void test_exception_reply(void) {
+  replyException = true;
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 8, onDone, nullptr, fakeNowUs);
+  runUntilDone(500, 1000000);
+
+  TEST_ASSERT_EQUAL(FL_RTU_EXCEPTION, lastStatus);
+  assertPollBudget();
+}
+
+void test_trickling_slave(void) {
+  // Bytes 3 t3.5 apart — slow, but inside the stall window — polled far
+  // more often than they arrive
+  replyByteUs = rtu.frameGapUs * 3;
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, FL_RTU_MAX_REGS, onDone, nullptr, fakeNowUs);
+  runUntilDone(100, 10000000);
+
+  TEST_ASSERT_EQUAL(FL_RTU_OK, lastStatus);
+  TEST_ASSERT_EQUAL(FL_RTU_MAX_REGS, lastCount);
+  assertPollBudget();
+}
+
+void test_burst_reply_bounded_per_poll(void) {
+  // The whole 133-byte reply lands at once; each poll reads at most the budget
+  replyByteUs = 0;
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, FL_RTU_MAX_REGS, onDone, nullptr, fakeNowUs);
+  runUntilDone(10000, 1000000);
+
+  TEST_ASSERT_EQUAL(FL_RTU_OK, lastStatus);
+  TEST_ASSERT_EQUAL(FL_RTU_MAX_BYTES_PER_POLL, maxReadsPerPoll);
+  assertPollBudget();
+}
+
+// Continuous noise: one byte per character time, far more than one poll drains
+static void floodNoise(uint32_t fromUs, uint32_t forUs, uint32_t seed) {
+  uint32_t n = forUs / 100;
+  if (n > RX_CAP - rxTail) n = RX_CAP - rxTail;
+  for (uint32_t i = 0; i < n; i++) {
+    seed = seed * 1103515245u + 12345u;
+    rxPush((uint8_t)(seed >> 16), fromUs + i * 100);
+  }
+}
+
+void test_noise_before_request_never_transmits_into_it(void) {
+  onRequest = nullptr;
+  floodNoise(fakeNowUs, 600000, 1);
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 2, onDone, nullptr, fakeNowUs);
+  uint32_t start = fakeNowUs;
+  runUntilDone(1000, 2000000);
+
+  // The line never went quiet for t3.5: nothing sent, and the transaction
+  // gives up after the response timeout instead of holding the bus
+  TEST_ASSERT_EQUAL(0, txLen);
+  TEST_ASSERT_FALSE(deOn);
+  TEST_ASSERT_EQUAL(1, doneCount);
+  TEST_ASSERT_EQUAL(FL_RTU_TIMEOUT, lastStatus);
+  TEST_ASSERT_LESS_THAN(260000, fakeNowUs - start);
+  assertPollBudget();
+}
+
+void test_noise_during_reply(void) {
+  for (uint8_t slave = 1; slave <= 50; slave++) {
+    setUp();
+    onRequest = [](const uint8_t*, size_t) { floodNoise(fakeNowUs + 2000, 800000, 7); };
+    fl_rtuRequest(rtu, slave, FL_RTU_FC_READ_HOLDING, 0, 2, onDone, nullptr, fakeNowUs);
+    runUntilDone(1000, 2000000);
+
+    TEST_ASSERT_EQUAL(1, doneCount);
+    TEST_ASSERT_TRUE(lastStatus != FL_RTU_OK);
+    assertPollBudget();
+  }
+}
+
+static void chainNext(fl_rtu_status_t status, const uint16_t* regs, uint8_t count, void* ctx) {
+  onDone(status, regs, count, ctx);
+  if (doneCount < 20) {
+    TEST_ASSERT_TRUE(fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 2, chainNext, nullptr, fakeNowUs));
+  }
+}
+
+void test_back_to_back_from_callback(void) {
+  fl_rtuRequest(rtu, 1, FL_RTU_FC_READ_HOLDING, 0, 2, chainNext, nullptr, fakeNowUs);
+  for (uint32_t n = 0; n < 100000 && fl_rtuBusy(rtu); n++) {
+    timedPoll();
+    fakeNowUs += 500;
+  }
+  TEST_ASSERT_EQUAL(20, doneCount);
+  TEST_ASSERT_EQUAL(20, rtu.transactions);
+  TEST_ASSERT_EQUAL(0, rtu.errors);
+  assertPollBudget();
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc16_reference);
+  RUN_TEST(test_read_ok);
+  RUN_TEST(test_timeout_without_reply);
+  RUN_TEST(test_timeout_on_stalled_reply);
+  RUN_TEST(test_crc_error);
+  RUN_TEST(test_exception_reply);
+  RUN_TEST(test_trickling_slave);
+  RUN_TEST(test_burst_reply_bounded_per_poll);
+  RUN_TEST(test_noise_before_request_never_transmits_into_it);
+  RUN_TEST(test_noise_during_reply);
+  RUN_TEST(test_back_to_back_from_callback);
+  char msg[64];
+  snprintf(msg, sizeof(msg), "worst fl_rtuPoll(): %u us", (unsigned)worstPollUs);
+  TEST_MESSAGE(msg);
+  return UNITY_END();
+}
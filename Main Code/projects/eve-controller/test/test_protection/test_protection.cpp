@@ -0,0 +1,404 @@
+// Host tests for the protection engine: pickup delays, inrush blanking,
+// start timeout, run detection, the inverse-time curves, a scenario sweep
+// and a throughput benchmark of fl_protectionStep().
+
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <math.h>
+#include "fl_protection.cpp"
+
+static fl_protection_config_t cfg;
+static fl_protection_t prot;
+static fl_protection_input_t in;
+
+// 10 A motor, 1 s overcurrent, 5 s dry run, 3 s start timeout
+static void baseConfig(fl_protection_config_t& c) {
+  memset(&c, 0, sizeof(c));
+  c.overcurrentEnabled = true;
+  c.maxCurrent = 15.0f;
+  c.overcurrentDelayMs = 1000;
+  c.dryRunEnabled = true;
+  c.dryCurrent = 2.0f;
+  c.dryRunDelayMs = 5000;
+  c.startTimeoutMs = 3000;
+  c.runThreshold = 1.0f;
+  c.hysteresis = 0.3f;
+  c.debounceCount = 3;
+  c.thermalMode = FL_THERMAL_OFF;
+}
+
+void setUp(void) {
+  baseConfig(cfg);
+  fl_protectionInit(prot);
+  memset(&in, 0, sizeof(in));
+  in.state = FL_MOTOR_STOPPED;
+}
+
+void tearDown(void) {}
+
+// Feed one sample and carry the decided state into the next input
+static fl_protection_decision_t step(uint32_t nowMs, float current) {
+  in.nowMs = nowMs;
+  in.current = current;
+  fl_protection_decision_t d = fl_protectionStep(prot, cfg, in);
+  in.state = d.state;
+  return d;
+}
+
+// Command a start and run until the debounce confirms RUNNING
+static uint32_t startRunning(uint32_t t0, float current) {
+  in.startCommand = true;
+  in.startCommandMs = t0;
+  in.contactorClosed = true;
+  in.contactorCloseMs = t0;
+  uint32_t t = t0;
+  while (in.state != FL_MOTOR_RUNNING) {
+    step(t, current);
+    t += 100;
+  }
+  return t;
+}
+
+// Time of the first trip at a fixed sample period, or UINT32_MAX
+static uint32_t runUntilTrip(uint32_t t, uint32_t endMs, uint32_t periodMs, float current,
+                             fl_trip_t* why = nullptr) {
+  for (; t <= endMs; t += periodMs) {
+    fl_protection_decision_t d = step(t, current);
+    if (d.events & FL_PROT_EV_TRIP) {
+      if (why) *why = d.trip;
+      return t;
+    }
+  }
+  return UINT32_MAX;
+}
+
+void test_overcurrent_trips_after_delay(void) {
+  uint32_t t = startRunning(0, 10.0f);
+  fl_protection_decision_t d = step(t, 20.0f);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_OC_START, d.events);
+  TEST_ASSERT_EQUAL(FL_MOTOR_RUNNING, d.state);
+
+  d = step(t + 999, 20.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, d.trip);
+
+  d = step(t + 1000, 20.0f);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_TRIP, d.events);
+  TEST_ASSERT_EQUAL(FL_TRIP_OVERCURRENT, d.trip);
+  TEST_ASSERT_EQUAL(FL_MOTOR_FAULT, d.state);
+  TEST_ASSERT_EQUAL(FL_FAULT_OVERCURRENT, fl_faultFromTrip(d.trip));
+}
+
+void test_overcurrent_clears_before_delay(void) {
+  uint32_t t = startRunning(0, 10.0f);
+  step(t, 20.0f);
+  fl_protection_decision_t d = step(t + 500, 10.0f);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_OC_CLEAR, d.events);
+
+  // The delay restarts from the next pickup
+  step(t + 600, 20.0f);
+  d = step(t + 1500, 20.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, d.trip);
+  d = step(t + 1600, 20.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_OVERCURRENT, d.trip);
+}
+
+void test_overcurrent_blanked_during_inrush(void) {
+  cfg.inrushBlankMs = 2000;
+  cfg.overcurrentDelayMs = 0;
+  in.startCommand = true;
+  in.contactorClosed = true;
+  in.contactorCloseMs = 0;
+
+  fl_protection_decision_t d = step(0, 60.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, d.trip);
+  d = step(1999, 60.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, d.trip);
+  d = step(2000, 60.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_OVERCURRENT, d.trip);
+}
+
+void test_dry_run_trips_when_running_light(void) {
+  uint32_t t = startRunning(0, 10.0f);
+  // Below the dry-run current but above the stop threshold
+  fl_protection_decision_t d = step(t, 1.5f);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_DR_START, d.events);
+  d = step(t + 4999, 1.5f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, d.trip);
+  d = step(t + 5000, 1.5f);
+  TEST_ASSERT_EQUAL(FL_TRIP_DRY_RUN, d.trip);
+}
+
+void test_dry_run_ignored_without_command(void) {
+  uint32_t t = startRunning(0, 10.0f);
+  in.startCommand = false;
+  TEST_ASSERT_EQUAL(UINT32_MAX, runUntilTrip(t, t + 20000, 100, 1.5f));
+}
+
+void test_start_timeout(void) {
+  in.startCommand = true;
+  in.startCommandMs = 0;
+  fl_trip_t why = FL_TRIP_NONE;
+  uint32_t at = runUntilTrip(0, 10000, 100, 0.0f, &why);
+  TEST_ASSERT_EQUAL(FL_TRIP_START_TIMEOUT, why);
+  TEST_ASSERT_EQUAL_UINT32(3100, at);
+  // Reported under the DRY_RUN fault string
+  TEST_ASSERT_EQUAL(FL_FAULT_DRY_RUN, fl_faultFromTrip(why));
+}
+
+void test_run_detection_debounce(void) {
+  fl_protection_decision_t d = step(0, 5.0f);
+  TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, d.state);
+  d = step(100, 5.0f);
+  TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, d.state);
+  // A dip resets the count
+  d = step(200, 0.0f);
+  d = step(300, 5.0f);
+  d = step(400, 5.0f);
+  TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, d.state);
+  TEST_ASSERT_TRUE(fl_protectionTiming(prot));
+  d = step(500, 5.0f);
+  TEST_ASSERT_EQUAL(FL_MOTOR_RUNNING, d.state);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_STATE, d.events);
+  TEST_ASSERT_FALSE(fl_protectionTiming(prot));
+}
+
+void test_run_detection_hysteresis(void) {
+  uint32_t t = startRunning(0, 5.0f);
+  in.startCommand = false;
+  // Inside the band (0.7..1.0 A) the motor stays RUNNING
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL(FL_MOTOR_RUNNING, step(t, 0.8f).state);
+    t += 100;
+  }
+  step(t, 0.5f);
+  step(t + 100, 0.5f);
+  fl_protection_decision_t d = step(t + 200, 0.5f);
+  TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, d.state);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_STATE, d.events);
+
+  // ...and from STOPPED, 0.8 A is not enough to count as running
+  for (int i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, step(t + 300 + i * 100, 0.8f).state);
+  }
+}
+
+void test_sensor_fault_and_auto_reset(void) {
+  cfg.faultAutoResetMs = 10000;
+  in.sensorFault = true;
+  fl_protection_decision_t d = step(1000, 0.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_SENSOR, d.trip);
+
+  in.sensorFault = false;
+  d = step(11000, 0.0f);
+  TEST_ASSERT_BITS_LOW(FL_PROT_EV_AUTO_RESET, d.events);
+  d = step(11001, 0.0f);
+  TEST_ASSERT_BITS_HIGH(FL_PROT_EV_AUTO_RESET, d.events);
+}
+
+// IEC 60255-151 standard inverse: t = TMS * 0.14 / ((I/Is)^0.02 - 1)
+void test_idmt_trip_time(void) {
+  const float multiples[] = { 1.5f, 2.0f, 5.0f, 10.0f };
+  const float tmsValues[] = { 0.1f, 0.5f, 1.0f };
+
+  for (float tms : tmsValues) {
+    for (float m : multiples) {
+      setUp();
+      cfg.overcurrentEnabled = false;
+      cfg.thermalMode = FL_THERMAL_IDMT;
+      cfg.thermalPickup = 10.0f;
+      cfg.thermalTms = tms;
+      // Overload starts right after the sample at t
+      uint32_t t = startRunning(0, 10.0f);
+      step(t, 10.0f);
+      fl_trip_t why = FL_TRIP_NONE;
+      uint32_t at = runUntilTrip(t + 10, t + 600000, 10, 10.0f * m, &why);
+      float expected = tms * 0.14f / (powf(m, 0.02f) - 1.0f);
+      TEST_ASSERT_EQUAL(FL_TRIP_THERMAL, why);
+      TEST_ASSERT_FLOAT_WITHIN(expected * 0.01f + 0.02f, expected, (at - t) / 1000.0f);
+    }
+  }
+}
+
+void test_idmt_resets_below_pickup(void) {
+  cfg.overcurrentEnabled = false;
+  cfg.thermalMode = FL_THERMAL_IDMT;
+  cfg.thermalPickup = 10.0f;
+  cfg.thermalTms = 1.0f;
+  cfg.tauCoolS = 1.0f;
+  uint32_t t = startRunning(0, 10.0f);
+  // Half the 2x trip time, then well below pickup
+  runUntilTrip(t, t + 5000, 10, 20.0f);
+  float accumulated = prot.thermal;
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.5f, accumulated);
+  runUntilTrip(t + 5010, t + 15000, 10, 5.0f);
+  TEST_ASSERT_LESS_THAN(0.001f, prot.thermal);
+}
+
+// First-order image from cold: trips when r^2 (1 - e^(-t/tau)) reaches 1
+void test_thermal_image_trip_time(void) {
+  const float ratios[] = { 1.2f, 2.0f, 6.0f };
+  for (float r : ratios) {
+    setUp();
+    cfg.overcurrentEnabled = false;
+    cfg.thermalMode = FL_THERMAL_IMAGE;
+    cfg.thermalPickup = 10.0f;
+    cfg.tauHeatS = 300.0f;
+    cfg.tauCoolS = 1200.0f;
+    uint32_t t = startRunning(0, 10.0f * r);
+    step(t, 10.0f * r);
+    float head = prot.thermal;
+    fl_trip_t why = FL_TRIP_NONE;
+    uint32_t at = runUntilTrip(t + 100, t + 3600000, 100, 10.0f * r, &why);
+    float r2 = r * r;
+    float expected = 300.0f * logf((r2 - head) / (r2 - 1.0f));
+    TEST_ASSERT_EQUAL(FL_TRIP_THERMAL, why);
+    TEST_ASSERT_FLOAT_WITHIN(expected * 0.01f + 0.2f, expected, (at - t) / 1000.0f);
+  }
+}
+
+void test_thermal_image_holds_at_full_load(void) {
+  cfg.overcurrentEnabled = false;
+  cfg.thermalMode = FL_THERMAL_IMAGE;
+  cfg.thermalPickup = 10.0f;
+  cfg.tauHeatS = 300.0f;
+  cfg.tauCoolS = 1200.0f;
+  uint32_t t = startRunning(0, 9.5f);
+  TEST_ASSERT_EQUAL(UINT32_MAX, runUntilTrip(t, t + 7200000, 1000, 9.5f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.9025f, prot.thermal);
+}
+
+// Inrush before the debounce confirms RUNNING heats with the heating time
+// constant, not the (much longer) cooling one
+void test_thermal_image_heats_during_start(void) {
+  cfg.overcurrentEnabled = false;
+  cfg.thermalMode = FL_THERMAL_IMAGE;
+  cfg.thermalPickup = 10.0f;
+  cfg.tauHeatS = 10.0f;
+  cfg.tauCoolS = 1000.0f;
+  cfg.debounceCount = 50;
+  in.startCommand = true;
+  in.contactorClosed = true;
+
+  // 1.5x full load for 2 s, sampled every 100 ms, all of it still STOPPED
+  for (uint32_t t = 0; t <= 2000; t += 100) {
+    TEST_ASSERT_EQUAL(FL_MOTOR_STOPPED, step(t, 15.0f).state);
+  }
+  float expected = 2.25f * (1.0f - expf(-2.0f / 10.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, expected, prot.thermal);
+}
+
+// A mode change starts from cold: heat built up under IDMT must not count
+// towards the image's trip
+void test_thermal_reset_on_mode_change(void) {
+  cfg.overcurrentEnabled = false;
+  cfg.thermalMode = FL_THERMAL_IDMT;
+  cfg.thermalPickup = 10.0f;
+  cfg.thermalTms = 1.0f;
+  uint32_t t = startRunning(0, 10.0f);
+  // 90% of the way to an IDMT trip at 2x
+  TEST_ASSERT_EQUAL(UINT32_MAX, runUntilTrip(t, t + 9000, 10, 20.0f));
+  TEST_ASSERT_GREATER_THAN_FLOAT(0.85f, prot.thermal);
+
+  fl_protectionThermalReset(prot);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, prot.thermal);
+  cfg.thermalMode = FL_THERMAL_IMAGE;
+  cfg.tauHeatS = 300.0f;
+  cfg.tauCoolS = 1200.0f;
+  t += 9010;
+  step(t, 12.0f);
+  fl_trip_t why = FL_TRIP_NONE;
+  uint32_t at = runUntilTrip(t + 100, t + 3600000, 100, 12.0f, &why);
+  float expected = 300.0f * logf(1.44f / 0.44f);
+  TEST_ASSERT_EQUAL(FL_TRIP_THERMAL, why);
+  TEST_ASSERT_FLOAT_WITHIN(expected * 0.01f + 0.2f, expected, (at - t) / 1000.0f);
+}
+
+// Every combination of delay, sample period and overcurrent level: the trip
+// lands on the first sample at or after the pickup delay, never before
+void test_overcurrent_scenario_sweep(void) {
+  const uint32_t delays[] = { 0, 100, 250, 1000, 2500, 5000 };
+  const uint32_t periods[] = { 10, 33, 100, 250, 1000 };
+  uint32_t scenarios = 0;
+
+  for (uint32_t delay : delays) {
+    for (uint32_t period : periods) {
+      for (int level = 0; level < 100; level++) {
+        setUp();
+        cfg.overcurrentDelayMs = delay;
+        cfg.dryRunEnabled = false;
+        float current = cfg.maxCurrent + 0.1f + level * 0.5f;
+        uint32_t t = startRunning(0, 10.0f);
+        fl_trip_t why = FL_TRIP_NONE;
+        uint32_t at = runUntilTrip(t, t + delay + 2 * period, period, current, &why);
+        uint32_t expected = t + ((delay + period - 1) / period) * period;
+        TEST_ASSERT_EQUAL(FL_TRIP_OVERCURRENT, why);
+        TEST_ASSERT_EQUAL_UINT32(expected, at);
+        scenarios++;
+      }
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(3000, scenarios);
+}
+
+// Timestamps wrap at 2^32 ms (49.7 days) on the device
+void test_pickup_across_millis_wrap(void) {
+  uint32_t t0 = 0xFFFFFF00u;
+  uint32_t t = startRunning(t0, 10.0f);
+  step(t, 20.0f);
+  TEST_ASSERT_EQUAL(FL_TRIP_NONE, step(t + 999, 20.0f).trip);
+  TEST_ASSERT_EQUAL(FL_TRIP_OVERCURRENT, step(t + 1000, 20.0f).trip);
+}
+
+void test_benchmark_step_throughput(void) {
+  cfg.thermalMode = FL_THERMAL_IMAGE;
+  cfg.thermalPickup = 10.0f;
+  cfg.tauHeatS = 300.0f;
+  cfg.tauCoolS = 1200.0f;
+  cfg.maxCurrent = 1000.0f;
+  cfg.dryRunEnabled = false;
+  uint32_t t = startRunning(0, 10.0f);
+
+  const uint32_t kSteps = 2000000;
+  uint32_t trips = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (uint32_t n = 0; n < kSteps; n++) {
+    // Load wobbles around full load so every branch does real work
+    float current = 9.0f + (float)(n & 7) * 0.25f;
+    if (step(t + n * 10, current).events & FL_PROT_EV_TRIP) trips++;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - begin).count() / kSteps;
+  char msg[96];
+  snprintf(msg, sizeof(msg), "fl_protectionStep: %.1f ns/step, %.2f M steps/s",
+           ns, 1000.0 / ns);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(0, trips);
+  // Generous bound: a regression to per-step allocation or history scans
+  // shows up as microseconds
+  TEST_ASSERT_LESS_THAN(2000.0, ns);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_overcurrent_trips_after_delay);
+  RUN_TEST(test_overcurrent_clears_before_delay);
+  RUN_TEST(test_overcurrent_blanked_during_inrush);
+  RUN_TEST(test_dry_run_trips_when_running_light);
+  RUN_TEST(test_dry_run_ignored_without_command);
+  RUN_TEST(test_start_timeout);
+  RUN_TEST(test_run_detection_debounce);
+  RUN_TEST(test_run_detection_hysteresis);
+  RUN_TEST(test_sensor_fault_and_auto_reset);
+  RUN_TEST(test_idmt_trip_time);
+  RUN_TEST(test_idmt_resets_below_pickup);
+  RUN_TEST(test_thermal_image_trip_time);
+  RUN_TEST(test_thermal_image_holds_at_full_load);
+  RUN_TEST(test_thermal_image_heats_during_start);
+  RUN_TEST(test_thermal_reset_on_mode_change);
+  RUN_TEST(test_overcurrent_scenario_sweep);
+  RUN_TEST(test_pickup_across_millis_wrap);
+  RUN_TEST(test_benchmark_step_throughput);
+  return UNITY_END();
+}
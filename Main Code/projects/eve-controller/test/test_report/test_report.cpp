@@ -0,0 +1,140 @@
+// Host tests for the telemetry publish policy (report-by-exception):
+// events, deadband drift, heartbeat, periodic mode, back-off and stretch.
+
+#include <unity.h>
+#include "fl_report.cpp"
+
+static fl_report_t r;
+
+void setUp(void) {
+  fl_reportInit(r);
+  r.cfg.intervalMs = 2000;
+  r.cfg.heartbeatS = 60;
+}
+
+void tearDown(void) {}
+
+// Decide and, if asked to publish, record the outcome
+static fl_report_reason_t tick(uint32_t nowMs, bool event, bool drift, bool ok = true,
+                               bool requested = false) {
+  fl_report_reason_t why = fl_reportDecide(r, nowMs, requested, event, drift);
+  if (why != FL_REPORT_NONE) fl_reportSent(r, nowMs, why, ok);
+  return why;
+}
+
+void test_defaults(void) {
+  fl_reportInit(r);
+  TEST_ASSERT_TRUE(r.cfg.exception);
+  TEST_ASSERT_EQUAL_UINT32(FL_REPORT_DEFAULT_INTERVAL_MS, r.cfg.intervalMs);
+  TEST_ASSERT_EQUAL(FL_REPORT_DEFAULT_HEARTBEAT_S, r.cfg.heartbeatS);
+  TEST_ASSERT_EQUAL_UINT32(0, fl_reportPublishedTotal(r));
+}
+
+void test_exceeds(void) {
+  TEST_ASSERT_FALSE(fl_reportExceeds(230.0f, 231.9f, 2.0f));
+  TEST_ASSERT_TRUE(fl_reportExceeds(230.0f, 232.1f, 2.0f));
+  TEST_ASSERT_TRUE(fl_reportExceeds(230.0f, 227.9f, 2.0f));
+  TEST_ASSERT_TRUE(fl_reportExceeds(1.0f, 1.01f, 0.0f));
+  TEST_ASSERT_TRUE(fl_reportExceeds(NAN, 1.0f, 2.0f));
+  TEST_ASSERT_TRUE(fl_reportExceeds(1.0f, NAN, 2.0f));
+  TEST_ASSERT_FALSE(fl_reportExceeds(NAN, NAN, 2.0f));
+}
+
+void test_event_publishes_at_once(void) {
+  TEST_ASSERT_EQUAL(FL_REPORT_EVENT, tick(2000, true, false));
+  // A second event inside the interval still goes straight out
+  TEST_ASSERT_EQUAL(FL_REPORT_EVENT, tick(2100, true, false));
+  TEST_ASSERT_EQUAL_UINT32(2, r.published[FL_REPORT_EVENT]);
+}
+
+void test_drift_waits_for_interval(void) {
+  TEST_ASSERT_EQUAL(FL_REPORT_DEADBAND, tick(2000, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(2500, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(3999, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_DEADBAND, tick(4000, false, true));
+}
+
+void test_heartbeat_when_idle(void) {
+  tick(2000, true, false);
+  uint32_t heartbeats = 0, frames = 0;
+  for (uint32_t t = 2100; t <= 2000 + 180000; t += 100) {
+    fl_report_reason_t why = tick(t, false, false);
+    if (why == FL_REPORT_HEARTBEAT) heartbeats++;
+    if (why != FL_REPORT_NONE) frames++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, heartbeats);
+  TEST_ASSERT_EQUAL_UINT32(3, frames);
+  // Each 2 s interval with nothing to say counts as suppressed
+  TEST_ASSERT_GREATER_THAN_UINT32(80, r.suppressed);
+}
+
+void test_heartbeat_measured_from_last_publish(void) {
+  tick(2000, true, false);
+  tick(50000, false, true);             // Drift resets the heartbeat clock
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(100000, false, false));
+  TEST_ASSERT_EQUAL(FL_REPORT_HEARTBEAT, tick(110000, false, false));
+}
+
+void test_periodic_mode(void) {
+  r.cfg.exception = false;
+  uint32_t frames = 0;
+  for (uint32_t t = 0; t <= 20000; t += 100) {
+    fl_report_reason_t why = tick(t, t == 500, false);
+    if (why != FL_REPORT_NONE) {
+      TEST_ASSERT_EQUAL(FL_REPORT_PERIODIC, why);
+      frames++;
+    }
+  }
+  // Every interval, events or not
+  TEST_ASSERT_EQUAL_UINT32(10, frames);
+}
+
+void test_request_always_publishes(void) {
+  tick(2000, true, false);
+  TEST_ASSERT_EQUAL(FL_REPORT_REQUEST, tick(2001, false, false, true, true));
+  r.cfg.exception = false;
+  TEST_ASSERT_EQUAL(FL_REPORT_REQUEST, tick(2002, false, false, true, true));
+}
+
+void test_failed_publish_backs_off_to_next_interval(void) {
+  TEST_ASSERT_EQUAL(FL_REPORT_EVENT, tick(2000, true, false, false));
+  TEST_ASSERT_EQUAL_UINT32(1, r.failed);
+  TEST_ASSERT_EQUAL_UINT32(0, fl_reportPublishedTotal(r));
+  // The event is still pending but waits for the interval
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(2500, true, false));
+  TEST_ASSERT_EQUAL(FL_REPORT_EVENT, tick(4000, true, false));
+  TEST_ASSERT_FALSE(r.backoff);
+  // A failed attempt does not count as a heartbeat
+  TEST_ASSERT_EQUAL_UINT32(4000, r.lastPublishMs);
+}
+
+void test_stretch_lengthens_interval(void) {
+  r.stretchMs = 3000;
+  tick(5000, false, true);
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(9999, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_DEADBAND, tick(10000, false, true));
+}
+
+void test_millis_wrap(void) {
+  uint32_t t0 = 0xFFFFF000u;
+  tick(t0, true, false);
+  TEST_ASSERT_EQUAL(FL_REPORT_NONE, tick(t0 + 1000, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_DEADBAND, tick(t0 + 2000, false, true));
+  TEST_ASSERT_EQUAL(FL_REPORT_HEARTBEAT, tick(t0 + 62000, false, false));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults);
+  RUN_TEST(test_exceeds);
+  RUN_TEST(test_event_publishes_at_once);
+  RUN_TEST(test_drift_waits_for_interval);
+  RUN_TEST(test_heartbeat_when_idle);
+  RUN_TEST(test_heartbeat_measured_from_last_publish);
+  RUN_TEST(test_periodic_mode);
+  RUN_TEST(test_request_always_publishes);
+  RUN_TEST(test_failed_publish_backs_off_to_next_interval);
+  RUN_TEST(test_stretch_lengthens_interval);
+  RUN_TEST(test_millis_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,227 @@
+// Host tests for the pump run window: the next-edge walk across midnight,
+// month and year ends, the horizon fallback when nothing ever changes,
+// tariff-driven edges, and the allow-everything answer before the clock is
+// set. Every edge is also checked minute by minute against
+// fl_scheduleAllowedAt.
+
+#include <unity.h>
+#include <stdlib.h>
+#include <ArduinoJson.h>
+#include "fl_tariff.cpp"
+#include "fl_schedule.cpp"
+
+// SAST, as configTime() sets it for the Ruraflex sites
+static const char* kTz = "SAST-2";
+
+static fl_schedule_t s;
+static fl_tariff_map_t ruraflex;
+
+static time_t at(int year, int month, int mday, int hour, int minute) {
+  struct tm d = {};
+  d.tm_year = year - 1900;
+  d.tm_mon = month - 1;
+  d.tm_mday = mday;
+  d.tm_hour = hour;
+  d.tm_min = minute;
+  d.tm_isdst = -1;
+  return mktime(&d);
+}
+
+static bool allowedAt(const fl_tariff_map_t* tariff, time_t t) {
+  struct tm d;
+  localtime_r(&t, &d);
+  return fl_scheduleAllowedAt(s, tariff, d, d.tm_hour * 60 + d.tm_min);
+}
+
+// Same state from now up to the edge, the other state at it
+static void checkEdge(const fl_tariff_map_t* tariff, time_t now, fl_schedule_eval_t e) {
+  TEST_ASSERT_EQUAL(allowedAt(tariff, now), e.allowed);
+  TEST_ASSERT_TRUE(e.nextChange > now);
+  uint32_t same = 0;
+  for (time_t t = now - now % 60 + 60; t < e.nextChange; t += 60)
+    if (allowedAt(tariff, t) == e.allowed) same++;
+  TEST_ASSERT_EQUAL_UINT32((e.nextChange - (now - now % 60) - 1) / 60, same);
+  TEST_ASSERT_NOT_EQUAL(e.allowed, allowedAt(tariff, e.nextChange));
+}
+
+static void window(uint8_t startHour, uint8_t endHour, uint8_t days) {
+  s = {};
+  s.enabled = true;
+  s.startHour = startHour;
+  s.endHour = endHour;
+  s.days = days;
+}
+
+void setUp(void) {
+  setenv("TZ", kTz, 1);
+  tzset();
+  window(6, 18, 0x7F);
+  fl_tariff_t t;
+  fl_tariffDefault(t);
+  fl_tariffCompile(t, ruraflex);
+}
+
+void tearDown(void) {}
+
+void test_daytime_window(void) {
+  time_t now = at(2026, 3, 10, 5, 30);
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 10, 6, 0), e.nextChange);
+  checkEdge(nullptr, now, e);
+
+  now = at(2026, 3, 10, 6, 0);
+  e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 10, 18, 0), e.nextChange);
+}
+
+void test_overnight_window(void) {
+  window(22, 5, 0x7F);
+  s.endMinute = 30;
+  time_t now = at(2026, 3, 10, 21, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 10, 22, 0), e.nextChange);
+
+  now = at(2026, 3, 10, 23, 15) + 42;
+  e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 11, 5, 30), e.nextChange);
+  checkEdge(nullptr, now, e);
+
+  now = at(2026, 3, 11, 5, 29) + 59;
+  e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 11, 5, 30), e.nextChange);
+}
+
+void test_overnight_window_on_chosen_days(void) {
+  // Starts on Friday evening only; the early hours belong to their own day,
+  // which is not in the mask
+  window(22, 5, 1 << 5);
+  time_t now = at(2026, 3, 13, 23, 0);     // Friday
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 14, 0, 0), e.nextChange);
+  checkEdge(nullptr, now, e);
+}
+
+void test_edge_across_month_end(void) {
+  // Sundays 06:00-07:00; Saturday 28 February 2026 to Sunday 1 March
+  window(6, 7, 1 << 0);
+  time_t now = at(2026, 2, 28, 20, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 3, 1, 6, 0), e.nextChange);
+  checkEdge(nullptr, now, e);
+}
+
+void test_edge_across_year_end(void) {
+  // Mondays only, from Wednesday 31 December 2025 to Monday 5 January 2026
+  window(8, 17, 1 << 1);
+  time_t now = at(2025, 12, 31, 18, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 1, 5, 8, 0), e.nextChange);
+  checkEdge(nullptr, now, e);
+
+  // Overnight through midnight on New Year's Eve
+  window(22, 5, 0x7F);
+  now = at(2025, 12, 31, 23, 0);
+  e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 1, 1, 5, 0), e.nextChange);
+}
+
+void test_no_days_falls_back_to_horizon(void) {
+  window(6, 18, 0);
+  time_t now = at(2026, 7, 1, 12, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(now + FL_SCHEDULE_HORIZON_DAYS * 86400L, e.nextChange);
+
+  // A window that never closes behaves the same way
+  window(0, 0, 0x7F);
+  s.endHour = 0;
+  s.startHour = 0;
+  e = fl_scheduleEval(s, nullptr, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(now + FL_SCHEDULE_HORIZON_DAYS * 86400L, e.nextChange);
+}
+
+void test_tariff_edges(void) {
+  // High-season Tuesday: off-peak until 06:00, then peak/standard to 22:00
+  s.enabled = false;        // The tariff applies whatever the pump's own window
+  time_t now = at(2026, 7, 14, 5, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, &ruraflex, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 7, 14, 6, 0), e.nextChange);
+  checkEdge(&ruraflex, now, e);
+
+  now = at(2026, 7, 14, 6, 30);
+  e = fl_scheduleEval(s, &ruraflex, now);
+  TEST_ASSERT_FALSE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 7, 14, 22, 0), e.nextChange);
+  checkEdge(&ruraflex, now, e);
+
+  // Friday night into the Saturday standard block
+  now = at(2026, 7, 17, 23, 0);
+  e = fl_scheduleEval(s, &ruraflex, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 7, 18, 7, 0), e.nextChange);
+
+  // Sunday 31 May (low season) into Monday 1 June (high season)
+  now = at(2026, 5, 31, 20, 0);
+  e = fl_scheduleEval(s, &ruraflex, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(at(2026, 6, 1, 6, 0), e.nextChange);
+  checkEdge(&ruraflex, now, e);
+}
+
+void test_tariff_everything_allowed_uses_horizon(void) {
+  fl_tariff_t t;
+  fl_tariffDefault(t);
+  t.allowMask = 0x07;
+  fl_tariff_map_t all;
+  fl_tariffCompile(t, all);
+  time_t now = at(2026, 7, 14, 12, 0);
+  fl_schedule_eval_t e = fl_scheduleEval(s, &all, now);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(now + FL_SCHEDULE_HORIZON_DAYS * 86400L, e.nextChange);
+}
+
+void test_clock_not_valid(void) {
+  // Before the first NTP sync: allowed, nothing pending, tariff or not
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, 3600);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(0, e.nextChange);
+  e = fl_scheduleEval(s, &ruraflex, FL_CLOCK_VALID_EPOCH - 1);
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(0, e.nextChange);
+  e = fl_scheduleEval(s, nullptr, FL_CLOCK_VALID_EPOCH);
+  TEST_ASSERT_NOT_EQUAL(0, e.nextChange);
+}
+
+void test_disabled_without_tariff(void) {
+  s.enabled = false;
+  s.days = 0;
+  fl_schedule_eval_t e = fl_scheduleEval(s, nullptr, at(2026, 7, 14, 12, 0));
+  TEST_ASSERT_TRUE(e.allowed);
+  TEST_ASSERT_EQUAL_INT64(0, e.nextChange);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_daytime_window);
+  RUN_TEST(test_overnight_window);
+  RUN_TEST(test_overnight_window_on_chosen_days);
+  RUN_TEST(test_edge_across_month_end);
+  RUN_TEST(test_edge_across_year_end);
+  RUN_TEST(test_no_days_falls_back_to_horizon);
+  RUN_TEST(test_tariff_edges);
+  RUN_TEST(test_tariff_everything_allowed_uses_horizon);
+  RUN_TEST(test_clock_not_valid);
+  RUN_TEST(test_disabled_without_tariff);
+  return UNITY_END();
+}
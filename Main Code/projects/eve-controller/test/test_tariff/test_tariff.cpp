@@ -0,0 +1,228 @@
+// Host tests for the TOU tariff engine: the compiled bitmaps against a
+// minute-by-minute walk of the definition (default Ruraflex and custom
+// tariffs), segments across midnight, overlap order, holidays, and the
+// definitions SET_TARIFF must refuse.
+
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "fl_tariff.cpp"
+
+static fl_tariff_t t;
+static fl_tariff_map_t map;
+static StaticJsonDocument<4096> doc;
+
+static struct tm dayOf(uint8_t month, uint8_t mday, uint8_t wday) {
+  struct tm d = {};
+  d.tm_mon = month - 1;
+  d.tm_mday = mday;
+  d.tm_wday = wday;
+  return d;
+}
+
+// The definition read directly: off-peak unless a segment covers the
+// minute, the last covering segment deciding the band
+static bool naiveAllows(const fl_tariff_t& def, uint8_t month, uint8_t wday, bool holiday, uint16_t minute) {
+  const fl_tou_season_t* season = nullptr;
+  for (uint8_t s = 0; s < def.seasonCount; s++)
+    if (def.season[s].months & (1 << (month - 1))) season = &def.season[s];
+  if (!season) return false;       // fl_tariffValidate() rules this out
+  fl_tou_day_t d = holiday ? FL_TOU_HOLIDAY : wday == 0 ? FL_TOU_SUNDAY : wday == 6 ? FL_TOU_SATURDAY : FL_TOU_WEEKDAY;
+  const fl_tou_profile_t& p = season->day[d];
+  fl_tou_band_t band = FL_TOU_OFF_PEAK;
+  for (uint8_t k = 0; k < p.count; k++) {
+    const fl_tou_segment_t& g = p.seg[k];
+    bool in = g.startMin < g.endMin ? minute >= g.startMin && minute < g.endMin
+                                    : minute >= g.startMin || minute < g.endMin;
+    if (in) band = g.band;
+  }
+  return def.allowMask & (1 << band);
+}
+
+// Every minute of every weekday of every month, plus each holiday
+static void checkAgainstNaive(const fl_tariff_t& def) {
+  TEST_ASSERT_NULL(fl_tariffValidate(def));
+  fl_tariffCompile(def, map);
+  uint32_t mismatches = 0;
+  for (uint8_t month = 1; month <= 12; month++) {
+    for (uint8_t wday = 0; wday < 7; wday++) {
+      struct tm d = dayOf(month, 2 + wday, wday);
+      bool holiday = false;
+      for (uint8_t h = 0; h < def.holidayCount; h++)
+        if (def.holiday[h].month == month && def.holiday[h].day == d.tm_mday) holiday = true;
+      for (uint16_t minute = 0; minute < FL_TARIFF_DAY_MINUTES; minute++)
+        if (fl_tariffAllowsMinute(map, d, minute) != naiveAllows(def, month, wday, holiday, minute)) mismatches++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+}
+
+static const char* fromJson(const char* json) {
+  doc.clear();
+  if (deserializeJson(doc, json)) return "test JSON";
+  return fl_tariffFromJson(doc.as<JsonVariantConst>(), t);
+}
+
+void setUp(void) {
+  fl_tariffDefault(t);
+}
+
+void tearDown(void) {}
+
+/* ---- Compile ---- */
+
+void test_default_ruraflex_matches_definition(void) {
+  checkAgainstNaive(t);
+}
+
+void test_default_ruraflex_spot_checks(void) {
+  fl_tariffCompile(t, map);
+  struct tm julyTue = dayOf(7, 15, 2);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, julyTue, 6 * 60 + 30));    // High-season morning peak
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, julyTue, 21 * 60 + 59));   // Standard to 22:00
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, julyTue, 22 * 60));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, julyTue, 5 * 60 + 59));
+  struct tm marchTue = dayOf(3, 10, 2);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, marchTue, 8 * 60));        // Low-season peak 07:00-09:00
+  struct tm sat = dayOf(3, 14, 6);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, sat, 8 * 60));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, sat, 13 * 60));
+  // fl_tariffAllows() takes the minute from the time fields
+  julyTue.tm_hour = 23;
+  julyTue.tm_min = 15;
+  TEST_ASSERT_TRUE(fl_tariffAllows(map, julyTue));
+}
+
+void test_segment_wraps_past_midnight(void) {
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[1320,360,2]],\"sat\":[]}]}"));
+  checkAgainstNaive(t);
+  fl_tariffCompile(t, map);
+  struct tm wed = dayOf(5, 14, 3);
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, wed, 1319));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, wed, 1320));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, wed, 1439));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, wed, 0));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, wed, 359));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, wed, 360));
+  // An end of 1440 is the end of the day, not a wrap
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[1320,1440,2]]}]}"));
+  fl_tariffCompile(t, map);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, wed, 1439));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, wed, 0));
+}
+
+void test_later_segment_wins(void) {
+  // Peak all day with an off-peak hole, then the same two the other way round
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,1440,2],[600,700,0]]}]}"));
+  checkAgainstNaive(t);
+  fl_tariffCompile(t, map);
+  struct tm thu = dayOf(9, 11, 4);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, thu, 599));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, thu, 600));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, thu, 699));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, thu, 700));
+
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[600,700,0],[0,1440,2]]}]}"));
+  fl_tariffCompile(t, map);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, thu, 650));
+}
+
+void test_allow_mask_picks_bands(void) {
+  // Off-peak and standard allowed: only peak blocks
+  TEST_ASSERT_NULL(fromJson("{\"allow\":3,\"seasons\":[{\"months\":4095,"
+                            "\"wd\":[[360,480,2],[480,1020,1],[1020,1200,2]]}]}"));
+  checkAgainstNaive(t);
+}
+
+void test_holidays(void) {
+  // Weekdays peak 06:00-22:00; Sunday and, by default, holidays are free
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[360,1320,2]],\"sat\":[[360,1320,2]],\"sun\":[]}],"
+                            "\"holidays\":[[12,25],[1,1],[3,31]]}"));
+  TEST_ASSERT_EQUAL_UINT8(0, t.season[0].day[FL_TOU_HOLIDAY].count);
+  checkAgainstNaive(t);
+  fl_tariffCompile(t, map);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, dayOf(12, 24, 3), 720));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, dayOf(12, 25, 4), 720));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, dayOf(1, 1, 4), 720));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, dayOf(3, 31, 2), 720));     // Top bit of the month
+  // Same day number, other month
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, dayOf(11, 25, 2), 720));
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, dayOf(1, 31, 5), 720));
+}
+
+void test_holiday_profile_per_season(void) {
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":["
+                            "{\"months\":224,\"wd\":[],\"hol\":[[0,1440,2]]},"
+                            "{\"months\":3871,\"wd\":[],\"hol\":[]}],"
+                            "\"holidays\":[[6,16],[12,16]]}"));
+  checkAgainstNaive(t);
+  fl_tariffCompile(t, map);
+  TEST_ASSERT_FALSE(fl_tariffAllowsMinute(map, dayOf(6, 16, 1), 600));
+  TEST_ASSERT_TRUE(fl_tariffAllowsMinute(map, dayOf(12, 16, 2), 600));
+}
+
+/* ---- Definitions ---- */
+
+void test_rejects_month_in_two_seasons(void) {
+  TEST_ASSERT_EQUAL_STRING("month in two seasons",
+                           fromJson("{\"seasons\":[{\"months\":4095},{\"months\":1}]}"));
+}
+
+void test_rejects_month_without_season(void) {
+  TEST_ASSERT_EQUAL_STRING("month without season",
+                           fromJson("{\"seasons\":[{\"months\":224},{\"months\":3870}]}"));
+  TEST_ASSERT_EQUAL_STRING("month mask", fromJson("{\"seasons\":[{\"months\":8191}]}"));
+}
+
+void test_rejects_too_many_segments(void) {
+  TEST_ASSERT_EQUAL_STRING("too many segments",
+                           fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,60,1],[60,120,1],[120,180,1],"
+                                    "[180,240,1],[240,300,1],[300,360,1],[360,420,1],[420,480,1],[480,540,1]]}]}"));
+  // Eight is the limit, not over it
+  TEST_ASSERT_NULL(fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,60,1],[60,120,1],[120,180,1],"
+                            "[180,240,1],[240,300,1],[300,360,1],[360,420,1],[420,480,1]]}]}"));
+}
+
+void test_rejects_bad_segments_and_counts(void) {
+  TEST_ASSERT_EQUAL_STRING("no seasons", fromJson("{\"seasons\":[]}"));
+  TEST_ASSERT_EQUAL_STRING("too many seasons",
+                           fromJson("{\"seasons\":[{\"months\":1},{\"months\":2},{\"months\":4},"
+                                    "{\"months\":8},{\"months\":4080}]}"));
+  TEST_ASSERT_EQUAL_STRING("segment is not [start, end, band]",
+                           fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,60]]}]}"));
+  TEST_ASSERT_EQUAL_STRING("empty segment", fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[60,60,1]]}]}"));
+  TEST_ASSERT_EQUAL_STRING("segment time", fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,1441,1]]}]}"));
+  TEST_ASSERT_EQUAL_STRING("band", fromJson("{\"seasons\":[{\"months\":4095,\"wd\":[[0,60,3]]}]}"));
+  TEST_ASSERT_EQUAL_STRING("allow mask", fromJson("{\"allow\":0,\"seasons\":[{\"months\":4095}]}"));
+  TEST_ASSERT_EQUAL_STRING("holiday day", fromJson("{\"seasons\":[{\"months\":4095}],\"holidays\":[[2,0]]}"));
+  TEST_ASSERT_EQUAL_STRING("holiday month", fromJson("{\"seasons\":[{\"months\":4095}],\"holidays\":[[13,1]]}"));
+}
+
+void test_json_round_trip(void) {
+  fl_tariff_t original;
+  fl_tariffDefault(original);
+  original.holidayCount = 2;
+  original.holiday[0] = { 1, 1 };
+  original.holiday[1] = { 12, 26 };
+  doc.clear();
+  fl_tariffToJson(doc.to<JsonObject>(), original);
+  fl_tariff_t back;
+  TEST_ASSERT_NULL(fl_tariffFromJson(doc.as<JsonVariantConst>(), back));
+  TEST_ASSERT_EQUAL_MEMORY(&original, &back, sizeof(original));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_ruraflex_matches_definition);
+  RUN_TEST(test_default_ruraflex_spot_checks);
+  RUN_TEST(test_segment_wraps_past_midnight);
+  RUN_TEST(test_later_segment_wins);
+  RUN_TEST(test_allow_mask_picks_bands);
+  RUN_TEST(test_holidays);
+  RUN_TEST(test_holiday_profile_per_season);
+  RUN_TEST(test_rejects_month_in_two_seasons);
+  RUN_TEST(test_rejects_month_without_season);
+  RUN_TEST(test_rejects_too_many_segments);
+  RUN_TEST(test_rejects_bad_segments_and_counts);
+  RUN_TEST(test_json_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,14 @@
+static const golden_t kGolden[] = {
+  { "eve",
+    "031d03e803805101000506070509fd0816040100072afc0800000000000080ce040201046620060000350740e20100cd810100380100000200000064000000100e00000000000000000000070000000100000001000000110000000345564506322e31312e30",
+    "{\"V1\":230.1,\"I1\":10.46,\"s1\":\"RUNNING\",\"c1\":true,\"f1\":\"\",\"cf1\":true,\"th1\":42,\"V2\":230,\"I2\":0,\"s2\":\"STOPPED\",\"c2\":false,\"f2\":\"\",\"cf2\":false,\"V3\":null,\"I3\":12.3,\"s3\":\"FAULT\",\"c3\":false,\"f3\":\"OVERCURRENT\",\"cf3\":false,\"th3\":102,\"I1max\":15.68,\"I2max\":0,\"I3max\":18.45,\"kwh1\":1234.56,\"rh1\":987.65,\"st1\":312,\"fc1\":2,\"kwh2\":1,\"rh2\":36,\"st2\":0,\"fc2\":0,\"kwh3\":0.07,\"rh3\":0.01,\"st3\":1,\"fc3\":17,\"sensor\":true,\"uptime\":86400,\"network\":\"ETH\",\"di\":5,\"do\":6,\"hardware_type\":\"EVE\",\"firmware_version\":\"2.11.0\",\"time\":\"07:05:09\"}" },
+  { "eve",
+    "031003e9038a5101000506070916040100072a060900000000000080ce040201046620060000350740e20100cd810100380100000200000064000000100e0000000000000000000007000000010000000100000011000000",
+    "{\"V1\":231.1,\"I1\":10.46,\"s1\":\"RUNNING\",\"c1\":true,\"f1\":\"\",\"cf1\":true,\"th1\":42,\"V2\":231,\"I2\":0,\"s2\":\"STOPPED\",\"c2\":false,\"f2\":\"\",\"cf2\":false,\"V3\":null,\"I3\":12.3,\"s3\":\"FAULT\",\"c3\":false,\"f3\":\"OVERCURRENT\",\"cf3\":false,\"th3\":102,\"I1max\":15.68,\"I2max\":0,\"I3max\":18.45,\"kwh1\":1234.56,\"rh1\":987.65,\"st1\":312,\"fc1\":2,\"kwh2\":1,\"rh2\":36,\"st2\":0,\"fc2\":0,\"kwh3\":0.07,\"rh3\":0.01,\"st3\":1,\"fc3\":17,\"sensor\":true,\"uptime\":86410,\"network\":\"WiFi\",\"di\":5,\"do\":6,\"hardware_type\":\"EVE\",\"firmware_version\":\"2.11.0\"}" },
+  { "motor",
+    "031f01e8033b00000000ff173b3bac0f9f0fa00f350c120c00001808e80302050500a52382237017000000000000000000000000000000000950554d50202233502209312e342e302d726331",
+    "{\"V1\":401.2,\"V2\":399.9,\"V3\":400,\"IL1\":31.25,\"IL2\":30.9,\"IL3\":0,\"avgI\":20.72,\"imbalance\":100,\"s\":\"FAULT\",\"c\":true,\"f\":\"PHASE_LOSS\",\"cf\":false,\"th\":0,\"IL1max\":91.25,\"IL2max\":90.9,\"IL3max\":60,\"kwh\":0,\"rh\":0,\"st\":0,\"fc\":0,\"sensor\":true,\"uptime\":59,\"network\":\"ETH\",\"di\":0,\"do\":255,\"hardware_type\":\"PUMP \\\"3P\\\"\",\"firmware_version\":\"1.4.0-rc1\",\"time\":\"23:59:59\"}" },
+  { "motor",
+    "030e01e9033c00000000ff173b3bac0f9f0fa00f990c760c64007c08e80302050500a5238223701700000000000000000000000000000000",
+    "{\"V1\":401.2,\"V2\":399.9,\"V3\":400,\"IL1\":32.25,\"IL2\":31.9,\"IL3\":1,\"avgI\":21.72,\"imbalance\":100,\"s\":\"FAULT\",\"c\":true,\"f\":\"PHASE_LOSS\",\"cf\":false,\"th\":0,\"IL1max\":91.25,\"IL2max\":90.9,\"IL3max\":60,\"kwh\":0,\"rh\":0,\"st\":0,\"fc\":0,\"sensor\":false,\"uptime\":60,\"network\":\"ETH\",\"di\":0,\"do\":255,\"hardware_type\":\"PUMP \\\"3P\\\"\",\"firmware_version\":\"1.4.0-rc1\",\"time\":\"23:59:59\"}" },
+};
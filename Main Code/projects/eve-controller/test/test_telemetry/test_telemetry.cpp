@@ -0,0 +1,156 @@
+// Golden frames for the two telemetry encodings: each frame below goes
+// through both fl_telemetry_t encoders and must come out exactly as the
+// hex and JSON stored in golden.h. tools/check_telemetry_golden.py feeds
+// the same hex through the reference decoder and expects the same JSON, so
+// between them the firmware and the decoder are held to one another.
+
+#include <unity.h>
+#include <stdio.h>
+#include "fl_jsonw.cpp"
+#include "fl_telembin.cpp"
+#include "fl_protection.cpp"
+#include "fl_telemetry.h"
+
+struct golden_t {
+  const char* product;    // One decoder per product, frames in order
+  const char* hex;
+  const char* json;
+};
+
+#include "golden.h"
+
+using Eve = fl_telemetry_t<3, false>;     // Three pumps, one meter phase each
+using Motor = fl_telemetry_t<1, true>;    // One 3-phase motor
+
+static void eveFrame(Eve::frame_t& f, uint8_t n) {
+  f = {};
+  const float V[3] = { 230.14f, 229.96f, NAN };   // L3 CT unplugged
+  const float I[3] = { 10.456f, 0.0f, 12.3f };
+  for (uint8_t k = 0; k < 3; k++) {
+    f.V[k] = V[k] + n;
+    f.I[k] = I[k];
+    f.Imax[k] = I[k] * 1.5f;
+  }
+  f.pump[0] = { FL_MOTOR_RUNNING, FL_FAULT_NONE, true, true, true, 42.4f, 123456, 98765, 312, 2 };
+  f.pump[1] = { FL_MOTOR_STOPPED, FL_FAULT_NONE, false, false, false, 0.0f, 100, 3600, 0, 0 };
+  f.pump[2] = { FL_MOTOR_FAULT, FL_FAULT_OVERCURRENT, false, false, true, 101.6f, 7, 1, 1, 17 };
+  f.sensor = true;
+  f.ethernet = n == 0;
+  f.uptime = 86400 + n * 10;
+  f.di = 0x05;
+  f.dout = 0x06;
+  f.hwType = "EVE";
+  f.fwVersion = "2.11.0";
+  f.clockValid = n == 0;
+  f.hour = 7;
+  f.minute = 5;
+  f.second = 9 + n;
+  f.epoch = 1760598309;
+}
+
+static void motorFrame(Motor::frame_t& f, uint8_t n) {
+  f = {};
+  const float V[3] = { 401.2f, 399.85f, 400.0f };
+  const float I[3] = { 31.25f, 30.9f, 0.004f };    // Phase loss on L3
+  for (uint8_t k = 0; k < 3; k++) {
+    f.V[k] = V[k];
+    f.I[k] = I[k] + n;
+    f.Imax[k] = I[k] + 60.0f;
+  }
+  f.avgI = 20.72f + n;
+  f.imbalancePct = 99.98f;
+  f.pump[0] = { FL_MOTOR_FAULT, FL_FAULT_PHASE_LOSS, true, false, true, 0.4f, 0, 0, 0, 0 };
+  f.sensor = n == 0;
+  f.ethernet = true;
+  f.uptime = 59 + n;
+  f.di = 0;
+  f.dout = 0xFF;
+  f.hwType = "PUMP \"3P\"";     // Escaped in JSON, raw in the static block
+  f.fwVersion = "1.4.0-rc1";
+  f.clockValid = true;
+  f.hour = 23;
+  f.minute = 59;
+  f.second = 59;
+  f.epoch = 0;
+}
+
+static void toHex(const uint8_t* data, size_t len, char* out) {
+  for (size_t k = 0; k < len; k++) sprintf(out + 2 * k, "%02x", data[k]);
+  out[2 * len] = '\0';
+}
+
+// Frame n of every product against golden entry n of that product
+template <class T>
+static void checkGolden(const char* product, void (*make)(typename T::frame_t&, uint8_t)) {
+  uint8_t n = 0;
+  for (const golden_t& g : kGolden) {
+    if (strcmp(g.product, product) != 0) continue;
+    typename T::frame_t f;
+    make(f, n);
+    char json[1024];
+    uint8_t bin[192];
+    char hex[2 * sizeof(bin) + 1];
+    size_t jlen = T::encodeJson(json, sizeof(json), f, false);
+    // Static block on the first frame only, as after a reconnect
+    size_t blen = T::encodeBinary(bin, sizeof(bin), f, 1000 + n, n == 0);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, jlen);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, blen);
+    toHex(bin, blen, hex);
+    TEST_ASSERT_EQUAL_STRING(g.json, json);
+    TEST_ASSERT_EQUAL_STRING(g.hex, hex);
+    n++;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, n);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_eve_golden(void) {
+  checkGolden<Eve>("eve", eveFrame);
+}
+
+void test_motor_golden(void) {
+  checkGolden<Motor>("motor", motorFrame);
+}
+
+void test_stamped_frame_adds_epoch(void) {
+  Eve::frame_t f;
+  eveFrame(f, 0);
+  char plain[1024], stamped[1024];
+  size_t a = Eve::encodeJson(plain, sizeof(plain), f, false);
+  size_t b = Eve::encodeJson(stamped, sizeof(stamped), f, true);
+  TEST_ASSERT_EQUAL_UINT32(a + strlen(",\"ts\":1760598309"), b);
+  TEST_ASSERT_EQUAL_STRING(",\"ts\":1760598309}", stamped + a - 1);
+}
+
+void test_status_leaves_out_thermal(void) {
+  Eve::frame_t f;
+  eveFrame(f, 0);
+  char buf[512];
+  fl_jsonw_t w;
+  fl_jsonwBegin(w, buf, sizeof(buf));
+  Eve::encodeStatus(w, f, false);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, fl_jsonwEnd(w));
+  TEST_ASSERT_NULL(strstr(buf, "\"th"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"cf3\":false"));
+}
+
+void test_binary_overflow_reports_zero(void) {
+  Eve::frame_t f;
+  eveFrame(f, 0);
+  uint8_t bin[40];
+  TEST_ASSERT_EQUAL_UINT32(0, Eve::encodeBinary(bin, sizeof(bin), f, 0, true));
+  char json[64];
+  TEST_ASSERT_EQUAL_UINT32(0, Eve::encodeJson(json, sizeof(json), f, false));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_eve_golden);
+  RUN_TEST(test_motor_golden);
+  RUN_TEST(test_stamped_frame_adds_epoch);
+  RUN_TEST(test_status_leaves_out_thermal);
+  RUN_TEST(test_binary_overflow_reports_zero);
+  return UNITY_END();
+}
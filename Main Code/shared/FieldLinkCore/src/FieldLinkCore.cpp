@@ -16,6 +16,12 @@ void fl_begin() {
   // Initialize NVS
   fl_initNVS();
 
+  // Command and publish queues between the loop and the network task
+  fl_initNetQueues();
+
+  // Offline telemetry journal (spiffs partition)
+  fl_initJournal();
+
   Serial.println("Type 'HELP' for serial commands");
 
   // Initialize digital inputs
@@ -26,17 +32,20 @@ void fl_begin() {
 }
 
 void fl_tick() {
+  // Wall clock first — everything after reads the cached copy
+  fl_clockTick();
+
+  // Modbus RTU state machine (non-blocking) — owned by the sensor task if running
+  if (!fl_sensorTaskRunning()) {
+    fl_pollModbus();
+  }
+
   // Handle OTA updates
   ArduinoOTA.handle();
 
-  // Handle serial commands
+  // Serial lines join the command queue; run what MQTT, web and serial queued
   fl_handleSerial();
-
-  // MQTT reconnect and loop
-  if (fl_configLoaded) {
-    fl_reconnectMQTT();
-    fl_mqtt.loop();
-  }
+  fl_processCommands();
 
   // Read digital inputs
   fl_readDI();
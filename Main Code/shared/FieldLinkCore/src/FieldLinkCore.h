@@ -6,8 +6,25 @@
 
 #include "fl_pins.h"
 #include "fl_board.h"
+#include "fl_clock.h"
+#include "fl_modbus_rtu.h"
+#include "fl_meter.h"
 #include "fl_modbus.h"
+#include "fl_inrush.h"
+#include "fl_jsonw.h"
+#include "fl_agg.h"
+#include "fl_telembin.h"
+#include "fl_report.h"
+#include "fl_journal.h"
+#include "fl_history.h"
+#include "fl_counters.h"
+#include "fl_protection.h"
+#include "fl_tariff.h"
+#include "fl_schedule.h"
+#include "fl_controller.h"
 #include "fl_storage.h"
+#include "fl_conn.h"
+#include "fl_command.h"
 #include "fl_comms.h"
 #include "fl_ota.h"
 #include "fl_web.h"
@@ -17,7 +34,7 @@
 // Initialize hardware: I2C recovery, TCA9554 DO, DI pins, NVS, RS485/Modbus, Serial
 void fl_begin();
 
-// Tick: OTA handle, serial commands, MQTT reconnect+loop, DI read
+// Tick: Modbus poll, OTA handle, serial and queued commands, DI read
 void fl_tick();
 
 #endif
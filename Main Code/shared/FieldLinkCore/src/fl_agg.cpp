@@ -0,0 +1,27 @@
+#include "fl_agg.h"
+#include <math.h>
+
+void fl_aggAdd(fl_agg_t& a, float x) {
+  if (isnan(x)) return;
+  if (a.n == 0 || x < a.min) a.min = x;
+  if (a.n == 0 || x > a.max) a.max = x;
+  a.n++;
+  a.sum += x;
+  a.sumSq += (double)x * x;
+}
+
+float fl_aggMin(const fl_agg_t& a) {
+  return a.n ? a.min : NAN;
+}
+
+float fl_aggMax(const fl_agg_t& a) {
+  return a.n ? a.max : NAN;
+}
+
+float fl_aggMean(const fl_agg_t& a) {
+  return a.n ? (float)(a.sum / a.n) : NAN;
+}
+
+float fl_aggRms(const fl_agg_t& a) {
+  return a.n ? (float)sqrt(a.sumSq / a.n) : NAN;
+}
@@ -0,0 +1,32 @@
+#ifndef FL_AGG_H
+#define FL_AGG_H
+
+// Streaming aggregate of one reading over a window: count, min, max, mean
+// and RMS in constant memory. Every sample is folded in as it arrives, so
+// what a window reports does not depend on how often it is published.
+// NaN samples (no reading) are skipped. Hardware-free.
+
+#include <stdint.h>
+
+#define FL_AGG_DEFAULT_WINDOW_S  60     // Long-window stats topic; 0 = off
+#define FL_AGG_MIN_WINDOW_S      10
+#define FL_AGG_MAX_WINDOW_S      3600
+
+struct fl_agg_t {
+  uint32_t n;
+  float min;
+  float max;
+  double sum;                  // Double: an hour of 230 V samples outgrows a float's precision
+  double sumSq;
+};
+
+inline void fl_aggReset(fl_agg_t& a) { a = {}; }
+void fl_aggAdd(fl_agg_t& a, float x);
+
+// NaN for an empty window
+float fl_aggMin(const fl_agg_t& a);
+float fl_aggMax(const fl_agg_t& a);
+float fl_aggMean(const fl_agg_t& a);
+float fl_aggRms(const fl_agg_t& a);
+
+#endif
@@ -0,0 +1,41 @@
+#include "fl_clock.h"
+
+void fl_clockSynced(fl_clock_t& c, fl_clock_ref_t& ref, int64_t syncMs, uint32_t syncMillis) {
+  // Where the clock would have been without this sync
+  int64_t predicted = ref.wallMs + (int64_t)(uint32_t)(syncMillis - ref.atMillis);
+  c.driftMs = c.valid ? (int32_t)(syncMs - predicted) : 0;
+  c.syncs++;
+  ref.lastSyncMillis = syncMillis;
+}
+
+void fl_clockUpdate(fl_clock_t& c, fl_clock_ref_t& ref, int64_t nowMs, uint32_t nowMillis) {
+  time_t epoch = nowMs / 1000;
+  int64_t expected = ref.wallMs + (int64_t)(uint32_t)(nowMillis - ref.atMillis);
+  int64_t jump = nowMs - expected;
+  bool valid = epoch >= FL_CLOCK_VALID_EPOCH;
+  if (valid != c.valid || jump > FL_CLOCK_STEP_MS || jump < -FL_CLOCK_STEP_MS) c.steps++;
+  ref.wallMs = nowMs;
+  ref.atMillis = nowMillis;
+
+  c.epoch = epoch;
+  c.valid = valid;
+  localtime_r(&c.epoch, &c.local);
+  c.minuteOfDay = c.local.tm_hour * 60 + c.local.tm_min;
+  c.minuteOfWeek = c.local.tm_wday * 1440 + c.minuteOfDay;
+  if (valid) strftime(c.hms, sizeof(c.hms), "%H:%M:%S", &c.local);
+  else c.hms[0] = '\0';
+
+  c.syncAgeS = c.syncs ? (nowMillis - ref.lastSyncMillis) / 1000 : UINT32_MAX;
+  if (!valid) c.sync = FL_CLOCK_UNSET;
+  else if (c.syncs && c.syncAgeS < FL_CLOCK_STALE_S) c.sync = FL_CLOCK_SYNCED;
+  else c.sync = FL_CLOCK_STALE;
+}
+
+const char* fl_clockSyncToString(fl_clock_sync_t sync) {
+  switch (sync) {
+    case FL_CLOCK_UNSET:  return "unset";
+    case FL_CLOCK_SYNCED: return "synced";
+    case FL_CLOCK_STALE:  return "stale";
+    default:              return "unknown";
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef FL_CLOCK_H
+#define FL_CLOCK_H
+
+// Cached wall clock.
+// fl_clockTick() (from fl_tick) reads the system time every pass but only
+// runs the local-time conversion when the second changes. Everything else —
+// telemetry, settings, schedules, the JSON API — reads the cached copy and
+// never calls getLocalTime(), which can stall for its timeout before NTP has
+// synced. Also tracks NTP sync age and the correction applied at each sync.
+// The bookkeeping (fl_clockSynced, fl_clockUpdate) is hardware-free
+// (fl_clock.cpp); the system clock and SNTP hook are in fl_clock_sntp.cpp.
+
+#include <stdint.h>
+#include <time.h>
+
+#define FL_CLOCK_VALID_EPOCH   1451606400   // 2016-01-01, getLocalTime()'s test for a set clock
+#define FL_CLOCK_STEP_MS       2000         // Larger jumps count as the clock being stepped
+#define FL_CLOCK_STALE_S       (3 * 3600)   // Three missed hourly SNTP syncs
+
+enum fl_clock_sync_t : uint8_t {
+  FL_CLOCK_UNSET = 0,          // Never set — time fields are meaningless
+  FL_CLOCK_SYNCED,             // NTP within FL_CLOCK_STALE_S
+  FL_CLOCK_STALE               // Set, but no NTP sync for a while (free-running)
+};
+
+struct fl_clock_t {
+  time_t epoch;
+  struct tm local;
+  uint16_t minuteOfDay;
+  uint16_t minuteOfWeek;       // 0 = Sunday 00:00 .. 10079
+  bool valid;
+  fl_clock_sync_t sync;
+  char hms[9];                 // "HH:MM:SS", empty while unset
+  uint32_t steps;              // Times the clock was set or stepped — cached times derived from it are stale
+  uint32_t syncs;              // NTP syncs since boot
+  uint32_t syncAgeS;           // Since the last NTP sync, UINT32_MAX if never
+  int32_t driftMs;             // Correction at the last sync (+ = local clock was behind)
+};
+
+// Wall clock / millis() pair from the last conversion, to spot steps
+struct fl_clock_ref_t {
+  int64_t wallMs;              // Read at atMillis
+  uint32_t atMillis;
+  uint32_t lastSyncMillis;
+};
+
+// An NTP sync set the wall clock to 'syncMs' at 'syncMillis': count it and
+// record the correction against where the clock would otherwise have been
+void fl_clockSynced(fl_clock_t& c, fl_clock_ref_t& ref, int64_t syncMs, uint32_t syncMillis);
+
+// Convert wall time 'nowMs' read at 'nowMillis': local time, the step
+// count (validity changes and jumps beyond FL_CLOCK_STEP_MS), sync age and
+// sync state
+void fl_clockUpdate(fl_clock_t& c, fl_clock_ref_t& ref, int64_t nowMs, uint32_t nowMillis);
+
+// Register the SNTP sync hook (fl_initNTP calls this)
+void fl_clockBegin();
+
+// Once per loop pass, before anything reads the clock
+void fl_clockTick();
+
+// Loop task only
+const fl_clock_t& fl_clock();
+
+// Any task (web handlers): consistent copy
+void fl_clockRead(fl_clock_t& out);
+
+const char* fl_clockSyncToString(fl_clock_sync_t sync);
+
+#endif
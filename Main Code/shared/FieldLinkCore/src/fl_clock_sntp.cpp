@@ -0,0 +1,50 @@
+#include "fl_clock.h"
+#include <Arduino.h>
+#include "fl_seqlock.h"
+#include <sys/time.h>
+#include <esp_sntp.h>
+
+static fl_clock_t _clock = {};
+static fl_clock_ref_t _ref = {};
+static fl_seqlock<fl_clock_t> _shared;
+
+// Written by the SNTP callback (lwIP task), consumed in fl_clockTick()
+static volatile bool _syncPending = false;
+static volatile int64_t _syncMs = 0;
+static volatile uint32_t _syncMillis = 0;
+
+static void onTimeSync(struct timeval* tv) {
+  _syncMs = (int64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000;
+  _syncMillis = millis();
+  _syncPending = true;
+}
+
+void fl_clockBegin() {
+  sntp_set_time_sync_notification_cb(onTimeSync);
+}
+
+void fl_clockTick() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec == _clock.epoch && !_syncPending) return;
+
+  uint32_t nowMillis = millis();
+  int64_t nowMs = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+  if (_syncPending) {
+    _syncPending = false;
+    fl_clockSynced(_clock, _ref, _syncMs, _syncMillis);
+    Serial.printf("NTP sync #%lu (drift %ld ms)\n", (unsigned long)_clock.syncs, (long)_clock.driftMs);
+  }
+
+  fl_clockUpdate(_clock, _ref, nowMs, nowMillis);
+  _shared.write(_clock);
+}
+
+const fl_clock_t& fl_clock() {
+  return _clock;
+}
+
+void fl_clockRead(fl_clock_t& out) {
+  _shared.read(out);
+}
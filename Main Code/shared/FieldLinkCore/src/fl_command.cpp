@@ -0,0 +1,109 @@
+#include "fl_command.h"
+#include "fl_comms.h"
+#include "fl_storage.h"
+#include "fl_ota.h"
+#include "fl_jsonw.h"
+
+static StaticJsonDocument<FL_CMD_ARENA_BYTES> _arena;  // static: too big for the loop task stack
+static fl_cmd_handler_t _projectHandler = nullptr;
+
+static fl_cmd_id_t _id;        // Of the command being run
+static fl_cmd_recent_t _recent;
+
+void fl_setCommandHandler(fl_cmd_handler_t handler) {
+  _projectHandler = handler;
+}
+
+/* ================= LIBRARY COMMANDS ================= */
+
+struct core_t {};
+static core_t _core;
+
+static constexpr auto coreCommands = fl_cmdTable<core_t>({
+  // The project sees it first (e.g. to stop pumps), then the download starts
+  { "UPDATE_FIRMWARE", { fl_argStr("url", true) }, [](core_t&, fl_cmd_call_t& call) {
+      if (_projectHandler) _projectHandler(call);
+      const char* url = call.args["url"];
+      Serial.printf("Remote firmware update requested: %s\n", url);
+      fl_cmdAck(call, true);   // Queued ahead of the session going down
+      static const char updating[] = "{\"status\":\"updating\"}";
+      fl_publish(fl_TOPIC_TELEMETRY, updating, sizeof(updating) - 1, FL_PUB_ACK);
+      fl_performRemoteFirmwareUpdate(url);
+      return true;
+    } },
+});
+
+/* ================= ACKS ================= */
+
+// For the command being run
+static void publishAck(bool ok, const char* err, int32_t us, bool dup) {
+  char buf[160];
+  fl_jsonw_t w;
+  fl_jsonwBegin(w, buf, sizeof(buf));
+  if (_id.numeric) fl_jsonwInt(w, "id", _id.number);
+  else fl_jsonwStr(w, "id", _id.text);
+  fl_jsonwBool(w, "ok", ok);
+  if (err) fl_jsonwStr(w, "err", err);
+  if (dup) fl_jsonwBool(w, "dup", true);
+  else fl_jsonwInt(w, "us", us);
+  size_t len = fl_jsonwEnd(w);
+  if (len) fl_publish(fl_TOPIC_ACK, buf, len, FL_PUB_ACK);
+}
+
+void fl_cmdAck(fl_cmd_call_t& call, bool ok) {
+  if (!call.id || call.acked) return;
+  call.acked = true;
+  publishAck(ok, ok ? nullptr : call.error, micros() - call.receivedUs, false);
+  fl_cmdRecentAdd(_recent, _id, ok);
+}
+
+/* ================= DISPATCH ================= */
+
+fl_cmd_status_t fl_runCommand(fl_cmd_source_t source, const char* text, size_t len, uint32_t receivedUs) {
+  _arena.clear();
+  fl_cmd_call_t call = { nullptr, JsonObjectConst(), source, nullptr, nullptr, receivedUs, false };
+  if (!deserializeJson(_arena, text, len)) {
+    call.args = _arena.as<JsonObjectConst>();
+    call.name = call.args["command"];
+    if (!fl_cmdReadId(call.args, _id)) {
+      Serial.printf("Command refused, bad 'id' (string up to %d characters, or integer): %.*s\n",
+                    FL_CMD_ID_MAX, (int)len, text);
+      return FL_CMD_REJECTED;
+    }
+    if (_id.text[0]) call.id = _id.text;
+  }
+
+  // Already run: answer again, don't run again
+  if (call.id) {
+    const fl_cmd_seen_t* r = fl_cmdRecentFind(_recent, _id);
+    if (r) {
+      Serial.printf("Command id %s already handled, not repeated\n", call.id);
+      publishAck(r->ok, nullptr, 0, true);
+      return r->ok ? FL_CMD_DONE : FL_CMD_REJECTED;
+    }
+  }
+
+  fl_cmd_status_t status = FL_CMD_NOT_JSON;
+  if (call.name) {
+    status = fl_cmdDispatch(coreCommands, _core, call);
+    if (status == FL_CMD_UNKNOWN && _projectHandler) status = _projectHandler(call);
+  }
+
+  switch (status) {
+    case FL_CMD_NOT_JSON:
+      Serial.printf("Unrecognized command: %.*s\n", (int)len, text);
+      call.error = "no command";
+      break;
+    case FL_CMD_UNKNOWN:
+      Serial.printf("Unrecognized command: %s\n", call.name);
+      call.error = "unknown command";
+      break;
+    case FL_CMD_REJECTED:
+      Serial.printf("%s rejected: %s\n", call.name, call.error);
+      break;
+    default:
+      break;
+  }
+  fl_cmdAck(call, status == FL_CMD_DONE);
+  return status;
+}
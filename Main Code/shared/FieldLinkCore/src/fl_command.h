@@ -0,0 +1,253 @@
+#ifndef FL_COMMAND_H
+#define FL_COMMAND_H
+
+// JSON command registry. A command is one table entry: its name, an
+// argument schema and a handler:
+//
+//   { "SET_INRUSH", { fl_argInt("window_ms", 500, 30000, true) },
+//     [](Ctx& c, fl_cmd_call_t& call) { ...; return true; } },
+//
+// fl_cmdTable() builds a perfect hash over the names at compile time (a
+// duplicate name does not compile), so a lookup is one hash and one strcmp
+// however many commands there are. Arguments are checked against the
+// schema before the handler runs; a handler only sees well-typed,
+// in-range values and can still refuse the command by setting 'error'.
+//
+// The payload is parsed once, by the library, into one static document
+// shared by the library's commands (UPDATE_FIRMWARE) and the project's.
+// Everything runs on the loop task (fl_processCommands).
+//
+// A command with an "id" (string or integer) is answered on
+// fieldlink/{id}/ack once it has been applied or refused:
+//
+//   {"id":"a1","ok":true,"us":1830}
+//   {"id":"a1","ok":false,"err":"'pump' out of range","us":420}
+//
+// "us" runs from the MQTT client handing the command over to the handler
+// returning; handlers that switch outputs do so before returning, so it
+// includes the relay. The last FL_CMD_RECENT_IDS ids are remembered: a
+// repeat (a QoS 1 redelivery, a client retrying) is not run again, only
+// answered again with "dup":true and the original outcome.
+//
+// The table, the schema check and the id memory (fl_command_check.cpp)
+// are hardware-free and run in the host tests; parsing, dispatch and acks
+// (fl_command.cpp) need the board.
+
+#include <stdint.h>
+#include <string.h>
+#include <ArduinoJson.h>
+
+#define FL_CMD_ARENA_BYTES  2048   // JSON nodes of the largest command, a four-season SET_TARIFF
+#define FL_CMD_MAX_ARGS     8
+#define FL_CMD_ID_MAX       40     // Characters; a UUID fits
+#define FL_CMD_RECENT_IDS   16
+
+enum fl_cmd_source_t : uint8_t {
+  FL_CMD_MQTT = 0,
+  FL_CMD_WEB,
+  FL_CMD_SERIAL,
+  FL_CMD_SOURCE_COUNT
+};
+
+enum fl_cmd_status_t : uint8_t {
+  FL_CMD_DONE = 0,
+  FL_CMD_NOT_JSON,             // Unparsable, or no "command"
+  FL_CMD_UNKNOWN,
+  FL_CMD_REJECTED              // Failed its schema, or refused by the handler
+};
+
+struct fl_cmd_call_t {
+  const char* name;
+  JsonObjectConst args;        // The whole payload, "command" included
+  fl_cmd_source_t source;
+  const char* error;           // Why it was rejected
+  const char* id;              // nullptr = no ack wanted
+  uint32_t receivedUs;         // micros() when it was queued
+  bool acked;
+};
+
+/* ----- Argument schema ----- */
+
+enum fl_arg_type_t : uint8_t {
+  FL_ARG_INT,                  // Integer within [min, max]
+  FL_ARG_NUM,                  // Number within [min, max]
+  FL_ARG_BOOL,                 // true/false, or 0/1
+  FL_ARG_STR,
+  FL_ARG_OBJ,
+  FL_ARG_ARR
+};
+
+struct fl_cmd_arg_t {
+  const char* key;             // nullptr = unused slot
+  fl_arg_type_t type;
+  bool required;
+  float min;
+  float max;
+};
+
+constexpr fl_cmd_arg_t fl_argInt(const char* key, long min, long max, bool required = false) {
+  return { key, FL_ARG_INT, required, (float)min, (float)max };
+}
+constexpr fl_cmd_arg_t fl_argNum(const char* key, float min, float max, bool required = false) {
+  return { key, FL_ARG_NUM, required, min, max };
+}
+constexpr fl_cmd_arg_t fl_argBool(const char* key, bool required = false) {
+  return { key, FL_ARG_BOOL, required, 0, 1 };
+}
+constexpr fl_cmd_arg_t fl_argStr(const char* key, bool required = false) {
+  return { key, FL_ARG_STR, required, 0, 0 };
+}
+constexpr fl_cmd_arg_t fl_argObj(const char* key, bool required = false) {
+  return { key, FL_ARG_OBJ, required, 0, 0 };
+}
+constexpr fl_cmd_arg_t fl_argArr(const char* key, bool required = false) {
+  return { key, FL_ARG_ARR, required, 0, 0 };
+}
+
+// Check 'call.args' against 'args'; on failure sets 'call.error' and
+// returns false
+bool fl_cmdValidate(const fl_cmd_arg_t* args, uint8_t count, fl_cmd_call_t& call);
+
+/* ----- Ids ----- */
+
+// A command's "id": as text, and as a number if it came as one
+struct fl_cmd_id_t {
+  char text[FL_CMD_ID_MAX + 1];  // Empty = none
+  bool numeric;
+  int32_t number;
+};
+
+// Read "id" from 'args'. False if present but unusable (a string that is
+// empty or longer than FL_CMD_ID_MAX, or any other type): nothing could be
+// acked.
+bool fl_cmdReadId(JsonObjectConst args, fl_cmd_id_t& id);
+
+// The last FL_CMD_RECENT_IDS ids run and their outcome. A numeric 7 and a
+// string "7" are different ids.
+struct fl_cmd_seen_t {
+  fl_cmd_id_t id;
+  bool ok;
+};
+
+struct fl_cmd_recent_t {
+  fl_cmd_seen_t seen[FL_CMD_RECENT_IDS];
+  uint8_t next;
+};
+
+const fl_cmd_seen_t* fl_cmdRecentFind(const fl_cmd_recent_t& r, const fl_cmd_id_t& id);
+
+// Oldest forgotten first
+void fl_cmdRecentAdd(fl_cmd_recent_t& r, const fl_cmd_id_t& id, bool ok);
+
+/* ----- Tables ----- */
+
+// Handler: false (with 'call.error' set) rejects the command
+template <class Ctx>
+struct fl_cmd_def_t {
+  const char* name;
+  fl_cmd_arg_t args[FL_CMD_MAX_ARGS];
+  bool (*run)(Ctx& ctx, fl_cmd_call_t& call);
+};
+
+// Seeded FNV-1a with a final mix, so the low bits used as the slot spread
+constexpr uint32_t fl_cmdHash(const char* s, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  while (*s) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  return h;
+}
+
+// At least twice as many slots as commands: a collision-free seed turns up
+// within a few hundred tries
+constexpr size_t fl_cmdSlots(size_t n) {
+  size_t s = 1;
+  while (s < 2 * n) s <<= 1;
+  return s;
+}
+
+template <class Ctx, size_t N>
+struct fl_cmd_table_t {
+  static constexpr size_t kSlots = fl_cmdSlots(N);
+  fl_cmd_def_t<Ctx> defs[N];
+  uint32_t seed;
+  uint8_t slot[kSlots];        // Index into defs + 1, 0 = empty
+};
+
+// Never defined: reaching one while building a table is a compile error
+void fl_cmdDuplicateName();
+void fl_cmdNoPerfectHash();
+
+constexpr bool fl_cmdSameName(const char* a, const char* b) {
+  while (*a && *a == *b) { a++; b++; }
+  return *a == *b;
+}
+
+// Evaluate into a static constexpr; the search runs in the compiler
+template <class Ctx, size_t N>
+constexpr fl_cmd_table_t<Ctx, N> fl_cmdTable(const fl_cmd_def_t<Ctx> (&defs)[N]) {
+  static_assert(N < 255, "too many commands for a uint8_t slot");
+  fl_cmd_table_t<Ctx, N> t{};
+  for (size_t i = 0; i < N; i++) {
+    t.defs[i] = defs[i];
+    for (size_t j = 0; j < i; j++)
+      if (fl_cmdSameName(defs[i].name, defs[j].name)) fl_cmdDuplicateName();
+  }
+  for (uint32_t seed = 1; seed < 65536; seed++) {
+    for (size_t k = 0; k < t.kSlots; k++) t.slot[k] = 0;
+    bool ok = true;
+    for (size_t i = 0; i < N && ok; i++) {
+      size_t k = fl_cmdHash(defs[i].name, seed) & (t.kSlots - 1);
+      if (t.slot[k]) ok = false;
+      else t.slot[k] = i + 1;
+    }
+    if (ok) {
+      t.seed = seed;
+      return t;
+    }
+  }
+  fl_cmdNoPerfectHash();
+  return t;
+}
+
+template <class Ctx, size_t N>
+const fl_cmd_def_t<Ctx>* fl_cmdFind(const fl_cmd_table_t<Ctx, N>& t, const char* name) {
+  uint8_t i = t.slot[fl_cmdHash(name, t.seed) & (t.kSlots - 1)];
+  if (!i || strcmp(t.defs[i - 1].name, name) != 0) return nullptr;
+  return &t.defs[i - 1];
+}
+
+template <class Ctx, size_t N>
+fl_cmd_status_t fl_cmdDispatch(const fl_cmd_table_t<Ctx, N>& t, Ctx& ctx, fl_cmd_call_t& call) {
+  const fl_cmd_def_t<Ctx>* def = fl_cmdFind(t, call.name);
+  if (!def) return FL_CMD_UNKNOWN;
+  if (!fl_cmdValidate(def->args, FL_CMD_MAX_ARGS, call)) return FL_CMD_REJECTED;
+  if (!def->run(ctx, call)) {
+    if (!call.error) call.error = "refused";
+    return FL_CMD_REJECTED;
+  }
+  return FL_CMD_DONE;
+}
+
+/* ----- Running commands ----- */
+
+// Project commands: typically fl_cmdDispatch over the project's table
+typedef fl_cmd_status_t (*fl_cmd_handler_t)(fl_cmd_call_t& call);
+
+void fl_setCommandHandler(fl_cmd_handler_t handler);
+
+// Parse a JSON command into the arena and dispatch it: library commands
+// first, then the project's. Logs anything not done and acks it if it
+// carries an id. 'receivedUs' is when it was queued.
+fl_cmd_status_t fl_runCommand(fl_cmd_source_t source, const char* text, size_t len, uint32_t receivedUs);
+
+// Ack now rather than after the handler returns, for a handler that goes
+// on to something slow or that doesn't return (a firmware update). Once
+// per command; nothing without an id.
+void fl_cmdAck(fl_cmd_call_t& call, bool ok);
+
+#endif
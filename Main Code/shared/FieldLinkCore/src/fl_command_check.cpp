@@ -0,0 +1,79 @@
+#include "fl_command.h"
+#include <stdio.h>
+
+static char _error[64];
+
+static bool reject(fl_cmd_call_t& call, const char* key, const char* why) {
+  snprintf(_error, sizeof(_error), "'%s' %s", key, why);
+  call.error = _error;
+  return false;
+}
+
+bool fl_cmdValidate(const fl_cmd_arg_t* args, uint8_t count, fl_cmd_call_t& call) {
+  for (uint8_t i = 0; i < count; i++) {
+    const fl_cmd_arg_t& a = args[i];
+    if (!a.key) continue;
+    JsonVariantConst v = call.args[a.key];
+    if (v.isNull()) {
+      if (a.required) return reject(call, a.key, "missing");
+      continue;
+    }
+    switch (a.type) {
+      case FL_ARG_INT:
+        if (!v.is<long>()) return reject(call, a.key, "not an integer");
+        if (v.as<long>() < a.min || v.as<long>() > a.max) return reject(call, a.key, "out of range");
+        break;
+      case FL_ARG_NUM:
+        if (!v.is<float>()) return reject(call, a.key, "not a number");
+        if (v.as<float>() < a.min || v.as<float>() > a.max) return reject(call, a.key, "out of range");
+        break;
+      case FL_ARG_BOOL:
+        if (v.is<bool>()) break;
+        if (!v.is<long>() || (v.as<long>() != 0 && v.as<long>() != 1)) return reject(call, a.key, "not a boolean");
+        break;
+      case FL_ARG_STR:
+        if (!v.is<const char*>()) return reject(call, a.key, "not a string");
+        break;
+      case FL_ARG_OBJ:
+        if (!v.is<JsonObjectConst>()) return reject(call, a.key, "not an object");
+        break;
+      case FL_ARG_ARR:
+        if (!v.is<JsonArrayConst>()) return reject(call, a.key, "not an array");
+        break;
+    }
+  }
+  return true;
+}
+
+/* ================= IDS ================= */
+
+bool fl_cmdReadId(JsonObjectConst args, fl_cmd_id_t& id) {
+  id.text[0] = '\0';
+  id.numeric = false;
+  id.number = 0;
+  JsonVariantConst v = args["id"];
+  if (v.isNull()) return true;
+  if (v.is<int32_t>()) {
+    id.numeric = true;
+    id.number = v.as<int32_t>();
+    snprintf(id.text, sizeof(id.text), "%ld", (long)id.number);
+    return true;
+  }
+  const char* text = v.as<const char*>();
+  if (!text || !*text || strlen(text) > FL_CMD_ID_MAX) return false;
+  strcpy(id.text, text);
+  return true;
+}
+
+const fl_cmd_seen_t* fl_cmdRecentFind(const fl_cmd_recent_t& r, const fl_cmd_id_t& id) {
+  for (const fl_cmd_seen_t& s : r.seen)
+    if (s.id.text[0] && s.id.numeric == id.numeric && strcmp(s.id.text, id.text) == 0) return &s;
+  return nullptr;
+}
+
+void fl_cmdRecentAdd(fl_cmd_recent_t& r, const fl_cmd_id_t& id, bool ok) {
+  fl_cmd_seen_t& s = r.seen[r.next];
+  r.next = (r.next + 1) % FL_CMD_RECENT_IDS;
+  s.id = id;
+  s.ok = ok;
+}
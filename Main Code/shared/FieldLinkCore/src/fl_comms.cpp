@@ -2,7 +2,11 @@
 #include "fl_pins.h"
 #include "fl_storage.h"
 #include "fl_ota.h"
-#include <ArduinoJson.h>
+#include "fl_clock.h"
+#include "fl_serial.h"
+#include "fl_telegram.h"
+#include <Dns.h>
+#include <freertos/ringbuf.h>
 
 // Network clients
 static WiFiClientSecure fl_espClientSecure;
@@ -21,23 +25,217 @@ bool fl_useEthernet = false;
 bool fl_configLoaded = false;
 unsigned long fl_lastMqttActivity = 0;
 
-int fl_mqttPublishFailCount = 0;
-
 WiFiManager fl_wifiManager;
 
+fl_conn_t fl_conn;
+
 // Internal state
-static unsigned long lastMqttRetry = 0;
 static unsigned long lastStatusPublish = 0;
 static int mqttConnectFailCount = 0;
 
-// Project callback
-static fl_mqtt_callback_t _mqttProjectCallback = nullptr;
+// Network task
+static TaskHandle_t _netTask = nullptr;
+static volatile bool _paused = false;   // Firmware download in progress
+static bool _ethPresent = false;
+static bool _wifiEnabled = false;       // Credentials saved
+static bool _wifiStarted = false;
+static volatile bool _wifiLink = false; // Associated
+static volatile bool _wifiIp = false;   // Address assigned
+static bool _preferWifi = false;        // MQTT kept failing over Ethernet
+static IPAddress _brokerIp;
+static uint16_t _brokerPort = 0;
+static bool _useTls = false;
+static Client* _transport = nullptr;
+
+/* ================= QUEUES ================= */
+
+// Ring buffer items: header, then payload (publishes) or NUL-terminated text (commands)
+struct publish_item_t {
+  const char* topic;
+  uint16_t len;
+  bool retained;
+};
+
+struct command_item_t {
+  uint32_t queuedUs;
+  uint16_t len;
+  fl_cmd_source_t source;
+};
+
+// Publish lanes in priority order: one per class, and for telemetry one
+// per topic so a frame only ever replaces its own kind
+struct lane_t {
+  RingbufHandle_t ring;
+  uint16_t bytes;
+  fl_pub_class_t cls;
+  const char* topic;           // Telemetry: bound on first use
+  publish_item_t* held;        // Network task: taken off the ring, not yet accepted by the client
+  uint16_t refusals;           // Network task: of 'held', in a row
+  uint32_t stretchMs;          // Loop task, telemetry lanes: this topic's backpressure
+};
+
+#define PUB_LANES (FL_PUB_CLASS_COUNT - 1 + FL_PUB_TELEMETRY_TOPICS)
+
+static lane_t _lanes[PUB_LANES];
+static RingbufHandle_t _commandQueue = nullptr;
+static bool _retryWait = false;              // Network task
+static uint32_t _retryAtMs = 0;
+
+fl_cmd_stats_t fl_cmdStats[FL_CMD_SOURCE_COUNT] = {};
+fl_publish_stats_t fl_publishStats[FL_PUB_CLASS_COUNT] = {};
+
+static const char* const cmdSourceNames[FL_CMD_SOURCE_COUNT] = { "MQTT", "Web", "Serial" };
+static const char* const pubClassNames[FL_PUB_CLASS_COUNT] = { "fault", "ack", "settings", "telemetry", "replay" };
+static const uint16_t pubLaneBytes[FL_PUB_CLASS_COUNT] = {
+  FL_PUB_FAULT_BYTES, FL_PUB_ACK_BYTES, FL_PUB_SETTINGS_BYTES, FL_PUB_TELEMETRY_BYTES, FL_PUB_REPLAY_BYTES
+};
+
+void fl_initNetQueues() {
+  if (!_commandQueue) _commandQueue = xRingbufferCreate(FL_COMMAND_QUEUE_BYTES, RINGBUF_TYPE_NOSPLIT);
+  if (_lanes[0].ring) return;
+  uint8_t n = 0;
+  for (uint8_t c = 0; c < FL_PUB_CLASS_COUNT; c++) {
+    uint8_t count = c == FL_PUB_TELEMETRY ? FL_PUB_TELEMETRY_TOPICS : 1;
+    for (uint8_t k = 0; k < count; k++) {
+      lane_t& l = _lanes[n++];
+      l.cls = (fl_pub_class_t)c;
+      l.bytes = pubLaneBytes[c];
+      l.ring = xRingbufferCreate(l.bytes, RINGBUF_TYPE_NOSPLIT);
+    }
+  }
+}
+
+bool fl_postCommand(fl_cmd_source_t source, const char* text, size_t len) {
+  void* item = nullptr;
+  if (!_commandQueue || len >= FL_MAX_PAYLOAD_SIZE ||
+      xRingbufferSendAcquire(_commandQueue, &item, sizeof(command_item_t) + len + 1, 0) != pdTRUE) {
+    fl_cmdStats[source].dropped++;
+    return false;
+  }
+  command_item_t* head = (command_item_t*)item;
+  head->queuedUs = micros();
+  head->len = len;
+  head->source = source;
+  char* body = (char*)(head + 1);
+  memcpy(body, text, len);
+  body[len] = '\0';
+  xRingbufferSendComplete(_commandQueue, item);
+  return true;
+}
+
+static lane_t* laneFor(const char* topic, fl_pub_class_t cls) {
+  lane_t* spare = nullptr;
+  for (lane_t& l : _lanes) {
+    if (l.cls != cls) continue;
+    if (cls != FL_PUB_TELEMETRY || l.topic == topic) return &l;
+    if (!l.topic && !spare) spare = &l;
+  }
+  if (spare) spare->topic = topic;
+  return spare;
+}
+
+// PubSubClient refuses, every time, a packet larger than its buffer:
+// fixed header (up to MQTT_MAX_HEADER_SIZE), topic length and topic, payload
+static bool fitsClient(const char* topic, size_t len) {
+  return MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + len <= FL_MAX_PAYLOAD_SIZE;
+}
+
+bool fl_publish(const char* topic, const void* payload, size_t len, fl_pub_class_t cls, bool retained) {
+  if (!fl_mqttConnected || cls >= FL_PUB_CLASS_COUNT) return false;
+  lane_t* lane = laneFor(topic, cls);
+  if (!lane || !lane->ring) return false;   // More telemetry topics than FL_PUB_TELEMETRY_TOPICS
+  fl_publish_stats_t& st = fl_publishStats[cls];
+  if (!fitsClient(topic, len)) {
+    st.oversize++;
+    return false;
+  }
+
+  // A frame still waiting is stale now. Having to replace one means the
+  // link is slower than this topic's frame rate: stretch the interval.
+  // Per lane, so a clean frame on one topic can't undo another's backlog.
+  if (cls == FL_PUB_TELEMETRY) {
+    uint32_t& stretch = lane->stretchMs;
+    size_t size;
+    void* old;
+    bool replaced = false;
+    while ((old = xRingbufferReceive(lane->ring, &size, 0)) != nullptr) {
+      vRingbufferReturnItem(lane->ring, old);
+      st.coalesced++;
+      replaced = true;
+    }
+    if (replaced) {
+      stretch = stretch ? stretch * 2 : FL_PUB_STRETCH_STEP_MS;
+      if (stretch > FL_PUB_STRETCH_MAX_MS) stretch = FL_PUB_STRETCH_MAX_MS;
+    } else {
+      stretch = stretch >= 2 * FL_PUB_STRETCH_STEP_MS ? stretch / 2 : 0;
+    }
+  }
+
+  void* item = nullptr;
+  if (xRingbufferSendAcquire(lane->ring, &item, sizeof(publish_item_t) + len, 0) != pdTRUE) {
+    st.full++;
+    return false;
+  }
+  publish_item_t* head = (publish_item_t*)item;
+  head->topic = topic;
+  head->len = len;
+  head->retained = retained;
+  memcpy(head + 1, payload, len);
+  xRingbufferSendComplete(lane->ring, item);
+
+  st.queued++;
+  uint32_t fill = lane->bytes - xRingbufferGetCurFreeSize(lane->ring);
+  if (fill > st.peakBytes) st.peakBytes = fill;
+  if (_netTask) xTaskNotifyGive(_netTask);
+  return true;
+}
+
+uint32_t fl_publishStretchMs() {
+  uint32_t worst = 0;
+  for (const lane_t& l : _lanes)
+    if (l.cls == FL_PUB_TELEMETRY && l.stretchMs > worst) worst = l.stretchMs;
+  return worst;
+}
+
+/* ================= COMMANDS (loop task) ================= */
+
+void fl_processCommands() {
+  if (!_commandQueue) return;
+  for (uint8_t n = 0; n < FL_COMMANDS_PER_TICK; n++) {
+    size_t size;
+    command_item_t* head = (command_item_t*)xRingbufferReceive(_commandQueue, &size, 0);
+    if (!head) return;
+
+    uint32_t start = micros();
+    const char* text = (const char*)(head + 1);
+    if (head->source == FL_CMD_SERIAL) fl_runSerialCommand(String(text));
+    else fl_runCommand(head->source, text, head->len, head->queuedUs);
+    uint32_t end = micros();
+
+    fl_cmd_stats_t& st = fl_cmdStats[head->source];
+    uint32_t wait = start - head->queuedUs;
+    uint32_t exec = end - start;
+    st.count++;
+    st.waitSumUs += wait;
+    st.execSumUs += exec;
+    if (wait > st.waitMaxUs) st.waitMaxUs = wait;
+    if (exec > st.execMaxUs) st.execMaxUs = exec;
+    vRingbufferReturnItem(_commandQueue, head);
+  }
+}
 
-void fl_setMqttCallback(fl_mqtt_callback_t callback) {
-  _mqttProjectCallback = callback;
+void fl_printCommandStatus() {
+  for (uint8_t i = 0; i < FL_CMD_SOURCE_COUNT; i++) {
+    const fl_cmd_stats_t& st = fl_cmdStats[i];
+    if (!st.count && !st.dropped) continue;
+    uint32_t n = st.count ? st.count : 1;
+    Serial.printf("  %-6s %lu commands, %lu dropped | wait avg %luus, worst %luus | exec avg %luus, worst %luus\n",
+                  cmdSourceNames[i], st.count, st.dropped, (uint32_t)(st.waitSumUs / n), st.waitMaxUs,
+                  (uint32_t)(st.execSumUs / n), st.execMaxUs);
+  }
 }
 
-// Internal MQTT callback - handles UPDATE_FIRMWARE, forwards rest to project
+// Network task: the only thing done with a command is to queue it
 static void internalMqttCallback(char* topic, byte* payload, unsigned int length) {
   if (length >= FL_MAX_PAYLOAD_SIZE) {
     Serial.println("MQTT payload too large, ignoring");
@@ -52,40 +250,9 @@ static void internalMqttCallback(char* topic, byte* payload, unsigned int length
   // Update activity tracker
   fl_lastMqttActivity = millis();
 
-  static char cmd[FL_MAX_PAYLOAD_SIZE];  // static to avoid stack overflow in TLS callback chain
-  memcpy(cmd, payload, length);
-  cmd[length] = '\0';
-
-  Serial.print("MQTT CMD: "); Serial.println(cmd);
-
-  // Try parsing as JSON for UPDATE_FIRMWARE
-  // Cast to const char* to force copy mode — preserves cmd buffer for project callback
-  static StaticJsonDocument<512> doc;  // static to reduce stack usage
-  doc.clear();
-  DeserializationError error = deserializeJson(doc, (const char*)cmd);
-
-  if (!error) {
-    const char* command = doc["command"];
-    if (command && strcmp(command, "UPDATE_FIRMWARE") == 0) {
-      const char* firmwareUrl = doc["url"];
-      if (firmwareUrl) {
-        // Notify project callback first (e.g., stop pump for safety)
-        if (_mqttProjectCallback) {
-          _mqttProjectCallback(cmd, length);
-        }
-        Serial.printf("Remote firmware update requested: %s\n", firmwareUrl);
-        fl_mqtt.publish(fl_TOPIC_TELEMETRY, "{\"status\":\"updating\"}");
-        fl_performRemoteFirmwareUpdate(firmwareUrl);
-      } else {
-        Serial.println("UPDATE_FIRMWARE command missing 'url' parameter");
-      }
-      return;  // Handled internally
-    }
-  }
-
-  // Forward everything else to project callback
-  if (_mqttProjectCallback) {
-    _mqttProjectCallback(cmd, length);
+  Serial.printf("MQTT CMD: %.*s\n", (int)length, (const char*)payload);
+  if (!fl_postCommand(FL_CMD_MQTT, (const char*)payload, length)) {
+    Serial.println("Command queue full, MQTT command dropped");
   }
 }
 
@@ -110,65 +277,70 @@ bool fl_initEthernet() {
   Serial.printf("Ethernet MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
                 ethMac[0], ethMac[1], ethMac[2], ethMac[3], ethMac[4], ethMac[5]);
 
-  Serial.println("Requesting IP via DHCP...");
-  if (Ethernet.begin(ethMac, 10000)) {  // 10 second timeout
-    Serial.printf("Ethernet connected! IP: %s\n", Ethernet.localIP().toString().c_str());
-    Serial.printf("Gateway: %s\n", Ethernet.gatewayIP().toString().c_str());
-    Serial.printf("DNS: %s\n", Ethernet.dnsServerIP().toString().c_str());
-    fl_ethernetConnected = true;
-    fl_useEthernet = true;
-    return true;
-  } else {
-    Serial.println("Ethernet DHCP failed - no cable or no DHCP server");
-    fl_ethernetConnected = false;
+  // Reading the link status probes the chip
+  EthernetLinkStatus link = Ethernet.linkStatus();
+  if (Ethernet.hardwareStatus() == EthernetNoHardware) {
+    Serial.println("Ethernet controller not found");
     return false;
   }
+  Serial.printf("Ethernet link: %s\n", link == LinkON ? "up" : "down (no cable)");
+  return true;
 }
 
-static void maintainEthernet() {
-  if (fl_useEthernet) {
-    switch (Ethernet.maintain()) {
-      case 1:
-        Serial.println("Ethernet DHCP renew failed");
-        fl_ethernetConnected = false;
-        break;
-      case 2:
-        Serial.println("Ethernet DHCP renewed");
-        break;
-      case 3:
-        Serial.println("Ethernet DHCP rebind failed");
-        fl_ethernetConnected = false;
-        break;
-      case 4:
-        Serial.println("Ethernet DHCP rebind success");
-        break;
-    }
-
-    if (Ethernet.linkStatus() == LinkOFF) {
-      if (fl_ethernetConnected) {
-        Serial.println("Ethernet cable disconnected!");
-        fl_ethernetConnected = false;
-      }
-    } else if (!fl_ethernetConnected) {
-      Serial.println("Ethernet cable reconnected, re-init...");
-      fl_initEthernet();
-    }
+// WiFi events arrive on the event task; the connection state machine reads these
+static void onWiFiEvent(arduino_event_id_t event) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      _wifiLink = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      _wifiIp = true;
+      fl_wifiConnected = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      _wifiIp = false;
+      fl_wifiConnected = false;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      _wifiLink = false;
+      _wifiIp = false;
+      fl_wifiConnected = false;
+      break;
+    default:
+      break;
   }
 }
 
+static void startWiFi() {
+  if (_wifiStarted) return;
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin();
+  _wifiStarted = true;
+  Serial.println("Connecting to WiFi...");
+}
+
+static void stopWiFi() {
+  if (!_wifiStarted) return;
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  _wifiStarted = false;
+  Serial.println("WiFi disabled (Ethernet active)");
+}
+
 void fl_initNetwork() {
   // === NETWORK PRIORITY: Ethernet first, WiFi fallback ===
+  _ethPresent = fl_initEthernet();
+  WiFi.onEvent(onWiFiEvent);
 
-  if (fl_initEthernet()) {
-    Serial.println("Using Ethernet as primary connection");
-    fl_configLoaded = true;
+  // WiFiManager reads the saved credentials from the started STA interface
+  WiFi.mode(WIFI_STA);
+  _wifiEnabled = fl_wifiManager.getWiFiIsSaved();
+  bool cable = _ethPresent && Ethernet.linkStatus() == LinkON;
 
-    // Disable WiFi completely when using Ethernet
-    WiFi.mode(WIFI_OFF);
-    Serial.println("WiFi disabled (Ethernet active)");
-  } else {
-    // Ethernet failed, use WiFi
-    Serial.println("Ethernet not available, using WiFi...");
+  if (!cable && !_wifiEnabled) {
+    // Nothing to connect with: commissioning, so ask for WiFi credentials
+    Serial.println("No Ethernet cable and no saved WiFi");
 
     fl_wifiManager.setConfigPortalTimeout(FL_PORTAL_TIMEOUT_S);
     fl_wifiManager.setAPCallback([](WiFiManager *mgr) {
@@ -181,212 +353,447 @@ void fl_initNetwork() {
       Serial.println("WiFi credentials saved!");
     });
 
-    Serial.println("Connecting to WiFi...");
     if (fl_wifiManager.autoConnect(fl_AP_NAME)) {
       Serial.printf("WiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
-      fl_wifiConnected = true;
-      fl_configLoaded = true;
+      _wifiEnabled = true;
+      _wifiStarted = true;
+    } else {
+      Serial.println("WiFi setup timed out - waiting for an Ethernet cable");
     }
   }
 
   // Force disable any rogue AP
-  if (!fl_useEthernet) {
-    WiFi.softAPdisconnect(true);
-    WiFi.mode(WIFI_STA);
-    WiFi.setAutoReconnect(true);
-    Serial.println("Soft AP disabled, WiFi in STA mode (auto-reconnect enabled)");
-  } else {
+  WiFi.softAPdisconnect(true);
+  if (cable || !_wifiEnabled) {
     WiFi.mode(WIFI_OFF);
+    _wifiStarted = false;
     Serial.println("WiFi disabled (Ethernet mode)");
+  } else {
+    WiFi.mode(WIFI_STA);
+    startWiFi();
   }
 
-  if (!fl_configLoaded) {
-    Serial.println("Failed to connect to network. Restarting...");
-    delay(3000);
-    ESP.restart();
-  }
-
-  Serial.printf("\n=== Network: %s ===\n", fl_useEthernet ? "ETHERNET (priority)" : "WiFi");
-  Serial.printf("IP Address: %s\n", fl_useEthernet ? Ethernet.localIP().toString().c_str() : WiFi.localIP().toString().c_str());
+  fl_configLoaded = true;
+  Serial.printf("\n=== Network: %s, WiFi fallback %s ===\n",
+                cable ? "ETHERNET (priority)" : (_ethPresent ? "Ethernet (no link)" : "no Ethernet"),
+                _wifiEnabled ? "configured" : "not configured");
 }
 
 void fl_initNTP(long gmtOffsetSec) {
+  fl_clockBegin();
   configTime(gmtOffsetSec, 0, "pool.ntp.org", "time.nist.gov");
   Serial.println("NTP configured");
 }
 
-bool fl_connectMQTT() {
-  if (!fl_ethernetConnected && !fl_wifiConnected) return false;
+/* ================= CONNECTING (network task) ================= */
 
-  Serial.printf("Connecting to MQTT: %s:%d (TLS: %s, via %s)\n",
-                fl_mqtt_host, fl_mqtt_port, fl_mqtt_use_tls ? "yes" : "no",
-                fl_useEthernet ? "Ethernet" : "WiFi");
+static void connFail(const char* why) {
+  fl_conn_state_t s = fl_connState(fl_conn);
+  if (_transport) _transport->stop();
+  _transport = nullptr;
 
-  // Configure client based on connection type and TLS setting
+  if (s == FL_CONN_LINK) {
+    // The WiFi fallback never came up: give Ethernet another go
+    _preferWifi = false;
+  } else if (s == FL_CONN_DHCP && fl_useEthernet) {
+    fl_ethernetConnected = false;
+  } else if (s >= FL_CONN_DNS && fl_useEthernet && _wifiEnabled &&
+             ++mqttConnectFailCount >= FL_MAX_MQTT_CONNECT_FAILURES) {
+    Serial.println("MQTT over Ethernet failed repeatedly - switching to WiFi for TLS support");
+    mqttConnectFailCount = 0;
+    _preferWifi = true;
+  }
+
+  fl_connFail(fl_conn, millis(), esp_random());
+  Serial.printf("Network: %s failed (%s), retry in %lums\n",
+                fl_connStateToString(s), why, fl_conn.backoffMs);
+}
+
+// Cable first; WiFi if there is none, or after MQTT kept failing over it
+static void connLink(uint32_t now) {
+  bool ethLink = _ethPresent && Ethernet.linkStatus() == LinkON;
+  if (!ethLink) fl_ethernetConnected = false;  // The next cable may be another network
+  if (ethLink && !_preferWifi) {
+    stopWiFi();
+    fl_useEthernet = true;
+    Serial.println("Network: Ethernet link up");
+    fl_connEnter(fl_conn, FL_CONN_DHCP, now);
+    return;
+  }
+  if (!_wifiEnabled) return;  // Wait for a cable
+  startWiFi();
+  if (_wifiLink) {
+    fl_useEthernet = false;
+    fl_ethernetConnected = false;
+    Serial.println("Network: WiFi associated");
+    fl_connEnter(fl_conn, FL_CONN_DHCP, now);
+  }
+}
+
+static void connDhcp() {
   if (fl_useEthernet) {
-    if (fl_mqtt_use_tls) {
-      Serial.println("WARNING: TLS not supported over Ethernet, using non-TLS on port 1883");
-      fl_mqtt_port = 1883;
+    if (fl_ethernetConnected) {
+      // Only the session was lost; the lease still stands
+      fl_connEnter(fl_conn, FL_CONN_DNS, millis());
+      return;
+    }
+    Serial.println("Requesting IP via DHCP...");
+    if (!Ethernet.begin(ethMac, FL_CONN_DHCP_TIMEOUT_MS)) {
+      connFail("no DHCP server");
+      return;
     }
-    fl_mqtt.setClient(fl_ethClient);
-  } else if (fl_mqtt_use_tls) {
-    fl_espClientSecure.setInsecure();  // Skip certificate verification
-    fl_mqtt.setClient(fl_espClientSecure);
+    Serial.printf("Ethernet connected! IP: %s\n", Ethernet.localIP().toString().c_str());
+    Serial.printf("Gateway: %s\n", Ethernet.gatewayIP().toString().c_str());
+    Serial.printf("DNS: %s\n", Ethernet.dnsServerIP().toString().c_str());
+    fl_ethernetConnected = true;
   } else {
-    fl_mqtt.setClient(fl_espClientInsecure);
+    if (!_wifiLink) {
+      connFail("WiFi association lost");
+      return;
+    }
+    if (!_wifiIp) return;
+    Serial.printf("WiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
   }
+  fl_connEnter(fl_conn, FL_CONN_DNS, millis());
+}
 
-  fl_mqtt.setServer(fl_mqtt_host, fl_mqtt_port);
-  fl_mqtt.setBufferSize(FL_MAX_PAYLOAD_SIZE);
-  fl_mqtt.setKeepAlive(FL_MQTT_KEEPALIVE_S);
-  fl_mqtt.setCallback(internalMqttCallback);
+static void connDns() {
+  bool ok;
+  if (fl_useEthernet) {
+    DNSClient dns;
+    dns.begin(Ethernet.dnsServerIP());
+    ok = dns.getHostByName(fl_mqtt_host, _brokerIp, FL_CONN_DNS_TIMEOUT_MS) == 1;
+  } else {
+    ok = WiFi.hostByName(fl_mqtt_host, _brokerIp) == 1;
+  }
+  if (!ok) {
+    connFail("cannot resolve broker");
+    return;
+  }
 
-  unsigned long startTime = millis();
-  while (!fl_mqtt.connected()) {
-    // Connect with Last Will and Testament (LWT)
-    if (fl_mqtt.connect(fl_DEVICE_ID, fl_mqtt_user, fl_mqtt_pass, fl_TOPIC_STATUS, 0, true, "offline")) {
-      fl_mqtt.subscribe(fl_TOPIC_SUBSCRIBE);
-      fl_mqtt.publish(fl_TOPIC_STATUS, "online", true);
-      fl_lastMqttActivity = millis();
-      Serial.printf("MQTT connected as %s!\n", fl_DEVICE_ID);
-      Serial.printf("Subscribed to: %s\n", fl_TOPIC_SUBSCRIBE);
-      Serial.printf("Status topic: %s (LWT enabled)\n", fl_TOPIC_STATUS);
-      fl_mqttConnected = true;
-      return true;
-    }
+  _useTls = fl_mqtt_use_tls && !fl_useEthernet;
+  _brokerPort = fl_mqtt_port;
+  if (fl_mqtt_use_tls && fl_useEthernet) {
+    Serial.println("WARNING: TLS not supported over Ethernet, using non-TLS on port 1883");
+    _brokerPort = 1883;
+  }
+  Serial.printf("Connecting to MQTT: %s (%s):%d (TLS: %s, via %s)\n",
+                fl_mqtt_host, _brokerIp.toString().c_str(), _brokerPort, _useTls ? "yes" : "no",
+                fl_useEthernet ? "Ethernet" : "WiFi");
+  fl_connEnter(fl_conn, _useTls ? FL_CONN_TLS : FL_CONN_TCP, millis());
+}
 
-    if (millis() - startTime > FL_MQTT_TIMEOUT_MS) {
-      Serial.printf("MQTT connection TIMEOUT (rc=%d)\n", fl_mqtt.state());
-      fl_mqttConnected = false;
-      return false;
-    }
-    delay(500);
+static void connTcp() {
+  bool ok;
+  if (fl_useEthernet) {
+    fl_ethClient.setConnectionTimeout(FL_CONN_TCP_TIMEOUT_MS);
+    _transport = &fl_ethClient;
+    ok = fl_ethClient.connect(_brokerIp, _brokerPort);
+  } else {
+    _transport = &fl_espClientInsecure;
+    ok = fl_espClientInsecure.connect(_brokerIp, _brokerPort, FL_CONN_TCP_TIMEOUT_MS);
   }
+  if (!ok) {
+    connFail("TCP connect failed");
+    return;
+  }
+  fl_connEnter(fl_conn, FL_CONN_MQTT, millis());
+}
+
+static void connTls() {
+  // Connect by name so the broker gets SNI; the address is cached by now
+  fl_espClientSecure.setInsecure();  // Skip certificate verification
+  fl_espClientSecure.setHandshakeTimeout(FL_CONN_TLS_TIMEOUT_MS / 1000);
+  _transport = &fl_espClientSecure;
+  if (!fl_espClientSecure.connect(fl_mqtt_host, _brokerPort)) {
+    connFail("TLS handshake failed");
+    return;
+  }
+  fl_connEnter(fl_conn, FL_CONN_MQTT, millis());
+}
+
+static void connMqtt() {
+  // The transport is already open, so connect() only exchanges CONNECT/CONNACK
+  fl_mqtt.setClient(*_transport);
+  fl_mqtt.setServer(_brokerIp, _brokerPort);
+  // Connect with Last Will and Testament (LWT)
+  if (!fl_mqtt.connect(fl_DEVICE_ID, fl_mqtt_user, fl_mqtt_pass, fl_TOPIC_STATUS, 0, true, "offline")) {
+    Serial.printf("MQTT connect failed, rc=%d\n", fl_mqtt.state());
+    connFail("no CONNACK");
+    return;
+  }
+  fl_connEnter(fl_conn, FL_CONN_SUBSCRIBE, millis());
+}
 
+static void connSubscribe() {
+  // QoS 1: a command lost on a flaky link is redelivered; fl_runCommand
+  // drops repeats of a command id. Clean session, so nothing queued while
+  // offline is replayed at reconnect.
+  if (!fl_mqtt.subscribe(fl_TOPIC_COMMAND, 1) || !fl_mqtt.publish(fl_TOPIC_STATUS, "online", true)) {
+    fl_mqtt.disconnect();
+    connFail("subscribe failed");
+    return;
+  }
+  Serial.printf("MQTT connected as %s!\n", fl_DEVICE_ID);
+  Serial.printf("Subscribed to: %s (QoS 1)\n", fl_TOPIC_COMMAND);
+  Serial.printf("Status topic: %s (LWT enabled)\n", fl_TOPIC_STATUS);
+
+  unsigned long now = millis();
+  fl_lastMqttActivity = now;
+  lastStatusPublish = now;
+  mqttConnectFailCount = 0;
   fl_mqttConnected = true;
-  return true;
+  fl_connEnter(fl_conn, FL_CONN_UP, now);
 }
 
-void fl_reconnectMQTT() {
-  bool networkOk = false;
+// One step of the state machine. May block inside a library call, never
+// longer than that step's timeout.
+static void connStep() {
+  uint32_t now = millis();
+  fl_conn_state_t s = fl_connState(fl_conn);
+
+  // LINK only times out while it waits for the WiFi fallback; otherwise
+  // it waits for a cable or an association as long as it takes
+  bool timed = s != FL_CONN_BACKOFF && (s != FL_CONN_LINK || _preferWifi);
+  if (timed && fl_connExpired(fl_conn, now)) {
+    connFail("timeout");
+    return;
+  }
 
-  if (fl_useEthernet) {
-    maintainEthernet();
-    networkOk = fl_ethernetConnected;
-
-    if (!networkOk) {
-      Serial.println("Ethernet down, checking WiFi...");
-      if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("Falling back to WiFi");
-        fl_useEthernet = false;
-        fl_wifiConnected = true;
-        networkOk = true;
-        fl_mqtt.disconnect();
-        fl_mqttConnected = false;
-      }
-    }
-  } else {
-    if (WiFi.status() != WL_CONNECTED) {
-      if (fl_wifiConnected) {
-        Serial.println("WiFi disconnected!");
-        fl_wifiConnected = false;
-        fl_mqttConnected = false;
-      }
-      if (fl_initEthernet()) {
-        Serial.println("Switched to Ethernet");
-        networkOk = true;
-        fl_mqtt.disconnect();
-        fl_mqttConnected = false;
-      }
-    } else {
-      if (!fl_wifiConnected) {
-        Serial.printf("WiFi reconnected! IP: %s\n", WiFi.localIP().toString().c_str());
-        fl_wifiConnected = true;
-      }
-      networkOk = true;
-    }
+  switch (s) {
+    case FL_CONN_LINK:      connLink(now); break;
+    case FL_CONN_DHCP:      connDhcp(); break;
+    case FL_CONN_DNS:       connDns(); break;
+    case FL_CONN_TCP:       connTcp(); break;
+    case FL_CONN_TLS:       connTls(); break;
+    case FL_CONN_MQTT:      connMqtt(); break;
+    case FL_CONN_SUBSCRIBE: connSubscribe(); break;
+    case FL_CONN_BACKOFF:
+      if (fl_connExpired(fl_conn, now)) fl_connEnter(fl_conn, FL_CONN_LINK, now);
+      break;
+    default:
+      break;
   }
+}
 
-  if (!networkOk) return;
+/* ================= SESSION (network task, while UP) ================= */
 
-  if (!fl_mqtt.connected()) {
-    unsigned long now = millis();
-    if (now - lastMqttRetry > FL_MQTT_RETRY_INTERVAL) {
-      lastMqttRetry = now;
-      Serial.printf("Attempting MQTT reconnect via %s...\n", fl_useEthernet ? "Ethernet" : "WiFi");
+// Lease renewal is a short DHCP exchange every half lease; a lost link
+// ends the session
+static void maintainEthernet() {
+  switch (Ethernet.maintain()) {
+    case 1:
+      Serial.println("Ethernet DHCP renew failed");
+      fl_ethernetConnected = false;
+      break;
+    case 2:
+      Serial.println("Ethernet DHCP renewed");
+      break;
+    case 3:
+      Serial.println("Ethernet DHCP rebind failed");
+      fl_ethernetConnected = false;
+      break;
+    case 4:
+      Serial.println("Ethernet DHCP rebind success");
+      break;
+  }
 
-      // Reconfigure client for current network
-      if (fl_useEthernet) {
-        fl_mqtt.setClient(fl_ethClient);
-      } else if (fl_mqtt_use_tls) {
-        fl_espClientSecure.setInsecure();
-        fl_mqtt.setClient(fl_espClientSecure);
-      } else {
-        fl_mqtt.setClient(fl_espClientInsecure);
-      }
+  if (fl_ethernetConnected && Ethernet.linkStatus() == LinkOFF) {
+    Serial.println("Ethernet cable disconnected!");
+    fl_ethernetConnected = false;
+  }
+}
 
-      fl_mqtt.setServer(fl_mqtt_host, fl_useEthernet ? 1883 : fl_mqtt_port);
-      fl_mqtt.setBufferSize(FL_MAX_PAYLOAD_SIZE);
-      fl_mqtt.setKeepAlive(FL_MQTT_KEEPALIVE_S);
-
-      // Connect with LWT
-      if (fl_mqtt.connect(fl_DEVICE_ID, fl_mqtt_user, fl_mqtt_pass, fl_TOPIC_STATUS, 0, true, "offline")) {
-        fl_mqtt.subscribe(fl_TOPIC_SUBSCRIBE);
-        fl_mqtt.publish(fl_TOPIC_STATUS, "online", true);
-        fl_lastMqttActivity = millis();
-        Serial.printf("MQTT reconnected as %s!\n", fl_DEVICE_ID);
-        fl_mqttConnected = true;
-        mqttConnectFailCount = 0;
-      } else {
-        Serial.printf("MQTT reconnect failed, rc=%d\n", fl_mqtt.state());
-        fl_mqttConnected = false;
-        mqttConnectFailCount++;
-
-        // If on Ethernet and MQTT keeps failing, fall back to WiFi
-        if (fl_useEthernet && mqttConnectFailCount >= FL_MAX_MQTT_CONNECT_FAILURES) {
-          Serial.println("MQTT over Ethernet failed repeatedly - switching to WiFi for TLS support");
-          mqttConnectFailCount = 0;
-          fl_useEthernet = false;
-          fl_ethernetConnected = false;
-
-          WiFi.mode(WIFI_STA);
-          WiFi.begin();
-          Serial.println("Connecting to WiFi...");
-
-          unsigned long wifiStart = millis();
-          while (WiFi.status() != WL_CONNECTED && millis() - wifiStart < 15000) {
-            delay(500);
-            Serial.print(".");
-          }
-
-          if (WiFi.status() == WL_CONNECTED) {
-            Serial.printf("\nWiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
-            fl_wifiConnected = true;
-            WiFi.softAPdisconnect(true);
-          } else {
-            Serial.println("\nWiFi connection failed - will retry");
-          }
-        }
-      }
+// The next item of the highest class that has one
+static lane_t* nextLane() {
+  for (lane_t& l : _lanes) {
+    if (!l.held && l.ring) {
+      size_t size;
+      l.held = (publish_item_t*)xRingbufferReceive(l.ring, &size, 0);
     }
-  } else {
-    fl_mqttConnected = true;
+    if (l.held) return &l;
+  }
+  return nullptr;
+}
 
-    // Periodic "online" status publish to clear stale LWT
-    unsigned long now2 = millis();
-    if (now2 - lastStatusPublish > FL_MQTT_STATUS_INTERVAL_MS) {
-      lastStatusPublish = now2;
-      fl_mqtt.publish(fl_TOPIC_STATUS, "online", true);
+// Faults, acks and journal records are never given up on; the rest would
+// be stale long before a link that slow recovers
+static bool abandonable(fl_pub_class_t cls) {
+  return cls == FL_PUB_SETTINGS || cls == FL_PUB_TELEMETRY;
+}
+
+// One item at a time, highest class first, so a fault queued meanwhile
+// goes next. A publish the client refuses with the socket still open is
+// kept and retried: the link is slow, not gone. Settings or telemetry
+// refused FL_PUB_MAX_RETRIES times in a row is dropped, so it cannot hold
+// up the classes below it for ever. Anything else is retried until it goes
+// or the session ends (the stale timeout ends one where nothing moves);
+// faults and journal records then wait for the next session. False once
+// the link is gone.
+static bool sendPublishes() {
+  if (_retryWait && (int32_t)(millis() - _retryAtMs) < 0) return true;
+  _retryWait = false;
+  lane_t* l;
+  while ((l = nextLane()) != nullptr) {
+    publish_item_t* head = l->held;
+    fl_publish_stats_t& st = fl_publishStats[l->cls];
+    if (!fl_mqtt.publish(head->topic, (const uint8_t*)(head + 1), head->len, head->retained)) {
+      if (!fl_mqtt.connected()) return false;
+      if (l->refusals < FL_PUB_MAX_RETRIES) l->refusals++;
+      if (l->refusals < FL_PUB_MAX_RETRIES || !abandonable(l->cls)) {
+        st.retried++;
+        _retryWait = true;
+        _retryAtMs = millis() + FL_PUB_RETRY_MS;
+        return true;
+      }
+      Serial.printf("Publish to %s refused %d times, dropped\n", head->topic, FL_PUB_MAX_RETRIES);
+      vRingbufferReturnItem(l->ring, head);
+      l->held = nullptr;
+      l->refusals = 0;
+      st.abandoned++;
+      continue;
     }
+    vRingbufferReturnItem(l->ring, head);
+    l->held = nullptr;
+    l->refusals = 0;
+    st.sent++;
+    fl_lastMqttActivity = millis();
+  }
+  return true;
+}
 
-    // Staleness detection
-    unsigned long now = millis();
-    if (fl_lastMqttActivity > 0 && (now - fl_lastMqttActivity > FL_MQTT_STALE_TIMEOUT_MS)) {
-      Serial.printf("MQTT connection stale (no activity for %lus) - forcing reconnect\n",
-                    (now - fl_lastMqttActivity) / 1000);
-      fl_mqtt.disconnect();
-      fl_mqttConnected = false;
-      fl_lastMqttActivity = 0;
+// Session gone: faults and journal records wait for the next one, the
+// rest would be stale by then
+static void flushPublishes() {
+  for (lane_t& l : _lanes) {
+    if (!l.ring || l.cls == FL_PUB_FAULT || l.cls == FL_PUB_REPLAY) continue;
+    fl_publish_stats_t& st = fl_publishStats[l.cls];
+    if (l.held) {
+      vRingbufferReturnItem(l.ring, l.held);
+      l.held = nullptr;
+      l.refusals = 0;
+      st.flushed++;
     }
+    size_t size;
+    void* item;
+    while ((item = xRingbufferReceive(l.ring, &size, 0)) != nullptr) {
+      vRingbufferReturnItem(l.ring, item);
+      st.flushed++;
+    }
+  }
+  _retryWait = false;
+}
+
+static void serviceSession() {
+  const char* lost = nullptr;
+  if (fl_useEthernet) {
+    maintainEthernet();
+    if (!fl_ethernetConnected) lost = "Ethernet down";
+  } else if (!_wifiIp) {
+    Serial.println("WiFi disconnected!");
+    lost = "WiFi down";
+  }
+  if (!lost && !fl_mqtt.loop()) lost = "broker closed the session";
+  if (!lost && !sendPublishes()) lost = "socket closed while publishing";
+  if (!lost && _paused) lost = "paused";
+
+  unsigned long now = millis();
+  if (!lost && fl_lastMqttActivity > 0 && (now - fl_lastMqttActivity > FL_MQTT_STALE_TIMEOUT_MS)) {
+    Serial.printf("MQTT connection stale (no activity for %lus) - forcing reconnect\n",
+                  (now - fl_lastMqttActivity) / 1000);
+    lost = "stale";
+  }
+
+  if (lost) {
+    Serial.printf("MQTT connection lost (%s) after %lus\n", lost, fl_connElapsed(fl_conn, now) / 1000);
+    fl_mqttConnected = false;
+    fl_mqtt.disconnect();
+    flushPublishes();
+    fl_lastMqttActivity = 0;
+    fl_connLost(fl_conn, now);
+    return;
+  }
+
+  // Periodic "online" status publish to clear stale LWT. Counts as
+  // activity: with report-by-exception telemetry may be quiet for longer
+  // than the stale timeout.
+  if (now - lastStatusPublish > FL_MQTT_STATUS_INTERVAL_MS) {
+    lastStatusPublish = now;
+    if (fl_mqtt.publish(fl_TOPIC_STATUS, "online", true)) fl_lastMqttActivity = now;
+  }
+}
+
+static void netTask(void* arg) {
+  for (;;) {
+    bool up = fl_connState(fl_conn) == FL_CONN_UP;
+    if (up) serviceSession();
+    else if (!_paused) connStep();
+    fl_serviceTelegram();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(up ? FL_NET_SERVICE_MS : FL_NET_POLL_MS));
+  }
+}
+
+bool fl_connectMQTT() {
+  if (_netTask) return true;
+
+  fl_mqtt.setBufferSize(FL_MAX_PAYLOAD_SIZE);
+  fl_mqtt.setKeepAlive(FL_MQTT_KEEPALIVE_S);
+  fl_mqtt.setSocketTimeout(FL_CONN_MQTT_TIMEOUT_MS / 1000);  // CONNACK wait
+  fl_mqtt.setCallback(internalMqttCallback);
+
+  fl_connInit(fl_conn, millis());
+  if (xTaskCreatePinnedToCore(netTask, "fl_net", FL_NET_TASK_STACK, nullptr,
+                              FL_NET_TASK_PRIO, &_netTask, FL_NET_TASK_CORE) != pdPASS) {
+    Serial.println("Failed to start network task");
+    _netTask = nullptr;
+    return false;
+  }
+  Serial.printf("Network task started (broker %s:%d, TLS: %s)\n",
+                fl_mqtt_host, fl_mqtt_port, fl_mqtt_use_tls ? "yes" : "no");
+  return true;
+}
+
+void fl_netPause(uint32_t timeoutMs) {
+  _paused = true;
+  if (!_netTask) return;
+  xTaskNotifyGive(_netTask);
+  uint32_t start = millis();
+  while (fl_connState(fl_conn) == FL_CONN_UP && millis() - start < timeoutMs) delay(10);
+}
+
+void fl_netResume() {
+  _paused = false;
+  if (_netTask) xTaskNotifyGive(_netTask);
+}
+
+void fl_printConnStatus() {
+  uint32_t now = millis();
+  fl_conn_state_t s = fl_connState(fl_conn);
+  uint32_t elapsed = fl_connElapsed(fl_conn, now);
+  Serial.printf("Network: %s via %s for %lus, %lu sessions", fl_connStateToString(s),
+                fl_useEthernet ? "Ethernet" : "WiFi", elapsed / 1000, fl_conn.sessions);
+  if (s == FL_CONN_BACKOFF && elapsed < fl_conn.backoffMs) {
+    Serial.printf(" | retry in %lums", fl_conn.backoffMs - elapsed);
+  }
+  if (fl_conn.attempts) {
+    Serial.printf(" | %d failed attempts, last in %s", fl_conn.attempts,
+                  fl_connStateToString(fl_conn.failedIn));
+  }
+  Serial.println();
+  for (uint8_t i = 0; i < FL_CONN_STATE_COUNT; i++) {
+    const fl_conn_stats_t& st = fl_conn.stats[i];
+    if (!st.entries) continue;
+    Serial.printf("  %-9s %lu entries, %lu failed | total %lums, last %lums, worst %lums\n",
+                  fl_connStateToString((fl_conn_state_t)i), st.entries, st.failures,
+                  st.totalMs, st.lastMs, st.maxMs);
+  }
+  Serial.printf("Publish queues (telemetry interval stretched by %lums):\n", fl_publishStretchMs());
+  for (uint8_t i = 0; i < FL_PUB_CLASS_COUNT; i++) {
+    const fl_publish_stats_t& ps = fl_publishStats[i];
+    if (!ps.queued && !ps.full && !ps.oversize) continue;
+    Serial.printf("  %-9s %lu queued, %lu sent, %lu retried, %lu abandoned, %lu full, %lu oversize, %lu coalesced, "
+                  "%lu flushed | peak %lu of %u bytes\n",
+                  pubClassNames[i], ps.queued, ps.sent, ps.retried, ps.abandoned, ps.full, ps.oversize,
+                  ps.coalesced, ps.flushed, ps.peakBytes, pubLaneBytes[i]);
   }
 }
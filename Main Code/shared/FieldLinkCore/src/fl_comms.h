@@ -8,22 +8,51 @@
 #include <PubSubClient.h>
 #include <Ethernet.h>
 #include <SPI.h>
+#include "fl_conn.h"
+#include "fl_command.h"
 
-// Connection timeouts
+// Connection timeouts (per connection step: fl_conn.h)
 #define FL_PORTAL_TIMEOUT_S       180
-#define FL_WIFI_TIMEOUT_MS        30000
-#define FL_MQTT_TIMEOUT_MS        10000
-#define FL_MQTT_RETRY_INTERVAL    5000
 #define FL_MQTT_KEEPALIVE_S       30
 #define FL_MQTT_STALE_TIMEOUT_MS  90000
 #define FL_MQTT_STATUS_INTERVAL_MS 60000
-#define FL_MAX_PAYLOAD_SIZE       1024
-#define FL_MAX_MQTT_PUBLISH_FAILURES 3
-#define FL_MAX_MQTT_CONNECT_FAILURES 3
+#define FL_MAX_PAYLOAD_SIZE       2048   // Settings with per-pump thermal config and journal stats run ~1.4 KB
+#define FL_MAX_MQTT_CONNECT_FAILURES 3   // Over Ethernet, before trying WiFi (TLS)
 
-// MQTT client
+// Network task: all socket I/O. It connects (fl_conn.h), runs the MQTT
+// loop, sends the publish queue and Telegram notifications, and posts
+// inbound commands to the command queue; the control loop only touches
+// the queues. Same core and priority as loopTask, so a library
+// spinning on a socket shares the core with the loop instead of starving it.
+#define FL_NET_TASK_STACK    8192   // mbedTLS handshake
+#define FL_NET_TASK_PRIO     1
+#define FL_NET_TASK_CORE     1
+#define FL_NET_POLL_MS       50     // While connecting
+#define FL_NET_SERVICE_MS    10     // While UP; a publish wakes the task at once
+
+// Queue sizes in bytes: items are variable length (FreeRTOS ring buffers)
+#define FL_COMMAND_QUEUE_BYTES  4096   // A tariff definition and a few commands
+#define FL_COMMANDS_PER_TICK    4      // Bounds the loop time spent on commands
+
+// Publish queues, one per class (fl_pub_class_t), each lane a ring buffer.
+// A telemetry lane holds one frame being sent and the newest waiting one.
+#define FL_PUB_FAULT_BYTES      2048   // A dozen fault records
+#define FL_PUB_ACK_BYTES        2048
+#define FL_PUB_SETTINGS_BYTES   4096   // Two settings documents
+#define FL_PUB_TELEMETRY_BYTES  2304   // Per topic: two 1 KB frames
+#define FL_PUB_TELEMETRY_TOPICS 3      // telemetry, telemetry.bin, telemetry.stats
+#define FL_PUB_REPLAY_BYTES     2304   // Two journal records
+#define FL_PUB_RETRY_MS         250    // After the client refuses a publish (socket busy)
+#define FL_PUB_MAX_RETRIES      40     // Then settings or telemetry is dropped: 10 s of refusals
+#define FL_PUB_STRETCH_STEP_MS  1000   // Telemetry interval stretch under backpressure:
+#define FL_PUB_STRETCH_MAX_MS   30000  //   doubles per coalesced frame, halves per clean one
+
+// MQTT client. Owned by the network task.
 extern PubSubClient fl_mqtt;
 
+// Connection state machine
+extern fl_conn_t fl_conn;
+
 // Connection state
 extern bool fl_mqttConnected;
 extern bool fl_wifiConnected;
@@ -32,31 +61,98 @@ extern bool fl_useEthernet;
 extern bool fl_configLoaded;
 extern unsigned long fl_lastMqttActivity;
 
-// MQTT publish failure tracking
-extern int fl_mqttPublishFailCount;
+/* ----- Inbound commands ----- */
+
+// Per source: queue wait (posted to picked up) and execution time
+struct fl_cmd_stats_t {
+  uint32_t count;
+  uint32_t dropped;            // Queue full
+  uint32_t waitMaxUs;
+  uint32_t execMaxUs;
+  uint64_t waitSumUs;
+  uint64_t execSumUs;
+};
+
+extern fl_cmd_stats_t fl_cmdStats[FL_CMD_SOURCE_COUNT];
+
+/* ----- Outbound publishes ----- */
+
+// Highest priority first: the network task always sends from the first
+// non-empty class
+enum fl_pub_class_t : uint8_t {
+  FL_PUB_FAULT = 0,            // Protection trips. Kept across reconnects.
+  FL_PUB_ACK,                  // Command acks and replies
+  FL_PUB_SETTINGS,             // Settings and other one-off documents
+  FL_PUB_TELEMETRY,            // Live frames: only the newest per topic waits
+  FL_PUB_REPLAY,               // Journal backlog. Kept across reconnects.
+  FL_PUB_CLASS_COUNT
+};
+
+struct fl_publish_stats_t {
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t retried;            // Refused by the client (socket busy), sent again later
+  uint32_t full;               // Not queued: no room
+  uint32_t oversize;           // Not queued: topic and payload exceed the client's buffer
+  uint32_t abandoned;          // Refused FL_PUB_MAX_RETRIES times in a row, dropped (settings, telemetry)
+  uint32_t coalesced;          // Replaced by a newer frame before it went out
+  uint32_t flushed;            // Discarded when the session went down
+  uint32_t peakBytes;          // Highest fill of one lane
+};
+
+extern fl_publish_stats_t fl_publishStats[FL_PUB_CLASS_COUNT];
 
 // WiFiManager instance
 extern WiFiManager fl_wifiManager;
 
-// MQTT command callback type: receives (command_string, length)
-typedef void (*fl_mqtt_callback_t)(const char* cmd, unsigned int length);
+// Create the command and publish queues (fl_begin)
+void fl_initNetQueues();
+
+// Queue a command for the loop task; false if the queue is full. Safe from
+// any task.
+bool fl_postCommand(fl_cmd_source_t source, const char* text, size_t len);
+
+// Run queued commands (call in loop via fl_tick): JSON through
+// fl_runCommand, serial lines through the serial handler
+void fl_processCommands();
 
-// Set project MQTT command callback
-void fl_setMqttCallback(fl_mqtt_callback_t callback);
+// Queue a publish for the network task, from the loop task. 'topic' is
+// kept by pointer, so it must be static (the fl_TOPIC_* strings). A
+// telemetry frame replaces one of the same topic still waiting. False while
+// the session is down, when the class has no room, or when the packet
+// would not fit the client's FL_MAX_PAYLOAD_SIZE buffer (the client would
+// refuse it every time); true only means queued (QoS 0 either way).
+bool fl_publish(const char* topic, const void* payload, size_t len, fl_pub_class_t cls, bool retained = false);
 
-// Initialize network (Ethernet first, WiFi fallback)
+// Extra delay for the telemetry interval while frames are being coalesced
+// (the link is slower than the frame rate): the largest of the telemetry
+// topics' own stretches; 0 when they all keep up
+uint32_t fl_publishStretchMs();
+
+// Take the broker session down once the publish queue has been sent, and
+// keep it down (a firmware download needs the TLS memory). Waits up to
+// 'timeoutMs' for the network task.
+void fl_netPause(uint32_t timeoutMs = 3000);
+void fl_netResume();
+
+// Initialize network hardware (Ethernet first, WiFi fallback). Returns at
+// once, except for the WiFi setup portal when there is neither an Ethernet
+// cable nor saved WiFi credentials.
 void fl_initNetwork();
 
 // Configure NTP time sync
 void fl_initNTP(long gmtOffsetSec);
 
-// Connect to MQTT broker
+// Start the network task; the broker session comes up in the background.
+// Returns false if the task could not be created.
 bool fl_connectMQTT();
 
-// MQTT reconnect logic (call in loop via fl_tick)
-void fl_reconnectMQTT();
-
-// Initialize Ethernet
+// Reset the W5500 and bring up SPI. Returns false if the chip doesn't
+// answer. Addressing is left to the network task.
 bool fl_initEthernet();
 
+// State, per-state time and failures; queue statistics
+void fl_printConnStatus();
+void fl_printCommandStatus();
+
 #endif
@@ -0,0 +1,85 @@
+#include "fl_conn.h"
+#include <string.h>
+
+void fl_connInit(fl_conn_t& c, uint32_t nowMs) {
+  c.state.store(FL_CONN_LINK);
+  c.enteredMs = nowMs;
+  c.backoffMs = 0;
+  c.attempts = 0;
+  c.failedIn = FL_CONN_LINK;
+  c.sessions = 0;
+  memset(c.stats, 0, sizeof(c.stats));
+  c.stats[FL_CONN_LINK].entries = 1;
+}
+
+void fl_connEnter(fl_conn_t& c, fl_conn_state_t next, uint32_t nowMs) {
+  fl_conn_stats_t& s = c.stats[fl_connState(c)];
+  uint32_t ms = nowMs - c.enteredMs;
+  s.totalMs += ms;
+  s.lastMs = ms;
+  if (ms > s.maxMs) s.maxMs = ms;
+
+  if (next == FL_CONN_UP) {
+    c.attempts = 0;
+    c.sessions++;
+  }
+  c.stats[next].entries++;
+  c.enteredMs = nowMs;
+  c.state.store(next);
+}
+
+void fl_connFail(fl_conn_t& c, uint32_t nowMs, uint32_t random) {
+  fl_conn_state_t s = fl_connState(c);
+  c.stats[s].failures++;
+  c.failedIn = s;
+  if (c.attempts < 255) c.attempts++;
+
+  // 1 s, 2 s, 4 s ... capped, then +/-25 % so a site full of devices
+  // doesn't reconnect in step after a broker restart
+  uint32_t base = FL_CONN_BACKOFF_MIN_MS;
+  for (uint8_t i = 1; i < c.attempts && base < FL_CONN_BACKOFF_MAX_MS; i++) base *= 2;
+  if (base > FL_CONN_BACKOFF_MAX_MS) base = FL_CONN_BACKOFF_MAX_MS;
+  c.backoffMs = base - base / 4 + random % (base / 2 + 1);
+
+  fl_connEnter(c, FL_CONN_BACKOFF, nowMs);
+}
+
+void fl_connLost(fl_conn_t& c, uint32_t nowMs) {
+  c.stats[FL_CONN_UP].failures++;
+  c.failedIn = FL_CONN_UP;
+  fl_connEnter(c, FL_CONN_LINK, nowMs);
+}
+
+bool fl_connExpired(const fl_conn_t& c, uint32_t nowMs) {
+  fl_conn_state_t s = fl_connState(c);
+  uint32_t limit = s == FL_CONN_BACKOFF ? c.backoffMs : fl_connTimeoutMs(s);
+  return limit && nowMs - c.enteredMs >= limit;
+}
+
+uint32_t fl_connTimeoutMs(fl_conn_state_t s) {
+  switch (s) {
+    case FL_CONN_LINK:      return FL_CONN_LINK_TIMEOUT_MS;
+    case FL_CONN_DHCP:      return FL_CONN_DHCP_TIMEOUT_MS;
+    case FL_CONN_DNS:       return FL_CONN_DNS_TIMEOUT_MS;
+    case FL_CONN_TCP:       return FL_CONN_TCP_TIMEOUT_MS;
+    case FL_CONN_TLS:       return FL_CONN_TLS_TIMEOUT_MS;
+    case FL_CONN_MQTT:      return FL_CONN_MQTT_TIMEOUT_MS;
+    case FL_CONN_SUBSCRIBE: return FL_CONN_SUBSCRIBE_TIMEOUT_MS;
+    default:                return 0;
+  }
+}
+
+const char* fl_connStateToString(fl_conn_state_t s) {
+  switch (s) {
+    case FL_CONN_LINK:      return "LINK";
+    case FL_CONN_DHCP:      return "DHCP";
+    case FL_CONN_DNS:       return "DNS";
+    case FL_CONN_TCP:       return "TCP";
+    case FL_CONN_TLS:       return "TLS";
+    case FL_CONN_MQTT:      return "MQTT";
+    case FL_CONN_SUBSCRIBE: return "SUBSCRIBE";
+    case FL_CONN_UP:        return "UP";
+    case FL_CONN_BACKOFF:   return "BACKOFF";
+    default:                return "?";
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef FL_CONN_H
+#define FL_CONN_H
+
+// Broker connection as an explicit state machine:
+//
+//   LINK -> DHCP -> DNS -> TCP -> MQTT -> SUBSCRIBE -> UP
+//                       \-> TLS --/
+//
+// LINK waits for a cable or a WiFi association, DHCP for an address, DNS
+// resolves the broker, TCP or TLS opens the transport (WiFiClientSecure
+// does TCP and the handshake in one call, so TLS time includes its TCP
+// connect), MQTT waits for CONNACK and SUBSCRIBE subscribes and publishes
+// "online". A step that fails or overruns its timeout goes to BACKOFF,
+// which waits an exponentially growing, jittered delay and starts again
+// at LINK; losing the session in UP does the same without the wait.
+// Entries, failures and time are accounted per state.
+// Hardware-free: fl_comms does the I/O and feeds the results in.
+
+#include <stdint.h>
+#include <atomic>
+
+// Per-state timeouts. DHCP, DNS, TCP, TLS and MQTT are also handed to the
+// blocking library call as its own timeout.
+#define FL_CONN_LINK_TIMEOUT_MS       30000
+#define FL_CONN_DHCP_TIMEOUT_MS       10000
+#define FL_CONN_DNS_TIMEOUT_MS        5000
+#define FL_CONN_TCP_TIMEOUT_MS        5000
+#define FL_CONN_TLS_TIMEOUT_MS        15000
+#define FL_CONN_MQTT_TIMEOUT_MS       10000
+#define FL_CONN_SUBSCRIBE_TIMEOUT_MS  5000
+
+#define FL_CONN_BACKOFF_MIN_MS        1000
+#define FL_CONN_BACKOFF_MAX_MS        60000   // Before +/-25 % jitter
+
+enum fl_conn_state_t : uint8_t {
+  FL_CONN_LINK = 0,
+  FL_CONN_DHCP,
+  FL_CONN_DNS,
+  FL_CONN_TCP,
+  FL_CONN_TLS,
+  FL_CONN_MQTT,
+  FL_CONN_SUBSCRIBE,
+  FL_CONN_UP,
+  FL_CONN_BACKOFF,
+  FL_CONN_STATE_COUNT
+};
+
+struct fl_conn_stats_t {
+  uint32_t entries;
+  uint32_t failures;           // Errors and timeouts
+  uint32_t totalMs;            // Closed visits only
+  uint32_t lastMs;
+  uint32_t maxMs;
+};
+
+struct fl_conn_t {
+  // Written by whichever task owns the connection: the connecting side
+  // until UP, the supervising side while UP
+  std::atomic<uint8_t> state;
+  uint32_t enteredMs;
+  uint32_t backoffMs;          // Current wait in BACKOFF
+  uint8_t attempts;            // Consecutive failed attempts
+  fl_conn_state_t failedIn;    // Where the last attempt failed
+  uint32_t sessions;           // Times UP was reached
+  fl_conn_stats_t stats[FL_CONN_STATE_COUNT];
+};
+
+void fl_connInit(fl_conn_t& c, uint32_t nowMs);
+
+inline fl_conn_state_t fl_connState(const fl_conn_t& c) { return (fl_conn_state_t)c.state.load(); }
+
+// Close the current state's visit and open 'next'
+void fl_connEnter(fl_conn_t& c, fl_conn_state_t next, uint32_t nowMs);
+
+// The current step failed: count it and enter BACKOFF. 'random' supplies
+// the jitter.
+void fl_connFail(fl_conn_t& c, uint32_t nowMs, uint32_t random);
+
+// UP was lost: back to LINK at once
+void fl_connLost(fl_conn_t& c, uint32_t nowMs);
+
+// The current state has overrun its timeout; BACKOFF: its wait is over
+bool fl_connExpired(const fl_conn_t& c, uint32_t nowMs);
+
+// Time in the current state so far
+inline uint32_t fl_connElapsed(const fl_conn_t& c, uint32_t nowMs) { return nowMs - c.enteredMs; }
+
+uint32_t fl_connTimeoutMs(fl_conn_state_t s);
+const char* fl_connStateToString(fl_conn_state_t s);
+
+#endif
@@ -0,0 +1,405 @@
+#include "fl_controller.h"
+
+/* ================= PUMP DEFAULTS ================= */
+
+void fl_pumpInit(fl_pump_t& p, uint8_t id, const fl_controller_config_t& cfg) {
+  memset(&p, 0, sizeof(p));
+  p.id = id;
+  p.state = FL_MOTOR_STOPPED;
+  p.faultType = FL_FAULT_NONE;
+  p.maxCurrentThreshold = 120.0;
+  p.dryCurrentThreshold = 0.5;
+  p.overcurrentEnabled = true;
+  p.dryRunEnabled = true;
+  p.thermalMode = FL_THERMAL_OFF;
+  p.thermalTms = cfg.thermalTms;
+  p.thermalTauHeatS = cfg.tauHeatS;
+  p.thermalTauCoolS = cfg.tauCoolS;
+  p.imbalanceEnabled = true;
+  p.maxImbalancePct = cfg.maxImbalancePct;
+  p.imbalanceDelayS = cfg.imbalanceDelayS;
+  p.phaseLossEnabled = true;
+  p.phaseLossDelayS = cfg.phaseLossDelayS;
+  p.voltageEnabled = false;
+  p.underVoltage = cfg.underVoltage;
+  p.overVoltage = cfg.overVoltage;
+  p.voltageDelayS = cfg.voltageDelayS;
+  fl_protectionInit(p.prot);
+  p.schedule.startHour = 6;
+  p.schedule.endHour = 18;
+  p.schedule.days = 0x7F;
+}
+
+fl_protection_config_t fl_pumpProtectionConfig(const fl_pump_t& p, const fl_controller_config_t& c) {
+  fl_protection_config_t cfg = {};
+  cfg.overcurrentEnabled = p.overcurrentEnabled;
+  cfg.maxCurrent = p.maxCurrentThreshold;
+  cfg.overcurrentDelayMs = p.overcurrentDelayS * 1000;
+  cfg.dryRunEnabled = p.dryRunEnabled;
+  cfg.dryCurrent = p.dryCurrentThreshold;
+  cfg.dryRunDelayMs = p.dryrunDelayS * 1000;
+  cfg.startTimeoutMs = c.startTimeoutMs;
+  cfg.inrushBlankMs = c.inrushBlankMs;
+  cfg.runThreshold = c.runThreshold;
+  cfg.hysteresis = c.hysteresis;
+  cfg.debounceCount = c.debounceCount;
+  cfg.faultAutoResetMs = c.faultAutoResetMs;
+  cfg.thermalMode = p.thermalMode;
+  cfg.thermalPickup = p.thermalPickup;
+  cfg.thermalTms = p.thermalTms;
+  cfg.tauHeatS = p.thermalTauHeatS;
+  cfg.tauCoolS = p.thermalTauCoolS;
+  // Only acted on when the step input carries phase metrics
+  cfg.imbalanceEnabled = p.imbalanceEnabled;
+  cfg.maxImbalancePct = p.maxImbalancePct;
+  cfg.imbalanceDelayMs = p.imbalanceDelayS * 1000;
+  cfg.phaseLossEnabled = p.phaseLossEnabled;
+  cfg.phaseLossDelayMs = p.phaseLossDelayS * 1000;
+  cfg.voltageEnabled = p.voltageEnabled;
+  cfg.underVoltage = p.underVoltage;
+  cfg.overVoltage = p.overVoltage;
+  cfg.voltageDelayMs = p.voltageDelayS * 1000;
+  return cfg;
+}
+
+/* ================= NVS ================= */
+
+void fl_pumpLoadProtection(fl_pump_t& p, const char* ns, const char* tag, bool threePhase,
+                           const fl_controller_config_t& cfg) {
+  fl_preferences.begin(ns, true);
+  p.overcurrentEnabled = fl_preferences.getBool("oc_en", true);
+  p.dryRunEnabled = fl_preferences.getBool("dr_en", true);
+  p.maxCurrentThreshold = fl_preferences.getFloat("max_i", 120.0);
+  p.dryCurrentThreshold = fl_preferences.getFloat("dry_i", 0.5);
+  p.overcurrentDelayS = fl_preferences.getULong("oc_delay", 0);
+  p.dryrunDelayS = fl_preferences.getULong("dr_delay", 0);
+  p.thermalMode = (fl_thermal_mode_t)fl_preferences.getUChar("th_mode", FL_THERMAL_OFF);
+  p.thermalPickup = fl_preferences.getFloat("th_pick", 0);
+  p.thermalTms = fl_preferences.getFloat("th_tms", cfg.thermalTms);
+  p.thermalTauHeatS = fl_preferences.getUShort("th_tauh", cfg.tauHeatS);
+  p.thermalTauCoolS = fl_preferences.getUShort("th_tauc", cfg.tauCoolS);
+  if (threePhase) {
+    p.imbalanceEnabled = fl_preferences.getBool("ub_en", true);
+    p.maxImbalancePct = fl_preferences.getFloat("ub_max", cfg.maxImbalancePct);
+    p.imbalanceDelayS = fl_preferences.getULong("ub_delay", cfg.imbalanceDelayS);
+    p.phaseLossEnabled = fl_preferences.getBool("pl_en", true);
+    p.phaseLossDelayS = fl_preferences.getULong("pl_delay", cfg.phaseLossDelayS);
+    p.voltageEnabled = fl_preferences.getBool("v_en", false);
+    p.underVoltage = fl_preferences.getFloat("uv", cfg.underVoltage);
+    p.overVoltage = fl_preferences.getFloat("ov", cfg.overVoltage);
+    p.voltageDelayS = fl_preferences.getULong("v_delay", cfg.voltageDelayS);
+  }
+  fl_preferences.end();
+  if (p.thermalMode >= FL_THERMAL_MODE_COUNT) p.thermalMode = FL_THERMAL_OFF;
+
+  Serial.printf("%s protection: max=%.1fA, dry=%.1fA, oc_delay=%lus, dr_delay=%lus\n",
+                tag, p.maxCurrentThreshold, p.dryCurrentThreshold, p.overcurrentDelayS, p.dryrunDelayS);
+  Serial.printf("%s thermal: mode=%s, pickup=%.1fA, tms=%.2f, tau=%u/%us\n",
+                tag, fl_thermalModeToString(p.thermalMode), p.thermalPickup, p.thermalTms,
+                p.thermalTauHeatS, p.thermalTauCoolS);
+  if (threePhase) {
+    Serial.printf("%s phases: unbalance %s %.1f%%/%lus, loss %s %lus, voltage %s %.0f-%.0fV/%lus\n",
+                  tag, p.imbalanceEnabled ? "ON" : "OFF", p.maxImbalancePct, p.imbalanceDelayS,
+                  p.phaseLossEnabled ? "ON" : "OFF", p.phaseLossDelayS,
+                  p.voltageEnabled ? "ON" : "OFF", p.underVoltage, p.overVoltage, p.voltageDelayS);
+  }
+}
+
+void fl_pumpSaveProtection(const fl_pump_t& p, const char* ns, const char* tag, bool threePhase) {
+  fl_preferences.begin(ns, false);
+  fl_preferences.putBool("oc_en", p.overcurrentEnabled);
+  fl_preferences.putBool("dr_en", p.dryRunEnabled);
+  fl_preferences.putFloat("max_i", p.maxCurrentThreshold);
+  fl_preferences.putFloat("dry_i", p.dryCurrentThreshold);
+  fl_preferences.putULong("oc_delay", p.overcurrentDelayS);
+  fl_preferences.putULong("dr_delay", p.dryrunDelayS);
+  fl_preferences.putUChar("th_mode", p.thermalMode);
+  fl_preferences.putFloat("th_pick", p.thermalPickup);
+  fl_preferences.putFloat("th_tms", p.thermalTms);
+  fl_preferences.putUShort("th_tauh", p.thermalTauHeatS);
+  fl_preferences.putUShort("th_tauc", p.thermalTauCoolS);
+  if (threePhase) {
+    fl_preferences.putBool("ub_en", p.imbalanceEnabled);
+    fl_preferences.putFloat("ub_max", p.maxImbalancePct);
+    fl_preferences.putULong("ub_delay", p.imbalanceDelayS);
+    fl_preferences.putBool("pl_en", p.phaseLossEnabled);
+    fl_preferences.putULong("pl_delay", p.phaseLossDelayS);
+    fl_preferences.putBool("v_en", p.voltageEnabled);
+    fl_preferences.putFloat("uv", p.underVoltage);
+    fl_preferences.putFloat("ov", p.overVoltage);
+    fl_preferences.putULong("v_delay", p.voltageDelayS);
+  }
+  fl_preferences.end();
+  Serial.printf("%s protection saved\n", tag);
+}
+
+void fl_pumpLoadSchedule(fl_pump_t& p, const char* ns, const char* tag) {
+  fl_preferences.begin(ns, true);
+  p.schedule.enabled = fl_preferences.getBool("en", false);
+  p.schedule.startHour = fl_preferences.getUChar("sH", 6);
+  p.schedule.startMinute = fl_preferences.getUChar("sM", 0);
+  p.schedule.endHour = fl_preferences.getUChar("eH", 18);
+  p.schedule.endMinute = fl_preferences.getUChar("eM", 0);
+  p.schedule.days = fl_preferences.getUChar("days", 0x7F);
+  fl_preferences.end();
+  Serial.printf("%s schedule loaded\n", tag);
+}
+
+void fl_pumpSaveSchedule(const fl_pump_t& p, const char* ns, const char* tag) {
+  fl_preferences.begin(ns, false);
+  fl_preferences.putBool("en", p.schedule.enabled);
+  fl_preferences.putUChar("sH", p.schedule.startHour);
+  fl_preferences.putUChar("sM", p.schedule.startMinute);
+  fl_preferences.putUChar("eH", p.schedule.endHour);
+  fl_preferences.putUChar("eM", p.schedule.endMinute);
+  fl_preferences.putUChar("days", p.schedule.days);
+  fl_preferences.end();
+  Serial.printf("%s schedule saved\n", tag);
+}
+
+void fl_pumpLoadCounters(fl_pump_t& p, const char* ns, const char* tag) {
+  fl_preferences.begin(ns, true);
+  fl_countersRestore(p.counters, fl_preferences.getULong("wh", 0), fl_preferences.getULong("run", 0),
+                     fl_preferences.getULong("starts", 0), fl_preferences.getULong("faults", 0), millis());
+  fl_preferences.end();
+  Serial.printf("%s counters: %.2f kWh, %.1f h, %lu starts, %lu faults\n", tag, p.counters.wh / 1000,
+                p.counters.runS / 3600.0, (unsigned long)p.counters.starts, (unsigned long)p.counters.faults);
+}
+
+void fl_pumpSaveCounters(fl_pump_t& p, const char* ns) {
+  fl_counters_t& c = p.counters;
+  if (!fl_countersDirty(c)) return;
+  fl_preferences.begin(ns, false);
+  if ((uint32_t)c.wh != c.savedWh) fl_preferences.putULong("wh", (uint32_t)c.wh);
+  if (c.runS != c.savedRunS) fl_preferences.putULong("run", c.runS);
+  if (c.starts != c.savedStarts) fl_preferences.putULong("starts", c.starts);
+  if (c.faults != c.savedFaults) fl_preferences.putULong("faults", c.faults);
+  fl_preferences.end();
+  fl_countersSaved(c, millis());
+}
+
+/* ================= COMMANDS ================= */
+
+// Schema booleans may be 0/1, which '|' would pass over
+static bool argBool(JsonObjectConst args, const char* key, bool current) {
+  JsonVariantConst v = args[key];
+  return v.isNull() ? current : v.as<bool>();
+}
+
+void fl_pumpApplyThresholds(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag) {
+  p.maxCurrentThreshold = args["max_current"] | p.maxCurrentThreshold;
+  p.dryCurrentThreshold = args["dry_current"] | p.dryCurrentThreshold;
+  if (threePhase) {
+    p.maxImbalancePct = args["max_imbalance"] | p.maxImbalancePct;
+    p.underVoltage = args["under_voltage"] | p.underVoltage;
+    p.overVoltage = args["over_voltage"] | p.overVoltage;
+    Serial.printf("%s: Thresholds updated max=%.1fA dry=%.1fA unbalance=%.1f%% V=%.0f-%.0f\n",
+                  tag, p.maxCurrentThreshold, p.dryCurrentThreshold, p.maxImbalancePct,
+                  p.underVoltage, p.overVoltage);
+  } else {
+    Serial.printf("%s: Thresholds updated max=%.1fA dry=%.1fA\n",
+                  tag, p.maxCurrentThreshold, p.dryCurrentThreshold);
+  }
+}
+
+void fl_pumpApplyProtection(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag) {
+  p.overcurrentEnabled = argBool(args, "overcurrent_enabled", p.overcurrentEnabled);
+  p.dryRunEnabled = argBool(args, "dryrun_enabled", p.dryRunEnabled);
+  if (threePhase) {
+    p.imbalanceEnabled = argBool(args, "imbalance_enabled", p.imbalanceEnabled);
+    p.phaseLossEnabled = argBool(args, "phase_loss_enabled", p.phaseLossEnabled);
+    p.voltageEnabled = argBool(args, "voltage_enabled", p.voltageEnabled);
+  }
+  Serial.printf("%s: Protection updated\n", tag);
+}
+
+void fl_pumpApplyDelays(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag) {
+  p.overcurrentDelayS = args["overcurrent_delay_s"] | p.overcurrentDelayS;
+  p.dryrunDelayS = args["dryrun_delay_s"] | p.dryrunDelayS;
+  if (threePhase) {
+    p.imbalanceDelayS = args["imbalance_delay_s"] | p.imbalanceDelayS;
+    p.phaseLossDelayS = args["phase_loss_delay_s"] | p.phaseLossDelayS;
+    p.voltageDelayS = args["voltage_delay_s"] | p.voltageDelayS;
+  }
+  Serial.printf("%s: Delays updated oc=%lus dr=%lus\n", tag, p.overcurrentDelayS, p.dryrunDelayS);
+}
+
+const char* fl_pumpApplyThermal(fl_pump_t& p, JsonObjectConst args, const char* tag) {
+  fl_thermal_mode_t mode = p.thermalMode;
+  if (args.containsKey("mode")) {
+    mode = fl_thermalModeFromString(args["mode"] | "");
+    if (mode >= FL_THERMAL_MODE_COUNT) return "unknown mode";
+  }
+  float pickup = args["pickup"] | p.thermalPickup;
+  if (mode != p.thermalMode || pickup != p.thermalPickup) fl_protectionThermalReset(p.prot);
+  p.thermalMode = mode;
+  p.thermalPickup = pickup;
+  p.thermalTms = args["tms"] | p.thermalTms;
+  p.thermalTauHeatS = args["tau_heat_s"] | p.thermalTauHeatS;
+  p.thermalTauCoolS = args["tau_cool_s"] | p.thermalTauCoolS;
+  Serial.printf("%s: Thermal updated mode=%s pickup=%.1fA\n",
+                tag, fl_thermalModeToString(p.thermalMode), p.thermalPickup);
+  return nullptr;
+}
+
+void fl_pumpApplySchedule(fl_pump_t& p, JsonObjectConst args) {
+  p.schedule.enabled = argBool(args, "enabled", p.schedule.enabled);
+  p.schedule.startHour = args["start_hour"] | p.schedule.startHour;
+  p.schedule.startMinute = args["start_minute"] | p.schedule.startMinute;
+  p.schedule.endHour = args["end_hour"] | p.schedule.endHour;
+  p.schedule.endMinute = args["end_minute"] | p.schedule.endMinute;
+  p.schedule.days = args["days"] | p.schedule.days;
+}
+
+/* ================= JSON ================= */
+
+void fl_pumpProtectionJson(JsonObject o, const fl_pump_t& p, bool threePhase) {
+  o["overcurrent_enabled"] = p.overcurrentEnabled;
+  o["dryrun_enabled"] = p.dryRunEnabled;
+  o["max_current"] = p.maxCurrentThreshold;
+  o["dry_current"] = p.dryCurrentThreshold;
+  o["overcurrent_delay_s"] = p.overcurrentDelayS;
+  o["dryrun_delay_s"] = p.dryrunDelayS;
+  o["thermal_mode"] = fl_thermalModeToString(p.thermalMode);
+  o["thermal_pickup"] = p.thermalPickup;
+  o["thermal_tms"] = p.thermalTms;
+  o["tau_heat_s"] = p.thermalTauHeatS;
+  o["tau_cool_s"] = p.thermalTauCoolS;
+  o["thermal_pct"] = round(fl_protectionThermalPercent(p.prot));
+  if (threePhase) {
+    o["imbalance_enabled"] = p.imbalanceEnabled;
+    o["max_imbalance"] = p.maxImbalancePct;
+    o["imbalance_delay_s"] = p.imbalanceDelayS;
+    o["phase_loss_enabled"] = p.phaseLossEnabled;
+    o["phase_loss_delay_s"] = p.phaseLossDelayS;
+    o["voltage_enabled"] = p.voltageEnabled;
+    o["under_voltage"] = p.underVoltage;
+    o["over_voltage"] = p.overVoltage;
+    o["voltage_delay_s"] = p.voltageDelayS;
+  }
+}
+
+void fl_pumpSettingsJson(JsonObject o, const fl_pump_t& p, bool threePhase) {
+  o["overcurrent_enabled"] = p.overcurrentEnabled;
+  o["dryrun_enabled"] = p.dryRunEnabled;
+  o["max_current"] = p.maxCurrentThreshold;
+  o["dry_current"] = p.dryCurrentThreshold;
+  o["overcurrent_delay_s"] = p.overcurrentDelayS;
+  o["dryrun_delay_s"] = p.dryrunDelayS;
+  if (threePhase) {
+    o["imbalance_enabled"] = p.imbalanceEnabled;
+    o["max_imbalance"] = p.maxImbalancePct;
+    o["imbalance_delay_s"] = p.imbalanceDelayS;
+    o["phase_loss_enabled"] = p.phaseLossEnabled;
+    o["phase_loss_delay_s"] = p.phaseLossDelayS;
+    o["voltage_enabled"] = p.voltageEnabled;
+    o["under_voltage"] = p.underVoltage;
+    o["over_voltage"] = p.overVoltage;
+    o["voltage_delay_s"] = p.voltageDelayS;
+  }
+  o["th_mode"] = fl_thermalModeToString(p.thermalMode);
+  o["th_pick"] = p.thermalPickup;
+  o["th_tms"] = p.thermalTms;
+  o["th_tauh"] = p.thermalTauHeatS;
+  o["th_tauc"] = p.thermalTauCoolS;
+  o["sch_en"] = p.schedule.enabled;
+  o["sch_sH"] = p.schedule.startHour;
+  o["sch_sM"] = p.schedule.startMinute;
+  o["sch_eH"] = p.schedule.endHour;
+  o["sch_eM"] = p.schedule.endMinute;
+  o["sch_days"] = p.schedule.days;
+  o["kwh"] = fl_countersCentiKwh(p.counters) / 100.0;
+  o["run_h"] = fl_countersCentiHours(p.counters) / 100.0;
+  o["starts"] = p.counters.starts;
+  o["faults"] = p.counters.faults;
+}
+
+void fl_pumpScheduleJson(JsonObject o, const fl_pump_t& p) {
+  o["enabled"] = p.schedule.enabled;
+  o["start_hour"] = p.schedule.startHour;
+  o["start_minute"] = p.schedule.startMinute;
+  o["end_hour"] = p.schedule.endHour;
+  o["end_minute"] = p.schedule.endMinute;
+  o["days"] = p.schedule.days;
+  if (p.scheduleNextChange) o["next_change"] = (uint32_t)p.scheduleNextChange;
+}
+
+/* ================= INRUSH ================= */
+
+void fl_publishInrushSummary(const fl_inrush_t& c, uint8_t pumpId, const char* tag) {
+  const fl_inrush_summary_t& s = c.summary;
+  Serial.printf("%s inrush: peak %.1fA @%ums, steady after %ums, settled %.2fA (%u samples%s)\n",
+                tag, s.peakA, s.peakMs, s.steadyMs, s.settledA, s.samples, s.aborted ? ", aborted" : "");
+
+  if (!fl_mqttConnected) return;
+  StaticJsonDocument<256> doc;
+  doc["type"] = "inrush";
+  if (pumpId) doc["pump"] = pumpId;
+  doc["peak"] = round(s.peakA * 10) / 10.0;
+  doc["peak_ms"] = s.peakMs;
+  doc["steady_ms"] = s.steadyMs;
+  doc["settled"] = round(s.settledA * 100) / 100.0;
+  doc["n"] = s.samples;
+  doc["window_ms"] = c.windowMs;
+  if (s.aborted) doc["aborted"] = true;
+  char buf[256];
+  size_t len = serializeJson(doc, buf);
+  fl_publish(fl_TOPIC_TELEMETRY, buf, len, FL_PUB_SETTINGS);
+}
+
+/* ================= HISTORY ================= */
+
+void fl_historyStreamBegin(fl_history_stream_t& s, uint8_t pumpId, uint32_t from, uint32_t to, uint32_t step) {
+  fl_historyQueryBegin(fl_history, s.q, pumpId ? pumpId - 1 : 0, from, to, step);
+  s.pumpId = pumpId;
+  s.part = 0;
+  s.first = true;
+  s.len = s.pos = 0;
+}
+
+size_t fl_historyStreamFill(fl_history_stream_t& s, uint8_t* buf, size_t maxLen) {
+  size_t out = 0;
+  while (out < maxLen) {
+    if (s.pos == s.len) {
+      s.pos = s.len = 0;
+      if (s.part == 0) {
+        char pump[16] = "";
+        if (s.pumpId) snprintf(pump, sizeof(pump), "\"pump\":%u,", s.pumpId);
+        s.len = snprintf(s.line, sizeof(s.line), "{%s\"from\":%lu,\"to\":%lu,\"step\":%lu,\"oldest\":%lu,\"points\":[",
+                         pump, (unsigned long)s.q.from, (unsigned long)s.q.to, (unsigned long)s.q.step,
+                         (unsigned long)fl_historyOldest(fl_history, s.q.series));
+        s.part = 1;
+      } else if (s.part == 1) {
+        fl_history_row_t r;
+        if (!fl_historyQueryNext(fl_history, s.q, r)) {
+          s.part = 2;
+          continue;
+        }
+        // One object per bucket; NaN (no reading) prints as null
+        char* row = s.line;
+        if (!s.first) *row++ = ',';
+        s.first = false;
+        fl_jsonw_t w;
+        fl_jsonwBegin(w, row, sizeof(s.line) - (row - s.line));
+        fl_jsonwUInt(w, "ts", r.ts);
+        fl_jsonwFixed(w, "v", r.v, 1);
+        fl_jsonwFixed(w, "i", r.i, 2);
+        fl_jsonwFixed(w, "i_max", r.iMax, 2);
+        fl_jsonwStr(w, "state", fl_motorStateToString((fl_motor_state_t)r.state));
+        fl_jsonwUInt(w, "n", r.n);
+        s.len = (row - s.line) + fl_jsonwEnd(w);
+      } else if (s.part == 2) {
+        s.len = snprintf(s.line, sizeof(s.line), "]}");
+        s.part = 3;
+      } else {
+        break;
+      }
+    }
+    size_t n = s.len - s.pos;
+    if (n > maxLen - out) n = maxLen - out;
+    memcpy(buf + out, s.line + s.pos, n);
+    s.pos += n;
+    out += n;
+  }
+  return out;
+}
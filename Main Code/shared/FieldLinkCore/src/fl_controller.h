@@ -0,0 +1,1699 @@
+#ifndef FL_CONTROLLER_H
+#define FL_CONTROLLER_H
+
+// Pump controller shared by the product firmwares.
+// fl_controller_t<N, Meter, Io> runs N pumps off one energy meter: protection,
+// schedule/TOU tariff, contactor outputs and feedback, inrush capture, NVS
+// settings, MQTT/serial commands and the JSON API. The layout — which meter
+// phase feeds which pump, the DO/DI channels, and the telemetry and NVS key
+// names — is fixed at compile time, so the per-sample path carries no layout
+// branches and no key formatting. A product supplies its maps, dashboard and
+// setup()/loop() glue.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "fl_board.h"
+#include "fl_clock.h"
+#include "fl_modbus.h"
+#include "fl_seqlock.h"
+#include "fl_meter.h"
+#include "fl_inrush.h"
+#include "fl_jsonw.h"
+#include "fl_agg.h"
+#include "fl_telembin.h"
+#include "fl_keys.h"
+#include "fl_telemetry.h"
+#include "fl_report.h"
+#include "fl_history.h"
+#include "fl_counters.h"
+#include "fl_protection.h"
+#include "fl_tariff.h"
+#include "fl_schedule.h"
+#include "fl_storage.h"
+#include "fl_comms.h"
+#include "fl_web.h"
+#include "fl_telegram.h"
+
+/* ================= METER AND IO MAPS ================= */
+
+// One pump per meter phase. Phase[i] is pump i+1's phase, 0..2 = L1..L3.
+template <uint8_t... Phase>
+struct fl_meter_per_phase {
+  static constexpr bool threePhase = false;
+  static constexpr uint8_t phase[sizeof...(Phase)] = { Phase... };
+};
+
+// One 3-phase motor on all three CTs
+struct fl_meter_three_phase {
+  static constexpr bool threePhase = true;
+};
+
+// An IoMap is a struct with three arrays of N channels:
+//   static constexpr uint8_t contactor[]   — DO driving the pump contactor
+//   static constexpr uint8_t faultAlarm[]  — DO lit while the pump is faulted
+//   static constexpr uint8_t feedbackBit[] — fl_diStatus bit of the auxiliary contact
+// DOs not named there are held off.
+
+/* ================= PUMP ================= */
+
+struct fl_pump_t {
+  uint8_t id;                  // 1..N (logs, Telegram)
+
+  // State machine
+  fl_motor_state_t state;
+  fl_fault_t faultType;
+  bool startCommand;
+  unsigned long startCommandTime;
+  bool contactorConfirmed;
+  bool lastDOState;
+  unsigned long contactorCloseTime;
+
+  // Energy, run time, starts and faults (NVS-checkpointed)
+  fl_counters_t counters;
+
+  // Fault tracking
+  unsigned long faultTimestamp;
+  float faultCurrent;
+
+  // Protection thresholds (NVS-stored)
+  float maxCurrentThreshold;   // Worst phase on a 3-phase motor
+  float dryCurrentThreshold;   // Average of the phases on a 3-phase motor
+  bool overcurrentEnabled;
+  bool dryRunEnabled;
+  uint32_t overcurrentDelayS;
+  uint32_t dryrunDelayS;
+
+  // Inverse-time overload (NVS-stored, off until a pickup is set)
+  fl_thermal_mode_t thermalMode;
+  float thermalPickup;         // A — motor full-load current
+  float thermalTms;            // IDMT time multiplier
+  uint16_t thermalTauHeatS;
+  uint16_t thermalTauCoolS;
+
+  // 3-phase checks (NVS-stored, 3-phase meter map only)
+  bool imbalanceEnabled;
+  float maxImbalancePct;
+  uint32_t imbalanceDelayS;
+  bool phaseLossEnabled;
+  uint32_t phaseLossDelayS;
+  bool voltageEnabled;
+  float underVoltage;
+  float overVoltage;
+  uint32_t voltageDelayS;
+
+  // Protection engine state (pickup timers, debounce)
+  fl_protection_t prot;
+
+  // Schedule (NVS-stored)
+  fl_schedule_t schedule;
+  bool wasWithinSchedule;
+  time_t scheduleNextChange;   // Epoch second of the next window edge, 0 = none pending
+};
+
+// Timing and defaults. Members may be changed before begin().
+struct fl_controller_config_t {
+  uint32_t sensorBoostMs = 5000;      // Fast sampling after a contactor close or command
+
+  // State detection
+  float runThreshold = 5.0;           // A
+  float hysteresis = 1.0;
+  uint8_t debounceCount = 3;
+
+  // Protection
+  uint32_t startTimeoutMs = 10000;
+  uint32_t inrushBlankMs = 1000;      // Overcurrent ignored this long after contactor close
+  uint32_t faultAutoResetMs = 0;      // 0 = manual reset only
+
+  // Inverse-time overload defaults
+  float thermalTms = 1.0;
+  uint16_t tauHeatS = 600;            // Typical small/medium TEFC motor
+  uint16_t tauCoolS = 1800;           // Standstill cooling is ~3x slower
+
+  // 3-phase defaults
+  float phaseLossFraction = 0.10;     // Phase lost below 10% of the highest phase current
+  float maxImbalancePct = 10.0;
+  uint32_t imbalanceDelayS = 5;
+  uint32_t phaseLossDelayS = 2;
+  float underVoltage = 207.0;         // 230V -10%
+  float overVoltage = 253.0;          // 230V +10%
+  uint32_t voltageDelayS = 5;
+
+  // Journal replay after a reconnect: one record per interval
+  uint32_t journalDrainMs = 200;
+
+  // One history point per pump per interval (fl_history.h)
+  uint16_t historyStepS = FL_HISTORY_DEFAULT_STEP_S;
+};
+
+// Layout-independent pump helpers (fl_controller.cpp). 'tag' prefixes log
+// lines ("Pump 2", or "Pump" on a single-motor controller).
+void fl_pumpInit(fl_pump_t& p, uint8_t id, const fl_controller_config_t& cfg);
+fl_protection_config_t fl_pumpProtectionConfig(const fl_pump_t& p, const fl_controller_config_t& cfg);
+void fl_pumpLoadProtection(fl_pump_t& p, const char* ns, const char* tag, bool threePhase,
+                           const fl_controller_config_t& cfg);
+void fl_pumpSaveProtection(const fl_pump_t& p, const char* ns, const char* tag, bool threePhase);
+void fl_pumpLoadSchedule(fl_pump_t& p, const char* ns, const char* tag);
+void fl_pumpSaveSchedule(const fl_pump_t& p, const char* ns, const char* tag);
+void fl_pumpLoadCounters(fl_pump_t& p, const char* ns, const char* tag);
+// Checkpoint, skipped when nothing changed
+void fl_pumpSaveCounters(fl_pump_t& p, const char* ns);
+
+// SET_THRESHOLDS / SET_PROTECTION / SET_DELAYS / SET_THERMAL / SET_SCHEDULE
+// fields on one pump, already checked against the command's schema; absent
+// fields are left alone. The caller saves.
+void fl_pumpApplyThresholds(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag);
+void fl_pumpApplyProtection(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag);
+void fl_pumpApplyDelays(fl_pump_t& p, JsonObjectConst args, bool threePhase, const char* tag);
+// nullptr, or why nothing was applied
+const char* fl_pumpApplyThermal(fl_pump_t& p, JsonObjectConst args, const char* tag);
+void fl_pumpApplySchedule(fl_pump_t& p, JsonObjectConst args);
+
+// Fill one pump's fields: /api/protection names, GET_SETTINGS short names, /api/schedule
+void fl_pumpProtectionJson(JsonObject o, const fl_pump_t& p, bool threePhase);
+void fl_pumpSettingsJson(JsonObject o, const fl_pump_t& p, bool threePhase);
+void fl_pumpScheduleJson(JsonObject o, const fl_pump_t& p);
+
+// pumpId 0 = leave the "pump" field out (single motor)
+void fl_publishInrushSummary(const fl_inrush_t& c, uint8_t pumpId, const char* tag);
+
+// /api/history body, produced a chunk at a time as the web server asks for
+// it, so a day of points never sits in RAM. pumpId 0 = leave "pump" out.
+struct fl_history_stream_t {
+  fl_history_query_t q;
+  uint8_t pumpId;
+  uint8_t part;                // Header, rows, footer, done
+  bool first;
+  char line[128];
+  uint16_t len, pos;
+};
+
+void fl_historyStreamBegin(fl_history_stream_t& s, uint8_t pumpId, uint32_t from, uint32_t to, uint32_t step);
+// Fills up to maxLen bytes; 0 at the end of the body
+size_t fl_historyStreamFill(fl_history_stream_t& s, uint8_t* buf, size_t maxLen);
+
+/* ================= CONTROLLER ================= */
+
+template <uint8_t N, class Meter, class Io>
+class fl_controller_t {
+public:
+  static_assert(N >= 1 && N <= 8, "One to eight pumps");
+  static_assert(!Meter::threePhase || N == 1, "A 3-phase meter map drives a single motor");
+  static_assert(sizeof(Io::contactor) == N && sizeof(Io::faultAlarm) == N && sizeof(Io::feedbackBit) == N,
+                "IoMap needs one channel per pump");
+
+  static constexpr bool kThreePhase = Meter::threePhase;
+  static constexpr uint8_t kPhases = kThreePhase ? 3 : N;   // Metered V/I channels
+
+  // DOs not used by any pump, forced off every pass (active low: 1 = off)
+  static constexpr uint8_t unusedDoMask() {
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < N; i++) used |= (1 << Io::contactor[i]) | (1 << Io::faultAlarm[i]);
+    return (uint8_t)~used;
+  }
+  static constexpr uint8_t kUnusedDo = unusedDoMask();
+
+  // Telemetry frame and its encodings (fl_telemetry.h), which own the
+  // telemetry key names
+  using Telemetry = fl_telemetry_t<N, kThreePhase>;
+
+  // Settings and NVS names
+  using KeyP    = fl_key_table<N, 'p'>;
+  using KeyProt = fl_key_table<N, 'p', 'r', 'o', 't', '_', 'p'>;
+  using KeySch  = fl_key_table<N, 's', 'c', 'h', 'e', 'd', '_', 'p'>;
+  using KeyCnt  = fl_key_table<N, 'c', 'n', 't', '_', 'p'>;
+  using KeyTag  = std::conditional_t<N == 1, fl_key_bare<'P', 'u', 'm', 'p'>,
+                                     fl_key_table<N, 'P', 'u', 'm', 'p', ' '>>;
+
+  // Window aggregates: "V1min", "IL2rms"
+  using ChanV   = typename Telemetry::ChanV;
+  using ChanI   = typename Telemetry::ChanI;
+  using SfxMin  = fl_chars<'m', 'i', 'n'>;
+  using SfxMax  = typename Telemetry::SfxMax;
+  using SfxAvg  = fl_chars<'a', 'v', 'g'>;
+  using SfxRms  = fl_chars<'r', 'm', 's'>;
+  using KeyVmin = fl_key_table_sfx<kPhases, ChanV, SfxMin>;
+  using KeyVmax = fl_key_table_sfx<kPhases, ChanV, SfxMax>;
+  using KeyVavg = fl_key_table_sfx<kPhases, ChanV, SfxAvg>;
+  using KeyVrms = fl_key_table_sfx<kPhases, ChanV, SfxRms>;
+  using KeyImin = fl_key_table_sfx<kPhases, ChanI, SfxMin>;
+  using KeyImax = typename Telemetry::KeyImax;
+  using KeyIavg = fl_key_table_sfx<kPhases, ChanI, SfxAvg>;
+  using KeyIrms = fl_key_table_sfx<kPhases, ChanI, SfxRms>;
+
+  fl_pump_t pumps[N];
+  fl_controller_config_t config;
+
+  // Each pump as of the last loop pass, for the web handlers (AsyncTCP).
+  // They read only these copies and tariffShared, never pumps[] or tariff.
+  fl_seqlock<fl_pump_t> pumpShared[N];
+
+  // Latest meter snapshot, copied once per control pass so the state machine,
+  // telemetry and serial status all see one consistent set of phases
+  fl_sensor_snapshot_t sensors = {};
+  fl_phase_metrics_t phases = {};     // 3-phase map only
+
+  // TOU tariff — overrides every pump schedule while enabled. The enable
+  // flag keeps its Ruraflex name (NVS "ruraflex", SET_RURAFLEX); the tariff
+  // itself is data (NVS "tariff", SET_TARIFF), Ruraflex 2025/26 by default.
+  bool ruraflexEnabled = false;
+  fl_tariff_t tariff;
+  fl_tariff_map_t tariffMap;
+  // Republished whenever SET_TARIFF or a load replaces it
+  fl_seqlock<fl_tariff_t> tariffShared;
+
+  // Inrush capture window after each contactor close (NVS "inrush")
+  uint16_t inrushWindowMs = FL_INRUSH_DEFAULT_WINDOW;
+  // Current trace of each pump's latest start, and its copy for /api/inrush,
+  // republished by the loop whenever it changes so the web task never reads
+  // a trace mid-update
+  fl_inrush_t inrush[N] = {};
+  fl_seqlock<fl_inrush_t> inrushShared[N];
+
+  // Set by the STATUS command; reportTelemetry() clears it
+  volatile bool telemetryRequested = false;
+
+  // Telemetry as JSON, compact binary (fl_telembin.h) or both, and when to
+  // send it (fl_report.h). Both in NVS "telemetry".
+  fl_telemetry_format_t telemetryFormat = FL_TELEMETRY_JSON;
+  fl_report_t reporting;
+
+  // Long-window min/max/mean/RMS of every V and I sample, published on
+  // telemetry.stats every statsWindowS seconds (0 = off, NVS "telemetry")
+  uint16_t statsWindowS = FL_AGG_DEFAULT_WINDOW_S;
+
+  static const char* tag(uint8_t i) { return KeyTag::key[i]; }
+
+  float voltage(const fl_sensor_snapshot_t& s, uint8_t i) const {
+    static_assert(!kThreePhase, "Per-pump voltage needs a per-phase meter map");
+    return s.*kPhaseV[Meter::phase[i]];
+  }
+
+  // Protection current: the pump's phase, or the worst phase of a 3-phase motor
+  float current(const fl_sensor_snapshot_t& s, const fl_phase_metrics_t& m, uint8_t i) const {
+    if constexpr (kThreePhase) return m.maxI;
+    else return s.*kPhaseI[Meter::phase[i]];
+  }
+
+  void computePhases(const fl_sensor_snapshot_t& s, fl_phase_metrics_t& m) const {
+    const float v[3] = { s.Va, s.Vb, s.Vc };
+    const float i[3] = { s.Ia, s.Ib, s.Ic };
+    fl_phaseMetrics(v, i, config.phaseLossFraction, m);
+  }
+
+  /* ----- Lifecycle ----- */
+
+  // Defaults for every pump (before NVS is loaded), and the history store
+  void begin() {
+    for (uint8_t i = 0; i < N; i++) fl_pumpInit(pumps[i], i + 1, config);
+    fl_reportInit(reporting);
+    fl_initHistory(N);
+  }
+
+  // Load settings from NVS, then start any pump booting inside its window
+  void load() {
+    for (uint8_t i = 0; i < N; i++) fl_pumpLoadProtection(pumps[i], KeyProt::key[i], tag(i), kThreePhase, config);
+    for (uint8_t i = 0; i < N; i++) fl_pumpLoadSchedule(pumps[i], KeySch::key[i], tag(i));
+    for (uint8_t i = 0; i < N; i++) fl_pumpLoadCounters(pumps[i], KeyCnt::key[i], tag(i));
+    loadRuraflexConfig();
+    loadTariff();
+    loadInrushConfig();
+    loadTelemetryConfig();
+
+    fl_clockTick();  // Fresh clock for the boot-time window check
+    time_t now = fl_clock().epoch;
+    scheduleClockSteps = fl_clock().steps;
+    scheduleDirty = false;
+    for (uint8_t i = 0; i < N; i++) {
+      fl_pump_t& p = pumps[i];
+      fl_schedule_eval_t e = fl_scheduleEval(p.schedule, activeTariff(), now);
+      p.wasWithinSchedule = e.allowed;
+      p.scheduleNextChange = e.nextChange;
+      Serial.printf("%s schedule init: %s window\n", tag(i), p.wasWithinSchedule ? "within" : "outside");
+      if ((p.schedule.enabled || ruraflexEnabled) && p.wasWithinSchedule) {
+        p.startCommand = true;
+        Serial.printf("%s: Boot within allowed hours, starting\n", tag(i));
+      }
+    }
+    publishPumps();
+  }
+
+  // Everything after fl_tick() in loop(): contactor feedback, journal
+  // replay, and one control pass per new sensor snapshot
+  void tick() {
+    // Fresh subscribers after a reconnect need the binary static block and
+    // a full frame, whatever changed meanwhile
+    if (!fl_mqttConnected) {
+      binStaticDue = true;
+      reportResync = true;
+    }
+
+    // Contactor feedback
+    for (uint8_t i = 0; i < N; i++) {
+      bool diFeedback = (fl_diStatus & (1 << Io::feedbackBit[i])) != 0;
+      bool contactorOn = (fl_do_state & (1 << Io::contactor[i])) == 0;  // Active low
+      pumps[i].contactorConfirmed = contactorOn && diFeedback;
+    }
+
+    // Force unused DO off
+    fl_do_state |= kUnusedDo;
+    fl_writeDO();
+
+    // Schedule edges fire on their own second, independent of sampling
+    updateSchedule();
+
+    // Replay what was journaled while offline, once the live frame after
+    // the reconnect has gone out
+    if (fl_journal.pending && fl_mqttConnected && !reportResync &&
+        millis() - lastDrainMs >= config.journalDrainMs) {
+      lastDrainMs = millis();
+      drainJournal();
+    }
+
+    // Long-window stats roll over on time, whether or not they can be sent
+    if (statsWindowS && millis() - statsStartMs >= (uint32_t)statsWindowS * 1000) {
+      if (fl_mqttConnected) publishStats();
+      resetStats();
+    }
+
+    if (millis() - historyStartMs >= (uint32_t)config.historyStepS * 1000) {
+      historyStartMs = millis();
+      recordHistory();
+    }
+
+    // Run time, and a counters checkpoint once enough has accrued
+    for (uint8_t i = 0; i < N; i++) {
+      fl_pump_t& p = pumps[i];
+      fl_countersRun(p.counters, millis(), p.state == FL_MOTOR_RUNNING);
+      if (fl_countersSaveDue(p.counters, millis())) fl_pumpSaveCounters(p, KeyCnt::key[i]);
+    }
+
+    // State machine on every new sensor snapshot. Acquisition runs in its
+    // own task; we only consume complete snapshots.
+    fl_sensor_snapshot_t snap;
+    if (!fl_getSensorSnapshot(snap) || snap.seq == lastSensorSeq) {
+      publishPumps();
+      return;
+    }
+    lastSensorSeq = snap.seq;
+    sensors = snap;
+    if constexpr (kThreePhase) computePhases(sensors, phases);
+    if (sensors.online) foldSamples();
+    meterEnergy();
+
+    for (uint8_t i = 0; i < N; i++) step(i);
+    for (uint8_t i = 0; i < N; i++) updateOutputs(i);
+
+    // Feed running inrush captures; publish the summary when one completes
+    for (uint8_t i = 0; i < N; i++) {
+      fl_inrush_t& c = inrush[i];
+      if (!fl_inrushCapturing(c)) continue;
+      bool done = pumps[i].lastDOState ? fl_inrushAddSample(c, sensors.timestampMs, current(sensors, phases, i))
+                                       : fl_inrushAbort(c);
+      inrushShared[i].write(c);
+      if (done) fl_publishInrushSummary(c, N == 1 ? 0 : pumps[i].id, tag(i));
+    }
+
+    updateSensorRate();
+    publishPumps();
+  }
+
+  /* ----- Commands ----- */
+
+  void start(uint8_t i, const char* verb) {
+    fl_pump_t& p = pumps[i];
+    if (p.state == FL_MOTOR_FAULT) {
+      Serial.printf("%s: Cannot start while in FAULT\n", tag(i));
+    } else {
+      p.startCommand = true;
+      p.startCommandTime = millis();
+      Serial.printf("%s: Start command %s\n", tag(i), verb);
+    }
+  }
+
+  void stop(uint8_t i) {
+    pumps[i].startCommand = false;
+    fl_setDO(Io::contactor[i], false);
+  }
+
+  void resetFault(uint8_t i) {
+    fl_pump_t& p = pumps[i];
+    if (p.state == FL_MOTOR_FAULT) {
+      Serial.printf("%s: Clearing fault: %s\n", tag(i), fl_faultToString(p.faultType));
+      p.state = FL_MOTOR_STOPPED;
+      p.faultType = FL_FAULT_NONE;
+      fl_protectionReset(p.prot);
+      p.startCommand = false;
+      fl_setDO(Io::faultAlarm[i], false);
+      Serial.printf("%s: Fault cleared. Ready to restart.\n", tag(i));
+    }
+  }
+
+  // JSON commands from MQTT or the web API, on the loop task
+  // (fl_processCommands via fl_runCommand). Per-pump commands carry
+  // "pump":1..N when N > 1. Start/stop/reset drive the contactor before
+  // returning, so the ack follows the relay.
+  fl_cmd_status_t handleCommand(fl_cmd_call_t& call) {
+    using Ctl = fl_controller_t;
+    static constexpr auto commands = fl_cmdTable<Ctl>({
+      // Stop all pumps for safety during the update (the library does the update)
+      { "UPDATE_FIRMWARE", {}, [](Ctl& s, fl_cmd_call_t&) {
+          for (uint8_t i = 0; i < N; i++) s.stop(i);
+          return true;
+        } },
+
+      { "START", { kPumpArg }, [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          if (s.pumps[i].state == FL_MOTOR_FAULT) {
+            c.error = "pump in fault";
+            return false;
+          }
+          s.start(i, "accepted");
+          s.updateOutputs(i);
+          return true;
+        } },
+
+      { "STOP", { kPumpArg }, [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          s.stop(i);
+          if (s.pumps[i].state != FL_MOTOR_FAULT) s.pumps[i].state = FL_MOTOR_STOPPED;
+          s.updateOutputs(i);
+          Serial.printf("%s: Stop command accepted\n", tag(i));
+          return true;
+        } },
+
+      { "RESET", { kPumpArg }, [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          s.resetFault(i);
+          s.updateOutputs(i);
+          return true;
+        } },
+
+      { "START_ALL", {}, [](Ctl& s, fl_cmd_call_t&) {
+          for (uint8_t i = 0; i < N; i++) {
+            if (s.pumps[i].state != FL_MOTOR_FAULT) {
+              s.pumps[i].startCommand = true;
+              s.pumps[i].startCommandTime = millis();
+            }
+            s.updateOutputs(i);
+          }
+          Serial.println("START_ALL accepted");
+          return true;
+        } },
+
+      { "STOP_ALL", {}, [](Ctl& s, fl_cmd_call_t&) {
+          for (uint8_t i = 0; i < N; i++) {
+            s.stop(i);
+            if (s.pumps[i].state != FL_MOTOR_FAULT) s.pumps[i].state = FL_MOTOR_STOPPED;
+            s.updateOutputs(i);
+          }
+          Serial.println("STOP_ALL accepted");
+          return true;
+        } },
+
+      { "RESET_ALL", {}, [](Ctl& s, fl_cmd_call_t&) {
+          for (uint8_t i = 0; i < N; i++) {
+            s.resetFault(i);
+            s.updateOutputs(i);
+          }
+          Serial.println("RESET_ALL accepted");
+          return true;
+        } },
+
+      // {"command":"SET_THRESHOLDS","max_current":32,"dry_current":2}
+      // 3-phase adds "max_imbalance", "under_voltage", "over_voltage"
+      { "SET_THRESHOLDS", { fl_argNum("max_current", 1, 500), fl_argNum("dry_current", 0, 50),
+                            fl_argNum("max_imbalance", 1, 50), fl_argNum("under_voltage", 0, 500),
+                            fl_argNum("over_voltage", 0, 500), kPumpArg },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          fl_pumpApplyThresholds(s.pumps[i], c.args, kThreePhase, tag(i));
+          fl_pumpSaveProtection(s.pumps[i], KeyProt::key[i], tag(i), kThreePhase);
+          return true;
+        } },
+
+      { "SET_PROTECTION", { fl_argBool("overcurrent_enabled"), fl_argBool("dryrun_enabled"),
+                            fl_argBool("imbalance_enabled"), fl_argBool("phase_loss_enabled"),
+                            fl_argBool("voltage_enabled"), kPumpArg },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          fl_pumpApplyProtection(s.pumps[i], c.args, kThreePhase, tag(i));
+          fl_pumpSaveProtection(s.pumps[i], KeyProt::key[i], tag(i), kThreePhase);
+          return true;
+        } },
+
+      { "SET_DELAYS", { fl_argInt("overcurrent_delay_s", 0, 30), fl_argInt("dryrun_delay_s", 0, 30),
+                        fl_argInt("imbalance_delay_s", 0, 30), fl_argInt("phase_loss_delay_s", 0, 30),
+                        fl_argInt("voltage_delay_s", 0, 30), kPumpArg },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          fl_pumpApplyDelays(s.pumps[i], c.args, kThreePhase, tag(i));
+          fl_pumpSaveProtection(s.pumps[i], KeyProt::key[i], tag(i), kThreePhase);
+          return true;
+        } },
+
+      // Inverse-time overload:
+      // {"command":"SET_THERMAL","mode":"off|thermal|idmt","pickup":22.5,
+      //  "tms":1.0,"tau_heat_s":600,"tau_cool_s":1800}
+      { "SET_THERMAL", { fl_argStr("mode"), fl_argNum("pickup", 0, 500), fl_argNum("tms", 0.05f, 10),
+                         fl_argInt("tau_heat_s", 10, 7200), fl_argInt("tau_cool_s", 10, 21600), kPumpArg },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          int i = s.pumpIndex(c.args);
+          c.error = fl_pumpApplyThermal(s.pumps[i], c.args, tag(i));
+          if (c.error) return false;
+          fl_pumpSaveProtection(s.pumps[i], KeyProt::key[i], tag(i), kThreePhase);
+          return true;
+        } },
+
+      // Schedule: optional "pump" with several pumps, omitted = all pumps
+      { "SET_SCHEDULE", { fl_argBool("enabled"), fl_argInt("start_hour", 0, 23), fl_argInt("start_minute", 0, 59),
+                          fl_argInt("end_hour", 0, 23), fl_argInt("end_minute", 0, 59), fl_argInt("days", 0, 0x7F),
+                          kPumpOptArg },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          int only = N > 1 && c.args.containsKey("pump") ? s.pumpIndex(c.args) : -1;
+          for (uint8_t i = 0; i < N; i++) {
+            if (only >= 0 && i != only) continue;
+            fl_pumpApplySchedule(s.pumps[i], c.args);
+            fl_pumpSaveSchedule(s.pumps[i], KeySch::key[i], tag(i));
+          }
+          s.scheduleDirty = true;
+          Serial.println("Schedule updated via MQTT");
+          return true;
+        } },
+
+      { "SET_RURAFLEX", { fl_argBool("enabled") }, [](Ctl& s, fl_cmd_call_t& c) {
+          if (c.args.containsKey("enabled"))
+            s.ruraflexEnabled = c.args["enabled"];
+          s.saveRuraflexConfig();
+          s.scheduleDirty = true;
+          Serial.println("Ruraflex updated via MQTT");
+          return true;
+        } },
+
+      // Tariff definition (see fl_tariff.h), or {"command":"SET_TARIFF","default":true}
+      { "SET_TARIFF", { fl_argBool("default"), fl_argStr("name"), fl_argArr("seasons"), fl_argArr("holidays") },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          if (c.args["default"].as<bool>()) {
+            fl_tariffErase(fl_preferences);
+            s.loadTariff();
+            return true;
+          }
+          static fl_tariff_t parsed;
+          c.error = fl_tariffFromJson(c.args, parsed);
+          if (c.error) return false;
+          s.tariff = parsed;
+          fl_tariffCompile(s.tariff, s.tariffMap);
+          s.tariffShared.write(s.tariff);
+          s.scheduleDirty = true;
+          fl_tariffSave(fl_preferences, s.tariff);
+          Serial.printf("Tariff '%s' saved (%u seasons)\n", s.tariff.name, s.tariff.seasonCount);
+          return true;
+        } },
+
+      // Inrush capture window: {"command":"SET_INRUSH","window_ms":5000}
+      { "SET_INRUSH", { fl_argInt("window_ms", FL_INRUSH_MIN_WINDOW, FL_INRUSH_MAX_WINDOW) },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          if (c.args.containsKey("window_ms")) s.inrushWindowMs = c.args["window_ms"];
+          s.saveInrushConfig();
+          return true;
+        } },
+
+      // Telemetry encoding: {"command":"SET_TELEMETRY","format":"json"|"binary"|"both"}
+      // Publish policy, any subset: {"command":"SET_TELEMETRY","mode":"exception"|"periodic",
+      //   "deadband_v":2.0,"deadband_i":0.2,"interval_ms":2000,"heartbeat_s":60,"stats_s":60}
+      { "SET_TELEMETRY", { fl_argStr("format"), fl_argStr("mode"),
+                           fl_argNum("deadband_v", 0, FL_REPORT_MAX_DEADBAND),
+                           fl_argNum("deadband_i", 0, FL_REPORT_MAX_DEADBAND),
+                           fl_argInt("interval_ms", FL_REPORT_MIN_INTERVAL_MS, FL_REPORT_MAX_INTERVAL_MS),
+                           fl_argInt("heartbeat_s", 1, FL_REPORT_MAX_HEARTBEAT_S),
+                           fl_argInt("stats_s", 0, FL_AGG_MAX_WINDOW_S) },
+        [](Ctl& s, fl_cmd_call_t& c) {
+          fl_telemetry_format_t f = FL_TELEMETRY_FORMAT_COUNT;
+          if (c.args.containsKey("format")) {
+            f = fl_telemetryFormatFromName(c.args["format"]);
+            if (f >= FL_TELEMETRY_FORMAT_COUNT) c.error = "unknown format";
+          }
+          if (!c.error) c.error = s.applyReportConfig(c.args);
+          if (c.error) return false;
+          if (f < FL_TELEMETRY_FORMAT_COUNT) {
+            s.telemetryFormat = f;
+            s.binStaticDue = true;
+          }
+          s.reportResync = true;
+          s.saveTelemetryConfig();
+          return true;
+        } },
+
+      // Energy meter model: {"command":"SET_METER","model":"SDM630"|"ADL400"|"GENERIC"}
+      { "SET_METER", { fl_argStr("model", true) }, [](Ctl&, fl_cmd_call_t& c) {
+          fl_meter_model_t model = fl_meterModelFromName(c.args["model"]);
+          if (model >= FL_METER_MODEL_COUNT) {
+            c.error = "unknown model";
+            return false;
+          }
+          fl_setMeterModel(model);
+          return true;
+        } },
+
+      { "GET_SETTINGS", {}, [](Ctl& s, fl_cmd_call_t&) {
+          s.publishSettings();
+          // And a telemetry frame: with report-by-exception an idle device
+          // would otherwise stay quiet until its next heartbeat
+          s.telemetryRequested = true;
+          return true;
+        } },
+
+      { "STATUS", {}, [](Ctl& s, fl_cmd_call_t&) {
+          s.telemetryRequested = true;
+          return true;
+        } },
+    });
+
+    // Sample fast while the command takes effect
+    fl_boostSensorRate(config.sensorBoostMs);
+    return fl_cmdDispatch(commands, *this, call);
+  }
+
+  // START/STOP/FAULT_RESET, numbered 1..N with several pumps (START2)
+  void handleSerial(const String& input) {
+    if (input == "STATUS") {
+      printStatus();
+    }
+    else if (input == "HELP") {
+      if constexpr (N == 1) {
+        Serial.println("START        - Start motor");
+        Serial.println("STOP         - Stop motor");
+        Serial.println("FAULT_RESET  - Clear motor fault");
+        Serial.println("STATUS       - Show motor state and phases");
+      } else {
+        Serial.printf("START1..%u     - Start individual pump\n", N);
+        Serial.printf("STOP1..%u      - Stop individual pump\n", N);
+        Serial.printf("FAULT_RESET1..%u - Clear pump fault\n", N);
+        Serial.println("STARTALL     - Start all pumps");
+        Serial.println("STOPALL      - Stop all pumps");
+        Serial.println("RESETALL     - Reset all faults");
+        Serial.println("STATUS       - Show all pump states");
+      }
+    }
+    else if (N > 1 && input == "STARTALL") {
+      for (uint8_t i = 0; i < N; i++) {
+        if (pumps[i].state != FL_MOTOR_FAULT) {
+          pumps[i].startCommand = true;
+          pumps[i].startCommandTime = millis();
+        }
+      }
+      Serial.println("All pumps: Start command issued");
+    }
+    else if (N > 1 && input == "STOPALL") {
+      for (uint8_t i = 0; i < N; i++) stop(i);
+      Serial.println("All pumps: Stop command issued");
+    }
+    else if (N > 1 && input == "RESETALL") {
+      for (uint8_t i = 0; i < N; i++) resetFault(i);
+      Serial.println("All pump faults reset");
+    }
+    else {
+      int i;
+      if ((i = serialPump(input, "START")) >= 0) {
+        start(i, "issued");
+      } else if ((i = serialPump(input, "STOP")) >= 0) {
+        stop(i);
+        Serial.printf("%s: Stop command issued\n", tag(i));
+      } else if ((i = serialPump(input, "FAULT_RESET")) >= 0) {
+        resetFault(i);
+      }
+    }
+  }
+
+  /* ----- JSON ----- */
+
+  // Per-pump live fields shared by telemetry (pumps[]) and /api/status
+  // (the pumpShared copies)
+  void fillStatus(typename Telemetry::frame_t& f, const fl_pump_t (&ps)[N], const fl_sensor_snapshot_t& s,
+                  const fl_phase_metrics_t& m) const {
+    if constexpr (kThreePhase) {
+      f.V[0] = s.Va;
+      f.V[1] = s.Vb;
+      f.V[2] = s.Vc;
+      f.I[0] = s.Ia;
+      f.I[1] = s.Ib;
+      f.I[2] = s.Ic;
+      f.avgI = m.avgI;
+      f.imbalancePct = m.imbalancePct;
+    }
+    for (uint8_t i = 0; i < N; i++) {
+      const fl_pump_t& p = ps[i];
+      typename Telemetry::pump_t& o = f.pump[i];
+      if constexpr (!kThreePhase) {
+        f.V[i] = voltage(s, i);
+        f.I[i] = current(s, m, i);
+      }
+      o.state = p.state;
+      o.fault = p.faultType;
+      o.command = p.startCommand;
+      o.confirmed = p.contactorConfirmed;
+      o.thermal = p.thermalMode != FL_THERMAL_OFF;
+      o.thermalPct = fl_protectionThermalPercent(p.prot);
+    }
+  }
+
+  void encodeStatus(fl_jsonw_t& w, const fl_pump_t (&ps)[N], const fl_sensor_snapshot_t& s,
+                    const fl_phase_metrics_t& m, bool withThermal) const {
+    typename Telemetry::frame_t f = {};
+    fillStatus(f, ps, s, m);
+    Telemetry::encodeStatus(w, f, withThermal);
+  }
+
+  // The latest control pass, with the highest current of every sample since
+  // the previous frame
+  void fillTelemetry(typename Telemetry::frame_t& f, const char* hwType, const char* fwVersion) const {
+    fillStatus(f, pumps, sensors, phases);
+    for (uint8_t k = 0; k < kPhases; k++) f.Imax[k] = fl_aggMax(frameI[k]);
+    for (uint8_t i = 0; i < N; i++) {
+      const fl_counters_t& c = pumps[i].counters;
+      typename Telemetry::pump_t& o = f.pump[i];
+      o.centiKwh = fl_countersCentiKwh(c);
+      o.centiHours = fl_countersCentiHours(c);
+      o.starts = c.starts;
+      o.faults = c.faults;
+    }
+    const fl_clock_t& clock = fl_clock();
+    f.sensor = sensors.online;
+    f.ethernet = fl_useEthernet;
+    f.uptime = millis() / 1000;
+    f.di = fl_diStatus;
+    f.dout = fl_do_state;
+    f.hwType = hwType;
+    f.fwVersion = fwVersion;
+    f.clockValid = clock.valid;
+    f.hour = clock.local.tm_hour;
+    f.minute = clock.local.tm_min;
+    f.second = clock.local.tm_sec;
+    f.epoch = (uint32_t)clock.epoch;
+  }
+
+  // Aggregates over the stats window, one set per V and I channel
+  void encodeStats(fl_jsonw_t& w) const {
+    fl_jsonwUInt(w, "window_s", (millis() - statsStartMs) / 1000);
+    fl_jsonwUInt(w, "n", statsSamples);
+    for (uint8_t k = 0; k < kPhases; k++) {
+      fl_jsonwFixed(w, KeyVmin::key[k], fl_aggMin(statsV[k]), 1);
+      fl_jsonwFixed(w, KeyVmax::key[k], fl_aggMax(statsV[k]), 1);
+      fl_jsonwFixed(w, KeyVavg::key[k], fl_aggMean(statsV[k]), 1);
+      fl_jsonwFixed(w, KeyVrms::key[k], fl_aggRms(statsV[k]), 1);
+      fl_jsonwFixed(w, KeyImin::key[k], fl_aggMin(statsI[k]), 2);
+      fl_jsonwFixed(w, KeyImax::key[k], fl_aggMax(statsI[k]), 2);
+      fl_jsonwFixed(w, KeyIavg::key[k], fl_aggMean(statsI[k]), 2);
+      fl_jsonwFixed(w, KeyIrms::key[k], fl_aggRms(statsI[k]), 2);
+    }
+  }
+
+  // Telemetry when the publish policy calls for it: a state, fault, command,
+  // feedback, DI or DO change, a reading outside its deadband, the heartbeat,
+  // or a STATUS request. While MQTT is down the same frames go to the
+  // journal and are replayed on telemetry.replay after the reconnect. Call
+  // every loop pass.
+  void reportTelemetry(const char* hwType, const char* fwVersion) {
+    bool online = fl_mqttConnected;
+    if (!online && !fl_journal.ready) return;
+
+    reported_t now;
+    captureReported(now);
+    bool event = false;
+    bool drift = false;
+    compareReported(now, event, drift);
+
+    uint32_t ms = millis();
+    bool requested = online && (telemetryRequested || reportResync);
+    reporting.stretchMs = online ? fl_publishStretchMs() : 0;
+    fl_report_reason_t why = fl_reportDecide(reporting, ms, requested, event, drift);
+    if (why == FL_REPORT_NONE) return;
+    if (why == FL_REPORT_REQUEST) telemetryRequested = false;
+
+    bool ok = online ? publishTelemetry(hwType, fwVersion) : journalTelemetry(hwType, fwVersion);
+    fl_reportSent(reporting, ms, why, ok);
+    if (ok) {
+      reported = now;
+      if (online) reportResync = false;
+    }
+  }
+
+  // One telemetry frame in the configured format(s), onto the publish
+  // queue. Call while MQTT is up; the network task deals with send failures.
+  bool publishTelemetry(const char* hwType, const char* fwVersion) {
+    bool ok = true;
+    if (telemetryFormat != FL_TELEMETRY_BINARY) ok = publishJsonTelemetry(hwType, fwVersion) && ok;
+    if (telemetryFormat != FL_TELEMETRY_JSON) ok = publishBinaryTelemetry(hwType, fwVersion) && ok;
+
+    if (ok) {
+      for (uint8_t k = 0; k < kPhases; k++) fl_aggReset(frameI[k]);
+      return true;
+    }
+    Serial.println("Telemetry not queued (session down or publish queue full)");
+    return false;
+  }
+
+  void publishSettings() {
+    static StaticJsonDocument<2048> resp;
+    resp.clear();
+    resp["type"] = "settings";
+
+    if constexpr (N == 1) {
+      fl_pumpSettingsJson(resp.as<JsonObject>(), pumps[0], kThreePhase);
+    } else {
+      for (uint8_t i = 0; i < N; i++)
+        fl_pumpSettingsJson(resp.createNestedObject(KeyP::key[i]), pumps[i], kThreePhase);
+    }
+
+    resp["ruraflex_enabled"] = ruraflexEnabled;
+    resp["tariff"] = tariff.name;
+    resp["meter"] = fl_meterModelName(fl_getMeterModel());
+    resp["inrush_window_ms"] = inrushWindowMs;
+    resp["telemetry_format"] = fl_telemetryFormatName(telemetryFormat);
+
+    // Publish policy and its counters since boot
+    JsonObject rep = resp.createNestedObject("reporting");
+    rep["mode"] = reporting.cfg.exception ? "exception" : "periodic";
+    rep["deadband_v"] = reporting.cfg.deadbandV;
+    rep["deadband_i"] = reporting.cfg.deadbandI;
+    rep["interval_ms"] = reporting.cfg.intervalMs;
+    rep["heartbeat_s"] = reporting.cfg.heartbeatS;
+    rep["stats_s"] = statsWindowS;
+    rep["published"] = fl_reportPublishedTotal(reporting);
+    rep["events"] = reporting.published[FL_REPORT_EVENT];
+    rep["heartbeats"] = reporting.published[FL_REPORT_HEARTBEAT];
+    rep["suppressed"] = reporting.suppressed;
+
+    // Offline journal: backlog, flash wear and write amplification
+    if (fl_journal.ready) {
+      JsonObject jr = resp.createNestedObject("journal");
+      jr["pending"] = fl_journal.pending;
+      jr["appended"] = fl_journal.appended;
+      jr["replayed"] = fl_journal.replayed;
+      jr["dropped"] = fl_journal.dropped;
+      jr["erases"] = fl_journal.erases;
+      jr["erase_max"] = fl_journal.eraseMax;
+      jr["wa"] = round(fl_journalWriteAmplification(fl_journal) * 100) / 100.0;
+    }
+
+    const fl_clock_t& clock = fl_clock();
+    if (clock.valid) resp["current_time"] = clock.hms;
+    JsonObject ntp = resp.createNestedObject("clock");
+    ntp["sync"] = fl_clockSyncToString(clock.sync);
+    if (clock.syncs) {
+      ntp["age_s"] = clock.syncAgeS;
+      ntp["drift_ms"] = clock.driftMs;
+    }
+
+    static char buf[FL_MAX_PAYLOAD_SIZE];
+    size_t len = serializeJson(resp, buf);
+    bool ok = fl_publish(fl_TOPIC_TELEMETRY, buf, len, FL_PUB_SETTINGS);
+    Serial.printf("Settings published (%d bytes, %s)\n", len, ok ? "queued" : "FAILED");
+  }
+
+  // /api/status, /api/command, /api/inrush, /api/protection, /api/schedule,
+  // /api/history, /api/tariff
+  void setupWebRoutes() {
+    fl_server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      // Runs in the AsyncTCP task — take our own consistent snapshot
+      fl_sensor_snapshot_t snap = {};
+      fl_getSensorSnapshot(snap);
+      fl_phase_metrics_t m = {};
+      if constexpr (kThreePhase) computePhases(snap, m);
+      fl_pump_t ps[N];
+      readPumps(ps);
+      char buf[512];
+      fl_jsonw_t w;
+      fl_jsonwBegin(w, buf, sizeof(buf));
+      encodeStatus(w, ps, snap, m, false);
+      fl_jsonwBool(w, "sensor", snap.online);
+      fl_jsonwUInt(w, "uptime", millis() / 1000);
+      fl_jsonwStr(w, "network", fl_useEthernet ? "ETH" : "WiFi");
+      fl_jsonwEnd(w);
+      request->send(200, "application/json", buf);
+    });
+
+    // Commands (queued for the loop, then the same path as MQTT)
+    fl_server.on("/api/command", HTTP_POST, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      if (request->hasParam("cmd", true)) {
+        String cmd = request->getParam("cmd", true)->value();
+        if (fl_postCommand(FL_CMD_WEB, cmd.c_str(), cmd.length())) {
+          request->send(200, "text/plain", "OK");
+        } else {
+          request->send(503, "text/plain", "Command queue full");
+        }
+      } else {
+        request->send(400, "text/plain", "Missing cmd parameter");
+      }
+    });
+
+    // Latest start-current trace: /api/inrush (?pump=N with several pumps)
+    fl_server.on("/api/inrush", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      int pump = 1;
+      if (N > 1) {
+        pump = request->hasParam("pump") ? request->getParam("pump")->value().toInt() : 0;
+        if (pump < 1 || pump > N) {
+          request->send(400, "text/plain", "Invalid pump");
+          return;
+        }
+      }
+      // Consistent copy: a start during the download can't mix two traces
+      std::unique_ptr<fl_inrush_t> copy(new (std::nothrow) fl_inrush_t);
+      if (!copy) {
+        request->send(503, "text/plain", "Out of memory");
+        return;
+      }
+      const fl_inrush_t& c = *copy;
+      if (!inrushShared[pump - 1].read(*copy) || c.state == FL_INRUSH_IDLE) {
+        request->send(404, "text/plain", "No capture yet");
+        return;
+      }
+      // Streamed: a full trace is too big for a JSON document on the TCP task stack
+      const fl_inrush_summary_t& s = c.summary;
+      uint16_t n = c.count;
+      AsyncResponseStream* response = request->beginResponseStream("application/json");
+      if (N > 1) response->printf("{\"pump\":%d,", pump);
+      else response->print("{");
+      response->printf("\"complete\":%s,\"window_ms\":%u,\"start_uptime_ms\":%lu,",
+                       c.state == FL_INRUSH_DONE ? "true" : "false", c.windowMs, (unsigned long)c.startMs);
+      response->printf("\"peak\":%.1f,\"peak_ms\":%u,\"steady_ms\":%u,\"settled\":%.2f,\"samples\":[",
+                       s.peakA, s.peakMs, s.steadyMs, s.settledA);
+      for (uint16_t i = 0; i < n; i++) {
+        response->printf("%s[%u,%.2f]", i ? "," : "", c.samples[i].tMs, c.samples[i].centiAmps / 100.0);
+      }
+      response->print("]}");
+      request->send(response);
+    });
+
+    fl_server.on("/api/protection", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      fl_pump_t ps[N];
+      readPumps(ps);
+      StaticJsonDocument<1024> doc;
+      if constexpr (N == 1) {
+        fl_pumpProtectionJson(doc.to<JsonObject>(), ps[0], kThreePhase);
+      } else {
+        for (uint8_t i = 0; i < N; i++)
+          fl_pumpProtectionJson(doc.createNestedObject(KeyP::key[i]), ps[i], kThreePhase);
+      }
+      String response;
+      serializeJson(doc, response);
+      request->send(200, "application/json", response);
+    });
+
+    fl_server.on("/api/schedule", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      fl_pump_t ps[N];
+      readPumps(ps);
+      std::unique_ptr<fl_tariff_t> t(new (std::nothrow) fl_tariff_t);
+      if (!t) {
+        request->send(503, "text/plain", "Out of memory");
+        return;
+      }
+      tariffShared.read(*t);
+      StaticJsonDocument<512> doc;
+      if constexpr (N == 1) {
+        fl_pumpScheduleJson(doc.to<JsonObject>(), ps[0]);
+      } else {
+        for (uint8_t i = 0; i < N; i++)
+          fl_pumpScheduleJson(doc.createNestedObject(KeyP::key[i]), ps[i]);
+      }
+      doc["ruraflex_enabled"] = ruraflexEnabled;
+      doc["tariff"] = t->name;
+      fl_clock_t clock;
+      fl_clockRead(clock);
+      if (clock.valid) {
+        doc["current_time"] = clock.hms;
+        doc["current_day"] = clock.local.tm_wday;
+      }
+      String response;
+      serializeJson(doc, response);
+      request->send(200, "application/json", response);
+    });
+
+    // Trend data: /api/history?pump=&from=&to=&step= (epoch seconds).
+    // Defaults to the last 24 h in 60 s buckets; streamed in chunks.
+    fl_server.on("/api/history", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      int pump = 1;
+      if (N > 1) {
+        pump = request->hasParam("pump") ? request->getParam("pump")->value().toInt() : 0;
+        if (pump < 1 || pump > N) {
+          request->send(400, "text/plain", "Invalid pump");
+          return;
+        }
+      }
+      fl_clock_t clock;
+      fl_clockRead(clock);
+      uint32_t to = clock.valid ? (uint32_t)clock.epoch : UINT32_MAX;
+      if (request->hasParam("to")) to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+      uint32_t from = to > 86400 ? to - 86400 : 0;
+      if (request->hasParam("from")) from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+      uint32_t step = 60;
+      if (request->hasParam("step")) step = strtoul(request->getParam("step")->value().c_str(), nullptr, 10);
+      if (step < config.historyStepS) step = config.historyStepS;
+      if (from > to) {
+        request->send(400, "text/plain", "from is after to");
+        return;
+      }
+
+      // Owned by the filler; freed with the response
+      std::shared_ptr<fl_history_stream_t> s(new (std::nothrow) fl_history_stream_t);
+      if (!s) {
+        request->send(503, "text/plain", "Out of memory");
+        return;
+      }
+      fl_historyStreamBegin(*s, N == 1 ? 0 : pump, from, to, step);
+      request->send(request->beginChunkedResponse("application/json",
+        [s](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+          return fl_historyStreamFill(*s, buf, maxLen);
+        }));
+    });
+
+    fl_server.on("/api/tariff", HTTP_GET, [this](AsyncWebServerRequest *request){
+      if (!fl_checkAuth(request)) return;
+      // ~1 KB; on the heap rather than the TCP task stack
+      std::unique_ptr<fl_tariff_t> t(new (std::nothrow) fl_tariff_t);
+      if (!t) {
+        request->send(503, "text/plain", "Out of memory");
+        return;
+      }
+      tariffShared.read(*t);
+      DynamicJsonDocument doc(8192);  // Heap: four full seasons run ~8 KB of JSON nodes
+      fl_tariffToJson(doc.to<JsonObject>(), *t);
+      doc["enabled"] = ruraflexEnabled;
+      String response;
+      serializeJson(doc, response);
+      request->send(200, "application/json", response);
+    });
+  }
+
+private:
+  static constexpr float fl_sensor_snapshot_t::* kPhaseV[3] = {
+    &fl_sensor_snapshot_t::Va, &fl_sensor_snapshot_t::Vb, &fl_sensor_snapshot_t::Vc };
+  static constexpr float fl_sensor_snapshot_t::* kPhaseI[3] = {
+    &fl_sensor_snapshot_t::Ia, &fl_sensor_snapshot_t::Ib, &fl_sensor_snapshot_t::Ic };
+
+  static constexpr const char* kPhaseName[4] = { "none", "L1", "L2", "L3" };
+
+  uint32_t lastSensorSeq = 0;
+
+  // Set when a schedule input changes; the next tick re-evaluates every pump
+  // (as does a change in fl_clock().steps)
+  volatile bool scheduleDirty = true;
+  uint32_t scheduleClockSteps = 0;
+
+  // Binary telemetry: frame counter, and the static block is due (after a
+  // reconnect or format change)
+  uint16_t binFrame = 0;
+  bool binStaticDue = true;
+
+  // Report-by-exception: the fields as last published. Voltages and
+  // currents are compared against their deadbands, the rest exactly.
+  struct reported_t {
+    float v[kPhases];
+    float i[kPhases];
+    float th[N];                 // NaN while the thermal model is off
+    uint8_t pump[N][4];          // State, fault, command, contactor confirmed
+    uint8_t di;
+    uint8_t dout;
+    bool sensor;
+  };
+  reported_t reported = {};
+  bool reportResync = true;      // Next frame goes out regardless (boot, reconnect, new policy)
+
+  // Every sample folded in: current since the last telemetry frame, V and
+  // I since the stats window opened
+  fl_agg_t frameI[kPhases] = {};
+  fl_agg_t statsV[kPhases] = {};
+  fl_agg_t statsI[kPhases] = {};
+  uint32_t statsSamples = 0;
+  uint32_t statsStartMs = 0;
+
+  uint32_t lastDrainMs = 0;
+  // A journal record queued on the replay lane, acked once the lane's sent
+  // count moves past the mark
+  bool replayInFlight = false;
+  uint32_t replaySentMark = 0;
+
+  fl_agg_t historyV[N] = {};
+  fl_agg_t historyI[N] = {};
+  uint32_t historyStartMs = 0;
+
+  // Per-pump commands: "pump":1..N, required with several pumps, absent with one
+  static constexpr fl_cmd_arg_t kPumpArg = N > 1 ? fl_argInt("pump", 1, N, true) : fl_cmd_arg_t{};
+  static constexpr fl_cmd_arg_t kPumpOptArg = N > 1 ? fl_argInt("pump", 1, N) : fl_cmd_arg_t{};
+
+  // Commands, schedule edges and the control pass all run before this on
+  // the loop task, so the copies trail pumps[] by at most one pass
+  void publishPumps() {
+    for (uint8_t i = 0; i < N; i++) pumpShared[i].write(pumps[i]);
+  }
+
+  // The pumpShared copies, for a web handler: each pump consistent in itself
+  void readPumps(fl_pump_t (&out)[N]) const {
+    for (uint8_t i = 0; i < N; i++) pumpShared[i].read(out[i]);
+  }
+
+  // "pump" → index, checked by the schema. Always 0 for one pump.
+  int pumpIndex(JsonObjectConst args) const {
+    if constexpr (N == 1) {
+      return 0;
+    } else {
+      return (args["pump"] | 1) - 1;
+    }
+  }
+
+  // "START" (one pump) or "START1".."STARTN" → index, else -1
+  static int serialPump(const String& input, const char* verb) {
+    size_t len = strlen(verb);
+    if (!input.startsWith(verb)) return -1;
+    if (N == 1) return input.length() == len ? 0 : -1;
+    if (input.length() != len + 1) return -1;
+    int n = input.charAt(len) - '0';
+    return (n >= 1 && n <= N) ? n - 1 : -1;
+  }
+
+  void triggerFault(uint8_t i, fl_fault_t type) {
+    fl_pump_t& p = pumps[i];
+    if (p.state == FL_MOTOR_FAULT) return;
+    p.state = FL_MOTOR_FAULT;
+    p.faultType = type;
+    p.faultTimestamp = millis();
+    p.faultCurrent = current(sensors, phases, i);
+
+    p.startCommand = false;
+    fl_setDO(Io::contactor[i], false);
+    fl_setDO(Io::faultAlarm[i], true);
+
+    if constexpr (kThreePhase) {
+      Serial.printf("!!! %s FAULT: %s (I=%.2f/%.2f/%.2fA) !!!\n", tag(i), fl_faultToString(type),
+                    sensors.Ia, sensors.Ib, sensors.Ic);
+    } else {
+      Serial.printf("!!! %s FAULT: %s (I=%.2fA) !!!\n", tag(i), fl_faultToString(type), p.faultCurrent);
+    }
+
+    // Only send Telegram for protection faults — these mean a pump was
+    // running and something went wrong. SENSOR_FAULT is a system status
+    // (e.g. no meter at boot), not actionable.
+    if (type != FL_FAULT_SENSOR) {
+      fl_countersFault(p.counters);
+      fl_sendFaultNotification(p.id, fl_faultToString(type), p.faultCurrent);
+    }
+
+    reportFault(i);
+  }
+
+  void step(uint8_t i) {
+    fl_pump_t& p = pumps[i];
+    const char* t = tag(i);
+
+    fl_protection_input_t in = {};
+    in.nowMs = millis();
+    in.state = p.state;
+    in.current = current(sensors, phases, i);
+    if constexpr (kThreePhase) in.phases = &phases;
+    // Sensor fault is shared — one meter for all pumps
+    in.sensorFault = !sensors.online && sensors.failCount >= FL_MAX_MODBUS_FAILURES;
+    in.startCommand = p.startCommand;
+    in.startCommandMs = p.startCommandTime;
+    in.contactorClosed = p.lastDOState;
+    in.contactorCloseMs = p.contactorCloseTime;
+
+    fl_protection_decision_t d = fl_protectionStep(p.prot, fl_pumpProtectionConfig(p, config), in);
+
+    if (d.events & FL_PROT_EV_OC_START)
+      Serial.printf("%s: Overcurrent condition started (delay=%lus)\n", t, p.overcurrentDelayS);
+    if (d.events & FL_PROT_EV_OC_CLEAR)
+      Serial.printf("%s: Overcurrent condition cleared\n", t);
+    if (d.events & FL_PROT_EV_DR_START)
+      Serial.printf("%s: Dry run condition started (delay=%lus)\n", t, p.dryrunDelayS);
+    if (d.events & FL_PROT_EV_DR_CLEAR)
+      Serial.printf("%s: Dry run condition cleared\n", t);
+    if constexpr (kThreePhase) {
+      if (d.events & FL_PROT_EV_UB_START)
+        Serial.printf("%s: Unbalance %.1f%% started (delay=%lus)\n", t, phases.imbalancePct, p.imbalanceDelayS);
+      if (d.events & FL_PROT_EV_UB_CLEAR)
+        Serial.printf("%s: Unbalance cleared\n", t);
+      if (d.events & FL_PROT_EV_PL_START)
+        Serial.printf("%s: L%d lost (delay=%lus)\n", t, phases.lostPhase, p.phaseLossDelayS);
+      if (d.events & FL_PROT_EV_PL_CLEAR)
+        Serial.printf("%s: Phase loss cleared\n", t);
+      if (d.events & FL_PROT_EV_V_START)
+        Serial.printf("%s: Voltage out of range %.1f-%.1fV (delay=%lus)\n", t, phases.minV, phases.maxV, p.voltageDelayS);
+      if (d.events & FL_PROT_EV_V_CLEAR)
+        Serial.printf("%s: Voltage back in range\n", t);
+    }
+
+    if (d.events & FL_PROT_EV_AUTO_RESET) {
+      Serial.printf("%s: Auto-resetting fault\n", t);
+      resetFault(i);
+      return;
+    }
+
+    if (d.events & FL_PROT_EV_TRIP) {
+      if (d.trip == FL_TRIP_THERMAL)
+        Serial.printf("%s: Thermal overload (%.0f%%)\n", t, fl_protectionThermalPercent(p.prot));
+      else if (d.trip == FL_TRIP_START_TIMEOUT)
+        Serial.printf("%s: Start failure timeout\n", t);
+      triggerFault(i, fl_faultFromTrip(d.trip));
+      return;
+    }
+
+    if (d.events & FL_PROT_EV_STATE) {
+      p.state = d.state;
+      Serial.printf("%s: State changed to %s\n", t, fl_motorStateToString(p.state));
+    }
+  }
+
+  // The metered channels of the latest snapshot: L1..L3 of a 3-phase motor,
+  // else each pump's own phase
+  void readChannels(float (&v)[kPhases], float (&c)[kPhases]) const {
+    for (uint8_t k = 0; k < kPhases; k++) {
+      uint8_t ph = phaseOf(k);
+      v[k] = sensors.*kPhaseV[ph];
+      c[k] = sensors.*kPhaseI[ph];
+    }
+  }
+
+  // Active power of pump i, W: the meter's total for a 3-phase motor when
+  // it reports one, else V x I x PF per phase. PF is the meter's total
+  // (shared by the pumps of a per-phase map), 1 without a reading.
+  float power(const fl_sensor_snapshot_t& s, uint8_t i) const {
+    float pf = (s.valid & FL_QMASK(FL_Q_PF)) ? fabsf(s.PF) : 1.0f;
+    if constexpr (kThreePhase) {
+      if (s.valid & FL_QMASK(FL_Q_KW)) return fabsf(s.kW) * 1000;
+      return (s.Va * s.Ia + s.Vb * s.Ib + s.Vc * s.Ic) * pf;
+    } else {
+      return voltage(s, i) * current(s, phases, i) * pf;
+    }
+  }
+
+  // Energy of every sample while the contactor is closed
+  void meterEnergy() {
+    for (uint8_t i = 0; i < N; i++) {
+      fl_pump_t& p = pumps[i];
+      float watts = !sensors.online ? NAN : p.lastDOState ? power(sensors, i) : 0;
+      fl_countersSample(p.counters, sensors.timestampMs, watts);
+    }
+  }
+
+  static constexpr uint8_t phaseOf(uint8_t i) {
+    if constexpr (kThreePhase) return i;
+    else return Meter::phase[i];
+  }
+
+  void foldSamples() {
+    float v[kPhases], c[kPhases];
+    readChannels(v, c);
+    for (uint8_t k = 0; k < kPhases; k++) {
+      fl_aggAdd(frameI[k], c[k]);
+      fl_aggAdd(statsV[k], v[k]);
+      fl_aggAdd(statsI[k], c[k]);
+    }
+    statsSamples++;
+
+    // History per pump: its own phase, or a 3-phase motor's mean voltage
+    // and protection current
+    for (uint8_t i = 0; i < N; i++) {
+      if constexpr (kThreePhase) fl_aggAdd(historyV[i], (v[0] + v[1] + v[2]) / 3);
+      else fl_aggAdd(historyV[i], v[i]);
+      fl_aggAdd(historyI[i], current(sensors, phases, i));
+    }
+  }
+
+  // Mean V and I of the step and the state at its end, stamped with wall
+  // time; nothing is recorded until the clock is set
+  void recordHistory() {
+    uint32_t ts = fl_clock().valid ? (uint32_t)fl_clock().epoch : 0;
+    for (uint8_t i = 0; i < N; i++) {
+      if (ts) {
+        fl_history_point_t p = { ts, fl_aggMean(historyV[i]), fl_aggMean(historyI[i]), pumps[i].state };
+        fl_historyAppend(fl_history, i, p);
+      }
+      fl_aggReset(historyV[i]);
+      fl_aggReset(historyI[i]);
+    }
+  }
+
+  void resetStats() {
+    for (uint8_t k = 0; k < kPhases; k++) {
+      fl_aggReset(statsV[k]);
+      fl_aggReset(statsI[k]);
+    }
+    statsSamples = 0;
+    statsStartMs = millis();
+  }
+
+  void publishStats() {
+    static char buf[1024];
+    fl_jsonw_t w;
+    fl_jsonwBegin(w, buf, sizeof(buf));
+    encodeStats(w);
+    fl_jsonwUInt(w, "uptime", millis() / 1000);
+    if (fl_clock().valid) fl_jsonwStr(w, "time", fl_clock().hms);
+    size_t len = fl_jsonwEnd(w);
+    if (len) fl_publish(fl_TOPIC_TELEMETRY_STATS, buf, len, FL_PUB_TELEMETRY);
+  }
+
+  void captureReported(reported_t& f) const {
+    readChannels(f.v, f.i);
+    for (uint8_t i = 0; i < N; i++) {
+      const fl_pump_t& p = pumps[i];
+      f.th[i] = p.thermalMode != FL_THERMAL_OFF ? fl_protectionThermalPercent(p.prot) : NAN;
+      f.pump[i][0] = p.state;
+      f.pump[i][1] = p.faultType;
+      f.pump[i][2] = p.startCommand;
+      f.pump[i][3] = p.contactorConfirmed;
+    }
+    f.di = fl_diStatus;
+    f.dout = fl_do_state;
+    f.sensor = sensors.online;
+  }
+
+  void compareReported(const reported_t& f, bool& event, bool& drift) const {
+    const reported_t& r = reported;
+    event = memcmp(f.pump, r.pump, sizeof(f.pump)) != 0 || f.di != r.di || f.dout != r.dout ||
+            f.sensor != r.sensor;
+    for (uint8_t k = 0; k < kPhases && !drift; k++) {
+      drift = fl_reportExceeds(r.v[k], f.v[k], reporting.cfg.deadbandV) ||
+              fl_reportExceeds(r.i[k], f.i[k], reporting.cfg.deadbandI) ||
+              (frameI[k].n && fl_reportExceeds(r.i[k], frameI[k].max, reporting.cfg.deadbandI));  // Spike between frames
+    }
+    for (uint8_t k = 0; k < N && !drift; k++)
+      drift = fl_reportExceeds(r.th[k], f.th[k], FL_REPORT_THERMAL_DEADBAND);
+  }
+
+  // SET_TELEMETRY policy fields, range-checked by the schema. Nothing is
+  // applied if one is refused.
+  const char* applyReportConfig(JsonObjectConst args) {
+    const char* mode = args["mode"] | "";
+    if (args.containsKey("mode") && strcmp(mode, "exception") != 0 && strcmp(mode, "periodic") != 0)
+      return "unknown mode";
+    uint32_t stats = args["stats_s"] | statsWindowS;
+    if (stats != 0 && stats < FL_AGG_MIN_WINDOW_S) return "'stats_s' out of range";
+
+    fl_report_config_t& c = reporting.cfg;
+    if (args.containsKey("mode")) c.exception = strcmp(mode, "exception") == 0;
+    c.deadbandV = args["deadband_v"] | c.deadbandV;
+    c.deadbandI = args["deadband_i"] | c.deadbandI;
+    c.intervalMs = args["interval_ms"] | c.intervalMs;
+    c.heartbeatS = args["heartbeat_s"] | c.heartbeatS;
+    if (args.containsKey("stats_s")) {
+      statsWindowS = stats;
+      resetStats();
+    }
+    return nullptr;
+  }
+
+  const fl_tariff_map_t* activeTariff() const { return ruraflexEnabled ? &tariffMap : nullptr; }
+
+  // Per loop pass this is a compare per pump against the cached clock. A pump
+  // is re-evaluated when its edge is due; all pumps when the schedule or
+  // tariff changed or the wall clock was set or stepped (NTP sync).
+  void updateSchedule() {
+    const fl_clock_t& clock = fl_clock();
+    time_t now = clock.epoch;
+    bool all = scheduleDirty || clock.steps != scheduleClockSteps;
+    if (all) {
+      scheduleDirty = false;
+      scheduleClockSteps = clock.steps;
+    }
+
+    for (uint8_t i = 0; i < N; i++) {
+      fl_pump_t& p = pumps[i];
+      if (!all && (p.scheduleNextChange == 0 || now < p.scheduleNextChange)) continue;
+      fl_schedule_eval_t e = fl_scheduleEval(p.schedule, activeTariff(), now);
+      p.scheduleNextChange = e.nextChange;
+      checkSchedule(i, e.allowed);
+      updateOutputs(i);
+    }
+  }
+
+  void checkSchedule(uint8_t i, bool scheduleAllows) {
+    fl_pump_t& p = pumps[i];
+    if (p.schedule.enabled || ruraflexEnabled) {
+      if (scheduleAllows && !p.wasWithinSchedule) {
+        if (p.state != FL_MOTOR_FAULT) p.startCommand = true;
+        Serial.printf("Schedule: %s entering allowed hours\n", tag(i));
+      }
+      if (!scheduleAllows && p.wasWithinSchedule) {
+        p.startCommand = false;
+        Serial.printf("Schedule: %s outside allowed hours\n", tag(i));
+      }
+    }
+    // Always track schedule state — even when schedule is disabled.
+    // Prevents stale wasWithinSchedule causing unexpected auto-start
+    // if schedule is re-enabled while outside the window.
+    p.wasWithinSchedule = scheduleAllows;
+  }
+
+  void updateOutputs(uint8_t i) {
+    fl_pump_t& p = pumps[i];
+    bool desiredDO = p.startCommand && p.state != FL_MOTOR_FAULT && p.wasWithinSchedule;
+    // Always enforce contactor state — don't rely on lastDOState tracking
+    // to catch edge cases (fault clear, schedule toggle, etc.)
+    fl_setDO(Io::contactor[i], desiredDO);
+    if (desiredDO != p.lastDOState) {
+      Serial.printf("%s contactor: %s\n", tag(i), desiredDO ? "ON" : "OFF");
+      p.lastDOState = desiredDO;
+      if (desiredDO) {
+        p.contactorCloseTime = millis();
+        fl_inrushStart(inrush[i], p.contactorCloseTime, inrushWindowMs);
+        inrushShared[i].write(inrush[i]);
+        fl_boostSensorRate(max(config.sensorBoostMs, (uint32_t)inrushWindowMs));
+        fl_countersStart(p.counters);
+      } else {
+        fl_pumpSaveCounters(p, KeyCnt::key[i]);   // Orderly stop or trip
+      }
+    }
+  }
+
+  // Sampling policy: fast while any pump is starting or a protection timer
+  // is running, normal while something runs, slow when everything is stopped
+  void updateSensorRate() {
+    bool timing = false;
+    bool active = false;
+    for (uint8_t i = 0; i < N; i++) {
+      const fl_pump_t& p = pumps[i];
+      if (fl_protectionTiming(p.prot) || (p.lastDOState && p.state != FL_MOTOR_RUNNING)) timing = true;
+      if (p.state == FL_MOTOR_RUNNING || p.lastDOState) active = true;
+    }
+    fl_setSensorRate(timing ? FL_RATE_FAST : active ? FL_RATE_NORMAL : FL_RATE_IDLE);
+  }
+
+  void printStatus() const {
+    if constexpr (kThreePhase) {
+      const fl_pump_t& p = pumps[0];
+      Serial.println("\n--- Motor Status ---");
+      Serial.printf("State: %s | cmd=%s | cf=%s", fl_motorStateToString(p.state),
+                    p.startCommand ? "ON" : "OFF", p.contactorConfirmed ? "YES" : "NO");
+      if (p.state == FL_MOTOR_FAULT) Serial.printf(" | fault=%s", fl_faultToString(p.faultType));
+      Serial.println();
+      Serial.printf("V: %.1f / %.1f / %.1f | I: %.2f / %.2f / %.2f\n",
+                    sensors.Va, sensors.Vb, sensors.Vc, sensors.Ia, sensors.Ib, sensors.Ic);
+      Serial.printf("Avg I: %.2fA | Unbalance: %.1f%% | Lost phase: %s\n",
+                    phases.avgI, phases.imbalancePct,
+                    kPhaseName[phases.lostPhase]);
+    } else {
+      Serial.printf("\n--- %u-Pump Status ---\n", N);
+      for (uint8_t i = 0; i < N; i++) {
+        const fl_pump_t& p = pumps[i];
+        Serial.printf("%s: %s | V=%.1f I=%.2f | cmd=%s | cf=%s", tag(i), fl_motorStateToString(p.state),
+                      voltage(sensors, i), current(sensors, phases, i),
+                      p.startCommand ? "ON" : "OFF", p.contactorConfirmed ? "YES" : "NO");
+        if (p.state == FL_MOTOR_FAULT) Serial.printf(" | fault=%s", fl_faultToString(p.faultType));
+        Serial.println();
+      }
+    }
+    Serial.printf("Sensor: %s | Tariff: %s (%s) | Schedule:", sensors.online ? "ONLINE" : "OFFLINE",
+                  tariff.name, ruraflexEnabled ? "ON" : "OFF");
+    for (uint8_t i = 0; i < N; i++) {
+      if (N > 1) Serial.printf(" P%u=", i + 1);
+      else Serial.print(" ");
+      Serial.print(pumps[i].schedule.enabled ? "ON" : "OFF");
+    }
+    Serial.println();
+    Serial.printf("Telemetry: %lu published (%lu events, %lu heartbeats) | %lu suppressed | %lu failed\n",
+                  (unsigned long)fl_reportPublishedTotal(reporting),
+                  (unsigned long)reporting.published[FL_REPORT_EVENT],
+                  (unsigned long)reporting.published[FL_REPORT_HEARTBEAT],
+                  (unsigned long)reporting.suppressed, (unsigned long)reporting.failed);
+    for (uint8_t i = 0; i < N; i++) {
+      const fl_counters_t& c = pumps[i].counters;
+      Serial.printf("%s: %.2f kWh | %.2f h run | %lu starts | %lu faults\n", tag(i), c.wh / 1000,
+                    c.runS / 3600.0, (unsigned long)c.starts, (unsigned long)c.faults);
+    }
+  }
+
+  void loadRuraflexConfig() {
+    fl_preferences.begin("ruraflex", true);
+    ruraflexEnabled = fl_preferences.getBool("enabled", false);
+    fl_preferences.end();
+    Serial.println("Ruraflex config loaded");
+  }
+
+  void saveRuraflexConfig() {
+    fl_preferences.begin("ruraflex", false);
+    fl_preferences.putBool("enabled", ruraflexEnabled);
+    fl_preferences.end();
+    Serial.println("Ruraflex config saved");
+  }
+
+  void loadTariff() {
+    bool stored = fl_tariffLoad(fl_preferences, tariff);
+    fl_tariffCompile(tariff, tariffMap);
+    tariffShared.write(tariff);
+    scheduleDirty = true;
+    Serial.printf("Tariff: %s (%s)\n", tariff.name, stored ? "NVS" : "built-in");
+  }
+
+  void loadInrushConfig() {
+    fl_preferences.begin("inrush", true);
+    inrushWindowMs = fl_preferences.getUShort("window", FL_INRUSH_DEFAULT_WINDOW);
+    fl_preferences.end();
+    Serial.printf("Inrush capture window: %ums\n", inrushWindowMs);
+  }
+
+  // The JSON frame; 'stamped' adds the epoch ("ts") for frames replayed later
+  size_t encodeJsonFrame(char* buf, size_t cap, const char* hwType, const char* fwVersion, bool stamped) const {
+    // Encoded in place: no JsonDocument, no float formatting
+    typename Telemetry::frame_t f = {};
+    fillTelemetry(f, hwType, fwVersion);
+    return Telemetry::encodeJson(buf, cap, f, stamped);
+  }
+
+  bool publishJsonTelemetry(const char* hwType, const char* fwVersion) {
+    static char buf[1024];
+    size_t len = encodeJsonFrame(buf, sizeof(buf), hwType, fwVersion, false);
+    if (!len) {
+      Serial.println("Telemetry exceeds buffer, not sent");
+      return false;
+    }
+    return fl_publish(fl_TOPIC_TELEMETRY, buf, len, FL_PUB_TELEMETRY);
+  }
+
+  /* ----- Offline journal (fl_journal.h) ----- */
+
+  static uint32_t journalTs() {
+    return fl_clock().valid ? (uint32_t)fl_clock().epoch : 0;
+  }
+
+  // Always JSON, whatever the live format: the replay is for the history
+  bool journalTelemetry(const char* hwType, const char* fwVersion) {
+    static char buf[FL_JOURNAL_MAX_RECORD];
+    size_t len = encodeJsonFrame(buf, sizeof(buf), hwType, fwVersion, true);
+    if (!len || !fl_journalAppend(fl_journal, FL_JOURNAL_TELEMETRY, journalTs(), buf, len)) return false;
+    for (uint8_t k = 0; k < kPhases; k++) fl_aggReset(frameI[k]);
+    return true;
+  }
+
+  size_t encodeFault(char* buf, size_t size, uint8_t i) {
+    const fl_pump_t& p = pumps[i];
+    fl_jsonw_t w;
+    fl_jsonwBegin(w, buf, size);
+    fl_jsonwStr(w, "type", "fault");
+    if (N > 1) fl_jsonwUInt(w, "pump", p.id);
+    fl_jsonwStr(w, "fault", fl_faultToString(p.faultType));
+    fl_jsonwFixed(w, "current", p.faultCurrent, 2);
+    fl_jsonwUInt(w, "uptime", millis() / 1000);
+    if (fl_clock().valid) fl_jsonwUInt(w, "ts", journalTs());
+    return fl_jsonwEnd(w);
+  }
+
+  // Live on the fault lane, ahead of any queued telemetry; journalled when
+  // offline or when even that lane is full
+  void reportFault(uint8_t i) {
+    char buf[160];
+    size_t len = encodeFault(buf, sizeof(buf), i);
+    if (!len) return;
+    if (fl_publish(fl_TOPIC_TELEMETRY, buf, len, FL_PUB_FAULT)) return;
+    if (fl_journal.ready) fl_journalAppend(fl_journal, FL_JOURNAL_FAULT, journalTs(), buf, len);
+  }
+
+  // One record at a time, oldest first. It stays pending in the journal
+  // until the network task has handed it to the client, so a reboot before
+  // then replays it again rather than losing it. This is the only producer
+  // on the replay lane: any send counted there is the record in flight.
+  void drainJournal() {
+    static uint8_t buf[FL_JOURNAL_MAX_RECORD];
+    if (replayInFlight) {
+      if (fl_publishStats[FL_PUB_REPLAY].sent == replaySentMark) return;
+      replayInFlight = false;
+      fl_journalAck(fl_journal);
+      if (!fl_journal.pending) {
+        Serial.printf("Journal drained (%lu replayed)\n", (unsigned long)fl_journal.replayed);
+        return;
+      }
+    }
+    fl_journal_record_t rec;
+    if (!fl_journalPeek(fl_journal, rec, buf, sizeof(buf))) return;
+    replaySentMark = fl_publishStats[FL_PUB_REPLAY].sent;
+    replayInFlight = fl_publish(fl_TOPIC_TELEMETRY_REPLAY, buf, rec.len, FL_PUB_REPLAY);
+  }
+
+  // Same fields as the JSON, laid out per fl_telembin.h
+  bool publishBinaryTelemetry(const char* hwType, const char* fwVersion) {
+    bool withStatic = binStaticDue || binFrame % FL_TELEMBIN_STATIC_EVERY == 0;
+    typename Telemetry::frame_t f = {};
+    fillTelemetry(f, hwType, fwVersion);
+    static uint8_t buf[192];
+    size_t len = Telemetry::encodeBinary(buf, sizeof(buf), f, binFrame, withStatic);
+    if (!len) {
+      Serial.println("Binary telemetry exceeds buffer, not sent");
+      return false;
+    }
+    bool ok = fl_publish(fl_TOPIC_TELEMETRY_BIN, buf, len, FL_PUB_TELEMETRY);
+    if (ok) {
+      binFrame++;
+      if (withStatic) binStaticDue = false;
+    }
+    return ok;
+  }
+
+  void loadTelemetryConfig() {
+    fl_report_config_t& c = reporting.cfg;
+    fl_preferences.begin("telemetry", true);
+    uint8_t f = fl_preferences.getUChar("format", FL_TELEMETRY_JSON);
+    c.exception = fl_preferences.getBool("rbe", true);
+    c.deadbandV = fl_preferences.getFloat("db_v", FL_REPORT_DEFAULT_DEADBAND_V);
+    c.deadbandI = fl_preferences.getFloat("db_i", FL_REPORT_DEFAULT_DEADBAND_I);
+    c.intervalMs = fl_preferences.getULong("interval", FL_REPORT_DEFAULT_INTERVAL_MS);
+    c.heartbeatS = fl_preferences.getUShort("heartbeat", FL_REPORT_DEFAULT_HEARTBEAT_S);
+    statsWindowS = fl_preferences.getUShort("stats", FL_AGG_DEFAULT_WINDOW_S);
+    fl_preferences.end();
+    telemetryFormat = f < FL_TELEMETRY_FORMAT_COUNT ? (fl_telemetry_format_t)f : FL_TELEMETRY_JSON;
+    Serial.printf("Telemetry format: %s, %s (dV=%.1f dI=%.2f every %lums, heartbeat %us)\n",
+                  fl_telemetryFormatName(telemetryFormat), c.exception ? "by exception" : "periodic",
+                  c.deadbandV, c.deadbandI, (unsigned long)c.intervalMs, c.heartbeatS);
+  }
+
+  void saveTelemetryConfig() {
+    const fl_report_config_t& c = reporting.cfg;
+    fl_preferences.begin("telemetry", false);
+    fl_preferences.putUChar("format", telemetryFormat);
+    fl_preferences.putBool("rbe", c.exception);
+    fl_preferences.putFloat("db_v", c.deadbandV);
+    fl_preferences.putFloat("db_i", c.deadbandI);
+    fl_preferences.putULong("interval", c.intervalMs);
+    fl_preferences.putUShort("heartbeat", c.heartbeatS);
+    fl_preferences.putUShort("stats", statsWindowS);
+    fl_preferences.end();
+    Serial.println("Telemetry config saved");
+  }
+
+  void saveInrushConfig() {
+    fl_preferences.begin("inrush", false);
+    fl_preferences.putUShort("window", inrushWindowMs);
+    fl_preferences.end();
+    Serial.println("Inrush config saved");
+  }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "fl_counters.h"
+#include <math.h>
+#include <string.h>
+
+void fl_countersRestore(fl_counters_t& c, uint32_t wh, uint32_t runS, uint32_t starts, uint32_t faults,
+                        uint32_t nowMs) {
+  memset(&c, 0, sizeof(c));
+  c.wh = wh;
+  c.runS = runS;
+  c.starts = starts;
+  c.faults = faults;
+  fl_countersSaved(c, nowMs);
+}
+
+void fl_countersRun(fl_counters_t& c, uint32_t nowMs, bool running) {
+  if (c.ticked && running) {
+    uint32_t ms = c.runMs + (nowMs - c.lastRunMs);
+    c.runS += ms / 1000;
+    c.runMs = ms % 1000;
+  }
+  c.lastRunMs = nowMs;
+  c.ticked = true;
+}
+
+void fl_countersSample(fl_counters_t& c, uint32_t sampleMs, float watts) {
+  if (isnan(watts)) {
+    c.sampled = false;
+    return;
+  }
+  uint32_t dt = sampleMs - c.lastSampleMs;
+  if (c.sampled && dt <= FL_COUNTERS_MAX_GAP_MS && watts > 0) c.wh += (double)watts * dt / 3600000.0;
+  c.lastSampleMs = sampleMs;
+  c.sampled = true;
+}
+
+bool fl_countersDirty(const fl_counters_t& c) {
+  return (uint32_t)c.wh != c.savedWh || c.runS != c.savedRunS || c.starts != c.savedStarts ||
+         c.faults != c.savedFaults;
+}
+
+bool fl_countersSaveDue(const fl_counters_t& c, uint32_t nowMs) {
+  if (!fl_countersDirty(c)) return false;
+  return nowMs - c.savedAtMs >= FL_COUNTERS_SAVE_INTERVAL_S * 1000UL ||
+         (uint32_t)c.wh - c.savedWh >= FL_COUNTERS_SAVE_DELTA_WH;
+}
+
+void fl_countersSaved(fl_counters_t& c, uint32_t nowMs) {
+  c.savedWh = (uint32_t)c.wh;
+  c.savedRunS = c.runS;
+  c.savedStarts = c.starts;
+  c.savedFaults = c.faults;
+  c.savedAtMs = nowMs;
+}
@@ -0,0 +1,64 @@
+#ifndef FL_COUNTERS_H
+#define FL_COUNTERS_H
+
+// Lifetime counters of one pump: energy, run time, starts and protection
+// faults, for billing and maintenance. Integrated in RAM on every sample
+// and checkpointed to NVS only when it is worth a write: after
+// FL_COUNTERS_SAVE_INTERVAL_S with anything changed, after
+// FL_COUNTERS_SAVE_DELTA_WH of energy, and whenever the contactor opens.
+// A power cut loses at most one interval of run time and one delta of
+// energy. NVS skips writes of unchanged values, so a stopped pump costs
+// nothing; a running one rewrites two entries per interval, a few NVS page
+// erases a day. Hardware-free: the controller does the NVS I/O.
+
+#include <stdint.h>
+
+#define FL_COUNTERS_SAVE_INTERVAL_S  900
+#define FL_COUNTERS_SAVE_DELTA_WH    1000
+#define FL_COUNTERS_MAX_GAP_MS       5000   // Longer gaps between samples are not integrated
+
+struct fl_counters_t {
+  double wh;                   // V x I x PF per phase; apparent (VAh) without a PF reading
+  uint32_t runS;
+  uint32_t starts;
+  uint32_t faults;
+
+  // Integration
+  uint16_t runMs;              // Below a second, carried
+  uint32_t lastRunMs;
+  uint32_t lastSampleMs;
+  bool ticked;
+  bool sampled;
+
+  // As last written
+  uint32_t savedWh;
+  uint32_t savedRunS;
+  uint32_t savedStarts;
+  uint32_t savedFaults;
+  uint32_t savedAtMs;
+};
+
+// Values loaded from NVS
+void fl_countersRestore(fl_counters_t& c, uint32_t wh, uint32_t runS, uint32_t starts, uint32_t faults,
+                        uint32_t nowMs);
+
+// Every loop pass: run time accrues while 'running'
+void fl_countersRun(fl_counters_t& c, uint32_t nowMs, bool running);
+// Every sensor sample: power in W (0 while the contactor is open, NaN = no reading)
+void fl_countersSample(fl_counters_t& c, uint32_t sampleMs, float watts);
+
+inline void fl_countersStart(fl_counters_t& c) { c.starts++; }
+inline void fl_countersFault(fl_counters_t& c) { c.faults++; }
+
+// Something differs from the last checkpoint
+bool fl_countersDirty(const fl_counters_t& c);
+// The time or energy threshold has been crossed
+bool fl_countersSaveDue(const fl_counters_t& c, uint32_t nowMs);
+// The caller has written the current values
+void fl_countersSaved(fl_counters_t& c, uint32_t nowMs);
+
+// Telemetry units: kWh and hours, both x100
+inline uint32_t fl_countersCentiKwh(const fl_counters_t& c) { return (uint32_t)(c.wh / 10); }
+inline uint32_t fl_countersCentiHours(const fl_counters_t& c) { return c.runS / 36; }
+
+#endif
@@ -0,0 +1,397 @@
+#include "fl_history.h"
+#include <math.h>
+#include <string.h>
+
+#define WORST_POINT_BITS  130   // 36 ts + 44 V + 44 I + 5 state, rounded up
+#define NO_WINDOW         0xFF
+
+/* ===== Bit stream (MSB first, into a zeroed buffer) ===== */
+
+static void putBits(uint8_t* buf, uint32_t& pos, uint32_t value, uint8_t n) {
+  while (n) {
+    n--;
+    if ((value >> n) & 1) buf[pos >> 3] |= 0x80 >> (pos & 7);
+    pos++;
+  }
+}
+
+static uint32_t getBits(const uint8_t* buf, uint32_t& pos, uint8_t n) {
+  uint32_t v = 0;
+  while (n--) {
+    v = (v << 1) | ((buf[pos >> 3] >> (7 - (pos & 7))) & 1);
+    pos++;
+  }
+  return v;
+}
+
+static int32_t signExtend(uint32_t v, uint8_t n) {
+  return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+static uint32_t floatBits(float f) {
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static float bitsFloat(uint32_t u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// Telemetry resolution; NaN (no reading) passes through
+static float quantise(float x, float scale) {
+  return isnan(x) ? NAN : roundf(x * scale) / scale;
+}
+
+/* ===== Gorilla coding ===== */
+
+// Delta-of-delta: '0' same spacing, '10' 7 bits, '110' 9, '1110' 12, '1111' 32
+static void putTs(uint8_t* d, uint32_t& pos, fl_history_codec_t& c, uint32_t ts) {
+  int32_t delta = (int32_t)(ts - c.ts);
+  int32_t dod = delta - c.delta;
+  if (dod == 0) {
+    putBits(d, pos, 0, 1);
+  } else if (dod >= -64 && dod <= 63) {
+    putBits(d, pos, 0x2, 2);
+    putBits(d, pos, (uint32_t)dod, 7);
+  } else if (dod >= -256 && dod <= 255) {
+    putBits(d, pos, 0x6, 3);
+    putBits(d, pos, (uint32_t)dod, 9);
+  } else if (dod >= -2048 && dod <= 2047) {
+    putBits(d, pos, 0xE, 4);
+    putBits(d, pos, (uint32_t)dod, 12);
+  } else {
+    putBits(d, pos, 0xF, 4);
+    putBits(d, pos, (uint32_t)dod, 32);
+  }
+  c.ts = ts;
+  c.delta = delta;
+}
+
+static uint32_t getTs(const uint8_t* d, uint32_t& pos, fl_history_codec_t& c) {
+  int32_t dod = 0;
+  if (getBits(d, pos, 1)) {
+    if (!getBits(d, pos, 1)) dod = signExtend(getBits(d, pos, 7), 7);
+    else if (!getBits(d, pos, 1)) dod = signExtend(getBits(d, pos, 9), 9);
+    else if (!getBits(d, pos, 1)) dod = signExtend(getBits(d, pos, 12), 12);
+    else dod = (int32_t)getBits(d, pos, 32);
+  }
+  c.delta += dod;
+  c.ts += c.delta;
+  return c.ts;
+}
+
+// XOR with the previous value: '0' same, '10' meaningful bits inside the
+// previous window, '11' 5-bit leading zeros, 5-bit length - 1, bits
+static void putXor(uint8_t* d, uint32_t& pos, uint32_t cur, uint32_t& prev, uint8_t& lead, uint8_t& trail) {
+  uint32_t x = cur ^ prev;
+  prev = cur;
+  if (!x) {
+    putBits(d, pos, 0, 1);
+    return;
+  }
+  uint8_t l = __builtin_clz(x);
+  uint8_t t = __builtin_ctz(x);
+  if (lead != NO_WINDOW && l >= lead && t >= trail) {
+    putBits(d, pos, 0x2, 2);
+    putBits(d, pos, x >> trail, 32 - lead - trail);
+    return;
+  }
+  uint8_t len = 32 - l - t;
+  putBits(d, pos, 0x3, 2);
+  putBits(d, pos, l, 5);
+  putBits(d, pos, len - 1, 5);
+  putBits(d, pos, x >> t, len);
+  lead = l;
+  trail = t;
+}
+
+static uint32_t getXor(const uint8_t* d, uint32_t& pos, uint32_t& prev, uint8_t& lead, uint8_t& trail) {
+  if (!getBits(d, pos, 1)) return prev;
+  if (getBits(d, pos, 1)) {
+    lead = getBits(d, pos, 5);
+    uint8_t len = getBits(d, pos, 5) + 1;
+    trail = 32 - lead - len;
+  }
+  prev ^= getBits(d, pos, 32 - lead - trail) << trail;
+  return prev;
+}
+
+// The first point of a block is stored raw
+static void encodePoint(uint8_t* d, uint32_t& pos, fl_history_codec_t& c, const fl_history_point_t& p) {
+  uint32_t v = floatBits(quantise(p.v, 10));
+  uint32_t i = floatBits(quantise(p.i, 100));
+  if (c.count++ == 0) {
+    putBits(d, pos, p.ts, 32);
+    putBits(d, pos, v, 32);
+    putBits(d, pos, i, 32);
+    putBits(d, pos, p.state, 4);
+    c.ts = p.ts;
+    c.delta = 0;
+    c.v = v;
+    c.i = i;
+    c.vLead = c.iLead = NO_WINDOW;
+    c.state = p.state;
+    return;
+  }
+  putTs(d, pos, c, p.ts);
+  putXor(d, pos, v, c.v, c.vLead, c.vTrail);
+  putXor(d, pos, i, c.i, c.iLead, c.iTrail);
+  if (p.state == c.state) {
+    putBits(d, pos, 0, 1);
+  } else {
+    putBits(d, pos, 1, 1);
+    putBits(d, pos, p.state, 4);
+    c.state = p.state;
+  }
+}
+
+static void decodePoint(const uint8_t* d, uint32_t& pos, fl_history_codec_t& c, fl_history_point_t& p) {
+  if (c.count++ == 0) {
+    c.ts = getBits(d, pos, 32);
+    c.delta = 0;
+    c.v = getBits(d, pos, 32);
+    c.i = getBits(d, pos, 32);
+    c.state = getBits(d, pos, 4);
+  } else {
+    getTs(d, pos, c);
+    getXor(d, pos, c.v, c.vLead, c.vTrail);
+    getXor(d, pos, c.i, c.iLead, c.iTrail);
+    if (getBits(d, pos, 1)) c.state = getBits(d, pos, 4);
+  }
+  p.ts = c.ts;
+  p.v = bitsFloat(c.v);
+  p.i = bitsFloat(c.i);
+  p.state = c.state;
+}
+
+/* ===== Store ===== */
+
+static uint32_t addrOf(const fl_history_t& h, uint32_t seq) {
+  return ((seq - 1) % h.sectors) * FL_HISTORY_BLOCK;
+}
+
+static void resetOpen(fl_history_open_t& o, uint8_t series) {
+  memset(&o.head, 0, sizeof(o.head));
+  o.head.series = series;
+  memset(&o.enc, 0, sizeof(o.enc));
+  memset(o.data, 0, sizeof(o.data));
+  o.bits.store(0, std::memory_order_relaxed);
+}
+
+// Write the open block to the next sector (if there is flash), then start
+// a new one. Readers holding the old generation go back to flash.
+static void flush(fl_history_t& h, fl_history_open_t& o) {
+  uint32_t bits = o.bits.load(std::memory_order_relaxed);
+  if (h.port && o.head.count) {
+    uint32_t seq = h.headSeq.load(std::memory_order_relaxed) + 1;
+    uint32_t addr = addrOf(h, seq);
+    o.head.magic = FL_HISTORY_MAGIC;
+    o.head.seq = seq;
+    o.head.bits = bits;
+    // Stream first, header last: a block torn by a power cut has no magic
+    uint32_t len = ((bits + 7) / 8 + 3) & ~3;
+    if (h.port->erase(addr) && h.port->write(addr + sizeof(o.head), o.data, len) &&
+        h.port->write(addr, &o.head, sizeof(o.head))) {
+      h.headSeq.store(seq, std::memory_order_release);
+      h.blocks++;
+    } else {
+      h.errors++;
+    }
+  }
+
+  uint32_t gen = o.gen.load(std::memory_order_relaxed);
+  o.gen.store(gen + 1, std::memory_order_relaxed);      // odd: reset in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  resetOpen(o, o.head.series);
+  std::atomic_thread_fence(std::memory_order_release);
+  o.gen.store(gen + 2, std::memory_order_release);
+}
+
+bool fl_historyMount(fl_history_t& h, uint8_t series, const fl_flash_port_t* port, uint32_t size) {
+  if (series > FL_HISTORY_MAX_SERIES) series = FL_HISTORY_MAX_SERIES;
+  h.series = series;
+  h.open = new fl_history_open_t[series];
+  for (uint8_t s = 0; s < series; s++) {
+    resetOpen(h.open[s], s);
+    h.open[s].gen.store(0, std::memory_order_relaxed);
+  }
+
+  h.port = nullptr;
+  h.sectors = size / FL_HISTORY_BLOCK;
+  uint32_t head = 0;
+  if (port && h.sectors >= 2) {
+    h.port = port;
+    for (uint16_t k = 0; k < h.sectors; k++) {
+      fl_history_block_t b;
+      if (!port->read((uint32_t)k * FL_HISTORY_BLOCK, &b, sizeof(b))) {
+        h.errors++;
+        continue;
+      }
+      if (b.magic != FL_HISTORY_MAGIC || !b.seq || (b.seq - 1) % h.sectors != k) continue;
+      if (b.seq > head) head = b.seq;
+    }
+  }
+  h.headSeq.store(head, std::memory_order_release);
+  h.ready = true;
+  return h.port != nullptr;
+}
+
+bool fl_historyAppend(fl_history_t& h, uint8_t series, const fl_history_point_t& p) {
+  if (!h.ready || series >= h.series) return false;
+  fl_history_open_t& o = h.open[series];
+  if (o.enc.count && p.ts <= o.enc.ts) {
+    h.dropped++;
+    return false;
+  }
+
+  uint32_t pos = o.bits.load(std::memory_order_relaxed);
+  if (pos + WORST_POINT_BITS > FL_HISTORY_PAYLOAD * 8) {
+    flush(h, o);
+    pos = 0;
+  }
+  uint32_t start = pos;
+  if (!o.enc.count) o.head.t0 = p.ts;
+  encodePoint(o.data, pos, o.enc, p);
+  o.head.t1 = p.ts;
+  o.head.count++;
+  o.bits.store(pos, std::memory_order_release);
+
+  h.points++;
+  h.bitsIn += pos - start;
+  return true;
+}
+
+float fl_historyBitsPerPoint(const fl_history_t& h) {
+  return h.points ? (float)h.bitsIn / h.points : 0;
+}
+
+uint32_t fl_historyOldest(const fl_history_t& h, uint8_t series) {
+  if (!h.ready || series >= h.series) return 0;
+  uint32_t head = h.headSeq.load(std::memory_order_acquire);
+  if (h.port) {
+    for (uint32_t seq = head > h.sectors ? head - h.sectors + 1 : 1; seq && seq <= head; seq++) {
+      fl_history_block_t b;
+      if (!h.port->read(addrOf(h, seq), &b, sizeof(b))) continue;
+      if (b.magic == FL_HISTORY_MAGIC && b.seq == seq && b.series == series) return b.t0;
+    }
+  }
+  const fl_history_open_t& o = h.open[series];
+  return o.bits.load(std::memory_order_acquire) ? o.head.t0 : 0;
+}
+
+/* ===== Range query ===== */
+
+static void beginDecode(fl_history_query_t& q, uint32_t bits) {
+  q.bits = bits;
+  q.pos = 0;
+  memset(&q.dec, 0, sizeof(q.dec));
+}
+
+// Next block of the series that may hold points in range: flash blocks
+// oldest first, then a copy of the open block
+static bool loadBlock(const fl_history_t& h, fl_history_query_t& q) {
+  for (;;) {
+    uint32_t head = h.headSeq.load(std::memory_order_acquire);
+    if (h.port && q.seq + h.sectors <= head) q.seq = head - h.sectors + 1;  // Overwritten meanwhile
+
+    while (h.port && q.seq <= head) {
+      uint32_t seq = q.seq++;
+      uint32_t addr = addrOf(h, seq);
+      fl_history_block_t& b = q.head;
+      if (!h.port->read(addr, &b, sizeof(b))) continue;
+      if (b.magic != FL_HISTORY_MAGIC || b.seq != seq || b.series != q.series) continue;
+      if (b.t1 <= q.lastTs || b.t1 < q.from || b.t0 > q.to || b.bits > FL_HISTORY_PAYLOAD * 8) continue;
+      uint32_t check = 0;
+      if (!h.port->read(addr + sizeof(b), q.data, (b.bits + 7) / 8)) continue;
+      if (!h.port->read(addr + offsetof(fl_history_block_t, seq), &check, sizeof(check)) || check != seq)
+        continue;  // Erased while we read it
+      beginDecode(q, b.bits);
+      return true;
+    }
+
+    if (q.ramDone) return false;
+    const fl_history_open_t& o = h.open[q.series];
+    uint32_t g1 = o.gen.load(std::memory_order_acquire);
+    if (g1 & 1) continue;
+    uint32_t bits = o.bits.load(std::memory_order_acquire);
+    memcpy(q.data, o.data, (bits + 7) / 8);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (o.gen.load(std::memory_order_relaxed) != g1) continue;  // Flushed: now in flash
+    q.ramDone = true;
+    beginDecode(q, bits);
+    return true;
+  }
+}
+
+static void closeBucket(fl_history_query_t& q, fl_history_row_t& row) {
+  row = q.acc;
+  row.v = q.nV ? q.sumV / q.nV : NAN;
+  row.i = q.nI ? q.sumI / q.nI : NAN;
+  q.acc.n = 0;
+}
+
+static void addPoint(fl_history_query_t& q, uint32_t bucket, const fl_history_point_t& p) {
+  if (!q.acc.n) {
+    q.acc.ts = bucket;
+    q.acc.iMax = NAN;
+    q.sumV = q.sumI = 0;
+    q.nV = q.nI = 0;
+  }
+  q.acc.n++;
+  q.acc.state = p.state;
+  if (!isnan(p.v)) {
+    q.sumV += p.v;
+    q.nV++;
+  }
+  if (!isnan(p.i)) {
+    q.sumI += p.i;
+    q.nI++;
+    if (isnan(q.acc.iMax) || p.i > q.acc.iMax) q.acc.iMax = p.i;
+  }
+}
+
+void fl_historyQueryBegin(const fl_history_t& h, fl_history_query_t& q, uint8_t series,
+                          uint32_t from, uint32_t to, uint32_t step) {
+  q.series = series;
+  q.from = from;
+  q.to = to;
+  q.step = step ? step : 1;
+  uint32_t head = h.headSeq.load(std::memory_order_acquire);
+  q.seq = head > h.sectors ? head - h.sectors + 1 : 1;
+  q.ramDone = false;
+  q.done = !h.ready || series >= h.series || from > to;
+  q.lastTs = 0;
+  q.decoding = false;
+  q.acc.n = 0;
+}
+
+bool fl_historyQueryNext(const fl_history_t& h, fl_history_query_t& q, fl_history_row_t& row) {
+  while (!q.done) {
+    if (!q.decoding || q.pos >= q.bits) {
+      q.decoding = loadBlock(h, q);
+      if (!q.decoding) q.done = true;
+      continue;
+    }
+    fl_history_point_t p;
+    decodePoint(q.data, q.pos, q.dec, p);
+    if (p.ts <= q.lastTs) continue;
+    q.lastTs = p.ts;
+    if (p.ts < q.from) continue;
+    if (p.ts > q.to) {
+      q.done = true;             // Blocks come in time order
+      break;
+    }
+
+    uint32_t bucket = q.from + (p.ts - q.from) / q.step * q.step;
+    bool full = q.acc.n && bucket != q.acc.ts;
+    if (full) closeBucket(q, row);
+    addPoint(q, bucket, p);
+    if (full) return true;
+  }
+  if (!q.acc.n) return false;
+  closeBucket(q, row);
+  return true;
+}
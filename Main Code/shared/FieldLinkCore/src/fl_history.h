@@ -0,0 +1,145 @@
+#ifndef FL_HISTORY_H
+#define FL_HISTORY_H
+
+// On-device time series: per-pump voltage, current and state every few
+// seconds, for trend views when the cloud is out of reach.
+//
+// Points are Gorilla-coded (Pelkonen et al., VLDB 2015): timestamps as
+// delta-of-delta, so a steady 10 s cadence costs one bit, and values as the
+// XOR with the previous one, so a repeated reading costs one bit and a
+// small change only its meaningful bits. V and I are rounded to telemetry
+// resolution (0.1 V, 0.01 A) first, which keeps the XORs short.
+//
+// Each series fills a 4 KB block in RAM. A full block is written to the
+// next sector of a flash ring (the ring is the wear levelling; sectors are
+// tagged with a sequence number and their series), and the oldest block
+// goes. Without flash the open blocks are all there is.
+//
+// Appends come from the loop task and queries from the web server task:
+// flash blocks are immutable until erased (the reader re-checks the header
+// after copying), and the open block publishes its length and a generation
+// count atomically, seqlock style.
+// Hardware-free: flash access goes through fl_flash_port_t (fl_journal.h).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "fl_journal.h"
+
+#define FL_HISTORY_BLOCK           4096        // One flash sector
+#define FL_HISTORY_MAX_SERIES      8
+#define FL_HISTORY_DEFAULT_STEP_S  10          // Recording resolution
+#define FL_HISTORY_MAGIC           0x31484C46  // "FLH1"
+
+struct fl_history_point_t {
+  uint32_t ts;                 // Epoch seconds
+  float v;
+  float i;
+  uint8_t state;
+};
+
+// Flash and RAM block header; the bit stream follows
+struct fl_history_block_t {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t t0;                 // First and last point
+  uint32_t t1;
+  uint32_t bits;
+  uint16_t count;
+  uint8_t series;
+  uint8_t reserved;
+};
+
+#define FL_HISTORY_PAYLOAD  (FL_HISTORY_BLOCK - sizeof(fl_history_block_t))
+
+// Previous point and XOR windows, shared by encoder and decoder
+struct fl_history_codec_t {
+  uint32_t count;
+  uint32_t ts;
+  int32_t delta;
+  uint32_t v;                  // Float bits
+  uint32_t i;
+  uint8_t vLead, vTrail;       // 0xFF = no window yet
+  uint8_t iLead, iTrail;
+  uint8_t state;
+};
+
+// The open block of one series
+struct fl_history_open_t {
+  fl_history_block_t head;
+  fl_history_codec_t enc;
+  uint8_t data[FL_HISTORY_PAYLOAD];
+  std::atomic<uint32_t> bits;  // Published stream length
+  std::atomic<uint32_t> gen;   // Odd while the block is being flushed
+};
+
+struct fl_history_t {
+  const fl_flash_port_t* port; // Null = RAM only
+  bool ready;
+  uint16_t sectors;
+  uint8_t series;
+  fl_history_open_t* open;     // One per series
+  std::atomic<uint32_t> headSeq;  // Newest flash block, 0 = none. Block 'seq' lives in sector (seq - 1) % sectors.
+
+  // Since boot
+  uint32_t points;
+  uint32_t dropped;            // Out of order (clock stepped back)
+  uint32_t blocks;             // Written to flash
+  uint32_t bitsIn;             // Coded bits appended
+  uint32_t errors;             // Failed flash operations
+};
+
+// Allocate the open blocks and find the newest flash block. 'port' may be
+// null (RAM only); 'size' is the flash region size.
+bool fl_historyMount(fl_history_t& h, uint8_t series, const fl_flash_port_t* port, uint32_t size);
+
+// Points must come in time order per series; older ones are dropped
+bool fl_historyAppend(fl_history_t& h, uint8_t series, const fl_history_point_t& p);
+
+// Coded bits per point since boot; 104 uncompressed
+float fl_historyBitsPerPoint(const fl_history_t& h);
+
+// Oldest point still held for 'series', 0 = none
+uint32_t fl_historyOldest(const fl_history_t& h, uint8_t series);
+
+/* ----- Range query ----- */
+
+// One bucket of 'step' seconds: mean V and I, peak I, last state
+struct fl_history_row_t {
+  uint32_t ts;                 // Bucket start
+  float v;
+  float i;
+  float iMax;
+  uint8_t state;
+  uint16_t n;                  // Points in the bucket
+};
+
+// Decodes one block at a time into its own copy, so it is ~4 KB: heap, not stack
+struct fl_history_query_t {
+  uint8_t series;
+  uint32_t from, to, step;
+
+  uint32_t seq;                // Next flash block to visit
+  bool ramDone;
+  bool done;
+  uint32_t lastTs;             // Newest point consumed; a block flushed mid-query is not read twice
+
+  fl_history_block_t head;
+  uint8_t data[FL_HISTORY_PAYLOAD];
+  uint32_t bits;
+  uint32_t pos;
+  fl_history_codec_t dec;
+  bool decoding;
+
+  fl_history_row_t acc;
+  float sumV, sumI;
+  uint16_t nV, nI;
+};
+
+void fl_historyQueryBegin(const fl_history_t& h, fl_history_query_t& q, uint8_t series,
+                          uint32_t from, uint32_t to, uint32_t step);
+
+// Next non-empty bucket in time order; false when the range is exhausted
+bool fl_historyQueryNext(const fl_history_t& h, fl_history_query_t& q, fl_history_row_t& row);
+
+#endif
@@ -0,0 +1,87 @@
+#include "fl_inrush.h"
+#include <math.h>
+#include <string.h>
+
+void fl_inrushStart(fl_inrush_t& c, uint32_t nowMs, uint16_t windowMs) {
+  if (windowMs < FL_INRUSH_MIN_WINDOW) windowMs = FL_INRUSH_MIN_WINDOW;
+  if (windowMs > FL_INRUSH_MAX_WINDOW) windowMs = FL_INRUSH_MAX_WINDOW;
+
+  c.state = FL_INRUSH_CAPTURING;
+  c.startMs = nowMs;
+  c.windowMs = windowMs;
+  c.spacingMs = windowMs / FL_INRUSH_MAX_SAMPLES;
+  c.count = 0;
+  memset(&c.summary, 0, sizeof(c.summary));
+}
+
+static void summarise(fl_inrush_t& c) {
+  fl_inrush_summary_t& s = c.summary;
+  c.state = FL_INRUSH_DONE;
+  s.samples = c.count;
+  if (c.count == 0) return;
+
+  // Peak
+  uint16_t peak = 0;
+  for (uint16_t i = 0; i < c.count; i++) {
+    if (c.samples[i].centiAmps > peak) {
+      peak = c.samples[i].centiAmps;
+      s.peakMs = c.samples[i].tMs;
+    }
+  }
+  s.peakA = peak / 100.0f;
+
+  // Settled current: mean over the last quarter of the captured span
+  uint16_t lastT = c.samples[c.count - 1].tMs;
+  uint16_t tailFrom = lastT - lastT / 4;
+  uint32_t sum = 0;
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < c.count; i++) {
+    if (c.samples[i].tMs >= tailFrom) {
+      sum += c.samples[i].centiAmps;
+      n++;
+    }
+  }
+  s.settledA = n ? (sum / (float)n) / 100.0f : 0;
+
+  // Time to steady state: just after the last sample outside the band
+  float band = s.settledA * FL_INRUSH_STEADY_BAND;
+  if (band < FL_INRUSH_STEADY_MIN_A) band = FL_INRUSH_STEADY_MIN_A;
+  s.steadyMs = 0;
+  for (int i = c.count - 1; i >= 0; i--) {
+    if (fabsf(c.samples[i].centiAmps / 100.0f - s.settledA) > band) {
+      s.steadyMs = (i + 1 < c.count) ? c.samples[i + 1].tMs : lastT;
+      break;
+    }
+  }
+}
+
+bool fl_inrushAddSample(fl_inrush_t& c, uint32_t sampleMs, float current) {
+  if (c.state != FL_INRUSH_CAPTURING) return false;
+
+  uint32_t t = sampleMs - c.startMs;
+  if ((int32_t)t < 0) return false;   // Read started before the contactor closed
+
+  if (t <= c.windowMs && c.count < FL_INRUSH_MAX_SAMPLES) {
+    bool spaced = c.count == 0 || t >= (uint32_t)c.samples[c.count - 1].tMs + c.spacingMs;
+    if (spaced) {
+      if (current < 0 || isnan(current)) current = 0;
+      float ca = current * 100.0f;
+      fl_inrush_sample_t& smp = c.samples[c.count++];
+      smp.tMs = (uint16_t)t;
+      smp.centiAmps = ca > 65535.0f ? 65535 : (uint16_t)lroundf(ca);
+    }
+  }
+
+  if (t >= c.windowMs || c.count >= FL_INRUSH_MAX_SAMPLES) {
+    summarise(c);
+    return true;
+  }
+  return false;
+}
+
+bool fl_inrushAbort(fl_inrush_t& c) {
+  if (c.state != FL_INRUSH_CAPTURING) return false;
+  c.summary.aborted = true;
+  summarise(c);
+  return true;
+}
@@ -0,0 +1,62 @@
+#ifndef FL_INRUSH_H
+#define FL_INRUSH_H
+
+// Motor-start inrush capture.
+// One capture per pump: started when the contactor closes, fed with current
+// samples for a fixed window, then summarised (peak, time to steady state,
+// settled current). The buffer is filled from the start and stops when full
+// so the peak right after closing is never overwritten; the trace stays
+// readable until the next start. Hardware-free.
+
+#include <stdint.h>
+
+#define FL_INRUSH_MAX_SAMPLES      200
+#define FL_INRUSH_DEFAULT_WINDOW   5000    // ms
+#define FL_INRUSH_MIN_WINDOW       500
+#define FL_INRUSH_MAX_WINDOW       30000
+#define FL_INRUSH_STEADY_BAND      0.10f   // Steady = within 10% of settled current...
+#define FL_INRUSH_STEADY_MIN_A     0.5f    // ...or this many amps, whichever is larger
+
+enum fl_inrush_state_t : uint8_t {
+  FL_INRUSH_IDLE = 0,     // No capture yet
+  FL_INRUSH_CAPTURING,
+  FL_INRUSH_DONE          // Summary and trace valid
+};
+
+struct fl_inrush_sample_t {
+  uint16_t tMs;           // Since contactor close
+  uint16_t centiAmps;     // Current x100 (0..655.35 A)
+};
+
+struct fl_inrush_summary_t {
+  float peakA;
+  uint16_t peakMs;        // Time of peak since close
+  uint16_t steadyMs;      // Time after which current stays in the steady band
+  float settledA;         // Mean over the last quarter of the window
+  uint16_t samples;
+  bool aborted;           // Contactor opened before the window ended
+};
+
+struct fl_inrush_t {
+  fl_inrush_state_t state;
+  uint32_t startMs;       // millis() at contactor close
+  uint16_t windowMs;
+  uint16_t spacingMs;     // Minimum sample spacing so the window fits the buffer
+  uint16_t count;
+  fl_inrush_sample_t samples[FL_INRUSH_MAX_SAMPLES];
+  fl_inrush_summary_t summary;
+};
+
+// Begin a new capture (discards the previous trace)
+void fl_inrushStart(fl_inrush_t& c, uint32_t nowMs, uint16_t windowMs);
+
+// Add a sample. Returns true when this sample completes the capture.
+bool fl_inrushAddSample(fl_inrush_t& c, uint32_t sampleMs, float current);
+
+// End a running capture early (contactor opened). Returns true if a capture
+// was running and has now been summarised.
+bool fl_inrushAbort(fl_inrush_t& c);
+
+inline bool fl_inrushCapturing(const fl_inrush_t& c) { return c.state == FL_INRUSH_CAPTURING; }
+
+#endif
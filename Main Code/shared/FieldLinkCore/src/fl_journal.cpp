@@ -0,0 +1,332 @@
+#include "fl_journal.h"
+#include <string.h>
+
+#define STATE_PENDING  0xFF
+#define STATE_SENT     0x00
+#define LEN_FREE       0xFFFF
+
+struct sector_header_t {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t erases;              // Lifetime, including the one that opened this sector
+  uint8_t drained;              // STATE_SENT once every record has been replayed
+  uint8_t reserved[3];
+};
+
+struct record_header_t {
+  uint16_t len;
+  uint8_t type;
+  uint8_t state;
+  uint32_t ts;
+  uint32_t crc;                 // Over len, type, ts and the payload
+};
+
+static_assert(sizeof(sector_header_t) == 16, "Sector header layout");
+static_assert(sizeof(record_header_t) == 12, "Record header layout");
+
+#define FIRST_RECORD   sizeof(sector_header_t)
+
+static uint32_t crc32Update(uint32_t crc, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint32_t recordCrc(const record_header_t& h, const void* payload) {
+  uint32_t crc = crc32Update(0, &h.len, sizeof(h.len));
+  crc = crc32Update(crc, &h.type, sizeof(h.type));
+  crc = crc32Update(crc, &h.ts, sizeof(h.ts));
+  return crc32Update(crc, payload, h.len);
+}
+
+static uint16_t recordSize(uint16_t len) {
+  return (sizeof(record_header_t) + len + 3) & ~3;
+}
+
+static uint32_t addrOf(uint16_t sector, uint16_t offset) {
+  return (uint32_t)sector * FL_JOURNAL_SECTOR + offset;
+}
+
+// Sector holding sequence 'seq' (which must be in the ring)
+static uint16_t sectorOf(const fl_journal_t& j, uint32_t seq) {
+  uint32_t back = (j.headSeq - seq) % j.sectors;
+  return (j.headSector + j.sectors - back) % j.sectors;
+}
+
+static bool readSectorHeader(fl_journal_t& j, uint16_t sector, sector_header_t& h) {
+  if (!j.port->read(addrOf(sector, 0), &h, sizeof(h))) {
+    j.errors++;
+    return false;
+  }
+  return h.magic == FL_JOURNAL_MAGIC && h.seq != 0xFFFFFFFF;
+}
+
+// Header of the record at 'offset', false at the end of the sector's records
+static bool readRecordHeader(fl_journal_t& j, uint16_t sector, uint16_t offset, record_header_t& h) {
+  if (offset + sizeof(h) > FL_JOURNAL_SECTOR) return false;
+  if (!j.port->read(addrOf(sector, offset), &h, sizeof(h))) {
+    j.errors++;
+    return false;
+  }
+  return h.len != LEN_FREE && h.len <= FL_JOURNAL_MAX_RECORD &&
+         offset + recordSize(h.len) <= FL_JOURNAL_SECTOR;
+}
+
+// Payload into buf and CRC check
+static bool readRecordPayload(fl_journal_t& j, uint16_t sector, uint16_t offset, const record_header_t& h,
+                              uint8_t* buf) {
+  if (!j.port->read(addrOf(sector, offset + sizeof(h)), buf, h.len)) {
+    j.errors++;
+    return false;
+  }
+  return recordCrc(h, buf) == h.crc;
+}
+
+static void program(fl_journal_t& j, uint32_t addr, const void* data, size_t len) {
+  if (j.port->write(addr, data, len)) j.bytesFlash += len;
+  else j.errors++;
+}
+
+// Pending records of one sector from 'offset' on. Verifies CRCs, so a torn
+// record ends the count as it ends replay.
+static uint32_t countPending(fl_journal_t& j, uint16_t sector, uint16_t offset, uint16_t end) {
+  static uint8_t buf[FL_JOURNAL_MAX_RECORD];
+  uint32_t n = 0;
+  record_header_t h;
+  while (offset < end && readRecordHeader(j, sector, offset, h)) {
+    if (!readRecordPayload(j, sector, offset, h, buf)) break;
+    if (h.state == STATE_PENDING) n++;
+    offset += recordSize(h.len);
+  }
+  return n;
+}
+
+// First free offset of the head sector. A torn record seals the sector.
+static uint16_t findHeadOffset(fl_journal_t& j) {
+  static uint8_t buf[FL_JOURNAL_MAX_RECORD];
+  uint16_t offset = FIRST_RECORD;
+  record_header_t h;
+  while (offset + sizeof(h) <= FL_JOURNAL_SECTOR) {
+    if (!j.port->read(addrOf(j.headSector, offset), &h, sizeof(h))) {
+      j.errors++;
+      return FL_JOURNAL_SECTOR;
+    }
+    if (h.len == LEN_FREE) return offset;
+    if (h.len > FL_JOURNAL_MAX_RECORD || offset + recordSize(h.len) > FL_JOURNAL_SECTOR ||
+        !readRecordPayload(j, j.headSector, offset, h, buf))
+      return FL_JOURNAL_SECTOR;
+    offset += recordSize(h.len);
+  }
+  return FL_JOURNAL_SECTOR;
+}
+
+// Replay has finished with the sector at readSeq: flag it, move on
+static void nextReadSector(fl_journal_t& j) {
+  if (j.readSeq < j.headSeq) {
+    uint8_t drained = STATE_SENT;
+    program(j, addrOf(sectorOf(j, j.readSeq), offsetof(sector_header_t, drained)), &drained, 1);
+  }
+  j.readSeq++;
+  j.readOffset = FIRST_RECORD;
+}
+
+bool fl_journalMount(fl_journal_t& j, const fl_flash_port_t* port, uint32_t size) {
+  memset(&j, 0, sizeof(j));
+  j.port = port;
+  j.sectors = size / FL_JOURNAL_SECTOR;
+  if (!port || j.sectors < 2) return false;
+
+  // Head: highest sequence. Tail: lowest one still within a ring's length.
+  uint32_t minSeq = 0xFFFFFFFF;
+  for (uint16_t s = 0; s < j.sectors; s++) {
+    sector_header_t h;
+    if (!readSectorHeader(j, s, h)) continue;
+    if (h.seq > j.headSeq) {
+      j.headSeq = h.seq;
+      j.headSector = s;
+    }
+    if (h.seq < minSeq) minSeq = h.seq;
+    if (h.erases > j.eraseMax) j.eraseMax = h.erases;
+  }
+
+  if (j.headSeq == 0) {
+    // Empty (or foreign data): the first append opens sector 0
+    j.headSector = j.sectors - 1;
+    j.headOffset = FL_JOURNAL_SECTOR;
+    j.tailSeq = 1;
+    j.readSeq = 1;
+    j.readOffset = FIRST_RECORD;
+    j.ready = true;
+    return true;
+  }
+
+  j.headOffset = findHeadOffset(j);
+  j.tailSeq = minSeq;
+  if (j.headSeq >= j.sectors && j.tailSeq < j.headSeq - j.sectors + 1) j.tailSeq = j.headSeq - j.sectors + 1;
+
+  // Replay resumes in the oldest sector not flagged drained, at its first
+  // pending record
+  j.readSeq = j.headSeq + 1;
+  j.readOffset = FIRST_RECORD;
+  for (uint32_t q = j.tailSeq; q <= j.headSeq; q++) {
+    uint16_t s = sectorOf(j, q);
+    sector_header_t h;
+    if (!readSectorHeader(j, s, h) || h.seq != q || h.drained != STATE_PENDING) continue;
+    uint16_t end = q == j.headSeq ? j.headOffset : FL_JOURNAL_SECTOR;
+    uint32_t n = countPending(j, s, FIRST_RECORD, end);
+    if (n && j.readSeq > j.headSeq) j.readSeq = q;
+    j.pending += n;
+    if (!n && q < j.headSeq) {
+      // Replayed before the flag was set: flag it now, the next mount skips it
+      uint8_t drained = STATE_SENT;
+      program(j, addrOf(s, offsetof(sector_header_t, drained)), &drained, 1);
+    }
+  }
+  if (j.readSeq > j.headSeq) {
+    j.readSeq = j.headSeq;
+    j.readOffset = j.headOffset;
+  }
+
+  j.ready = true;
+  return true;
+}
+
+// Open the next sector, erasing whatever it held
+static bool advance(fl_journal_t& j) {
+  uint16_t next = (j.headSector + 1) % j.sectors;
+  uint32_t seq = j.headSeq + 1;
+
+  sector_header_t old;
+  uint32_t erases = 1;
+  if (readSectorHeader(j, next, old)) {
+    erases = old.erases + 1;
+    // Ring full: this is the oldest sector. Its unsent records are lost.
+    if (old.seq >= j.readSeq && old.drained == STATE_PENDING) {
+      uint16_t from = old.seq == j.readSeq ? j.readOffset : FIRST_RECORD;
+      uint32_t lost = countPending(j, next, from, FL_JOURNAL_SECTOR);
+      if (lost > j.pending) lost = j.pending;
+      j.pending -= lost;
+      j.dropped += lost;
+    }
+  }
+
+  if (!j.port->erase(addrOf(next, 0))) {
+    j.errors++;
+    return false;
+  }
+  j.erases++;
+  if (erases > j.eraseMax) j.eraseMax = erases;
+
+  sector_header_t h;
+  memset(&h, 0xFF, sizeof(h));
+  h.magic = FL_JOURNAL_MAGIC;
+  h.seq = seq;
+  h.erases = erases;
+  program(j, addrOf(next, 0), &h, sizeof(h));
+
+  bool caughtUp = j.readSeq == j.headSeq && j.readOffset >= j.headOffset;
+  if (caughtUp && j.headSeq) {
+    // Everything in the sector being closed has been replayed
+    uint8_t drained = STATE_SENT;
+    program(j, addrOf(j.headSector, offsetof(sector_header_t, drained)), &drained, 1);
+  }
+  j.headSector = next;
+  j.headSeq = seq;
+  j.headOffset = FIRST_RECORD;
+  if (seq >= j.sectors) j.tailSeq = seq - j.sectors + 1;
+  if (caughtUp || j.readSeq < j.tailSeq) {
+    j.readSeq = caughtUp ? seq : j.tailSeq;
+    j.readOffset = FIRST_RECORD;
+    j.peekSize = 0;
+  }
+  return true;
+}
+
+bool fl_journalAppend(fl_journal_t& j, uint8_t type, uint32_t ts, const void* data, uint16_t len) {
+  if (!j.ready || len > FL_JOURNAL_MAX_RECORD) return false;
+  uint16_t size = recordSize(len);
+  if (j.headOffset + size > FL_JOURNAL_SECTOR && !advance(j)) return false;
+
+  static uint8_t buf[FL_JOURNAL_MAX_RECORD + sizeof(record_header_t) + 3];
+  record_header_t h;
+  h.len = len;
+  h.type = type;
+  h.state = STATE_PENDING;
+  h.ts = ts;
+  h.crc = recordCrc(h, data);
+  memcpy(buf, &h, sizeof(h));
+  memcpy(buf + sizeof(h), data, len);
+  memset(buf + sizeof(h) + len, 0xFF, size - sizeof(h) - len);
+
+  if (!j.port->write(addrOf(j.headSector, j.headOffset), buf, size)) {
+    // Whatever landed is torn: seal the sector
+    j.errors++;
+    j.headOffset = FL_JOURNAL_SECTOR;
+    return false;
+  }
+  j.headOffset += size;
+  j.bytesFlash += size;
+  j.bytesIn += len;
+  j.appended++;
+  j.pending++;
+  return true;
+}
+
+bool fl_journalPeek(fl_journal_t& j, fl_journal_record_t& rec, uint8_t* buf, uint16_t cap) {
+  j.peekSize = 0;
+  if (!j.ready) return false;
+
+  while (j.pending) {
+    if (j.readSeq > j.headSeq || (j.readSeq == j.headSeq && j.readOffset >= j.headOffset)) break;
+    uint16_t sector = sectorOf(j, j.readSeq);
+    record_header_t h;
+    if (!readRecordHeader(j, sector, j.readOffset, h)) {
+      nextReadSector(j);
+      continue;
+    }
+    uint16_t size = recordSize(h.len);
+    if (h.state != STATE_PENDING) {
+      j.readOffset += size;
+      continue;
+    }
+    if (h.len > cap) {
+      // Cannot be delivered: drop it as if replayed
+      uint8_t sent = STATE_SENT;
+      program(j, addrOf(sector, j.readOffset + offsetof(record_header_t, state)), &sent, 1);
+      j.readOffset += size;
+      j.pending--;
+      j.dropped++;
+      continue;
+    }
+    if (!readRecordPayload(j, sector, j.readOffset, h, buf)) {
+      nextReadSector(j);  // Torn: nothing after it in this sector is trustworthy
+      continue;
+    }
+    rec.type = h.type;
+    rec.ts = h.ts;
+    rec.len = h.len;
+    j.peekSize = size;
+    return true;
+  }
+  // Nothing left to replay (the count can only drift after flash errors)
+  j.pending = 0;
+  return false;
+}
+
+void fl_journalAck(fl_journal_t& j) {
+  if (!j.peekSize) return;
+  uint8_t sent = STATE_SENT;
+  program(j, addrOf(sectorOf(j, j.readSeq), j.readOffset + offsetof(record_header_t, state)), &sent, 1);
+  j.readOffset += j.peekSize;
+  j.peekSize = 0;
+  if (j.pending) j.pending--;
+  j.replayed++;
+}
+
+float fl_journalWriteAmplification(const fl_journal_t& j) {
+  return j.bytesIn ? (float)j.bytesFlash / j.bytesIn : 0.0f;
+}
@@ -0,0 +1,92 @@
+#ifndef FL_JOURNAL_H
+#define FL_JOURNAL_H
+
+// Store-and-forward journal: an append-only ring of records on a raw flash
+// partition (the "spiffs" partition, otherwise unused). Telemetry frames and
+// fault events are appended while MQTT is down and replayed, oldest first,
+// once it is back.
+//
+// Layout: 4 KB sectors written in turn round the partition, so every sector
+// is erased equally often (the ring is the wear levelling). A sector opens
+// with a header carrying its sequence number — the ring order, which
+// survives a reboot — and its lifetime erase count. Records follow, 4-byte
+// aligned: u16 len, u8 type, u8 state, u32 timestamp, u32 CRC-32, payload.
+// Replaying a record clears its state byte in place (NOR flash programs 1s
+// to 0s without an erase), and a fully replayed sector clears a flag in its
+// header, so progress survives a reboot without rewriting anything. When
+// the ring is full the oldest sector is erased, pending or not.
+// A record torn by a power cut fails its CRC; the rest of that sector is
+// skipped.
+// Hardware-free: flash access goes through fl_flash_port_t.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FL_JOURNAL_SECTOR       4096
+#define FL_JOURNAL_MAX_RECORD   1024    // Payload bytes
+#define FL_JOURNAL_MAGIC        0x314A4C46   // "FLJ1"
+
+enum fl_journal_type_t : uint8_t {
+  FL_JOURNAL_TELEMETRY = 1,     // JSON telemetry frame
+  FL_JOURNAL_FAULT              // JSON fault event
+};
+
+// Raw flash. Addresses are partition offsets; write only clears bits.
+struct fl_flash_port_t {
+  bool (*read)(uint32_t addr, void* dst, size_t len);
+  bool (*write)(uint32_t addr, const void* src, size_t len);
+  bool (*erase)(uint32_t addr);           // One FL_JOURNAL_SECTOR
+};
+
+struct fl_journal_record_t {
+  uint8_t type;
+  uint32_t ts;                  // Epoch seconds, 0 = clock not set
+  uint16_t len;
+};
+
+struct fl_journal_t {
+  const fl_flash_port_t* port;
+  bool ready;
+  uint16_t sectors;
+
+  // Write head, and the oldest sector still in the ring (by sequence)
+  uint16_t headSector;
+  uint32_t headSeq;             // 0 = empty journal
+  uint16_t headOffset;
+  uint32_t tailSeq;
+
+  // Next record to replay
+  uint32_t readSeq;
+  uint16_t readOffset;
+  uint16_t peekSize;            // Flash size of the record fl_journalPeek() returned, 0 = none
+  uint32_t pending;
+
+  // Since boot
+  uint32_t appended;
+  uint32_t replayed;
+  uint32_t dropped;             // Pending records lost to a full ring
+  uint32_t bytesIn;             // Payload bytes appended
+  uint32_t bytesFlash;          // Bytes programmed: headers, padding, replay marks
+  uint32_t erases;
+  uint32_t errors;              // Failed flash operations
+
+  // Lifetime, from the sector headers
+  uint32_t eraseMax;            // Most-erased sector
+};
+
+// Find the head, tail and replay position. 'size' is the partition size.
+bool fl_journalMount(fl_journal_t& j, const fl_flash_port_t* port, uint32_t size);
+
+bool fl_journalAppend(fl_journal_t& j, uint8_t type, uint32_t ts, const void* data, uint16_t len);
+
+// Oldest record not yet replayed. The payload is copied to buf (records
+// larger than cap are skipped). Returns false when there is none.
+bool fl_journalPeek(fl_journal_t& j, fl_journal_record_t& rec, uint8_t* buf, uint16_t cap);
+
+// Mark the record from fl_journalPeek() as replayed
+void fl_journalAck(fl_journal_t& j);
+
+// Flash bytes programmed per payload byte (1.0 = no overhead)
+float fl_journalWriteAmplification(const fl_journal_t& j);
+
+#endif
@@ -0,0 +1,134 @@
+#include "fl_jsonw.h"
+#include <math.h>
+#include <string.h>
+
+static void put(fl_jsonw_t& w, char c) {
+  if (w.len + 1 < w.cap) w.buf[w.len++] = c;
+  else w.overflow = true;
+}
+
+static void putRaw(fl_jsonw_t& w, const char* s) {
+  while (*s) put(w, *s++);
+}
+
+static void putUInt(fl_jsonw_t& w, uint32_t v) {
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) put(w, digits[--n]);
+}
+
+static void putString(fl_jsonw_t& w, const char* s) {
+  put(w, '"');
+  for (; *s; s++) {
+    char esc = 0;
+    switch (*s) {
+      case '"':  esc = '"'; break;
+      case '\\': esc = '\\'; break;
+      case '\b': esc = 'b'; break;
+      case '\f': esc = 'f'; break;
+      case '\n': esc = 'n'; break;
+      case '\r': esc = 'r'; break;
+      case '\t': esc = 't'; break;
+    }
+    if (esc) {
+      put(w, '\\');
+      put(w, esc);
+    } else {
+      put(w, *s);
+    }
+  }
+  put(w, '"');
+}
+
+static void member(fl_jsonw_t& w, const char* key) {
+  if (!w.first) put(w, ',');
+  w.first = false;
+  putString(w, key);
+  put(w, ':');
+}
+
+void fl_jsonwBegin(fl_jsonw_t& w, char* buf, size_t cap) {
+  w.buf = buf;
+  w.cap = cap;
+  w.len = 0;
+  w.overflow = cap == 0;
+  w.first = true;
+  put(w, '{');
+}
+
+static const uint32_t kScale[] = { 1, 10, 100, 1000 };
+
+// t / 10^decimals with trailing zeros dropped
+static void putScaled(fl_jsonw_t& w, long long t, uint8_t decimals) {
+  if (t < 0) {
+    put(w, '-');
+    t = -t;
+  }
+  uint32_t whole = (uint32_t)(t / kScale[decimals]);
+  uint32_t frac = (uint32_t)(t % kScale[decimals]);
+  putUInt(w, whole);
+  if (frac == 0) return;
+
+  char digits[3];
+  uint8_t n = decimals;
+  for (uint8_t k = n; k > 0; k--) {
+    digits[k - 1] = '0' + frac % 10;
+    frac /= 10;
+  }
+  while (digits[n - 1] == '0') n--;    // 1.50 -> 1.5
+  put(w, '.');
+  for (uint8_t k = 0; k < n; k++) put(w, digits[k]);
+}
+
+void fl_jsonwFixed(fl_jsonw_t& w, const char* key, float value, uint8_t decimals) {
+  member(w, key);
+  if (!isfinite(value)) {
+    putRaw(w, "null");
+    return;
+  }
+  if (decimals > 3) decimals = 3;
+
+  // Same float product and half-away-from-zero rounding as round(x * 10)
+  putScaled(w, llroundf(value * kScale[decimals]), decimals);
+}
+
+void fl_jsonwScaled(fl_jsonw_t& w, const char* key, uint32_t scaled, uint8_t decimals) {
+  member(w, key);
+  putScaled(w, scaled, decimals > 3 ? 3 : decimals);
+}
+
+void fl_jsonwInt(fl_jsonw_t& w, const char* key, int32_t value) {
+  member(w, key);
+  if (value < 0) {
+    put(w, '-');
+    putUInt(w, 0u - (uint32_t)value);
+  } else {
+    putUInt(w, (uint32_t)value);
+  }
+}
+
+void fl_jsonwUInt(fl_jsonw_t& w, const char* key, uint32_t value) {
+  member(w, key);
+  putUInt(w, value);
+}
+
+void fl_jsonwBool(fl_jsonw_t& w, const char* key, bool value) {
+  member(w, key);
+  putRaw(w, value ? "true" : "false");
+}
+
+void fl_jsonwStr(fl_jsonw_t& w, const char* key, const char* value) {
+  member(w, key);
+  if (value) putString(w, value);
+  else putRaw(w, "null");
+}
+
+size_t fl_jsonwEnd(fl_jsonw_t& w) {
+  put(w, '}');
+  if (w.cap) w.buf[w.len < w.cap ? w.len : w.cap - 1] = '\0';
+  return w.overflow ? 0 : w.len;
+}
@@ -0,0 +1,38 @@
+#ifndef FL_JSONW_H
+#define FL_JSONW_H
+
+// Append-only JSON object writer for the hot telemetry paths.
+// Writes one flat object straight into a caller buffer: no JsonDocument,
+// no heap, no double formatting. Numbers are fixed-point — the value is
+// rounded to 'decimals' places as an integer and printed with trailing
+// zeros dropped, which is exactly what ArduinoJson prints for the
+// round(x * 10) / 10.0 doubles the schema used to carry (magnitudes under
+// 1e7; NaN and infinity print as null, as ArduinoJson does by default).
+// Strings get ArduinoJson's escaping. Hardware-free.
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct fl_jsonw_t {
+  char* buf;
+  size_t cap;
+  size_t len;
+  bool overflow;               // Output truncated; fl_jsonwEnd() returns 0
+  bool first;                  // No member written yet
+};
+
+void fl_jsonwBegin(fl_jsonw_t& w, char* buf, size_t cap);
+
+void fl_jsonwFixed(fl_jsonw_t& w, const char* key, float value, uint8_t decimals);
+// An integer already scaled by 10^decimals, printed like fl_jsonwFixed():
+// exact for counters beyond a float's precision
+void fl_jsonwScaled(fl_jsonw_t& w, const char* key, uint32_t scaled, uint8_t decimals);
+void fl_jsonwInt(fl_jsonw_t& w, const char* key, int32_t value);
+void fl_jsonwUInt(fl_jsonw_t& w, const char* key, uint32_t value);
+void fl_jsonwBool(fl_jsonw_t& w, const char* key, bool value);
+void fl_jsonwStr(fl_jsonw_t& w, const char* key, const char* value);
+
+// Closes the object and NUL-terminates. Returns the length, 0 on overflow.
+size_t fl_jsonwEnd(fl_jsonw_t& w);
+
+#endif
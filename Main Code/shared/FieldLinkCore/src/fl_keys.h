@@ -0,0 +1,68 @@
+#ifndef FL_KEYS_H
+#define FL_KEYS_H
+
+// Telemetry and NVS key names built at compile time, so the hot paths
+// carry no key formatting. Hardware-free.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <type_traits>
+
+// Prefix plus 1-based index as a static string: fl_key_str<1, 'c', 'f'>::value == "cf2"
+template <size_t I, char... P>
+struct fl_key_str {
+  static_assert(I < 9, "Single-digit indices only");
+  static constexpr char value[sizeof...(P) + 2] = { P..., char('1' + I), '\0' };
+};
+
+template <typename Seq, char... P>
+struct fl_key_seq;
+
+template <size_t... I, char... P>
+struct fl_key_seq<std::index_sequence<I...>, P...> {
+  static constexpr const char* key[sizeof...(I)] = { fl_key_str<I, P...>::value... };
+};
+
+// key[0..N-1] = "<prefix>1".."<prefix>N"
+template <uint8_t N, char... P>
+using fl_key_table = fl_key_seq<std::make_index_sequence<N>, P...>;
+
+// Prefix alone
+template <char... P>
+struct fl_key_bare {
+  static constexpr char value[sizeof...(P) + 1] = { P..., '\0' };
+  static constexpr const char* key[1] = { value };
+};
+
+// Prefix, 1-based index, suffix: fl_key_str_sfx<0, fl_chars<'I', 'L'>, fl_chars<'m', 'a', 'x'>>::value == "IL1max"
+template <char... C>
+struct fl_chars {};
+
+template <size_t I, class Prefix, class Suffix>
+struct fl_key_str_sfx;
+
+template <size_t I, char... P, char... S>
+struct fl_key_str_sfx<I, fl_chars<P...>, fl_chars<S...>> {
+  static_assert(I < 9, "Single-digit indices only");
+  static constexpr char value[sizeof...(P) + sizeof...(S) + 2] = { P..., char('1' + I), S..., '\0' };
+};
+
+template <typename Seq, class Prefix, class Suffix>
+struct fl_key_seq_sfx;
+
+template <size_t... I, class Prefix, class Suffix>
+struct fl_key_seq_sfx<std::index_sequence<I...>, Prefix, Suffix> {
+  static constexpr const char* key[sizeof...(I)] = { fl_key_str_sfx<I, Prefix, Suffix>::value... };
+};
+
+// key[0..N-1] = "<prefix>1<suffix>".."<prefix>N<suffix>"
+template <uint8_t N, class Prefix, class Suffix>
+using fl_key_table_sfx = fl_key_seq_sfx<std::make_index_sequence<N>, Prefix, Suffix>;
+
+// Per-pump telemetry keys: numbered with several pumps ("s1".."s3"), bare
+// with one ("s")
+template <uint8_t N, char... P>
+using fl_pump_keys = std::conditional_t<N == 1, fl_key_bare<P...>, fl_key_table<N, P...>>;
+
+#endif
@@ -0,0 +1,105 @@
+#include "fl_meter.h"
+#include "fl_modbus_rtu.h"
+#include <ctype.h>
+
+/* ================= REGISTER MAPS ================= */
+
+// Eastron SDM630-Modbus — input registers, IEEE754 float, high word first
+struct fl_map_sdm630 {
+  static constexpr const char* name = "SDM630";
+  static constexpr uint8_t function = FL_RTU_FC_READ_INPUT;
+  static constexpr uint8_t maxGap = 16;
+  static constexpr fl_reg_def_t regs[] = {
+    { FL_Q_V1,  0x0000, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_V2,  0x0002, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_V3,  0x0004, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_I1,  0x0006, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_I2,  0x0008, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_I3,  0x000A, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_KW,  0x0034, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 0.001f },  // W -> kW
+    { FL_Q_PF,  0x003E, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_HZ,  0x0046, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+    { FL_Q_KWH, 0x0048, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f   },
+  };
+};
+
+// Acrel ADL400 3P — holding registers, scaled integers, high word first.
+// Secondary values (CT/PT ratio 1). Addresses per the ADL400 Modbus table;
+// not yet validated against a real meter (see BUG-002).
+struct fl_map_adl400 {
+  static constexpr const char* name = "ADL400";
+  static constexpr uint8_t function = FL_RTU_FC_READ_HOLDING;
+  static constexpr uint8_t maxGap = 24;
+  static constexpr fl_reg_def_t regs[] = {
+    { FL_Q_KWH, 0x0000, FL_REG_UINT32, FL_WORDS_HIGH_FIRST, 0.01f  },
+    { FL_Q_V1,  0x0061, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.1f   },
+    { FL_Q_V2,  0x0062, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.1f   },
+    { FL_Q_V3,  0x0063, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.1f   },
+    { FL_Q_I1,  0x0064, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.01f  },
+    { FL_Q_I2,  0x0065, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.01f  },
+    { FL_Q_I3,  0x0066, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.01f  },
+    { FL_Q_HZ,  0x0077, FL_REG_UINT16, FL_WORDS_HIGH_FIRST, 0.01f  },
+    { FL_Q_KW,  0x016A, FL_REG_INT32,  FL_WORDS_HIGH_FIRST, 0.001f },  // W -> kW
+    { FL_Q_PF,  0x017F, FL_REG_INT16,  FL_WORDS_HIGH_FIRST, 0.001f },
+  };
+};
+
+// Generic float meter — the original hard-coded layout (V1..V3, I1..I3 as
+// float32 from input register 0x0000). Fallback for Eastron-compatible meters.
+struct fl_map_generic {
+  static constexpr const char* name = "GENERIC";
+  static constexpr uint8_t function = FL_RTU_FC_READ_INPUT;
+  static constexpr uint8_t maxGap = 0;
+  static constexpr fl_reg_def_t regs[] = {
+    { FL_Q_V1,  0x0000, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+    { FL_Q_V2,  0x0002, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+    { FL_Q_V3,  0x0004, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+    { FL_Q_I1,  0x0006, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+    { FL_Q_I2,  0x0008, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+    { FL_Q_I3,  0x000A, FL_REG_FLOAT32, FL_WORDS_HIGH_FIRST, 1.0f },
+  };
+};
+
+const fl_meter_driver_t fl_meterDrivers[FL_METER_MODEL_COUNT] = {
+  fl_makeMeterDriver<fl_map_sdm630>(),
+  fl_makeMeterDriver<fl_map_adl400>(),
+  fl_makeMeterDriver<fl_map_generic>(),
+};
+
+// The SDM630 V+I plan must stay the single 12-register read it always was
+static_assert(fl_planMeterReads(fl_makeMeterDriver<fl_map_sdm630>(), FL_QMASK_VI).blockCount == 1,
+              "SDM630 V/I must be one block");
+static_assert(fl_planMeterReads(fl_makeMeterDriver<fl_map_sdm630>(), FL_QMASK_VI).blocks[0].count == 12,
+              "SDM630 V/I must be 12 registers");
+
+/* ================= DECODE ================= */
+
+uint16_t fl_decodeMeterBlock(const fl_meter_driver_t& d, const fl_meter_block_t& b,
+                             uint16_t wanted, const uint16_t* words, float* values) {
+  uint16_t got = 0;
+  for (uint8_t i = b.firstReg; i <= b.lastReg; i++) {
+    const fl_reg_def_t& r = d.regs[i];
+    if (!(wanted & FL_QMASK(r.quantity))) continue;
+    values[r.quantity] = d.decoders[i](words + (r.address - b.address));
+    got |= FL_QMASK(r.quantity);
+  }
+  return got;
+}
+
+/* ================= MODEL NAMES ================= */
+
+const char* fl_meterModelName(fl_meter_model_t model) {
+  if (model >= FL_METER_MODEL_COUNT) return "UNKNOWN";
+  return fl_meterDrivers[model].name;
+}
+
+fl_meter_model_t fl_meterModelFromName(const char* name) {
+  if (!name) return FL_METER_MODEL_COUNT;
+  for (uint8_t m = 0; m < FL_METER_MODEL_COUNT; m++) {
+    const char* a = fl_meterDrivers[m].name;
+    const char* b = name;
+    while (*a && *b && toupper((unsigned char)*a) == toupper((unsigned char)*b)) { a++; b++; }
+    if (*a == '\0' && *b == '\0') return (fl_meter_model_t)m;
+  }
+  return FL_METER_MODEL_COUNT;
+}
@@ -0,0 +1,203 @@
+#ifndef FL_METER_H
+#define FL_METER_H
+
+// Energy-meter driver layer.
+// Each meter model is a compile-time register map (address, word count,
+// word order, scaling, data type). Decoders are generated per map entry at
+// compile time, and a planner turns the quantities a project asks for into
+// the minimal set of contiguous block reads. Hardware-free.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+
+/* ---- Quantities ---- */
+
+enum fl_quantity_t : uint8_t {
+  FL_Q_V1 = 0, FL_Q_V2, FL_Q_V3,     // Phase voltages (V)
+  FL_Q_I1, FL_Q_I2, FL_Q_I3,         // Phase currents (A)
+  FL_Q_KW,                           // Total active power (kW)
+  FL_Q_PF,                           // Total power factor
+  FL_Q_HZ,                           // Frequency (Hz)
+  FL_Q_KWH,                          // Total import energy (kWh)
+  FL_Q_COUNT
+};
+
+#define FL_QMASK(q)     ((uint16_t)(1u << (q)))
+#define FL_QMASK_VOLTS  (FL_QMASK(FL_Q_V1) | FL_QMASK(FL_Q_V2) | FL_QMASK(FL_Q_V3))
+#define FL_QMASK_AMPS   (FL_QMASK(FL_Q_I1) | FL_QMASK(FL_Q_I2) | FL_QMASK(FL_Q_I3))
+#define FL_QMASK_VI     (FL_QMASK_VOLTS | FL_QMASK_AMPS)
+#define FL_QMASK_ALL    ((uint16_t)((1u << FL_Q_COUNT) - 1))
+
+/* ---- Register maps ---- */
+
+enum fl_reg_type_t : uint8_t {
+  FL_REG_FLOAT32,
+  FL_REG_INT16,
+  FL_REG_UINT16,
+  FL_REG_INT32,
+  FL_REG_UINT32
+};
+
+enum fl_word_order_t : uint8_t {
+  FL_WORDS_HIGH_FIRST,   // ABCD
+  FL_WORDS_LOW_FIRST     // CDAB
+};
+
+struct fl_reg_def_t {
+  fl_quantity_t quantity;
+  uint16_t address;
+  fl_reg_type_t type;
+  fl_word_order_t order;
+  float scale;           // Engineering value = raw * scale
+};
+
+constexpr uint8_t fl_regWords(fl_reg_type_t t) {
+  return (t == FL_REG_INT16 || t == FL_REG_UINT16) ? 1 : 2;
+}
+
+// A meter map is a type with:
+//   static constexpr const char* name;
+//   static constexpr uint8_t function;      // FC03 holding / FC04 input
+//   static constexpr uint8_t maxGap;        // Unused words a block may span
+//   static constexpr fl_reg_def_t regs[];   // Sorted by address
+
+/* ---- Compile-time decoders ---- */
+
+typedef float (*fl_reg_decoder_t)(const uint16_t* words);
+
+template <typename Map, size_t I>
+float fl_decodeReg(const uint16_t* w) {
+  constexpr fl_reg_def_t R = Map::regs[I];
+
+  if constexpr (R.type == FL_REG_INT16) {
+    return (int16_t)w[0] * R.scale;
+  } else if constexpr (R.type == FL_REG_UINT16) {
+    return w[0] * R.scale;
+  } else {
+    uint32_t raw;
+    if constexpr (R.order == FL_WORDS_HIGH_FIRST) raw = ((uint32_t)w[0] << 16) | w[1];
+    else                                          raw = ((uint32_t)w[1] << 16) | w[0];
+
+    if constexpr (R.type == FL_REG_FLOAT32) {
+      float f;
+      memcpy(&f, &raw, sizeof(f));
+      if constexpr (R.scale == 1.0f) return f;
+      else return f * R.scale;
+    } else if constexpr (R.type == FL_REG_INT32) {
+      return (int32_t)raw * R.scale;
+    } else {
+      return raw * R.scale;
+    }
+  }
+}
+
+template <typename Map, typename Seq> struct fl_decoder_table;
+
+template <typename Map, size_t... I>
+struct fl_decoder_table<Map, std::index_sequence<I...>> {
+  static constexpr fl_reg_decoder_t fns[] = { &fl_decodeReg<Map, I>... };
+};
+
+template <typename Map>
+constexpr size_t fl_mapSize() { return sizeof(Map::regs) / sizeof(Map::regs[0]); }
+
+template <typename Map>
+constexpr bool fl_mapSorted() {
+  for (size_t i = 1; i < fl_mapSize<Map>(); i++) {
+    if (Map::regs[i].address < Map::regs[i - 1].address + fl_regWords(Map::regs[i - 1].type)) return false;
+  }
+  return true;
+}
+
+/* ---- Type-erased driver (selectable at runtime) ---- */
+
+struct fl_meter_driver_t {
+  const char* name;
+  uint8_t function;
+  uint8_t maxGap;
+  uint8_t regCount;
+  const fl_reg_def_t* regs;
+  const fl_reg_decoder_t* decoders;
+};
+
+template <typename Map>
+constexpr fl_meter_driver_t fl_makeMeterDriver() {
+  static_assert(fl_mapSorted<Map>(), "meter map must be sorted by address without overlaps");
+  using Table = fl_decoder_table<Map, std::make_index_sequence<fl_mapSize<Map>()>>;
+  return { Map::name, Map::function, Map::maxGap, (uint8_t)fl_mapSize<Map>(), Map::regs, Table::fns };
+}
+
+/* ---- Read planner ---- */
+
+#define FL_METER_MAX_BLOCKS      6
+#define FL_METER_MAX_BLOCK_REGS  64   // Matches FL_RTU_MAX_REGS
+
+struct fl_meter_block_t {
+  uint16_t address;
+  uint8_t count;       // Registers to read
+  uint8_t firstReg;    // Index range into driver.regs covered by this block
+  uint8_t lastReg;
+};
+
+struct fl_meter_plan_t {
+  uint8_t blockCount;
+  uint16_t mask;       // Quantities the plan actually delivers
+  fl_meter_block_t blocks[FL_METER_MAX_BLOCKS];
+};
+
+// Greedy merge over the address-sorted map: a block is extended while the
+// next wanted register is within maxGap words and the block stays under
+// FL_METER_MAX_BLOCK_REGS. Optimal in block count for sorted intervals.
+constexpr fl_meter_plan_t fl_planMeterReads(const fl_meter_driver_t& d, uint16_t wanted) {
+  fl_meter_plan_t plan = {};
+  uint16_t blockEnd = 0;   // One past the last word of the open block
+  for (uint8_t i = 0; i < d.regCount; i++) {
+    const fl_reg_def_t& r = d.regs[i];
+    if (!(wanted & FL_QMASK(r.quantity))) continue;
+
+    uint16_t end = r.address + fl_regWords(r.type);
+    if (plan.blockCount > 0) {
+      fl_meter_block_t& b = plan.blocks[plan.blockCount - 1];
+      if (r.address <= blockEnd + d.maxGap && end - b.address <= FL_METER_MAX_BLOCK_REGS) {
+        b.count = end - b.address;
+        b.lastReg = i;
+        blockEnd = end;
+        plan.mask |= FL_QMASK(r.quantity);
+        continue;
+      }
+    }
+    if (plan.blockCount >= FL_METER_MAX_BLOCKS) break;
+    fl_meter_block_t& b = plan.blocks[plan.blockCount++];
+    b.address = r.address;
+    b.count = end - r.address;
+    b.firstReg = i;
+    b.lastReg = i;
+    blockEnd = end;
+    plan.mask |= FL_QMASK(r.quantity);
+  }
+  return plan;
+}
+
+// Decode one completed block into values[FL_Q_COUNT]. Returns the mask of
+// quantities written.
+uint16_t fl_decodeMeterBlock(const fl_meter_driver_t& d, const fl_meter_block_t& b,
+                             uint16_t wanted, const uint16_t* words, float* values);
+
+/* ---- Built-in models ---- */
+
+enum fl_meter_model_t : uint8_t {
+  FL_METER_SDM630 = 0,   // Eastron SDM630-Modbus (primary)
+  FL_METER_ADL400,       // Acrel ADL400 3P
+  FL_METER_GENERIC,      // Float32 V/I block at 0x0000 (legacy layout)
+  FL_METER_MODEL_COUNT
+};
+
+extern const fl_meter_driver_t fl_meterDrivers[FL_METER_MODEL_COUNT];
+
+const char* fl_meterModelName(fl_meter_model_t model);
+// Case-insensitive name lookup. Returns FL_METER_MODEL_COUNT if unknown.
+fl_meter_model_t fl_meterModelFromName(const char* name);
+
+#endif
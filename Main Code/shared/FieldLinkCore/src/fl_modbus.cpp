@@ -1,23 +1,66 @@
 #include "fl_modbus.h"
 #include "fl_pins.h"
+#include "fl_seqlock.h"
+#include "fl_storage.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
-float fl_Va = 0, fl_Vb = 0, fl_Vc = 0;
-float fl_Ia = 0, fl_Ib = 0, fl_Ic = 0;
-bool fl_sensorOnline = false;
-int fl_modbusFailCount = 0;
+volatile bool fl_sensorOnline = false;
 
-ModbusMaster fl_modbusNode;
+fl_rtu_master_t fl_modbusMaster;
+fl_bus_t fl_modbusBus;
 static HardwareSerial fl_RS485(2);
 
-static void preTransmission()  { digitalWrite(FL_RS485_DE, HIGH); }
-static void postTransmission() { digitalWrite(FL_RS485_DE, LOW); }
+static TaskHandle_t _sensorTask = nullptr;
+static volatile bool _readNow = false;
 
-static float registersToFloat(uint16_t high, uint16_t low) {
-  uint32_t combined = ((uint32_t)high << 16) | low;
-  float result;
-  memcpy(&result, &combined, sizeof(float));
-  return result;
-}
+// Adaptive rate. Applied from fl_setSensorRate() (loop task); boosts may be
+// requested from any task and are picked up there. A new interval is only
+// posted here — the poller copies it into the bus devices, the same way
+// _readNow is handed over.
+static uint32_t _normalIntervalMs = FL_SENSOR_DEFAULT_PERIOD_MS;
+static volatile uint32_t _currentIntervalMs = FL_SENSOR_DEFAULT_PERIOD_MS;
+static volatile uint32_t _intervalSeq = 0;      // Bumped after each new interval
+static uint32_t _appliedIntervalSeq = 0;        // Poller only
+static fl_sensor_rate_t _effectiveRate = FL_RATE_NORMAL;
+static volatile unsigned long _boostUntil = 0;
+static volatile bool _boostActive = false;
+
+// One energy meter on the bus. Everything except the pending fields and the
+// published snapshot is only touched by whoever polls the bus.
+struct fl_meter_state_t {
+  int8_t device;                    // Bus device id
+  char name[8];
+  fl_meter_model_t model;
+  uint16_t wanted;
+  fl_meter_plan_t plan;
+  float values[FL_Q_COUNT];
+  uint16_t got;
+  fl_sensor_snapshot_t work;        // Acquisition-side working copy
+
+  // Model/quantity changes from other tasks, applied between read cycles
+  volatile uint8_t pendingModel;
+  volatile uint16_t pendingWanted;
+};
+
+static fl_meter_state_t _meters[FL_MAX_METERS];
+static fl_seqlock<fl_sensor_snapshot_t> _snapshots[FL_MAX_METERS];
+static uint8_t _meterCount = 0;
+
+/* ---- RS485 port glue (all calls return immediately) ---- */
+
+static int    rs485Available()                          { return fl_RS485.available(); }
+static int    rs485Read()                               { return fl_RS485.read(); }
+static size_t rs485Write(const uint8_t* data, size_t len) { return fl_RS485.write(data, len); }
+static bool   rs485TxDone()                             { return uart_wait_tx_done(UART_NUM_2, 0) == ESP_OK; }
+// DE is driven by the UART itself (RS485 half-duplex mode), so it drops on the
+// last stop bit even if the loop is late polling — the reply can't collide.
+static void   rs485SetDE(bool on)                       { (void)on; }
+
+static const fl_rtu_port_t rs485Port = {
+  rs485Available, rs485Read, rs485Write, rs485TxDone, rs485SetDE
+};
 
 static bool isValidCurrent(float current) {
   if (isnan(current) || isinf(current)) return false;
@@ -31,86 +74,319 @@ static bool isValidVoltage(float voltage) {
   return true;
 }
 
-void fl_initModbus() {
-  pinMode(FL_RS485_DE, OUTPUT);
-  digitalWrite(FL_RS485_DE, LOW);
 
-  fl_RS485.begin(FL_RS485_BAUD, SERIAL_8N1, FL_RS485_RX, FL_RS485_TX);
-  fl_modbusNode.begin(FL_MODBUS_ID, fl_RS485);
-  fl_modbusNode.preTransmission(preTransmission);
-  fl_modbusNode.postTransmission(postTransmission);
+/* ================= METER CONFIG (NVS) ================= */
+
+// Meter 1 keeps the original "model" key; further meters use "model2".. so
+// existing single-meter installs keep their setting.
+static void meterModelKey(uint8_t meter, char* key, size_t len) {
+  if (meter == 0) snprintf(key, len, "model");
+  else            snprintf(key, len, "model%d", meter + 1);
 }
 
-bool fl_readSensors() {
-  // When sensor is offline, only retry every 30 seconds to avoid
-  // blocking the loop with 2s Modbus timeouts on every read
-  static unsigned long lastRetryTime = 0;
-  if (!fl_sensorOnline && fl_modbusFailCount >= FL_MAX_MODBUS_FAILURES) {
-    if (millis() - lastRetryTime < 30000) {
-      return false;  // Skip — sensor offline, not time to retry yet
-    }
-    lastRetryTime = millis();
-    Serial.println("Retrying Modbus sensor...");
-  }
+static fl_meter_model_t loadMeterModel(uint8_t meter) {
+  char key[12];
+  meterModelKey(meter, key, sizeof(key));
+  fl_preferences.begin("meter", true);
+  uint8_t model = fl_preferences.getUChar(key, FL_METER_SDM630);
+  fl_preferences.end();
+  return model < FL_METER_MODEL_COUNT ? (fl_meter_model_t)model : FL_METER_SDM630;
+}
 
-  // Read voltage (0x0000-0x0005) and current (0x0006-0x000B) in one transaction
-  uint8_t result = fl_modbusNode.readInputRegisters(0x0000, 12);
-
-  if (result != fl_modbusNode.ku8MBSuccess) {
-    fl_modbusFailCount++;
-    if (fl_modbusFailCount >= FL_MAX_MODBUS_FAILURES) {
-      if (fl_sensorOnline) {
-        Serial.println("ERROR: Modbus sensor offline!");
-        fl_sensorOnline = false;
-        // Zero out readings so stale values don't persist
-        fl_Va = 0; fl_Vb = 0; fl_Vc = 0;
-        fl_Ia = 0; fl_Ib = 0; fl_Ic = 0;
-      }
-    }
-    return false;
+// Re-read every meter's model from NVS (applied at the next cycle)
+void fl_loadMeterConfig() {
+  for (uint8_t i = 0; i < _meterCount; i++) {
+    _meters[i].pendingModel = loadMeterModel(i);
   }
+}
+
+void fl_setMeterModel(fl_meter_model_t model, uint8_t meter) {
+  if (model >= FL_METER_MODEL_COUNT || meter >= _meterCount) return;
+  char key[12];
+  meterModelKey(meter, key, sizeof(key));
+  fl_preferences.begin("meter", false);
+  fl_preferences.putUChar(key, model);
+  fl_preferences.end();
+  _meters[meter].pendingModel = model;
+  Serial.printf("Meter %d model set to %s (saved)\n", meter + 1, fl_meterModelName(model));
+}
+
+fl_meter_model_t fl_getMeterModel(uint8_t meter) {
+  if (meter >= _meterCount) return FL_METER_MODEL_COUNT;
+  uint8_t pending = _meters[meter].pendingModel;
+  return pending < FL_METER_MODEL_COUNT ? (fl_meter_model_t)pending : _meters[meter].model;
+}
+
+void fl_setMeterQuantities(uint16_t mask, uint8_t meter) {
+  if (meter >= _meterCount) return;
+  _meters[meter].pendingWanted = (mask & FL_QMASK_ALL) | FL_QMASK_VI;  // V/I always needed for protection
+}
+
+const fl_meter_plan_t& fl_getMeterPlan(uint8_t meter) {
+  return _meters[meter < _meterCount ? meter : 0].plan;
+}
+
+uint8_t fl_getMeterCount() {
+  return _meterCount;
+}
+
+/* ================= METER BUS DEVICE ================= */
 
-  if (!fl_sensorOnline) {
-    Serial.println("Modbus sensor online");
+static void publishSnapshot(fl_meter_state_t& m) {
+  m.work.seq++;
+  m.work.timestampMs = millis();
+  if (&m == &_meters[0]) fl_sensorOnline = m.work.online;
+  _snapshots[&m - _meters].write(m.work);
+}
+
+static void readFailed(fl_meter_state_t& m, fl_rtu_status_t status, const fl_bus_device_t& dev) {
+  m.work.failCount = dev.consecFails;
+  if (!dev.online && m.work.online) {
+    Serial.printf("ERROR: Modbus %s offline! (%s)\n", m.name, fl_rtuStatusToString(status));
+    m.work.online = false;
+    // Zero out readings so stale values don't persist
+    m.work.Va = 0; m.work.Vb = 0; m.work.Vc = 0;
+    m.work.Ia = 0; m.work.Ib = 0; m.work.Ic = 0;
+    m.work.kW = 0; m.work.PF = 0; m.work.Hz = 0;
+    m.work.valid = 0;
   }
-  fl_modbusFailCount = 0;
-  fl_sensorOnline = true;
+  publishSnapshot(m);
+}
 
-  // Parse voltages (registers 0-5)
-  float newVa = registersToFloat(fl_modbusNode.getResponseBuffer(0), fl_modbusNode.getResponseBuffer(1));
-  float newVb = registersToFloat(fl_modbusNode.getResponseBuffer(2), fl_modbusNode.getResponseBuffer(3));
-  float newVc = registersToFloat(fl_modbusNode.getResponseBuffer(4), fl_modbusNode.getResponseBuffer(5));
+static void readComplete(fl_meter_state_t& m) {
+  fl_sensor_snapshot_t& w = m.work;
+  if (!w.online) {
+    Serial.printf("Modbus %s online (%s)\n", m.name, fl_meterModelName(m.model));
+  }
+  w.failCount = 0;
+  w.online = true;
 
-  // Parse currents (registers 6-11)
-  float newIa = registersToFloat(fl_modbusNode.getResponseBuffer(6), fl_modbusNode.getResponseBuffer(7));
-  float newIb = registersToFloat(fl_modbusNode.getResponseBuffer(8), fl_modbusNode.getResponseBuffer(9));
-  float newIc = registersToFloat(fl_modbusNode.getResponseBuffer(10), fl_modbusNode.getResponseBuffer(11));
+  float newVa = m.values[FL_Q_V1], newVb = m.values[FL_Q_V2], newVc = m.values[FL_Q_V3];
+  float newIa = m.values[FL_Q_I1], newIb = m.values[FL_Q_I2], newIc = m.values[FL_Q_I3];
 
   // Validate voltages — reset to 0 on failure so stale values
   // don't persist (prevents system thinking power is present when it's not)
   if (isValidVoltage(newVa) && isValidVoltage(newVb) && isValidVoltage(newVc)) {
-    fl_Va = newVa;
-    fl_Vb = newVb;
-    fl_Vc = newVc;
+    w.Va = newVa;
+    w.Vb = newVb;
+    w.Vc = newVc;
   } else {
     Serial.printf("WARNING: Invalid voltage reading: Va=%.1f Vb=%.1f Vc=%.1f\n", newVa, newVb, newVc);
-    fl_Va = 0;
-    fl_Vb = 0;
-    fl_Vc = 0;
+    w.Va = 0;
+    w.Vb = 0;
+    w.Vc = 0;
   }
 
   // Validate currents — reset to 0 on failure
   if (!isValidCurrent(newIa) || !isValidCurrent(newIb) || !isValidCurrent(newIc)) {
     Serial.printf("WARNING: Invalid current reading: Ia=%.2f Ib=%.2f Ic=%.2f\n", newIa, newIb, newIc);
-    fl_Ia = 0;
-    fl_Ib = 0;
-    fl_Ic = 0;
-    return false;
+    w.Ia = 0;
+    w.Ib = 0;
+    w.Ic = 0;
+  } else {
+    w.Ia = newIa;
+    w.Ib = newIb;
+    w.Ic = newIc;
+  }
+
+  // Optional quantities — only present if the meter map provides them
+  w.valid = m.got;
+  w.kW  = (m.got & FL_QMASK(FL_Q_KW))  && isfinite(m.values[FL_Q_KW])  ? m.values[FL_Q_KW]  : 0;
+  w.PF  = (m.got & FL_QMASK(FL_Q_PF))  && isfinite(m.values[FL_Q_PF])  ? m.values[FL_Q_PF]  : 0;
+  w.Hz  = (m.got & FL_QMASK(FL_Q_HZ))  && isfinite(m.values[FL_Q_HZ])  ? m.values[FL_Q_HZ]  : 0;
+  if ((m.got & FL_QMASK(FL_Q_KWH)) && isfinite(m.values[FL_Q_KWH])) w.kWh = m.values[FL_Q_KWH];
+
+  publishSnapshot(m);
+}
+
+// Bus callbacks — run inside fl_pollModbus()
+static bool meterNextRead(void* ctx, uint8_t index, fl_bus_read_t& out) {
+  fl_meter_state_t& m = *(fl_meter_state_t*)ctx;
+
+  if (index == 0) {
+    // New cycle: apply model / quantity changes, then start from scratch
+    uint8_t pendingModel = m.pendingModel;
+    uint16_t pendingWanted = m.pendingWanted;
+    if (pendingModel < FL_METER_MODEL_COUNT || pendingWanted) {
+      if (pendingModel < FL_METER_MODEL_COUNT) {
+        m.model = (fl_meter_model_t)pendingModel;
+        m.pendingModel = FL_METER_MODEL_COUNT;
+      }
+      if (pendingWanted) {
+        m.wanted = pendingWanted;
+        m.pendingWanted = 0;
+      }
+      m.plan = fl_planMeterReads(fl_meterDrivers[m.model], m.wanted);
+      Serial.printf("%s %s: %d block read(s) per cycle\n", m.name, fl_meterModelName(m.model), m.plan.blockCount);
+    }
+    m.got = 0;
+    for (int i = 0; i < FL_Q_COUNT; i++) m.values[i] = 0;
   }
 
-  fl_Ia = newIa;
-  fl_Ib = newIb;
-  fl_Ic = newIc;
+  if (index >= m.plan.blockCount) return false;
+  const fl_meter_block_t& b = m.plan.blocks[index];
+  out.function = fl_meterDrivers[m.model].function;
+  out.address = b.address;
+  out.count = b.count;
+  return true;
+}
+
+static void meterOnData(void* ctx, uint8_t index, const uint16_t* regs, uint8_t count) {
+  fl_meter_state_t& m = *(fl_meter_state_t*)ctx;
+  if (index >= m.plan.blockCount || count < m.plan.blocks[index].count) return;
+  m.got |= fl_decodeMeterBlock(fl_meterDrivers[m.model], m.plan.blocks[index], m.wanted, regs, m.values);
+}
+
+static void meterCycleDone(void* ctx, fl_rtu_status_t status, const fl_bus_device_t& dev) {
+  fl_meter_state_t& m = *(fl_meter_state_t*)ctx;
+  if (status == FL_RTU_OK) readComplete(m);
+  else                     readFailed(m, status, dev);
+}
+
+static const fl_bus_driver_t meterDriver = { meterNextRead, meterOnData, meterCycleDone };
+
+int fl_addMeter(uint8_t slave, uint32_t periodMs, fl_bus_priority_t priority) {
+  if (_meterCount >= FL_MAX_METERS) return -1;
+
+  uint8_t idx = _meterCount;
+  fl_meter_state_t& m = _meters[idx];
+  memset(&m, 0, sizeof(m));
+  snprintf(m.name, sizeof(m.name), "meter%d", idx + 1);
+  m.wanted = FL_QMASK_VI;
+  m.pendingModel = FL_METER_MODEL_COUNT;
+  m.model = loadMeterModel(idx);
+  m.plan = fl_planMeterReads(fl_meterDrivers[m.model], m.wanted);
+
+  int dev = fl_busAddDevice(fl_modbusBus, m.name, slave, priority, periodMs, &meterDriver, &m);
+  if (dev < 0) return -1;
+  m.device = dev;
+  _meterCount++;
+  Serial.printf("Meter %d: %s (slave %d, %lums)\n", idx + 1, fl_meterModelName(m.model), slave, periodMs);
+  return idx;
+}
+
+int fl_addModbusDevice(const char* name, uint8_t slave, fl_bus_priority_t priority,
+                       uint32_t periodMs, const fl_bus_driver_t* driver, void* ctx) {
+  return fl_busAddDevice(fl_modbusBus, name, slave, priority, periodMs, driver, ctx);
+}
+
+/* ================= INIT + POLLING ================= */
+
+void fl_initModbus() {
+  pinMode(FL_RS485_DE, OUTPUT);
+  digitalWrite(FL_RS485_DE, LOW);
+
+  fl_RS485.begin(FL_RS485_BAUD, SERIAL_8N1, FL_RS485_RX, FL_RS485_TX);
+  // Hand DE to the UART as RTS in half-duplex mode
+  uart_set_pin(UART_NUM_2, FL_RS485_TX, FL_RS485_RX, FL_RS485_DE, UART_PIN_NO_CHANGE);
+  uart_set_mode(UART_NUM_2, UART_MODE_RS485_HALF_DUPLEX);
+  fl_rtuInit(fl_modbusMaster, &rs485Port, FL_RS485_BAUD, FL_MODBUS_TIMEOUT_MS);
+  fl_busInit(fl_modbusBus, &fl_modbusMaster);
+
+  // Primary meter — always meter 1
+  fl_addMeter(FL_MODBUS_ID, FL_SENSOR_DEFAULT_PERIOD_MS, FL_BUS_PRIO_CRITICAL);
+}
 
+bool fl_readSensors() {
+  // Never blocks: the reads themselves happen in fl_pollModbus()
+  if (_meterCount == 0) return false;
+  _readNow = true;
   return true;
 }
+
+void fl_pollModbus() {
+  uint32_t start = micros();
+  uint32_t seq = _intervalSeq;
+  if (seq != _appliedIntervalSeq) {
+    _appliedIntervalSeq = seq;
+    uint32_t interval = _currentIntervalMs;
+    for (uint8_t i = 0; i < _meterCount; i++) fl_busSetPeriod(fl_modbusBus, _meters[i].device, interval);
+  }
+  if (_readNow) {
+    _readNow = false;
+    for (uint8_t i = 0; i < _meterCount; i++) fl_busTrigger(fl_modbusBus, _meters[i].device);
+  }
+  fl_busPoll(fl_modbusBus, millis(), start);
+  uint32_t elapsed = micros() - start;
+  if (elapsed > fl_modbusMaster.maxPollUs) fl_modbusMaster.maxPollUs = elapsed;
+}
+
+void fl_printModbusStatus() {
+  Serial.printf("Modbus: %lu transactions, %lu errors, worst poll %lu us\n",
+                fl_modbusMaster.transactions, fl_modbusMaster.errors, fl_modbusMaster.maxPollUs);
+  static const char* const rateNames[] = { "IDLE", "NORMAL", "FAST" };
+  Serial.printf("Sampling: %s (%lums)%s\n", rateNames[_effectiveRate], _currentIntervalMs,
+                _boostActive ? " boosted" : "");
+  for (uint8_t i = 0; i < fl_modbusBus.deviceCount; i++) {
+    const fl_bus_device_t& d = fl_modbusBus.devices[i];
+    Serial.printf("  %-8s id=%-3d prio=%d %s | period %lums, achieved %lums, worst late %lums | %lu cycles, %lu failed",
+                  d.name, d.slave, d.priority, d.online ? "ONLINE " : "OFFLINE",
+                  d.periodMs, d.avgIntervalMs, d.maxLateMs, d.cycles, d.failures);
+    if (d.failures) Serial.printf(" (last %s)", fl_rtuStatusToString(d.lastError));
+    if (d.backoffMs) Serial.printf(" | backoff %lums", d.backoffMs);
+    Serial.println();
+  }
+}
+
+/* ================= SENSOR TASK ================= */
+
+static void sensorTask(void* arg) {
+  for (;;) {
+    fl_pollModbus();
+    vTaskDelay(1);
+  }
+}
+
+void fl_startSensorTask(uint32_t intervalMs) {
+  if (_sensorTask) return;
+  _normalIntervalMs = intervalMs;
+  fl_setSensorInterval(intervalMs);
+  xTaskCreatePinnedToCore(sensorTask, "fl_sensor", FL_SENSOR_TASK_STACK, nullptr,
+                          FL_SENSOR_TASK_PRIO, &_sensorTask, FL_SENSOR_TASK_CORE);
+  Serial.printf("Sensor task started (%lums)\n", intervalMs);
+}
+
+bool fl_sensorTaskRunning() {
+  return _sensorTask != nullptr;
+}
+
+void fl_setSensorInterval(uint32_t intervalMs) {
+  // Picked up by the next fl_pollModbus()
+  _currentIntervalMs = intervalMs;
+  _intervalSeq = _intervalSeq + 1;
+}
+
+uint32_t fl_getSensorInterval() {
+  return _currentIntervalMs;
+}
+
+/* ================= ADAPTIVE RATE ================= */
+
+void fl_setSensorRate(fl_sensor_rate_t rate) {
+  if (_boostActive && (long)(millis() - _boostUntil) >= 0) _boostActive = false;
+  if (_boostActive) rate = FL_RATE_FAST;
+  if (rate == _effectiveRate) return;
+
+  _effectiveRate = rate;
+  uint32_t interval = rate == FL_RATE_FAST ? FL_SENSOR_FAST_MS
+                    : rate == FL_RATE_IDLE ? FL_SENSOR_IDLE_MS
+                    : _normalIntervalMs;
+  fl_setSensorInterval(interval);
+}
+
+void fl_boostSensorRate(uint32_t durationMs) {
+  unsigned long until = millis() + durationMs;
+  if (!_boostActive || (long)(until - _boostUntil) > 0) _boostUntil = until;
+  _boostActive = true;
+  // Read now: the new snapshot drives the control pass that applies FAST
+  fl_readSensors();
+}
+
+fl_sensor_rate_t fl_getSensorRate() {
+  return _effectiveRate;
+}
+
+bool fl_getSensorSnapshot(fl_sensor_snapshot_t& out, uint8_t meter) {
+  if (meter >= _meterCount) return false;
+  return _snapshots[meter].read(out);
+}
@@ -2,26 +2,110 @@
 #define FL_MODBUS_H
 
 #include <Arduino.h>
-#include <ModbusMaster.h>
+#include "fl_modbus_rtu.h"
+#include "fl_modbus_bus.h"
+#include "fl_meter.h"
 
-// Sensor values
-extern float fl_Va, fl_Vb, fl_Vc;
-extern float fl_Ia, fl_Ib, fl_Ic;
-extern bool fl_sensorOnline;
-extern int fl_modbusFailCount;
+// Immutable, timestamped set of readings from one meter. Published as a whole by the
+// acquisition side so readers never see a half-updated set of phases.
+struct fl_sensor_snapshot_t {
+  float Va, Vb, Vc;
+  float Ia, Ib, Ic;
+  float kW, PF, Hz, kWh;      // Only meaningful if set in 'valid'
+  uint16_t valid;             // FL_QMASK() of quantities the meter delivered
+  bool online;
+  uint8_t failCount;          // Consecutive failed read cycles (from the bus device)
+  uint32_t seq;               // Completed reads (success or failure)
+  unsigned long timestampMs;  // millis() when the read completed
+};
 
-// ModbusMaster instance
-extern ModbusMaster fl_modbusNode;
+// Sensor online flag (mirrors meter 1's latest snapshot, for status printing)
+extern volatile bool fl_sensorOnline;
+
+// Non-blocking RTU master on the RS485 port, and the scheduler that shares
+// it between all slaves on the bus
+extern fl_rtu_master_t fl_modbusMaster;
+extern fl_bus_t fl_modbusBus;
 
 // Current/voltage validation limits
 #define FL_MIN_VALID_CURRENT  -0.5
 #define FL_MAX_VALID_CURRENT  500.0
-#define FL_MAX_MODBUS_FAILURES 5
+#define FL_MAX_MODBUS_FAILURES FL_BUS_OFFLINE_FAILS
+#define FL_MODBUS_TIMEOUT_MS   FL_RTU_DEFAULT_TIMEOUT_MS
+
+// Sensor acquisition task
+#define FL_SENSOR_TASK_STACK   4096
+#define FL_SENSOR_TASK_PRIO    2      // Above loopTask so network stalls can't delay it
+#define FL_SENSOR_TASK_CORE    1
+
+#define FL_MAX_METERS               4
+#define FL_SENSOR_DEFAULT_PERIOD_MS 500
+
+// Adaptive sampling periods. FAST is about one V/I transaction at 9600 baud,
+// i.e. back-to-back reads; NORMAL is the interval given to fl_startSensorTask().
+#define FL_SENSOR_FAST_MS      50
+#define FL_SENSOR_IDLE_MS      2000
 
-// Initialize RS485 and ModbusMaster
+enum fl_sensor_rate_t : uint8_t {
+  FL_RATE_IDLE = 0,      // Nothing running — save bus and CPU
+  FL_RATE_NORMAL,        // Steady running
+  FL_RATE_FAST           // Starts, active protection timers, after commands
+};
+
+// Initialize RS485, the RTU master and the bus, and register meter 1 at
+// FL_MODBUS_ID
 void fl_initModbus();
 
-// Read voltages and currents from power meter
+// Register a further meter (one per motor) on the bus. Returns its meter
+// index, or -1 if full. Call during setup, before fl_startSensorTask().
+int fl_addMeter(uint8_t slave, uint32_t periodMs = FL_SENSOR_DEFAULT_PERIOD_MS,
+                fl_bus_priority_t priority = FL_BUS_PRIO_CRITICAL);
+uint8_t fl_getMeterCount();
+
+// Register any other slave (remote I/O, ...) with its own driver. Driver
+// callbacks run in the sensor task. Returns the bus device id or -1.
+int fl_addModbusDevice(const char* name, uint8_t slave, fl_bus_priority_t priority,
+                       uint32_t periodMs, const fl_bus_driver_t* driver, void* ctx);
+
+// Ask for an immediate read of every meter. Never blocks; the result is
+// published as new snapshots when the cycles complete.
 bool fl_readSensors();
 
+// Run the bus scheduler (called from fl_tick when no sensor task runs)
+void fl_pollModbus();
+
+// Print per-device requested vs achieved poll rates and health
+void fl_printModbusStatus();
+
+// Meter model (persisted in NVS "meter"/"model", "model2".., applied
+// between read cycles)
+void fl_loadMeterConfig();
+void fl_setMeterModel(fl_meter_model_t model, uint8_t meter = 0);
+fl_meter_model_t fl_getMeterModel(uint8_t meter = 0);
+
+// Quantities the project wants read (FL_QMASK_*). V/I are always included.
+void fl_setMeterQuantities(uint16_t mask, uint8_t meter = 0);
+const fl_meter_plan_t& fl_getMeterPlan(uint8_t meter = 0);
+
+// Run the bus in its own pinned FreeRTOS task, polling every meter at the
+// given period. Once started, fl_tick() no longer touches the RS485 bus.
+void fl_startSensorTask(uint32_t intervalMs);
+bool fl_sensorTaskRunning();
+// Posts the period for every meter; whoever polls the bus applies it on its
+// next pass
+void fl_setSensorInterval(uint32_t intervalMs);
+
+// Adaptive sampling. The project sets a baseline from its own state on
+// every control pass (loop task); a boost holds FAST for a window after a
+// contactor close or command, regardless of the baseline. Boosts are safe
+// from any task and trigger an immediate read.
+void fl_setSensorRate(fl_sensor_rate_t rate);
+void fl_boostSensorRate(uint32_t durationMs);
+fl_sensor_rate_t fl_getSensorRate();
+uint32_t fl_getSensorInterval();
+
+// Copy the latest snapshot of a meter. Lock-free, safe from any task.
+// Returns false until that meter's first read has completed.
+bool fl_getSensorSnapshot(fl_sensor_snapshot_t& out, uint8_t meter = 0);
+
 #endif
@@ -0,0 +1,195 @@
+#include "fl_modbus_bus.h"
+#include <string.h>
+
+void fl_busInit(fl_bus_t& bus, fl_rtu_master_t* master) {
+  memset(&bus, 0, sizeof(bus));
+  bus.master = master;
+  bus.active = -1;
+  bus.defaultTimeoutUs = master->timeoutUs;
+  bus.turnaroundUs = FL_BUS_TURNAROUND_US;
+}
+
+int fl_busAddDevice(fl_bus_t& bus, const char* name, uint8_t slave,
+                    fl_bus_priority_t priority, uint32_t periodMs,
+                    const fl_bus_driver_t* driver, void* ctx) {
+  if (bus.deviceCount >= FL_BUS_MAX_DEVICES || !driver) return -1;
+
+  int id = bus.deviceCount;
+  fl_bus_device_t& d = bus.devices[id];
+  memset(&d, 0, sizeof(d));
+  d.name = name;
+  d.slave = slave;
+  d.priority = priority;
+  d.periodMs = periodMs ? periodMs : 1;
+  d.driver = driver;
+  d.ctx = ctx;
+  d.nextDueMs = bus.nowMs;
+  d.lastError = FL_RTU_OK;
+  bus.deviceCount++;
+  return id;
+}
+
+void fl_busSetPeriod(fl_bus_t& bus, int id, uint32_t periodMs) {
+  if (id < 0 || id >= bus.deviceCount || periodMs == 0) return;
+  fl_bus_device_t& d = bus.devices[id];
+  // Pull the next poll forward if the new period is shorter
+  if (periodMs < d.periodMs && d.backoffMs == 0 && (int32_t)(d.nextDueMs - (bus.nowMs + periodMs)) > 0) {
+    d.nextDueMs = bus.nowMs + periodMs;
+  }
+  d.periodMs = periodMs;
+}
+
+void fl_busTrigger(fl_bus_t& bus, int id) {
+  if (id < 0 || id >= bus.deviceCount) return;
+  fl_bus_device_t& d = bus.devices[id];
+  if (d.backoffMs == 0) d.nextDueMs = bus.nowMs;
+}
+
+/* ================= CYCLE HANDLING ================= */
+
+static void finishCycle(fl_bus_t& bus, fl_bus_device_t& d, fl_rtu_status_t status) {
+  d.inCycle = false;
+  d.readIndex = 0;
+  d.cycles++;
+
+  if (status == FL_RTU_OK) {
+    // A probe that got through was scheduled a whole backoff out: go back
+    // to the device's own period from when the probe started
+    if (d.backoffMs) d.nextDueMs = d.lastStartMs + d.periodMs;
+    d.consecFails = 0;
+    d.online = true;
+    d.backoffMs = 0;
+  } else {
+    d.failures++;
+    d.lastError = status;
+    if (d.consecFails < 255) d.consecFails++;
+    if (d.consecFails >= FL_BUS_OFFLINE_FAILS) {
+      d.online = false;
+      // Re-probe a dead slave ever less often so it can't eat bus time
+      uint32_t next = d.backoffMs ? d.backoffMs * 2 : d.periodMs * 2;
+      d.backoffMs = next > FL_BUS_MAX_BACKOFF_MS ? FL_BUS_MAX_BACKOFF_MS : next;
+      d.nextDueMs = bus.nowMs + d.backoffMs;
+    }
+  }
+
+  d.driver->cycleDone(d.ctx, status, d);
+}
+
+// RTU completion — runs inside fl_rtuPoll()
+static void onTransaction(fl_rtu_status_t status, const uint16_t* regs, uint8_t count, void* ctx) {
+  fl_bus_t& bus = *(fl_bus_t*)ctx;
+  if (bus.active < 0) return;
+  fl_bus_device_t& d = bus.devices[bus.active];
+  bus.active = -1;
+  bus.lastDoneUs = bus.nowUs;
+  bus.master->timeoutUs = bus.defaultTimeoutUs;
+
+  if (status != FL_RTU_OK) {
+    finishCycle(bus, d, status);
+    return;
+  }
+
+  d.driver->onData(d.ctx, d.readIndex, regs, count);
+  d.readIndex++;
+
+  fl_bus_read_t next;
+  if (!d.driver->nextRead(d.ctx, d.readIndex, next)) {
+    finishCycle(bus, d, FL_RTU_OK);
+  }
+  // Otherwise the cycle stays open and competes for the next slot
+}
+
+/* ================= SCHEDULING ================= */
+
+// Offline devices compete at the lowest priority so re-probing a dead
+// critical slave never delays a live one.
+static uint8_t effectivePriority(const fl_bus_device_t& d) {
+  return d.online || d.consecFails < FL_BUS_OFFLINE_FAILS ? d.priority : FL_BUS_PRIO_LOW;
+}
+
+// Most urgent eligible device: priority first, then open cycles (finish
+// what was started), then the most overdue.
+static int pickDevice(const fl_bus_t& bus) {
+  int best = -1;
+  uint8_t bestPrio = 255;
+  bool bestOpen = false;
+  int32_t bestLate = 0;
+
+  for (int i = 0; i < bus.deviceCount; i++) {
+    const fl_bus_device_t& d = bus.devices[i];
+    int32_t late = (int32_t)(bus.nowMs - d.nextDueMs);
+    if (!d.inCycle && late < 0) continue;
+
+    uint8_t prio = effectivePriority(d);
+    bool better;
+    if (best < 0)                    better = true;
+    else if (prio != bestPrio)       better = prio < bestPrio;
+    else if (d.inCycle != bestOpen)  better = d.inCycle;
+    else                             better = late > bestLate;
+
+    if (better) {
+      best = i;
+      bestPrio = prio;
+      bestOpen = d.inCycle;
+      bestLate = late;
+    }
+  }
+  return best;
+}
+
+static void beginCycle(fl_bus_t& bus, fl_bus_device_t& d) {
+  if (d.cycles > 0) {
+    uint32_t late = (uint32_t)(bus.nowMs - d.nextDueMs);
+    if (late > d.maxLateMs) d.maxLateMs = late;
+    uint32_t interval = bus.nowMs - d.lastStartMs;
+    d.avgIntervalMs = d.avgIntervalMs ? (d.avgIntervalMs * 7 + interval) / 8 : interval;
+  }
+  d.lastStartMs = bus.nowMs;
+
+  // Keep the cadence; if we fell a whole period behind, restart it from now
+  d.nextDueMs += d.backoffMs ? d.backoffMs : d.periodMs;
+  if ((int32_t)(bus.nowMs - d.nextDueMs) >= 0) {
+    d.nextDueMs = bus.nowMs + (d.backoffMs ? d.backoffMs : d.periodMs);
+  }
+
+  d.inCycle = true;
+  d.readIndex = 0;
+}
+
+static void startRead(fl_bus_t& bus, int id) {
+  fl_bus_device_t& d = bus.devices[id];
+
+  if (!d.inCycle) beginCycle(bus, d);
+
+  fl_bus_read_t rd;
+  if (!d.driver->nextRead(d.ctx, d.readIndex, rd)) {
+    // Nothing to read this cycle (e.g. empty plan) — not a failure
+    d.inCycle = false;
+    d.readIndex = 0;
+    return;
+  }
+
+  bus.master->timeoutUs = d.timeoutMs ? d.timeoutMs * 1000UL : bus.defaultTimeoutUs;
+  bus.active = id;
+  if (!fl_rtuRequest(*bus.master, d.slave, rd.function, rd.address, rd.count,
+                     onTransaction, &bus, bus.nowUs)) {
+    bus.active = -1;
+    bus.master->timeoutUs = bus.defaultTimeoutUs;
+    finishCycle(bus, d, FL_RTU_BAD_FRAME);
+  }
+}
+
+void fl_busPoll(fl_bus_t& bus, uint32_t nowMs, uint32_t nowUs) {
+  bus.nowMs = nowMs;
+  bus.nowUs = nowUs;
+
+  fl_rtuPoll(*bus.master, nowUs);
+  if (fl_rtuBusy(*bus.master)) return;
+
+  // Slaves at 9600 baud need a moment to release the line before the next
+  // address goes out, on top of the t3.5 gap the master enforces.
+  if (bus.active < 0 && bus.lastDoneUs != 0 && (uint32_t)(nowUs - bus.lastDoneUs) < bus.turnaroundUs) return;
+
+  int id = pickDevice(bus);
+  if (id >= 0) startRead(bus, id);
+}
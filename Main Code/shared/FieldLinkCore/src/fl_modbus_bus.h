@@ -0,0 +1,107 @@
+#ifndef FL_MODBUS_BUS_H
+#define FL_MODBUS_BUS_H
+
+// Multi-drop Modbus bus scheduler.
+// Shares one fl_rtu_master_t between several slaves on the same RS485 pair
+// (one meter per motor, remote I/O modules, ...). Each device has its own
+// poll period and priority. Only one transaction is ever on the wire, and
+// the next one is chosen at every transaction boundary, so a slow or dead
+// slave delays the others by at most one timeout. Failing devices are
+// demoted and backed off exponentially. Hardware-free.
+
+#include <stdint.h>
+#include "fl_modbus_rtu.h"
+
+#define FL_BUS_MAX_DEVICES      8
+#define FL_BUS_OFFLINE_FAILS    5       // Consecutive failed cycles before a device is offline
+#define FL_BUS_MAX_BACKOFF_MS   30000   // Ceiling for the offline re-probe interval
+#define FL_BUS_TURNAROUND_US    2000    // Silence after a reply before addressing the next slave
+
+enum fl_bus_priority_t : uint8_t {
+  FL_BUS_PRIO_CRITICAL = 0,   // Protection inputs (motor currents)
+  FL_BUS_PRIO_NORMAL,
+  FL_BUS_PRIO_LOW             // Counters, I/O status — anything that can wait
+};
+
+// One register read within a device cycle
+struct fl_bus_read_t {
+  uint8_t function;
+  uint16_t address;
+  uint8_t count;
+};
+
+struct fl_bus_device_t;
+
+// Device driver. A cycle is a sequence of reads that together form one
+// result (e.g. all blocks of a meter plan). Reads of different devices may
+// interleave; reads of one cycle are issued in order.
+struct fl_bus_driver_t {
+  // Describe read 'index' of the current cycle. Return false when there are
+  // no more reads. index 0 is only requested when a new cycle starts.
+  bool (*nextRead)(void* ctx, uint8_t index, fl_bus_read_t& out);
+  // Registers returned by read 'index'. Only valid during the call.
+  void (*onData)(void* ctx, uint8_t index, const uint16_t* regs, uint8_t count);
+  // Cycle finished: FL_RTU_OK if every read succeeded, otherwise the first
+  // error (the rest of the cycle is abandoned). dev holds updated health.
+  void (*cycleDone)(void* ctx, fl_rtu_status_t status, const fl_bus_device_t& dev);
+};
+
+struct fl_bus_device_t {
+  // Configuration
+  const char* name;
+  uint8_t slave;
+  fl_bus_priority_t priority;
+  uint32_t periodMs;          // Requested cycle period
+  uint32_t timeoutMs;         // Response timeout, 0 = master default
+  const fl_bus_driver_t* driver;
+  void* ctx;
+
+  // Scheduling
+  uint32_t nextDueMs;
+  uint32_t backoffMs;         // 0 while healthy
+  uint8_t readIndex;          // Next read of the open cycle
+  bool inCycle;
+
+  // Health (replaces the old global failure counter)
+  bool online;
+  uint8_t consecFails;        // Consecutive failed cycles
+  uint32_t cycles;            // Completed cycles, success or failure
+  uint32_t failures;          // Failed cycles
+  fl_rtu_status_t lastError;
+
+  // Achieved rate
+  uint32_t lastStartMs;
+  uint32_t avgIntervalMs;     // Smoothed interval between cycle starts (0 = no data)
+  uint32_t maxLateMs;         // Worst start delay past the due time
+};
+
+struct fl_bus_t {
+  fl_rtu_master_t* master;
+  fl_bus_device_t devices[FL_BUS_MAX_DEVICES];
+  uint8_t deviceCount;
+  int8_t active;              // Device whose transaction is in flight, -1 = none
+  uint32_t defaultTimeoutUs;
+  uint32_t turnaroundUs;
+  uint32_t lastDoneUs;
+  uint32_t nowMs, nowUs;      // Time of the current poll, for completion handling
+};
+
+// Attach to an initialised RTU master (its timeout becomes the default)
+void fl_busInit(fl_bus_t& bus, fl_rtu_master_t* master);
+
+// Register a device. Returns its id, or -1 if the table is full.
+// Devices are first polled on the next fl_busPoll().
+int fl_busAddDevice(fl_bus_t& bus, const char* name, uint8_t slave,
+                    fl_bus_priority_t priority, uint32_t periodMs,
+                    const fl_bus_driver_t* driver, void* ctx);
+
+void fl_busSetPeriod(fl_bus_t& bus, int id, uint32_t periodMs);
+
+// Make a device due immediately (no effect while it is backed off)
+void fl_busTrigger(fl_bus_t& bus, int id);
+
+// Advance the master and start the next read if the bus is free.
+// Never blocks; callbacks run from inside this call.
+void fl_busPoll(fl_bus_t& bus, uint32_t nowMs, uint32_t nowUs);
+
+#endif
@@ -0,0 +1,206 @@
+#include "fl_modbus_rtu.h"
+#include <string.h>
+
+// A partial frame that goes quiet for this many t3.5 periods is abandoned.
+// Generous on purpose: the ESP32 UART driver delivers RX bytes in bursts.
+#define FL_RTU_STALL_GAPS  10
+
+uint16_t fl_rtuCrc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      if (crc & 0x0001) crc = (crc >> 1) ^ 0xA001;
+      else              crc >>= 1;
+    }
+  }
+  return crc;
+}
+
+void fl_rtuInit(fl_rtu_master_t& m, const fl_rtu_port_t* port, uint32_t baud, uint32_t timeoutMs) {
+  memset(&m, 0, sizeof(m));
+  m.port = port;
+  m.state = FL_RTU_IDLE;
+
+  // 11 bits per character (start + 8 data + parity/stop + stop)
+  m.charTimeUs = (11UL * 1000000UL) / (baud ? baud : 9600);
+  // Modbus spec: fixed 1750us t3.5 above 19200 baud
+  m.frameGapUs = (baud > 19200) ? 1750 : (m.charTimeUs * 35) / 10;
+  m.timeoutUs = (timeoutMs ? timeoutMs : FL_RTU_DEFAULT_TIMEOUT_MS) * 1000UL;
+}
+
+bool fl_rtuRequest(fl_rtu_master_t& m, uint8_t slave, uint8_t function,
+                   uint16_t addr, uint8_t count,
+                   fl_rtu_callback_t callback, void* ctx, uint32_t nowUs) {
+  if (m.state != FL_RTU_IDLE || !m.port) return false;
+  if (count == 0 || count > FL_RTU_MAX_REGS) return false;
+
+  m.slave = slave;
+  m.function = function;
+  m.count = count;
+  m.callback = callback;
+  m.ctx = ctx;
+
+  m.frame[0] = slave;
+  m.frame[1] = function;
+  m.frame[2] = addr >> 8;
+  m.frame[3] = addr & 0xFF;
+  m.frame[4] = 0;
+  m.frame[5] = count;
+  uint16_t crc = fl_rtuCrc16(m.frame, 6);
+  m.frame[6] = crc & 0xFF;   // CRC is sent low byte first
+  m.frame[7] = crc >> 8;
+  m.frameLen = 8;
+  m.expectedLen = 0;
+
+  m.state = FL_RTU_GAP;
+  m.stateStartUs = nowUs;
+  return true;
+}
+
+static void finish(fl_rtu_master_t& m, fl_rtu_status_t status) {
+  uint16_t regs[FL_RTU_MAX_REGS];
+  uint8_t count = 0;
+
+  if (status == FL_RTU_OK) {
+    count = m.count;
+    for (uint8_t i = 0; i < count; i++) {
+      regs[i] = ((uint16_t)m.frame[3 + i * 2] << 8) | m.frame[4 + i * 2];
+    }
+  } else {
+    m.errors++;
+  }
+  m.transactions++;
+
+  // Back to idle BEFORE the callback so it can queue the next request
+  fl_rtu_callback_t cb = m.callback;
+  void* ctx = m.ctx;
+  m.state = FL_RTU_IDLE;
+  m.callback = nullptr;
+  if (cb) cb(status, regs, count, ctx);
+}
+
+static void checkFrame(fl_rtu_master_t& m) {
+  if (m.frame[0] != m.slave || (m.frame[1] & 0x7F) != m.function) {
+    finish(m, FL_RTU_BAD_FRAME);
+    return;
+  }
+
+  uint16_t crc = fl_rtuCrc16(m.frame, m.frameLen - 2);
+  uint16_t rxCrc = m.frame[m.frameLen - 2] | ((uint16_t)m.frame[m.frameLen - 1] << 8);
+  if (crc != rxCrc) {
+    finish(m, FL_RTU_CRC_ERROR);
+    return;
+  }
+
+  if (m.frame[1] & 0x80) {
+    finish(m, FL_RTU_EXCEPTION);
+    return;
+  }
+
+  if (m.frame[2] != m.count * 2) {
+    finish(m, FL_RTU_BAD_FRAME);
+    return;
+  }
+
+  finish(m, FL_RTU_OK);
+}
+
+void fl_rtuPoll(fl_rtu_master_t& m, uint32_t nowUs) {
+  const fl_rtu_port_t* port = m.port;
+  if (!port) return;
+
+  switch (m.state) {
+    case FL_RTU_IDLE:
+      return;
+
+    case FL_RTU_GAP: {
+      // Drain stale bytes (late replies, line noise) before talking
+      int budget = FL_RTU_MAX_BYTES_PER_POLL;
+      while (budget-- > 0 && port->available() > 0) {
+        port->read();
+        m.lastActivityUs = nowUs;
+      }
+      // A bus that never goes quiet (jabbering slave, noise) fails the
+      // transaction instead of holding the master forever
+      bool quiet = port->available() == 0 &&
+                   (uint32_t)(nowUs - m.lastActivityUs) >= m.frameGapUs;
+      if (!quiet) {
+        if ((uint32_t)(nowUs - m.stateStartUs) > m.timeoutUs) finish(m, FL_RTU_TIMEOUT);
+        return;
+      }
+
+      port->setDE(true);
+      port->write(m.frame, m.frameLen);
+      m.frameLen = 0;
+      m.state = FL_RTU_TX;
+      m.stateStartUs = nowUs;
+      m.lastActivityUs = nowUs;
+      return;
+    }
+
+    case FL_RTU_TX:
+      if (port->txDone()) {
+        port->setDE(false);
+        m.state = FL_RTU_WAIT;
+        m.stateStartUs = nowUs;
+        m.lastActivityUs = nowUs;
+      } else if ((uint32_t)(nowUs - m.stateStartUs) > m.timeoutUs) {
+        port->setDE(false);
+        finish(m, FL_RTU_TIMEOUT);
+      }
+      return;
+
+    case FL_RTU_WAIT: {
+      int budget = FL_RTU_MAX_BYTES_PER_POLL;
+      while (budget-- > 0 && port->available() > 0) {
+        int c = port->read();
+        if (c < 0) break;
+        m.lastActivityUs = nowUs;
+        if (m.frameLen >= FL_RTU_MAX_FRAME) {
+          finish(m, FL_RTU_BAD_FRAME);
+          return;
+        }
+        m.frame[m.frameLen++] = (uint8_t)c;
+
+        // Work out the full length as soon as the header allows
+        if (m.expectedLen == 0) {
+          if (m.frameLen == 2 && (m.frame[1] & 0x80)) {
+            m.expectedLen = 5;
+          } else if (m.frameLen == 3 && !(m.frame[1] & 0x80)) {
+            m.expectedLen = 5 + m.frame[2];
+            if (m.expectedLen > FL_RTU_MAX_FRAME) {
+              finish(m, FL_RTU_BAD_FRAME);
+              return;
+            }
+          }
+        }
+
+        if (m.expectedLen && m.frameLen >= m.expectedLen) {
+          checkFrame(m);
+          return;
+        }
+      }
+
+      if (m.frameLen == 0) {
+        if ((uint32_t)(nowUs - m.stateStartUs) > m.timeoutUs) {
+          finish(m, FL_RTU_TIMEOUT);
+        }
+      } else if ((uint32_t)(nowUs - m.lastActivityUs) > m.frameGapUs * FL_RTU_STALL_GAPS) {
+        finish(m, FL_RTU_TIMEOUT);
+      }
+      return;
+    }
+  }
+}
+
+const char* fl_rtuStatusToString(fl_rtu_status_t status) {
+  switch (status) {
+    case FL_RTU_OK:         return "OK";
+    case FL_RTU_TIMEOUT:    return "TIMEOUT";
+    case FL_RTU_CRC_ERROR:  return "CRC_ERROR";
+    case FL_RTU_EXCEPTION:  return "EXCEPTION";
+    case FL_RTU_BAD_FRAME:  return "BAD_FRAME";
+    default:                return "UNKNOWN";
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef FL_MODBUS_RTU_H
+#define FL_MODBUS_RTU_H
+
+// Non-blocking Modbus RTU master.
+// Hardware-free: all UART/DE access goes through fl_rtu_port_t, so the
+// state machine runs unchanged against a fake UART on the host.
+// fl_rtuPoll() never waits; every call does a bounded amount of work.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FL_RTU_MAX_REGS            64
+#define FL_RTU_MAX_FRAME           (5 + 2 * FL_RTU_MAX_REGS)
+#define FL_RTU_MAX_BYTES_PER_POLL  64    // Upper bound on UART reads per poll
+#define FL_RTU_DEFAULT_TIMEOUT_MS  250   // First-byte response timeout
+
+// Supported function codes
+#define FL_RTU_FC_READ_HOLDING  0x03
+#define FL_RTU_FC_READ_INPUT    0x04
+
+enum fl_rtu_status_t {
+  FL_RTU_OK = 0,
+  FL_RTU_TIMEOUT,       // No response / response stalled mid-frame / bus never idle
+  FL_RTU_CRC_ERROR,     // Full frame received, CRC mismatch
+  FL_RTU_EXCEPTION,     // Slave returned an exception response
+  FL_RTU_BAD_FRAME      // Wrong slave/function/byte count
+};
+
+enum fl_rtu_state_t {
+  FL_RTU_IDLE = 0,
+  FL_RTU_GAP,           // Request queued, waiting for inter-frame silence
+  FL_RTU_TX,            // Frame handed to UART, DE held until TX drains
+  FL_RTU_WAIT           // Collecting response bytes
+};
+
+// UART access. All functions must return immediately.
+struct fl_rtu_port_t {
+  int    (*available)();
+  int    (*read)();
+  size_t (*write)(const uint8_t* data, size_t len);
+  bool   (*txDone)();           // true once the last stop bit has left the wire
+  void   (*setDE)(bool on);     // RS485 driver enable
+};
+
+// Completion callback: regs is only valid for the duration of the call
+typedef void (*fl_rtu_callback_t)(fl_rtu_status_t status, const uint16_t* regs,
+                                  uint8_t count, void* ctx);
+
+struct fl_rtu_master_t {
+  const fl_rtu_port_t* port;
+  fl_rtu_state_t state;
+
+  // Timing (microseconds, wrap-safe subtraction)
+  uint32_t charTimeUs;
+  uint32_t frameGapUs;          // t3.5
+  uint32_t timeoutUs;
+  uint32_t stateStartUs;
+  uint32_t lastActivityUs;      // Last byte sent or received on the bus
+
+  // Current transaction
+  uint8_t slave;
+  uint8_t function;
+  uint8_t count;
+  fl_rtu_callback_t callback;
+  void* ctx;
+
+  uint8_t frame[FL_RTU_MAX_FRAME];
+  uint16_t frameLen;
+  uint16_t expectedLen;         // 0 until the header tells us
+
+  // Diagnostics
+  uint32_t transactions;
+  uint32_t errors;
+  uint32_t maxPollUs;           // Worst observed fl_rtuPoll() duration (set by glue)
+};
+
+// CRC-16/MODBUS (poly 0xA001, init 0xFFFF)
+uint16_t fl_rtuCrc16(const uint8_t* data, size_t len);
+
+// Reset master state and derive frame timings from the baud rate
+void fl_rtuInit(fl_rtu_master_t& m, const fl_rtu_port_t* port, uint32_t baud, uint32_t timeoutMs);
+
+// Queue a read-registers request. Returns false if a transaction is in flight.
+bool fl_rtuRequest(fl_rtu_master_t& m, uint8_t slave, uint8_t function,
+                   uint16_t addr, uint8_t count,
+                   fl_rtu_callback_t callback, void* ctx, uint32_t nowUs);
+
+// Advance the state machine. Call as often as possible (fl_tick / sensor task).
+void fl_rtuPoll(fl_rtu_master_t& m, uint32_t nowUs);
+
+inline bool fl_rtuBusy(const fl_rtu_master_t& m) { return m.state != FL_RTU_IDLE; }
+
+const char* fl_rtuStatusToString(fl_rtu_status_t status);
+
+#endif
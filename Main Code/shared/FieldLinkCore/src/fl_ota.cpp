@@ -25,23 +25,8 @@ const char* fl_getFwName()    { return _fw_name; }
 const char* fl_getFwVersion() { return _fw_version; }
 const char* fl_getHwType()    { return _hw_type; }
 
-void fl_performRemoteFirmwareUpdate(const char* firmwareUrl) {
-  if (!fl_wifiConnected) {
-    Serial.println("Cannot update - WiFi not connected");
-    return;
-  }
-
-  Serial.println("===========================================");
-  Serial.println("REMOTE FIRMWARE UPDATE STARTED");
-  Serial.printf("URL: %s\n", firmwareUrl);
-  Serial.println("===========================================");
-
-  // Disconnect MQTT first — free up TLS memory and avoid conflicts
-  // with two concurrent TLS connections
-  fl_mqtt.disconnect();
-  fl_mqttConnected = false;
-  delay(100);
-
+// Download and flash; restarts on success, returns on failure
+static void downloadFirmware(const char* firmwareUrl) {
   HTTPClient http;
   // Use WiFiClientSecure for HTTPS firmware URLs (e.g. Supabase Storage)
   static WiFiClientSecure otaClient;
@@ -134,6 +119,25 @@ void fl_performRemoteFirmwareUpdate(const char* firmwareUrl) {
   http.end();
 }
 
+void fl_performRemoteFirmwareUpdate(const char* firmwareUrl) {
+  if (!fl_wifiConnected) {
+    Serial.println("Cannot update - WiFi not connected");
+    return;
+  }
+
+  Serial.println("===========================================");
+  Serial.println("REMOTE FIRMWARE UPDATE STARTED");
+  Serial.printf("URL: %s\n", firmwareUrl);
+  Serial.println("===========================================");
+
+  // Take MQTT down first (after the queued publishes) — free up TLS memory
+  // and avoid conflicts with two concurrent TLS connections
+  fl_netPause();
+
+  downloadFirmware(firmwareUrl);
+  fl_netResume();
+}
+
 void fl_setupArduinoOTA() {
   ArduinoOTA.setHostname(fl_DEVICE_ID);
   if (_ota_password[0] != '\0') {
@@ -0,0 +1,306 @@
+#include "fl_protection.h"
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+void fl_protectionInit(fl_protection_t& s) {
+  memset(&s, 0, sizeof(s));
+  s.pendingState = FL_MOTOR_STOPPED;
+}
+
+void fl_protectionReset(fl_protection_t& s) {
+  s.pendingState = FL_MOTOR_STOPPED;
+  s.debounce = 0;
+  s.ocActive = false;
+  s.drActive = false;
+  s.ubActive = false;
+  s.plActive = false;
+  s.vActive = false;
+}
+
+void fl_protectionThermalReset(fl_protection_t& s) {
+  s.thermal = 0;
+  s.thermalValid = false;
+}
+
+static fl_protection_decision_t trip(fl_protection_t& s, const fl_protection_input_t& in,
+                                     fl_trip_t why, uint16_t events) {
+  s.faultMs = in.nowMs;
+  s.debounce = 0;
+  return { FL_MOTOR_FAULT, why, (uint16_t)(events | FL_PROT_EV_TRIP) };
+}
+
+// Advance the overload accumulator by the time since the previous sample.
+// Constant time: one exp() or pow() per sample.
+static void updateThermal(fl_protection_t& s, const fl_protection_config_t& cfg,
+                          const fl_protection_input_t& in) {
+  if (cfg.thermalMode == FL_THERMAL_OFF || cfg.thermalPickup <= 0) {
+    s.thermal = 0;
+    s.thermalValid = false;
+    return;
+  }
+
+  float dt = s.thermalValid ? (uint32_t)(in.nowMs - s.thermalMs) / 1000.0f : 0;
+  s.thermalMs = in.nowMs;
+  s.thermalValid = true;
+  if (dt <= 0) return;
+
+  float ratio = in.current > 0 ? in.current / cfg.thermalPickup : 0;
+
+  if (cfg.thermalMode == FL_THERMAL_IMAGE) {
+    // Exact first-order step towards the steady-state image (I/Ib)^2.
+    // Heating whenever current flows — a start is still STOPPED until the
+    // debounce confirms it, but its inrush is exactly what must be counted.
+    float target = ratio * ratio;
+    bool heating = ratio > 0 || in.startCommand || in.state == FL_MOTOR_RUNNING;
+    float tau = heating ? cfg.tauHeatS : cfg.tauCoolS;
+    if (tau <= 0) tau = 1;
+    s.thermal = target + (s.thermal - target) * expf(-dt / tau);
+  } else {
+    // IDMT: integrate 1/t(I) above pickup, decay below it
+    if (ratio > 1.0f) {
+      float tms = cfg.thermalTms > 0 ? cfg.thermalTms : 1.0f;
+      s.thermal += dt * (powf(ratio, 0.02f) - 1.0f) / (0.14f * tms);
+    } else {
+      float tau = cfg.tauCoolS > 0 ? cfg.tauCoolS : 1;
+      s.thermal *= expf(-dt / tau);
+    }
+  }
+  if (s.thermal < 0) s.thermal = 0;
+}
+
+// Pickup timer for one condition. Returns true once it has held for delayMs.
+static bool pickup(bool cond, bool& active, uint32_t& sinceMs, uint32_t delayMs,
+                   uint32_t nowMs, uint16_t& ev, uint16_t startEv, uint16_t clearEv) {
+  if (!cond) {
+    if (active) {
+      active = false;
+      ev |= clearEv;
+    }
+    return false;
+  }
+  if (!active) {
+    active = true;
+    sinceMs = nowMs;
+    ev |= startEv;
+  }
+  return delayMs == 0 || (nowMs - sinceMs) >= delayMs;
+}
+
+void fl_phaseMetrics(const float v[3], const float i[3], float lossFraction,
+                     fl_phase_metrics_t& out) {
+  float sum = 0, maxI = i[0], minI = i[0];
+  float minV = v[0], maxV = v[0];
+  uint8_t minPhase = 0;
+  for (uint8_t n = 0; n < 3; n++) {
+    sum += i[n];
+    if (i[n] > maxI) maxI = i[n];
+    if (i[n] < minI) { minI = i[n]; minPhase = n; }
+    if (v[n] < minV) minV = v[n];
+    if (v[n] > maxV) maxV = v[n];
+  }
+
+  out.avgI = sum / 3.0f;
+  out.maxI = maxI;
+  out.minV = minV;
+  out.maxV = maxV;
+
+  // Largest deviation from the average is at either the max or the min phase
+  float dev = maxI - out.avgI;
+  if (out.avgI - minI > dev) dev = out.avgI - minI;
+  out.imbalancePct = out.avgI > 0 ? dev / out.avgI * 100.0f : 0;
+
+  out.lostPhase = (maxI > 0 && minI < maxI * lossFraction) ? minPhase + 1 : 0;
+}
+
+fl_protection_decision_t fl_protectionStep(fl_protection_t& s, const fl_protection_config_t& cfg,
+                                           const fl_protection_input_t& in) {
+  uint16_t ev = 0;
+
+  updateThermal(s, cfg, in);
+
+  if (in.state == FL_MOTOR_FAULT) {
+    if (cfg.faultAutoResetMs > 0 && (in.nowMs - s.faultMs) > cfg.faultAutoResetMs) {
+      ev |= FL_PROT_EV_AUTO_RESET;
+    }
+    return { FL_MOTOR_FAULT, FL_TRIP_NONE, ev };
+  }
+
+  if (in.sensorFault) {
+    return trip(s, in, FL_TRIP_SENSOR, ev);
+  }
+
+  // Overcurrent with pickup delay, blanked during inrush
+  bool inrush = in.contactorClosed && (in.nowMs - in.contactorCloseMs) < cfg.inrushBlankMs;
+  if (cfg.overcurrentEnabled && in.current > cfg.maxCurrent && !inrush) {
+    if (!s.ocActive) {
+      s.ocActive = true;
+      s.ocSinceMs = in.nowMs;
+      ev |= FL_PROT_EV_OC_START;
+    }
+    if (cfg.overcurrentDelayMs == 0 || (in.nowMs - s.ocSinceMs) >= cfg.overcurrentDelayMs) {
+      return trip(s, in, FL_TRIP_OVERCURRENT, ev);
+    }
+  } else if (s.ocActive) {
+    s.ocActive = false;
+    ev |= FL_PROT_EV_OC_CLEAR;
+  }
+
+  // Inverse-time overload — not blanked: the curve itself rides through starts
+  if (s.thermal >= 1.0f) {
+    return trip(s, in, FL_TRIP_THERMAL, ev);
+  }
+
+  // 3-phase checks — unbalance and phase loss only mean something under
+  // load, so they wait for RUNNING and the end of inrush blanking
+  if (in.phases) {
+    const fl_phase_metrics_t& ph = *in.phases;
+    bool loaded = in.state == FL_MOTOR_RUNNING && !inrush;
+
+    if (pickup(cfg.phaseLossEnabled && loaded && ph.lostPhase != 0,
+               s.plActive, s.plSinceMs, cfg.phaseLossDelayMs, in.nowMs, ev,
+               FL_PROT_EV_PL_START, FL_PROT_EV_PL_CLEAR)) {
+      return trip(s, in, FL_TRIP_PHASE_LOSS, ev);
+    }
+
+    if (pickup(cfg.imbalanceEnabled && loaded && ph.imbalancePct > cfg.maxImbalancePct,
+               s.ubActive, s.ubSinceMs, cfg.imbalanceDelayMs, in.nowMs, ev,
+               FL_PROT_EV_UB_START, FL_PROT_EV_UB_CLEAR)) {
+      return trip(s, in, FL_TRIP_IMBALANCE, ev);
+    }
+
+    bool under = cfg.underVoltage > 0 && ph.minV < cfg.underVoltage;
+    bool over = cfg.overVoltage > 0 && ph.maxV > cfg.overVoltage;
+    bool supplied = in.startCommand || in.state == FL_MOTOR_RUNNING;
+    if (pickup(cfg.voltageEnabled && supplied && (under || over),
+               s.vActive, s.vSinceMs, cfg.voltageDelayMs, in.nowMs, ev,
+               FL_PROT_EV_V_START, FL_PROT_EV_V_CLEAR)) {
+      return trip(s, in, under ? FL_TRIP_UNDERVOLTAGE : FL_TRIP_OVERVOLTAGE, ev);
+    }
+  }
+
+  // Dry run: only while commanded and confirmed running
+  float loadCurrent = in.phases ? in.phases->avgI : in.current;
+  if (cfg.dryRunEnabled && cfg.dryCurrent > 0 && in.startCommand && in.state == FL_MOTOR_RUNNING) {
+    if (loadCurrent < cfg.dryCurrent) {
+      if (!s.drActive) {
+        s.drActive = true;
+        s.drSinceMs = in.nowMs;
+        ev |= FL_PROT_EV_DR_START;
+      }
+      if (cfg.dryRunDelayMs == 0 || (in.nowMs - s.drSinceMs) >= cfg.dryRunDelayMs) {
+        return trip(s, in, FL_TRIP_DRY_RUN, ev);
+      }
+    } else if (s.drActive) {
+      s.drActive = false;
+      ev |= FL_PROT_EV_DR_CLEAR;
+    }
+  } else {
+    s.drActive = false;
+  }
+
+  // Start failure
+  if (cfg.startTimeoutMs > 0 && in.startCommand && in.state != FL_MOTOR_RUNNING) {
+    if ((in.nowMs - in.startCommandMs) > cfg.startTimeoutMs) {
+      return trip(s, in, FL_TRIP_START_TIMEOUT, ev);
+    }
+  }
+
+  // Run detection with hysteresis
+  fl_motor_state_t target;
+  if (in.state == FL_MOTOR_RUNNING) {
+    target = in.current < (cfg.runThreshold - cfg.hysteresis) ? FL_MOTOR_STOPPED : FL_MOTOR_RUNNING;
+  } else {
+    target = in.current > cfg.runThreshold ? FL_MOTOR_RUNNING : FL_MOTOR_STOPPED;
+  }
+
+  // Debounce
+  fl_motor_state_t state = in.state;
+  if (target != in.state) {
+    if (target == s.pendingState) {
+      s.debounce++;
+      if (s.debounce >= cfg.debounceCount) {
+        state = target;
+        s.debounce = 0;
+        ev |= FL_PROT_EV_STATE;
+      }
+    } else {
+      s.pendingState = target;
+      s.debounce = 1;
+    }
+  } else {
+    s.debounce = 0;
+    s.pendingState = in.state;
+  }
+
+  return { state, FL_TRIP_NONE, ev };
+}
+
+const char* fl_tripToString(fl_trip_t trip) {
+  switch (trip) {
+    case FL_TRIP_OVERCURRENT:   return "OVERCURRENT";
+    case FL_TRIP_DRY_RUN:       return "DRY_RUN";
+    case FL_TRIP_START_TIMEOUT: return "START_TIMEOUT";
+    case FL_TRIP_SENSOR:        return "SENSOR_FAULT";
+    case FL_TRIP_THERMAL:       return "THERMAL";
+    case FL_TRIP_IMBALANCE:     return "IMBALANCE";
+    case FL_TRIP_PHASE_LOSS:    return "PHASE_LOSS";
+    case FL_TRIP_UNDERVOLTAGE:  return "UNDERVOLTAGE";
+    case FL_TRIP_OVERVOLTAGE:   return "OVERVOLTAGE";
+    default:                    return "";
+  }
+}
+
+fl_fault_t fl_faultFromTrip(fl_trip_t trip) {
+  switch (trip) {
+    case FL_TRIP_NONE:         return FL_FAULT_NONE;
+    case FL_TRIP_OVERCURRENT:
+    case FL_TRIP_THERMAL:      return FL_FAULT_OVERCURRENT;
+    case FL_TRIP_SENSOR:       return FL_FAULT_SENSOR;
+    case FL_TRIP_IMBALANCE:    return FL_FAULT_IMBALANCE;
+    case FL_TRIP_PHASE_LOSS:   return FL_FAULT_PHASE_LOSS;
+    case FL_TRIP_UNDERVOLTAGE: return FL_FAULT_UNDERVOLTAGE;
+    case FL_TRIP_OVERVOLTAGE:  return FL_FAULT_OVERVOLTAGE;
+    default:                   return FL_FAULT_DRY_RUN;   // Dry run, start timeout
+  }
+}
+
+const char* fl_faultToString(fl_fault_t fault) {
+  switch (fault) {
+    case FL_FAULT_OVERCURRENT:  return "OVERCURRENT";
+    case FL_FAULT_DRY_RUN:      return "DRY_RUN";
+    case FL_FAULT_SENSOR:       return "SENSOR_FAULT";
+    case FL_FAULT_IMBALANCE:    return "IMBALANCE";
+    case FL_FAULT_PHASE_LOSS:   return "PHASE_LOSS";
+    case FL_FAULT_UNDERVOLTAGE: return "UNDERVOLTAGE";
+    case FL_FAULT_OVERVOLTAGE:  return "OVERVOLTAGE";
+    default:                    return "";
+  }
+}
+
+const char* fl_motorStateToString(fl_motor_state_t state) {
+  switch (state) {
+    case FL_MOTOR_RUNNING: return "RUNNING";
+    case FL_MOTOR_FAULT:   return "FAULT";
+    default:               return "STOPPED";
+  }
+}
+
+const char* fl_thermalModeToString(fl_thermal_mode_t mode) {
+  switch (mode) {
+    case FL_THERMAL_IMAGE: return "thermal";
+    case FL_THERMAL_IDMT:  return "idmt";
+    default:               return "off";
+  }
+}
+
+fl_thermal_mode_t fl_thermalModeFromString(const char* name) {
+  if (!name) return FL_THERMAL_MODE_COUNT;
+  for (uint8_t m = 0; m < FL_THERMAL_MODE_COUNT; m++) {
+    const char* a = fl_thermalModeToString((fl_thermal_mode_t)m);
+    const char* b = name;
+    while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) { a++; b++; }
+    if (*a == '\0' && *b == '\0') return (fl_thermal_mode_t)m;
+  }
+  return FL_THERMAL_MODE_COUNT;
+}
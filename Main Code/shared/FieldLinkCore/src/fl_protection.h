@@ -0,0 +1,196 @@
+#ifndef FL_PROTECTION_H
+#define FL_PROTECTION_H
+
+// Motor protection engine.
+// Overcurrent and dry-run with pickup delays, inverse-time overload (motor
+// thermal image or IEC standard-inverse IDMT), start-failure timeout, run
+// detection with hysteresis and debounce, sensor fault and fault auto-reset.
+// For a single motor on all three CTs: phase unbalance, single-phasing and
+// under/over-voltage.
+// Pure: no millis(), no Serial, no outputs. Each step takes one sample with
+// an explicit timestamp and returns a decision plus the events it raised;
+// the caller drives contactors, alarms and logging. Builds on the host.
+
+#include <stdint.h>
+
+enum fl_motor_state_t : uint8_t {
+  FL_MOTOR_STOPPED = 0,
+  FL_MOTOR_RUNNING,
+  FL_MOTOR_FAULT
+};
+
+enum fl_trip_t : uint8_t {
+  FL_TRIP_NONE = 0,
+  FL_TRIP_OVERCURRENT,
+  FL_TRIP_DRY_RUN,
+  FL_TRIP_START_TIMEOUT,   // Commanded but never reached RUNNING
+  FL_TRIP_SENSOR,
+  FL_TRIP_THERMAL,         // Inverse-time overload reached 100%
+  FL_TRIP_IMBALANCE,
+  FL_TRIP_PHASE_LOSS,      // Single-phasing
+  FL_TRIP_UNDERVOLTAGE,
+  FL_TRIP_OVERVOLTAGE
+};
+
+// Latched fault as reported in telemetry. Coarser than fl_trip_t: a thermal
+// trip reports as OVERCURRENT and a start timeout as DRY_RUN — the fault
+// strings are part of the telemetry schema.
+enum fl_fault_t : uint8_t {
+  FL_FAULT_NONE = 0,
+  FL_FAULT_OVERCURRENT,
+  FL_FAULT_DRY_RUN,
+  FL_FAULT_SENSOR,
+  FL_FAULT_IMBALANCE,
+  FL_FAULT_PHASE_LOSS,
+  FL_FAULT_UNDERVOLTAGE,
+  FL_FAULT_OVERVOLTAGE
+};
+
+enum fl_thermal_mode_t : uint8_t {
+  FL_THERMAL_OFF = 0,
+  FL_THERMAL_IMAGE,        // First-order I^2 thermal image (IEC 60255-149 style)
+  FL_THERMAL_IDMT,         // IEC 60255-151 standard inverse: t = TMS * 0.14 / ((I/Is)^0.02 - 1)
+  FL_THERMAL_MODE_COUNT
+};
+
+// Events raised by a step (bit mask)
+#define FL_PROT_EV_OC_START     0x0001   // Overcurrent pickup, delay timer started
+#define FL_PROT_EV_OC_CLEAR     0x0002   // Overcurrent dropped out before the delay
+#define FL_PROT_EV_DR_START     0x0004
+#define FL_PROT_EV_DR_CLEAR     0x0008
+#define FL_PROT_EV_TRIP         0x0010   // decision.trip says why
+#define FL_PROT_EV_STATE        0x0020   // Debounced RUNNING/STOPPED change
+#define FL_PROT_EV_AUTO_RESET   0x0040   // Fault aged out; caller should reset
+#define FL_PROT_EV_UB_START     0x0080   // Phase unbalance pickup
+#define FL_PROT_EV_UB_CLEAR     0x0100
+#define FL_PROT_EV_PL_START     0x0200   // Phase loss pickup
+#define FL_PROT_EV_PL_CLEAR     0x0400
+#define FL_PROT_EV_V_START      0x0800   // Under/over-voltage pickup
+#define FL_PROT_EV_V_CLEAR      0x1000
+
+// Per-sample figures for one 3-phase motor, from a single pass over L1..L3
+struct fl_phase_metrics_t {
+  float avgI;
+  float maxI;                  // Worst phase — drives overcurrent and thermal
+  float imbalancePct;          // NEMA MG-1: max deviation from average / average x 100
+  float minV;
+  float maxV;
+  uint8_t lostPhase;           // 1..3 = phase carrying under the loss fraction of the highest, 0 = none
+};
+
+struct fl_protection_config_t {
+  bool overcurrentEnabled;
+  float maxCurrent;            // A
+  uint32_t overcurrentDelayMs; // 0 = trip on first sample
+  bool dryRunEnabled;
+  float dryCurrent;            // A, 0 = disabled
+  uint32_t dryRunDelayMs;
+  uint32_t startTimeoutMs;     // 0 = disabled
+  uint32_t inrushBlankMs;      // Overcurrent ignored this long after contactor close
+  float runThreshold;          // RUNNING above this current
+  float hysteresis;            // ...and STOPPED below runThreshold - hysteresis
+  uint8_t debounceCount;       // Consecutive samples to confirm RUNNING/STOPPED
+  uint32_t faultAutoResetMs;   // 0 = manual reset only
+
+  // Inverse-time overload, on top of the flat maxCurrent trip
+  fl_thermal_mode_t thermalMode;
+  float thermalPickup;         // A — motor full-load current (image) / Is (IDMT)
+  float thermalTms;            // IDMT time multiplier
+  float tauHeatS;              // Image heating time constant (while current flows)
+  float tauCoolS;              // Image cooling / IDMT reset time constant
+
+  // 3-phase checks, only applied when the input carries phase metrics
+  bool imbalanceEnabled;
+  float maxImbalancePct;       // % unbalance, checked while running
+  uint32_t imbalanceDelayMs;
+  bool phaseLossEnabled;
+  uint32_t phaseLossDelayMs;
+  bool voltageEnabled;
+  float underVoltage;          // V on any phase, 0 = no lower limit
+  float overVoltage;           // V on any phase, 0 = no upper limit
+  uint32_t voltageDelayMs;     // Checked while commanded or running
+};
+
+// Engine state for one motor (timers and debounce). The motor state itself
+// is owned by the caller and passed in with every sample.
+struct fl_protection_t {
+  fl_motor_state_t pendingState;
+  uint8_t debounce;
+  bool ocActive;
+  bool drActive;
+  uint32_t ocSinceMs;
+  uint32_t drSinceMs;
+  uint32_t faultMs;            // When the last trip was decided
+
+  // Overload accumulator: 0 = cold, 1.0 = trip. Keeps cooling while stopped
+  // or faulted so a hot motor can't be restarted straight into a re-trip.
+  float thermal;
+  uint32_t thermalMs;
+  bool thermalValid;
+
+  bool ubActive;
+  bool plActive;
+  bool vActive;
+  uint32_t ubSinceMs;
+  uint32_t plSinceMs;
+  uint32_t vSinceMs;
+};
+
+struct fl_protection_input_t {
+  uint32_t nowMs;
+  fl_motor_state_t state;      // Current motor state
+  float current;               // Protection current (worst phase)
+  bool sensorFault;            // Meter offline past the failure limit
+  bool startCommand;
+  uint32_t startCommandMs;
+  bool contactorClosed;
+  uint32_t contactorCloseMs;
+  // 3-phase motor only (nullptr otherwise). Dry run then uses the average
+  // current; 'current' should be the worst phase.
+  const fl_phase_metrics_t* phases;
+};
+
+struct fl_protection_decision_t {
+  fl_motor_state_t state;      // State after this sample
+  fl_trip_t trip;              // Set with FL_PROT_EV_TRIP
+  uint16_t events;
+};
+
+void fl_protectionInit(fl_protection_t& s);
+
+// Call when a fault is cleared (manually or on FL_PROT_EV_AUTO_RESET)
+void fl_protectionReset(fl_protection_t& s);
+
+// Back to a cold accumulator. Call when the thermal mode or pickup changes:
+// an image's (I/Ib)^2 and IDMT's integrated 1/t(I) are different quantities,
+// and either is meaningless against a new pickup.
+void fl_protectionThermalReset(fl_protection_t& s);
+
+// One pass over the three phases. A phase counts as lost when it carries
+// less than lossFraction of the highest phase current.
+void fl_phaseMetrics(const float v[3], const float i[3], float lossFraction,
+                     fl_phase_metrics_t& out);
+
+fl_protection_decision_t fl_protectionStep(fl_protection_t& s, const fl_protection_config_t& cfg,
+                                           const fl_protection_input_t& in);
+
+// True while a pickup delay or debounce is running — the moments where
+// sample rate matters most
+inline bool fl_protectionTiming(const fl_protection_t& s) {
+  return s.ocActive || s.drActive || s.ubActive || s.plActive || s.vActive || s.debounce > 0;
+}
+
+// Used thermal capacity in percent (100 = trip)
+inline float fl_protectionThermalPercent(const fl_protection_t& s) {
+  return s.thermal * 100.0f;
+}
+
+const char* fl_tripToString(fl_trip_t trip);
+fl_fault_t fl_faultFromTrip(fl_trip_t trip);
+const char* fl_faultToString(fl_fault_t fault);
+const char* fl_motorStateToString(fl_motor_state_t state);
+const char* fl_thermalModeToString(fl_thermal_mode_t mode);
+// Case-insensitive. Returns FL_THERMAL_MODE_COUNT if unknown.
+fl_thermal_mode_t fl_thermalModeFromString(const char* name);
+
+#endif
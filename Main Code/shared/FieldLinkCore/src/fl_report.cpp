@@ -0,0 +1,53 @@
+#include "fl_report.h"
+#include <math.h>
+#include <string.h>
+
+void fl_reportInit(fl_report_t& r) {
+  memset(&r, 0, sizeof(r));
+  r.cfg.exception = true;
+  r.cfg.deadbandV = FL_REPORT_DEFAULT_DEADBAND_V;
+  r.cfg.deadbandI = FL_REPORT_DEFAULT_DEADBAND_I;
+  r.cfg.intervalMs = FL_REPORT_DEFAULT_INTERVAL_MS;
+  r.cfg.heartbeatS = FL_REPORT_DEFAULT_HEARTBEAT_S;
+}
+
+bool fl_reportExceeds(float published, float now, float deadband) {
+  bool a = isnan(published);
+  bool b = isnan(now);
+  if (a || b) return a != b;
+  return fabsf(now - published) > deadband;
+}
+
+fl_report_reason_t fl_reportDecide(fl_report_t& r, uint32_t nowMs, bool requested, bool event, bool drift) {
+  if (requested) return FL_REPORT_REQUEST;
+
+  bool slot = nowMs - r.lastSlotMs >= r.cfg.intervalMs + r.stretchMs;
+  if (!r.cfg.exception) return slot ? FL_REPORT_PERIODIC : FL_REPORT_NONE;
+
+  if (event && !r.backoff) return FL_REPORT_EVENT;
+  if (!slot) return FL_REPORT_NONE;
+  if (event) return FL_REPORT_EVENT;
+  if (drift) return FL_REPORT_DEADBAND;
+  if (nowMs - r.lastPublishMs >= (uint32_t)r.cfg.heartbeatS * 1000) return FL_REPORT_HEARTBEAT;
+
+  r.suppressed++;
+  r.lastSlotMs = nowMs;
+  return FL_REPORT_NONE;
+}
+
+void fl_reportSent(fl_report_t& r, uint32_t nowMs, fl_report_reason_t why, bool ok) {
+  r.lastSlotMs = nowMs;
+  r.backoff = !ok;
+  if (!ok) {
+    r.failed++;
+    return;
+  }
+  r.lastPublishMs = nowMs;
+  if (why < FL_REPORT_REASON_COUNT) r.published[why]++;
+}
+
+uint32_t fl_reportPublishedTotal(const fl_report_t& r) {
+  uint32_t n = 0;
+  for (uint8_t k = 0; k < FL_REPORT_REASON_COUNT; k++) n += r.published[k];
+  return n;
+}
@@ -0,0 +1,71 @@
+#ifndef FL_REPORT_H
+#define FL_REPORT_H
+
+// Telemetry publish policy (report-by-exception).
+// The caller compares its live fields against the ones it last published
+// and says whether a discrete field changed (state, fault, DI, DO...) or an
+// analog one left its deadband. A discrete change publishes at once; deadband
+// drift publishes at most once per interval; with nothing to report a
+// heartbeat goes out so subscribers know the device is alive. In periodic
+// mode the policy publishes every interval regardless, as before.
+// Deadband drift is measured from the last published value, not the last
+// sample, so a slow ramp cannot creep through. Hardware-free.
+
+#include <stdint.h>
+
+#define FL_REPORT_DEFAULT_DEADBAND_V   2.0f    // V
+#define FL_REPORT_DEFAULT_DEADBAND_I   0.2f    // A
+#define FL_REPORT_MAX_DEADBAND         100.0f
+#define FL_REPORT_DEFAULT_INTERVAL_MS  2000    // Fastest analog rate; the period in periodic mode
+#define FL_REPORT_MIN_INTERVAL_MS      500
+#define FL_REPORT_MAX_INTERVAL_MS      60000
+#define FL_REPORT_DEFAULT_HEARTBEAT_S  60
+#define FL_REPORT_MAX_HEARTBEAT_S      900
+#define FL_REPORT_THERMAL_DEADBAND     5.0f    // % of trip
+
+// Why a frame went out (publish counters are kept per reason)
+enum fl_report_reason_t : uint8_t {
+  FL_REPORT_NONE = 0,
+  FL_REPORT_REQUEST,      // STATUS command or MQTT reconnect
+  FL_REPORT_EVENT,        // Discrete field changed
+  FL_REPORT_DEADBAND,     // Analog field outside its deadband
+  FL_REPORT_HEARTBEAT,
+  FL_REPORT_PERIODIC,     // Periodic mode
+  FL_REPORT_REASON_COUNT
+};
+
+struct fl_report_config_t {
+  bool exception;         // false = publish every interval
+  float deadbandV;        // 0 = any change
+  float deadbandI;
+  uint32_t intervalMs;
+  uint16_t heartbeatS;
+};
+
+struct fl_report_t {
+  fl_report_config_t cfg;
+  uint32_t lastPublishMs;
+  uint32_t lastSlotMs;    // Last publish, attempt or suppressed interval
+  bool backoff;           // Last attempt failed: wait for the next interval
+  uint32_t stretchMs;     // Added to the interval while the link is congested
+  uint32_t published[FL_REPORT_REASON_COUNT];
+  uint32_t suppressed;    // Intervals that passed with nothing to report
+  uint32_t failed;
+};
+
+// Defaults: report-by-exception on
+void fl_reportInit(fl_report_t& r);
+
+// |now - published| beyond the deadband, or a change to/from NaN
+bool fl_reportExceeds(float published, float now, float deadband);
+
+// What to publish now, FL_REPORT_NONE to hold. 'requested' forces a frame.
+// Counts a suppressed interval when one passes with nothing to report.
+fl_report_reason_t fl_reportDecide(fl_report_t& r, uint32_t nowMs, bool requested, bool event, bool drift);
+
+// Record the outcome of a publish fl_reportDecide() asked for
+void fl_reportSent(fl_report_t& r, uint32_t nowMs, fl_report_reason_t why, bool ok);
+
+uint32_t fl_reportPublishedTotal(const fl_report_t& r);
+
+#endif
@@ -0,0 +1,49 @@
+#include "fl_schedule.h"
+#include "fl_clock.h"
+
+bool fl_scheduleAllowedAt(const fl_schedule_t& s, const fl_tariff_map_t* tariff, const struct tm& day, uint16_t minute) {
+  if (tariff) return fl_tariffAllowsMinute(*tariff, day, minute);
+
+  if (!s.enabled) return true;
+
+  if (!(s.days & (1 << day.tm_wday))) {
+    return false;
+  }
+
+  int startMins = s.startHour * 60 + s.startMinute;
+  int endMins = s.endHour * 60 + s.endMinute;
+
+  if (startMins <= endMins) {
+    return minute >= startMins && minute < endMins;
+  } else {
+    return minute >= startMins || minute < endMins;
+  }
+}
+
+fl_schedule_eval_t fl_scheduleEval(const fl_schedule_t& s, const fl_tariff_map_t* tariff, time_t now) {
+  if ((!tariff && !s.enabled) || now < FL_CLOCK_VALID_EPOCH) return { true, 0 };
+
+  struct tm day;
+  localtime_r(&now, &day);
+  uint16_t minute = day.tm_hour * 60 + day.tm_min;
+  bool allowed = fl_scheduleAllowedAt(s, tariff, day, minute);
+
+  // Walk forward to the first minute that differs. Runs only on an edge or a
+  // settings change, never per sample.
+  for (uint8_t d = 0; d <= FL_SCHEDULE_HORIZON_DAYS; d++) {
+    for (uint16_t m = (d == 0) ? minute + 1 : 0; m < FL_TARIFF_DAY_MINUTES; m++) {
+      if (fl_scheduleAllowedAt(s, tariff, day, m) == allowed) continue;
+      day.tm_hour = m / 60;
+      day.tm_min = m % 60;
+      day.tm_sec = 0;
+      day.tm_isdst = -1;
+      return { allowed, mktime(&day) };
+    }
+    // Next calendar day; mktime() fixes up month, year and weekday
+    day.tm_mday++;
+    day.tm_hour = 12;
+    day.tm_isdst = -1;
+    mktime(&day);
+  }
+  return { allowed, now + FL_SCHEDULE_HORIZON_DAYS * 86400L };
+}
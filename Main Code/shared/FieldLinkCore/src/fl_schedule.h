@@ -0,0 +1,38 @@
+#ifndef FL_SCHEDULE_H
+#define FL_SCHEDULE_H
+
+// Pump run window: one daily start/end (wrapping past midnight when the end
+// is earlier) on the days in a weekday mask, or a TOU tariff, which
+// overrides the window while enabled. The controller evaluates it only when
+// an edge is due or an input changes, and keeps the time of the next edge.
+// Hardware-free.
+
+#include <stdint.h>
+#include <time.h>
+#include "fl_tariff.h"
+
+#define FL_SCHEDULE_HORIZON_DAYS  8            // Longest look-ahead for the next edge
+
+struct fl_schedule_t {
+  bool enabled;
+  uint8_t startHour;
+  uint8_t startMinute;
+  uint8_t endHour;
+  uint8_t endMinute;
+  uint8_t days;                // Bitmask: bit0=Sun...bit6=Sat (0x7F = all days)
+};
+
+struct fl_schedule_eval_t {
+  bool allowed;
+  time_t nextChange;           // 0 = never changes (no window, or no valid time yet)
+};
+
+// Minute 0..1439 of the calendar day in 'day'
+bool fl_scheduleAllowedAt(const fl_schedule_t& s, const fl_tariff_map_t* tariff, const struct tm& day, uint16_t minute);
+
+// Window state at 'now' and when it next flips. Without valid time the pump
+// is allowed to run. With no edge inside the horizon, nextChange is the
+// horizon itself so a later season is still picked up.
+fl_schedule_eval_t fl_scheduleEval(const fl_schedule_t& s, const fl_tariff_map_t* tariff, time_t now);
+
+#endif
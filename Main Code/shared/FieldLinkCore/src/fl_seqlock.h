@@ -0,0 +1,73 @@
+#ifndef FL_SEQLOCK_H
+#define FL_SEQLOCK_H
+
+// Single-writer / multi-reader sequence lock.
+// The writer never blocks; readers retry if they overlap a write, so every
+// read returns a complete, consistent copy of T. T must be trivially copyable.
+//
+// A reader may outrank the writer (AsyncTCP at priority 3 reading what the
+// loop task at 1 publishes). If it preempts the writer mid-copy on the same
+// core, spinning would never let the write finish, so after a few tries the
+// reader sleeps a tick and the writer gets the CPU back.
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+#define FL_SEQLOCK_SPINS  4            // Tries before the reader starts sleeping
+
+template <typename T>
+class fl_seqlock {
+public:
+  fl_seqlock() : _seq(0) { memset(&_data, 0, sizeof(_data)); }
+
+  // Writer side — one task only
+  void write(const T& value) {
+    uint32_t s = _seq.load(std::memory_order_relaxed);
+    _seq.store(s + 1, std::memory_order_relaxed);        // odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&_data, &value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_release);
+    _seq.store(s + 2, std::memory_order_release);        // even: stable
+  }
+
+  // Reader side — any task, never takes a lock. Returns false only if the
+  // writer has never published. Not from an ISR: a contended read sleeps.
+  bool read(T& out) const {
+    uint8_t tries = 0;
+    for (;;) {
+      if (tries < FL_SEQLOCK_SPINS) tries++;
+      else backoff();
+      uint32_t s1 = _seq.load(std::memory_order_acquire);
+      if (s1 & 1) continue;
+      memcpy(&out, &_data, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_seq.load(std::memory_order_relaxed) == s1) return s1 != 0;
+    }
+  }
+
+  // Number of completed writes
+  uint32_t version() const { return _seq.load(std::memory_order_acquire) >> 1; }
+
+private:
+  // A blocking delay, not a yield: taskYIELD() only hands over to equal or
+  // higher priorities, never to a lower-priority writer
+  static void backoff() {
+#ifdef ARDUINO
+    vTaskDelay(1);
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  std::atomic<uint32_t> _seq;
+  T _data;
+};
+
+#endif
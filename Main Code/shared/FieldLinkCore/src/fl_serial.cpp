@@ -18,7 +18,13 @@ void fl_handleSerial() {
 
   String input = Serial.readStringUntil('\n');
   input.trim();
+  if (!input.length()) return;
+  if (!fl_postCommand(FL_CMD_SERIAL, input.c_str(), input.length())) {
+    Serial.println("Command queue full, ignored");
+  }
+}
 
+void fl_runSerialCommand(const String& input) {
   if (input == "WIFI_RESET") {
     Serial.println("\n=== WIFI RESET ===");
     Serial.println("Clearing saved WiFi credentials...");
@@ -44,7 +50,12 @@ void fl_handleSerial() {
     if (fl_mqttConnected && fl_lastMqttActivity > 0) {
       Serial.printf("MQTT last activity: %lu seconds ago\n", (millis() - fl_lastMqttActivity) / 1000);
     }
+    fl_printConnStatus();
+    fl_printCommandStatus();
     Serial.printf("Sensor: %s\n", fl_sensorOnline ? "Online" : "Offline");
+    fl_printModbusStatus();
+    fl_printJournalStatus();
+    fl_printHistoryStatus();
     Serial.println("\n--- MQTT Topics ---");
     Serial.printf("Telemetry: %s\n", fl_TOPIC_TELEMETRY);
     Serial.printf("Command: %s\n", fl_TOPIC_COMMAND);
@@ -95,6 +106,37 @@ void fl_handleSerial() {
       Serial.printf("DO%d set to %s (channel %d, do_state=0x%02X)\n", ch+1, on?"ON":"OFF", ch, fl_do_state);
     }
   }
+  else if (input == "METER") {
+    for (uint8_t m = 0; m < fl_getMeterCount(); m++) {
+      const fl_meter_plan_t& plan = fl_getMeterPlan(m);
+      Serial.printf("Meter %d model: %s\n", m + 1, fl_meterModelName(fl_getMeterModel(m)));
+      for (int i = 0; i < plan.blockCount; i++) {
+        Serial.printf("  Block %d: 0x%04X x%d\n", i + 1, plan.blocks[i].address, plan.blocks[i].count);
+      }
+    }
+  }
+  else if (input.startsWith("METER ")) {
+    // METER [n] <SDM630|ADL400|GENERIC> — saved to NVS, applied on the next read
+    String arg = input.substring(6);
+    arg.trim();
+    uint8_t meter = 0;
+    int space = arg.indexOf(' ');
+    if (space > 0 && isDigit(arg[0])) {
+      meter = arg.substring(0, space).toInt() - 1;
+      arg = arg.substring(space + 1);
+    }
+    fl_meter_model_t model = fl_meterModelFromName(arg.c_str());
+    if (meter >= fl_getMeterCount()) {
+      Serial.printf("No meter %d\n", meter + 1);
+    } else if (model < FL_METER_MODEL_COUNT) {
+      fl_setMeterModel(model, meter);
+    } else {
+      Serial.println("Unknown meter model (SDM630, ADL400, GENERIC)");
+    }
+  }
+  else if (input == "BUS") {
+    fl_printModbusStatus();
+  }
   else if (input == "HELP") {
     Serial.println("\n=== SERIAL COMMANDS ===");
     Serial.println("STATUS       - Show system status");
@@ -103,6 +145,8 @@ void fl_handleSerial() {
     Serial.println("FACTORY_RESET- Clear all settings");
     Serial.println("DOxON/DOxOFF - Control any DO (x=1-8)");
     Serial.println("I2CTEST      - Test I2C communication with TCA9554");
+    Serial.println("METER [n] [model] - Show or set energy meter model");
+    Serial.println("BUS          - Modbus devices, poll rates and health");
     // Forward to project for additional help text
     if (_serialProjectCallback) {
       _serialProjectCallback(input);
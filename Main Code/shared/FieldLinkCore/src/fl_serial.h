@@ -9,7 +9,11 @@ typedef void (*fl_serial_callback_t)(const String& cmd);
 // Set project serial command callback
 void fl_setSerialCallback(fl_serial_callback_t callback);
 
-// Handle serial commands (call in loop via fl_tick)
+// Read a serial line into the command queue (call in loop via fl_tick)
 void fl_handleSerial();
 
+// Run one serial command: library commands, else the project callback
+// (fl_processCommands)
+void fl_runSerialCommand(const String& input);
+
 #endif
@@ -1,14 +1,18 @@
 #include "fl_storage.h"
 #include <WiFi.h>
 #include <nvs_flash.h>
+#include <esp_partition.h>
 #include "esp_wifi.h"
 
 char fl_DEVICE_ID[16] = "";
 char fl_AP_NAME[32] = "";
 char fl_TOPIC_TELEMETRY[64] = "";
+char fl_TOPIC_TELEMETRY_BIN[72] = "";
+char fl_TOPIC_TELEMETRY_STATS[72] = "";
+char fl_TOPIC_TELEMETRY_REPLAY[72] = "";
 char fl_TOPIC_COMMAND[64] = "";
 char fl_TOPIC_STATUS[64] = "";
-char fl_TOPIC_SUBSCRIBE[64] = "";
+char fl_TOPIC_ACK[64] = "";
 
 char fl_mqtt_host[128] = "";
 uint16_t fl_mqtt_port = 8883;
@@ -17,6 +21,8 @@ char fl_mqtt_pass[64] = "";
 bool fl_mqtt_use_tls = true;
 
 Preferences fl_preferences;
+fl_journal_t fl_journal;
+fl_history_t fl_history;
 
 // Default MQTT values (set via fl_setMqttDefaults)
 static char _default_mqtt_host[128] = "";
@@ -41,6 +47,90 @@ void fl_initNVS() {
   }
 }
 
+/* ===== Data partition: journal, then history ===== */
+
+// The "spiffs" partition (1.4 MB) is split: the first FL_JOURNAL_REGION
+// bytes hold the offline journal, the rest the history ring
+#define FL_JOURNAL_REGION  0x70000
+
+static const esp_partition_t* dataPartition() {
+  static const esp_partition_t* p =
+    esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "spiffs");
+  return p;
+}
+
+static uint32_t journalSize() {
+  return dataPartition()->size < FL_JOURNAL_REGION ? dataPartition()->size : FL_JOURNAL_REGION;
+}
+
+static bool journalRead(uint32_t addr, void* dst, size_t len) {
+  return esp_partition_read(dataPartition(), addr, dst, len) == ESP_OK;
+}
+
+static bool journalWrite(uint32_t addr, const void* src, size_t len) {
+  return esp_partition_write(dataPartition(), addr, src, len) == ESP_OK;
+}
+
+static bool journalErase(uint32_t addr) {
+  return esp_partition_erase_range(dataPartition(), addr, FL_JOURNAL_SECTOR) == ESP_OK;
+}
+
+static bool historyRead(uint32_t addr, void* dst, size_t len) {
+  return esp_partition_read(dataPartition(), FL_JOURNAL_REGION + addr, dst, len) == ESP_OK;
+}
+
+static bool historyWrite(uint32_t addr, const void* src, size_t len) {
+  return esp_partition_write(dataPartition(), FL_JOURNAL_REGION + addr, src, len) == ESP_OK;
+}
+
+static bool historyErase(uint32_t addr) {
+  return esp_partition_erase_range(dataPartition(), FL_JOURNAL_REGION + addr, FL_HISTORY_BLOCK) == ESP_OK;
+}
+
+static const fl_flash_port_t journalPort = { journalRead, journalWrite, journalErase };
+static const fl_flash_port_t historyPort = { historyRead, historyWrite, historyErase };
+
+void fl_initJournal() {
+  if (!dataPartition()) {
+    Serial.println("Journal: no spiffs partition, offline telemetry will be dropped");
+    return;
+  }
+  fl_journalMount(fl_journal, &journalPort, journalSize());
+  Serial.printf("Journal: %u sectors, %lu records pending, most-erased sector %lu\n", fl_journal.sectors,
+                (unsigned long)fl_journal.pending, (unsigned long)fl_journal.eraseMax);
+}
+
+void fl_initHistory(uint8_t series) {
+  const esp_partition_t* p = dataPartition();
+  uint32_t size = p && p->size > FL_JOURNAL_REGION ? p->size - FL_JOURNAL_REGION : 0;
+  if (!fl_historyMount(fl_history, series, size ? &historyPort : nullptr, size)) {
+    Serial.println("History: no flash region, keeping the last block per pump in RAM");
+    return;
+  }
+  Serial.printf("History: %u sectors, newest block %lu\n", fl_history.sectors,
+                (unsigned long)fl_history.headSeq.load());
+}
+
+void fl_printJournalStatus() {
+  const fl_journal_t& j = fl_journal;
+  if (!j.ready) {
+    Serial.println("Journal: unavailable");
+    return;
+  }
+  Serial.printf("Journal: %lu pending | %lu appended, %lu replayed, %lu dropped | %lu erases (max sector %lu) | WA %.2f | %lu errors\n",
+                (unsigned long)j.pending, (unsigned long)j.appended, (unsigned long)j.replayed,
+                (unsigned long)j.dropped, (unsigned long)j.erases, (unsigned long)j.eraseMax,
+                fl_journalWriteAmplification(j), (unsigned long)j.errors);
+}
+
+void fl_printHistoryStatus() {
+  const fl_history_t& h = fl_history;
+  if (!h.ready) return;
+  Serial.printf("History: %lu points, %.1f bits/point | %lu blocks to flash, %lu dropped | %lu errors\n",
+                (unsigned long)h.points, fl_historyBitsPerPoint(h), (unsigned long)h.blocks,
+                (unsigned long)h.dropped, (unsigned long)h.errors);
+}
+
 void fl_checkWifiRestore() {
   fl_preferences.begin("fieldlink", false);
   bool wifiRestoreDone = fl_preferences.getBool("wifi_restored", false);
@@ -62,9 +152,12 @@ void fl_generateDeviceId() {
   snprintf(fl_DEVICE_ID, sizeof(fl_DEVICE_ID), "FL-%02X%02X%02X", mac[3], mac[4], mac[5]);
   snprintf(fl_AP_NAME, sizeof(fl_AP_NAME), "FieldLink-%02X%02X%02X", mac[3], mac[4], mac[5]);
   snprintf(fl_TOPIC_TELEMETRY, sizeof(fl_TOPIC_TELEMETRY), "fieldlink/%s/telemetry", fl_DEVICE_ID);
+  snprintf(fl_TOPIC_TELEMETRY_BIN, sizeof(fl_TOPIC_TELEMETRY_BIN), "fieldlink/%s/telemetry.bin", fl_DEVICE_ID);
+  snprintf(fl_TOPIC_TELEMETRY_STATS, sizeof(fl_TOPIC_TELEMETRY_STATS), "fieldlink/%s/telemetry.stats", fl_DEVICE_ID);
+  snprintf(fl_TOPIC_TELEMETRY_REPLAY, sizeof(fl_TOPIC_TELEMETRY_REPLAY), "fieldlink/%s/telemetry.replay", fl_DEVICE_ID);
   snprintf(fl_TOPIC_COMMAND, sizeof(fl_TOPIC_COMMAND), "fieldlink/%s/command", fl_DEVICE_ID);
   snprintf(fl_TOPIC_STATUS, sizeof(fl_TOPIC_STATUS), "fieldlink/%s/status", fl_DEVICE_ID);
-  snprintf(fl_TOPIC_SUBSCRIBE, sizeof(fl_TOPIC_SUBSCRIBE), "fieldlink/%s/#", fl_DEVICE_ID);
+  snprintf(fl_TOPIC_ACK, sizeof(fl_TOPIC_ACK), "fieldlink/%s/ack", fl_DEVICE_ID);
 }
 
 void fl_printDeviceInfo() {
@@ -74,6 +167,7 @@ void fl_printDeviceInfo() {
   Serial.printf("  WiFi AP Name: %s\n", fl_AP_NAME);
   Serial.printf("  Telemetry Topic: %s\n", fl_TOPIC_TELEMETRY);
   Serial.printf("  Command Topic:   %s\n", fl_TOPIC_COMMAND);
+  Serial.printf("  Ack Topic:       %s\n", fl_TOPIC_ACK);
   Serial.println("========================================\n");
 }
 
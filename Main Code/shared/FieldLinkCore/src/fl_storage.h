@@ -3,14 +3,19 @@
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include "fl_journal.h"
+#include "fl_history.h"
 
 // Device identification
 extern char fl_DEVICE_ID[16];
 extern char fl_AP_NAME[32];
 extern char fl_TOPIC_TELEMETRY[64];
+extern char fl_TOPIC_TELEMETRY_BIN[72];
+extern char fl_TOPIC_TELEMETRY_STATS[72];
+extern char fl_TOPIC_TELEMETRY_REPLAY[72];
 extern char fl_TOPIC_COMMAND[64];
 extern char fl_TOPIC_STATUS[64];
-extern char fl_TOPIC_SUBSCRIBE[64];
+extern char fl_TOPIC_ACK[64];
 
 // MQTT configuration (loaded from NVS, fallback to defaults)
 extern char fl_mqtt_host[128];
@@ -28,6 +33,18 @@ void fl_setMqttDefaults(const char* host, uint16_t port, const char* user, const
 // Initialize NVS
 void fl_initNVS();
 
+// Store-and-forward journal on the "spiffs" data partition (fl_journal.h).
+// fl_journal.ready stays false if the partition is missing.
+extern fl_journal_t fl_journal;
+void fl_initJournal();
+void fl_printJournalStatus();
+
+// Per-pump V/I/state history (fl_history.h) on the rest of that partition,
+// one series per pump. Called by the controller, which knows the pump count.
+extern fl_history_t fl_history;
+void fl_initHistory(uint8_t series);
+void fl_printHistoryStatus();
+
 // One-time WiFi restore fix
 void fl_checkWifiRestore();
 
@@ -0,0 +1,203 @@
+#include "fl_tariff.h"
+#include <string.h>
+
+/* ================= DEFAULT ================= */
+
+static void addSegment(fl_tou_profile_t& p, uint16_t startMin, uint16_t endMin, fl_tou_band_t band) {
+  if (p.count >= FL_TARIFF_MAX_SEGMENTS) return;
+  p.seg[p.count++] = { startMin, endMin, band };
+}
+
+void fl_tariffDefault(fl_tariff_t& t) {
+  memset(&t, 0, sizeof(t));
+  t.version = FL_TARIFF_VERSION;
+  strncpy(t.name, "Ruraflex 2025/26", sizeof(t.name) - 1);
+  t.allowMask = 1 << FL_TOU_OFF_PEAK;
+  t.seasonCount = 2;
+
+  // High demand (June-August)
+  fl_tou_season_t& high = t.season[0];
+  high.months = 0x00E0;
+  addSegment(high.day[FL_TOU_WEEKDAY], 360, 480, FL_TOU_PEAK);
+  addSegment(high.day[FL_TOU_WEEKDAY], 480, 1020, FL_TOU_STANDARD);
+  addSegment(high.day[FL_TOU_WEEKDAY], 1020, 1200, FL_TOU_PEAK);
+  addSegment(high.day[FL_TOU_WEEKDAY], 1200, 1320, FL_TOU_STANDARD);
+
+  // Low demand (September-May)
+  fl_tou_season_t& low = t.season[1];
+  low.months = FL_TARIFF_ALL_MONTHS & ~0x00E0;
+  addSegment(low.day[FL_TOU_WEEKDAY], 360, 420, FL_TOU_STANDARD);
+  addSegment(low.day[FL_TOU_WEEKDAY], 420, 540, FL_TOU_PEAK);
+  addSegment(low.day[FL_TOU_WEEKDAY], 540, 1020, FL_TOU_STANDARD);
+  addSegment(low.day[FL_TOU_WEEKDAY], 1020, 1200, FL_TOU_PEAK);
+  addSegment(low.day[FL_TOU_WEEKDAY], 1200, 1320, FL_TOU_STANDARD);
+
+  // Weekends and holidays: standard 07:00-12:00 and 18:00-20:00, no peak
+  for (uint8_t s = 0; s < t.seasonCount; s++) {
+    for (uint8_t d = FL_TOU_SATURDAY; d < FL_TOU_DAY_COUNT; d++) {
+      addSegment(t.season[s].day[d], 420, 720, FL_TOU_STANDARD);
+      addSegment(t.season[s].day[d], 1080, 1200, FL_TOU_STANDARD);
+    }
+  }
+}
+
+/* ================= VALIDATE / COMPILE ================= */
+
+const char* fl_tariffValidate(const fl_tariff_t& t) {
+  if (t.version != FL_TARIFF_VERSION) return "version";
+  if (t.seasonCount == 0 || t.seasonCount > FL_TARIFF_MAX_SEASONS) return "season count";
+  if (t.allowMask == 0 || t.allowMask >= (1 << FL_TOU_BAND_COUNT)) return "allow mask";
+  if (t.holidayCount > FL_TARIFF_MAX_HOLIDAYS) return "holiday count";
+
+  uint16_t covered = 0;
+  for (uint8_t s = 0; s < t.seasonCount; s++) {
+    const fl_tou_season_t& season = t.season[s];
+    if (season.months & ~FL_TARIFF_ALL_MONTHS) return "month mask";
+    if (season.months & covered) return "month in two seasons";
+    covered |= season.months;
+    for (uint8_t d = 0; d < FL_TOU_DAY_COUNT; d++) {
+      const fl_tou_profile_t& p = season.day[d];
+      if (p.count > FL_TARIFF_MAX_SEGMENTS) return "segment count";
+      for (uint8_t k = 0; k < p.count; k++) {
+        const fl_tou_segment_t& g = p.seg[k];
+        if (g.startMin >= FL_TARIFF_DAY_MINUTES || g.endMin > FL_TARIFF_DAY_MINUTES) return "segment time";
+        if (g.startMin == g.endMin) return "empty segment";
+        if (g.band >= FL_TOU_BAND_COUNT) return "band";
+      }
+    }
+  }
+  if (covered != FL_TARIFF_ALL_MONTHS) return "month without season";
+
+  for (uint8_t h = 0; h < t.holidayCount; h++) {
+    if (t.holiday[h].month < 1 || t.holiday[h].month > 12) return "holiday month";
+    if (t.holiday[h].day < 1 || t.holiday[h].day > 31) return "holiday day";
+  }
+  return nullptr;
+}
+
+static void setBits(uint8_t* row, uint16_t from, uint16_t to, bool on) {
+  for (uint16_t b = from; b < to; b++) {
+    if (on) row[b >> 3] |= (1 << (b & 7));
+    else row[b >> 3] &= ~(1 << (b & 7));
+  }
+}
+
+// One day of 1440 bits starting at bit 'base' of row
+static void compileDay(uint8_t* row, uint16_t base, const fl_tou_profile_t& p, uint8_t allowMask) {
+  setBits(row, base, base + FL_TARIFF_DAY_MINUTES, allowMask & (1 << FL_TOU_OFF_PEAK));
+  for (uint8_t k = 0; k < p.count; k++) {
+    const fl_tou_segment_t& g = p.seg[k];
+    bool on = allowMask & (1 << g.band);
+    if (g.startMin < g.endMin) {
+      setBits(row, base + g.startMin, base + g.endMin, on);
+    } else {
+      setBits(row, base + g.startMin, base + FL_TARIFF_DAY_MINUTES, on);
+      setBits(row, base, base + g.endMin, on);
+    }
+  }
+}
+
+void fl_tariffCompile(const fl_tariff_t& t, fl_tariff_map_t& map) {
+  memset(&map, 0, sizeof(map));
+
+  for (uint8_t s = 0; s < t.seasonCount; s++) {
+    const fl_tou_season_t& season = t.season[s];
+    for (uint8_t m = 0; m < 12; m++)
+      if (season.months & (1 << m)) map.seasonOfMonth[m] = s;
+
+    for (uint8_t wday = 0; wday < 7; wday++) {
+      fl_tou_day_t d = wday == 0 ? FL_TOU_SUNDAY : wday == 6 ? FL_TOU_SATURDAY : FL_TOU_WEEKDAY;
+      compileDay(map.week[s], wday * FL_TARIFF_DAY_MINUTES, season.day[d], t.allowMask);
+    }
+    compileDay(map.holiday[s], 0, season.day[FL_TOU_HOLIDAY], t.allowMask);
+  }
+
+  for (uint8_t h = 0; h < t.holidayCount; h++)
+    map.holidayDays[t.holiday[h].month - 1] |= 1UL << t.holiday[h].day;
+}
+
+const char* fl_touBandToString(fl_tou_band_t band) {
+  switch (band) {
+    case FL_TOU_OFF_PEAK: return "off_peak";
+    case FL_TOU_STANDARD: return "standard";
+    case FL_TOU_PEAK:     return "peak";
+    default:              return "unknown";
+  }
+}
+
+/* ================= JSON ================= */
+
+static const char* const kDayKey[FL_TOU_DAY_COUNT] = { "wd", "sat", "sun", "hol" };
+
+static const char* profileFromJson(JsonArrayConst src, fl_tou_profile_t& p) {
+  p.count = 0;
+  if (src.size() > FL_TARIFF_MAX_SEGMENTS) return "too many segments";
+  for (JsonArrayConst seg : src) {
+    if (seg.size() != 3) return "segment is not [start, end, band]";
+    p.seg[p.count].startMin = seg[0] | 0;
+    p.seg[p.count].endMin = seg[1] | 0;
+    p.seg[p.count].band = (fl_tou_band_t)(seg[2] | 0);
+    p.count++;
+  }
+  return nullptr;
+}
+
+const char* fl_tariffFromJson(JsonVariantConst src, fl_tariff_t& t) {
+  memset(&t, 0, sizeof(t));
+  t.version = FL_TARIFF_VERSION;
+  strncpy(t.name, src["name"] | "custom", sizeof(t.name) - 1);
+  t.allowMask = src["allow"] | (1 << FL_TOU_OFF_PEAK);
+
+  JsonArrayConst seasons = src["seasons"];
+  if (seasons.isNull() || seasons.size() == 0) return "no seasons";
+  if (seasons.size() > FL_TARIFF_MAX_SEASONS) return "too many seasons";
+  for (JsonObjectConst so : seasons) {
+    fl_tou_season_t& season = t.season[t.seasonCount++];
+    season.months = so["months"] | 0;
+    for (uint8_t d = 0; d < FL_TOU_DAY_COUNT; d++) {
+      // Missing Sunday copies Saturday, missing holiday copies Sunday
+      if (!so.containsKey(kDayKey[d]) && d >= FL_TOU_SUNDAY) {
+        season.day[d] = season.day[d - 1];
+        continue;
+      }
+      const char* err = profileFromJson(so[kDayKey[d]], season.day[d]);
+      if (err) return err;
+    }
+  }
+
+  JsonArrayConst holidays = src["holidays"];
+  if (holidays.size() > FL_TARIFF_MAX_HOLIDAYS) return "too many holidays";
+  for (JsonArrayConst h : holidays) {
+    t.holiday[t.holidayCount].month = h[0] | 0;
+    t.holiday[t.holidayCount].day = h[1] | 0;
+    t.holidayCount++;
+  }
+
+  return fl_tariffValidate(t);
+}
+
+void fl_tariffToJson(JsonObject o, const fl_tariff_t& t) {
+  o["name"] = t.name;
+  o["allow"] = t.allowMask;
+  JsonArray seasons = o.createNestedArray("seasons");
+  for (uint8_t s = 0; s < t.seasonCount; s++) {
+    JsonObject so = seasons.createNestedObject();
+    so["months"] = t.season[s].months;
+    for (uint8_t d = 0; d < FL_TOU_DAY_COUNT; d++) {
+      JsonArray segs = so.createNestedArray(kDayKey[d]);
+      const fl_tou_profile_t& p = t.season[s].day[d];
+      for (uint8_t k = 0; k < p.count; k++) {
+        JsonArray seg = segs.createNestedArray();
+        seg.add(p.seg[k].startMin);
+        seg.add(p.seg[k].endMin);
+        seg.add((uint8_t)p.seg[k].band);
+      }
+    }
+  }
+  JsonArray holidays = o.createNestedArray("holidays");
+  for (uint8_t h = 0; h < t.holidayCount; h++) {
+    JsonArray hd = holidays.createNestedArray();
+    hd.add(t.holiday[h].month);
+    hd.add(t.holiday[h].day);
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef FL_TARIFF_H
+#define FL_TARIFF_H
+
+// Time-of-use tariff engine.
+// A tariff is data: up to four seasons (each owning a set of months), and per
+// season a weekday, Saturday, Sunday and public-holiday profile of
+// [start, end) minute ranges tagged peak / standard / off-peak. Minutes not
+// covered by any range are off-peak. allowMask says which bands the pumps may
+// run in (off-peak only for Ruraflex-style load shifting).
+//
+// fl_tariffCompile() turns the definition into one 7x1440-bit week bitmap per
+// season plus a 1440-bit holiday day, so fl_tariffAllows() is a table index
+// and a single bit test. Definition, compile, lookup and JSON are
+// hardware-free (fl_tariff.cpp); the NVS helpers take the caller's
+// Preferences (fl_tariff_nvs.cpp).
+
+#include <stdint.h>
+#include <time.h>
+#include <ArduinoJson.h>
+
+class Preferences;
+
+#define FL_TARIFF_VERSION         1
+#define FL_TARIFF_MAX_SEASONS     4
+#define FL_TARIFF_MAX_SEGMENTS    8      // Per day profile
+#define FL_TARIFF_MAX_HOLIDAYS    16
+#define FL_TARIFF_NAME_LEN        24
+#define FL_TARIFF_DAY_MINUTES     1440
+#define FL_TARIFF_ALL_MONTHS      0x0FFF
+
+enum fl_tou_band_t : uint8_t {
+  FL_TOU_OFF_PEAK = 0,
+  FL_TOU_STANDARD,
+  FL_TOU_PEAK,
+  FL_TOU_BAND_COUNT
+};
+
+enum fl_tou_day_t : uint8_t {
+  FL_TOU_WEEKDAY = 0,
+  FL_TOU_SATURDAY,
+  FL_TOU_SUNDAY,
+  FL_TOU_HOLIDAY,
+  FL_TOU_DAY_COUNT
+};
+
+struct fl_tou_segment_t {
+  uint16_t startMin;           // 0..1439
+  uint16_t endMin;             // 1..1440, exclusive. endMin <= startMin wraps past midnight.
+  fl_tou_band_t band;
+};
+
+struct fl_tou_profile_t {
+  uint8_t count;
+  fl_tou_segment_t seg[FL_TARIFF_MAX_SEGMENTS];   // Later segments win where they overlap
+};
+
+struct fl_tou_season_t {
+  uint16_t months;             // bit0 = January .. bit11 = December
+  fl_tou_profile_t day[FL_TOU_DAY_COUNT];
+};
+
+struct fl_tou_holiday_t {
+  uint8_t month;               // 1..12
+  uint8_t day;                 // 1..31
+};
+
+// Persisted as one NVS blob — keep it plain data
+struct fl_tariff_t {
+  uint8_t version;
+  char name[FL_TARIFF_NAME_LEN];
+  uint8_t allowMask;           // bit per fl_tou_band_t
+  uint8_t seasonCount;
+  fl_tou_season_t season[FL_TARIFF_MAX_SEASONS];
+  uint8_t holidayCount;
+  fl_tou_holiday_t holiday[FL_TARIFF_MAX_HOLIDAYS];
+};
+
+#define FL_TARIFF_WEEK_BYTES  (7 * FL_TARIFF_DAY_MINUTES / 8)   // 1260
+#define FL_TARIFF_DAY_BYTES   (FL_TARIFF_DAY_MINUTES / 8)       // 180
+
+// Lookup tables: a set bit means pumping is allowed in that minute
+struct fl_tariff_map_t {
+  uint8_t seasonOfMonth[12];
+  uint32_t holidayDays[12];    // bit n = day n of the month is a holiday
+  uint8_t week[FL_TARIFF_MAX_SEASONS][FL_TARIFF_WEEK_BYTES];      // Row = tm_wday (0 = Sunday)
+  uint8_t holiday[FL_TARIFF_MAX_SEASONS][FL_TARIFF_DAY_BYTES];
+};
+
+// Eskom Ruraflex 2025/26: high-demand season June-August, no holidays,
+// pumping in off-peak only
+void fl_tariffDefault(fl_tariff_t& t);
+
+// nullptr if the definition is usable, otherwise the reason. Every month must
+// belong to exactly one season.
+const char* fl_tariffValidate(const fl_tariff_t& t);
+
+// t must be valid
+void fl_tariffCompile(const fl_tariff_t& t, fl_tariff_map_t& map);
+
+// Minute 0..1439 of the calendar day in 'day' (only the date fields are used)
+inline bool fl_tariffAllowsMinute(const fl_tariff_map_t& map, const struct tm& day, uint16_t minute) {
+  uint8_t s = map.seasonOfMonth[day.tm_mon];
+  if (map.holidayDays[day.tm_mon] & (1UL << day.tm_mday))
+    return map.holiday[s][minute >> 3] & (1 << (minute & 7));
+  uint16_t bit = day.tm_wday * FL_TARIFF_DAY_MINUTES + minute;
+  return map.week[s][bit >> 3] & (1 << (bit & 7));
+}
+
+inline bool fl_tariffAllows(const fl_tariff_map_t& map, const struct tm& now) {
+  return fl_tariffAllowsMinute(map, now, now.tm_hour * 60 + now.tm_min);
+}
+
+const char* fl_touBandToString(fl_tou_band_t band);
+
+// Definition from a SET_TARIFF command:
+//   {"name":"Ruraflex","allow":1,
+//    "seasons":[{"months":224,"wd":[[360,480,2],[480,1020,1]],"sat":[[420,720,1]]}, ...],
+//    "holidays":[[1,1],[12,25]]}
+// Segments are [start_min, end_min, band]; "sun" defaults to "sat" and "hol"
+// to "sun". Returns nullptr or the reason the definition was rejected.
+const char* fl_tariffFromJson(JsonVariantConst src, fl_tariff_t& t);
+void fl_tariffToJson(JsonObject o, const fl_tariff_t& t);
+
+// NVS "tariff" namespace. Load falls back to the default when nothing valid
+// is stored; returns true if a stored tariff was used.
+bool fl_tariffLoad(Preferences& prefs, fl_tariff_t& t);
+void fl_tariffSave(Preferences& prefs, const fl_tariff_t& t);
+void fl_tariffErase(Preferences& prefs);
+
+#endif
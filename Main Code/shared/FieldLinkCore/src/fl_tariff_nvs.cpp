@@ -0,0 +1,26 @@
+#include "fl_tariff.h"
+#include <Preferences.h>
+
+/* ================= NVS ================= */
+
+bool fl_tariffLoad(Preferences& prefs, fl_tariff_t& t) {
+  prefs.begin("tariff", true);
+  size_t len = prefs.getBytesLength("def");
+  bool ok = len == sizeof(t) && prefs.getBytes("def", &t, sizeof(t)) == sizeof(t) &&
+            fl_tariffValidate(t) == nullptr;
+  prefs.end();
+  if (!ok) fl_tariffDefault(t);
+  return ok;
+}
+
+void fl_tariffSave(Preferences& prefs, const fl_tariff_t& t) {
+  prefs.begin("tariff", false);
+  prefs.putBytes("def", &t, sizeof(t));
+  prefs.end();
+}
+
+void fl_tariffErase(Preferences& prefs) {
+  prefs.begin("tariff", false);
+  prefs.clear();
+  prefs.end();
+}
@@ -6,19 +6,42 @@
 static char _bot_token[64] = "";
 static char _chat_id[24] = "";
 
+struct telegram_msg_t {
+  int pump;
+  char fault[24];
+  float current;
+};
+
+static QueueHandle_t _queue = nullptr;
+
 void fl_setTelegram(const char* botToken, const char* chatId) {
   strncpy(_bot_token, botToken, sizeof(_bot_token) - 1);
   strncpy(_chat_id, chatId, sizeof(_chat_id) - 1);
+  if (!_queue) _queue = xQueueCreate(FL_TELEGRAM_QUEUE, sizeof(telegram_msg_t));
 }
 
 void fl_sendFaultNotification(int pump, const char* faultType, float current) {
-  if (!fl_wifiConnected) {
-    Serial.println("Cannot send notification - WiFi not connected");
+  if (_bot_token[0] == '\0' || _chat_id[0] == '\0' || !_queue) {
+    Serial.println("Telegram not configured");
     return;
   }
 
-  if (_bot_token[0] == '\0' || _chat_id[0] == '\0') {
-    Serial.println("Telegram not configured");
+  telegram_msg_t msg;
+  msg.pump = pump;
+  strncpy(msg.fault, faultType, sizeof(msg.fault) - 1);
+  msg.fault[sizeof(msg.fault) - 1] = '\0';
+  msg.current = current;
+  if (xQueueSend(_queue, &msg, 0) != pdTRUE) {
+    Serial.println("Telegram queue full, notification dropped");
+  }
+}
+
+void fl_serviceTelegram() {
+  telegram_msg_t msg;
+  if (!_queue || xQueueReceive(_queue, &msg, 0) != pdTRUE) return;
+
+  if (!fl_wifiConnected) {
+    Serial.println("Cannot send notification - WiFi not connected");
     return;
   }
 
@@ -37,14 +60,14 @@ void fl_sendFaultNotification(int pump, const char* faultType, float current) {
     "Pump: *%d*\\n"
     "Fault: *%s* (%.1fA)\\n\\n"
     "Open FieldLogic to view details and reset.\"}",
-    _chat_id, fl_DEVICE_ID, pump, faultType, current);
+    _chat_id, fl_DEVICE_ID, msg.pump, msg.fault, msg.current);
 
   Serial.printf("Sending Telegram to chat %s\n", _chat_id);
 
   HTTPClient http;
   http.begin(url);
   http.addHeader("Content-Type", "application/json");
-  http.setTimeout(3000);  // 3s max — don't block the main loop
+  http.setTimeout(3000);  // 3s max — holds up MQTT servicing meanwhile
 
   unsigned long t0 = millis();
   int httpCode = http.POST(payload);
@@ -3,10 +3,17 @@
 
 #include <Arduino.h>
 
+#define FL_TELEGRAM_QUEUE  4
+
 // Configure Telegram bot token and chat ID
 void fl_setTelegram(const char* botToken, const char* chatId);
 
-// Send fault notification directly to Telegram group
+// Queue a fault notification for the Telegram group. Sent by the network
+// task (an HTTPS POST of up to 3 s); dropped if FL_TELEGRAM_QUEUE are
+// already waiting.
 void fl_sendFaultNotification(int pump, const char* faultType, float current);
 
+// Send one queued notification (network task)
+void fl_serviceTelegram();
+
 #endif
@@ -0,0 +1,70 @@
+#include "fl_telembin.h"
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+void fl_binwBegin(fl_binw_t& w, uint8_t* buf, size_t cap) {
+  w.buf = buf;
+  w.cap = cap;
+  w.len = 0;
+  w.overflow = false;
+}
+
+void fl_binwU8(fl_binw_t& w, uint8_t v) {
+  if (w.len < w.cap) w.buf[w.len++] = v;
+  else w.overflow = true;
+}
+
+void fl_binwU16(fl_binw_t& w, uint16_t v) {
+  fl_binwU8(w, v & 0xFF);
+  fl_binwU8(w, v >> 8);
+}
+
+void fl_binwU32(fl_binw_t& w, uint32_t v) {
+  fl_binwU16(w, v & 0xFFFF);
+  fl_binwU16(w, v >> 16);
+}
+
+void fl_binwScaled(fl_binw_t& w, float value, uint16_t scale) {
+  int16_t v;
+  if (!isfinite(value)) {
+    v = FL_TELEMBIN_NAN;
+  } else {
+    long long t = llroundf(value * scale);
+    if (t > INT16_MAX) t = INT16_MAX;
+    if (t <= INT16_MIN) t = INT16_MIN + 1;
+    v = (int16_t)t;
+  }
+  fl_binwU16(w, (uint16_t)v);
+}
+
+void fl_binwStr(fl_binw_t& w, const char* s) {
+  size_t n = s ? strlen(s) : 0;
+  if (n > 255) n = 255;
+  fl_binwU8(w, (uint8_t)n);
+  for (size_t k = 0; k < n; k++) fl_binwU8(w, (uint8_t)s[k]);
+}
+
+size_t fl_binwEnd(const fl_binw_t& w) {
+  return w.overflow ? 0 : w.len;
+}
+
+const char* fl_telemetryFormatName(fl_telemetry_format_t f) {
+  switch (f) {
+    case FL_TELEMETRY_JSON:   return "json";
+    case FL_TELEMETRY_BINARY: return "binary";
+    case FL_TELEMETRY_BOTH:   return "both";
+    default:                  return "unknown";
+  }
+}
+
+fl_telemetry_format_t fl_telemetryFormatFromName(const char* name) {
+  if (!name) return FL_TELEMETRY_FORMAT_COUNT;
+  for (uint8_t f = 0; f < FL_TELEMETRY_FORMAT_COUNT; f++) {
+    const char* a = fl_telemetryFormatName((fl_telemetry_format_t)f);
+    const char* b = name;
+    while (*a && *b && tolower((unsigned char)*a) == tolower((unsigned char)*b)) { a++; b++; }
+    if (*a == '\0' && *b == '\0') return (fl_telemetry_format_t)f;
+  }
+  return FL_TELEMETRY_FORMAT_COUNT;
+}
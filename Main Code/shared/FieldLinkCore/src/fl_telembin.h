@@ -0,0 +1,79 @@
+#ifndef FL_TELEMBIN_H
+#define FL_TELEMBIN_H
+
+// Compact binary telemetry (opt-in, topic fieldlink/{id}/telemetry.bin).
+// Carries the same fields as the JSON telemetry. Enums are sent as bytes,
+// readings as scaled int16 and the static strings only now and then.
+// The encoders are in fl_telemetry.h. Reference decoder:
+// tools/fieldlink_telemetry.py, which rebuilds the JSON byte for byte —
+// held to that by the golden frames of the native test test_telemetry and
+// tools/check_telemetry_golden.py.
+//
+// Schema 3, little-endian:
+//   u8  schema             FL_TELEMBIN_SCHEMA
+//   u8  flags              FL_TELEMBIN_F_*
+//   u8  pumps              N
+//   u16 frame              Counter, wraps
+//   u32 uptime             s
+//   u8  di, u8 do
+//   [u8 hour, u8 min, u8 sec]                  if F_TIME
+//   3-phase map: i16 V1..V3 (x10), i16 IL1..IL3 (x100), i16 avgI (x100),
+//                i16 imbalance (x10)
+//   per pump:    [i16 V (x10), i16 I (x100)]   per-phase map only
+//                u8 state (fl_motor_state_t), u8 fault (fl_fault_t),
+//                u8 bits (FL_TELEMBIN_P_*), [u8 thermal %] if P_THERMAL
+//   i16 peak current since the previous frame (x100), per V/I channel:
+//                IL1max..IL3max (3-phase), else I1max..INmax   (schema 2)
+//   per pump:    u32 kWh (x100), u32 run hours (x100), u32 starts,
+//                u32 faults                                    (schema 3)
+//   [str hardware_type, str firmware_version]  if F_STATIC (str = u8 len + bytes)
+// A scaled value of INT16_MIN means not-a-number (JSON null); other values
+// are clamped to the int16 range.
+// Hardware-free.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FL_TELEMBIN_SCHEMA       3
+#define FL_TELEMBIN_STATIC_EVERY 30     // Frames between static blocks, for late subscribers
+#define FL_TELEMBIN_NAN          INT16_MIN
+
+#define FL_TELEMBIN_F_STATIC     0x01
+#define FL_TELEMBIN_F_3PHASE     0x02
+#define FL_TELEMBIN_F_TIME       0x04
+#define FL_TELEMBIN_F_ETH        0x08   // Network: Ethernet, else WiFi
+#define FL_TELEMBIN_F_SENSOR     0x10   // Meter online
+
+#define FL_TELEMBIN_P_CMD        0x01
+#define FL_TELEMBIN_P_CONFIRMED  0x02
+#define FL_TELEMBIN_P_THERMAL    0x04
+
+enum fl_telemetry_format_t : uint8_t {
+  FL_TELEMETRY_JSON = 0,
+  FL_TELEMETRY_BINARY,
+  FL_TELEMETRY_BOTH,
+  FL_TELEMETRY_FORMAT_COUNT
+};
+
+struct fl_binw_t {
+  uint8_t* buf;
+  size_t cap;
+  size_t len;
+  bool overflow;
+};
+
+void fl_binwBegin(fl_binw_t& w, uint8_t* buf, size_t cap);
+void fl_binwU8(fl_binw_t& w, uint8_t v);
+void fl_binwU16(fl_binw_t& w, uint16_t v);
+void fl_binwU32(fl_binw_t& w, uint32_t v);
+// round(value * scale) as int16, same rounding as the JSON fixed-point
+void fl_binwScaled(fl_binw_t& w, float value, uint16_t scale);
+void fl_binwStr(fl_binw_t& w, const char* s);
+// Returns the length, 0 on overflow
+size_t fl_binwEnd(const fl_binw_t& w);
+
+const char* fl_telemetryFormatName(fl_telemetry_format_t f);
+// Case-insensitive. Returns FL_TELEMETRY_FORMAT_COUNT if unknown.
+fl_telemetry_format_t fl_telemetryFormatFromName(const char* name);
+
+#endif
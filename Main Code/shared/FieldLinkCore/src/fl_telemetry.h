@@ -0,0 +1,187 @@
+#ifndef FL_TELEMETRY_H
+#define FL_TELEMETRY_H
+
+// One telemetry frame as plain values, and its two encodings: the JSON on
+// fieldlink/{id}/telemetry (fl_jsonw.h) and the compact binary on
+// telemetry.bin (fl_telembin.h). The controller fills a frame from its
+// control pass; the host tests fill one by hand and check that the
+// reference decoder rebuilds the JSON from the binary.
+// Hardware-free.
+
+#include <math.h>
+#include "fl_keys.h"
+#include "fl_jsonw.h"
+#include "fl_telembin.h"
+#include "fl_protection.h"
+
+template <uint8_t N, bool ThreePhase>
+struct fl_telemetry_t {
+  static constexpr uint8_t kPhases = ThreePhase ? 3 : N;   // Metered V/I channels
+
+  // Channel names: "V1", "IL2" (3-phase) or "I2" (one per pump)
+  using ChanV   = fl_chars<'V'>;
+  using ChanI   = std::conditional_t<ThreePhase, fl_chars<'I', 'L'>, fl_chars<'I'>>;
+  using SfxMax  = fl_chars<'m', 'a', 'x'>;
+  using KeyV    = fl_key_table<kPhases, 'V'>;
+  using KeyI    = std::conditional_t<ThreePhase, fl_key_table<3, 'I', 'L'>, fl_key_table<N, 'I'>>;
+  using KeyImax = fl_key_table_sfx<kPhases, ChanI, SfxMax>;
+  using KeyS    = fl_pump_keys<N, 's'>;
+  using KeyC    = fl_pump_keys<N, 'c'>;
+  using KeyF    = fl_pump_keys<N, 'f'>;
+  using KeyCf   = fl_pump_keys<N, 'c', 'f'>;
+  using KeyTh   = fl_pump_keys<N, 't', 'h'>;
+  using KeyKwh  = fl_pump_keys<N, 'k', 'w', 'h'>;
+  using KeyRh   = fl_pump_keys<N, 'r', 'h'>;
+  using KeySt   = fl_pump_keys<N, 's', 't'>;
+  using KeyFc   = fl_pump_keys<N, 'f', 'c'>;
+
+  struct pump_t {
+    fl_motor_state_t state;
+    fl_fault_t fault;
+    bool command;
+    bool confirmed;
+    bool thermal;             // A thermal model is set
+    float thermalPct;         // Used capacity, % of trip
+    uint32_t centiKwh;
+    uint32_t centiHours;
+    uint32_t starts;
+    uint32_t faults;
+  };
+
+  struct frame_t {
+    // Per channel: the three phases, or each pump's voltage and protection
+    // current
+    float V[kPhases];
+    float I[kPhases];
+    float avgI;               // 3-phase only
+    float imbalancePct;       // 3-phase only
+    pump_t pump[N];
+    float Imax[kPhases];      // Peak since the previous frame
+    bool sensor;              // Meter online
+    bool ethernet;
+    uint32_t uptime;          // s
+    uint8_t di, dout;
+    const char* hwType;
+    const char* fwVersion;
+    bool clockValid;
+    uint8_t hour, minute, second;
+    uint32_t epoch;
+  };
+
+  // The live fields, shared by telemetry and /api/status (which leaves out
+  // the thermal capacity)
+  static void encodeStatus(fl_jsonw_t& w, const frame_t& f, bool withThermal) {
+    if constexpr (ThreePhase) {
+      for (uint8_t k = 0; k < 3; k++) fl_jsonwFixed(w, KeyV::key[k], f.V[k], 1);
+      for (uint8_t k = 0; k < 3; k++) fl_jsonwFixed(w, KeyI::key[k], f.I[k], 2);
+      fl_jsonwFixed(w, "avgI", f.avgI, 2);
+      fl_jsonwFixed(w, "imbalance", f.imbalancePct, 1);
+    }
+    for (uint8_t i = 0; i < N; i++) {
+      const pump_t& p = f.pump[i];
+      if constexpr (!ThreePhase) {
+        fl_jsonwFixed(w, KeyV::key[i], f.V[i], 1);
+        fl_jsonwFixed(w, KeyI::key[i], f.I[i], 2);
+      }
+      fl_jsonwStr(w, KeyS::key[i], fl_motorStateToString(p.state));
+      fl_jsonwBool(w, KeyC::key[i], p.command);
+      fl_jsonwStr(w, KeyF::key[i], fl_faultToString(p.fault));
+      fl_jsonwBool(w, KeyCf::key[i], p.confirmed);
+      if (withThermal && p.thermal) fl_jsonwFixed(w, KeyTh::key[i], p.thermalPct, 0);
+    }
+  }
+
+  // The JSON frame; 'stamped' adds the epoch ("ts") for frames replayed later
+  static size_t encodeJson(char* buf, size_t cap, const frame_t& f, bool stamped) {
+    fl_jsonw_t w;
+    fl_jsonwBegin(w, buf, cap);
+    encodeStatus(w, f, true);
+    for (uint8_t k = 0; k < kPhases; k++) fl_jsonwFixed(w, KeyImax::key[k], f.Imax[k], 2);
+    for (uint8_t i = 0; i < N; i++) {
+      const pump_t& p = f.pump[i];
+      fl_jsonwScaled(w, KeyKwh::key[i], p.centiKwh, 2);
+      fl_jsonwScaled(w, KeyRh::key[i], p.centiHours, 2);
+      fl_jsonwUInt(w, KeySt::key[i], p.starts);
+      fl_jsonwUInt(w, KeyFc::key[i], p.faults);
+    }
+    fl_jsonwBool(w, "sensor", f.sensor);
+    fl_jsonwUInt(w, "uptime", f.uptime);
+    fl_jsonwStr(w, "network", f.ethernet ? "ETH" : "WiFi");
+    fl_jsonwUInt(w, "di", f.di);
+    fl_jsonwUInt(w, "do", f.dout);
+    fl_jsonwStr(w, "hardware_type", f.hwType);
+    fl_jsonwStr(w, "firmware_version", f.fwVersion);
+    if (f.clockValid) {
+      // "HH:MM:SS", as fl_clock_t::hms
+      const uint8_t part[3] = { f.hour, f.minute, f.second };
+      char hms[9];
+      for (uint8_t k = 0; k < 3; k++) {
+        hms[3 * k] = '0' + part[k] / 10 % 10;
+        hms[3 * k + 1] = '0' + part[k] % 10;
+        hms[3 * k + 2] = ':';
+      }
+      hms[8] = '\0';
+      fl_jsonwStr(w, "time", hms);
+      if (stamped) fl_jsonwUInt(w, "ts", f.epoch);
+    }
+    return fl_jsonwEnd(w);
+  }
+
+  // Same fields as the JSON, laid out per fl_telembin.h. 'withStatic' adds
+  // the hardware and firmware strings.
+  static size_t encodeBinary(uint8_t* buf, size_t cap, const frame_t& f, uint16_t seq, bool withStatic) {
+    uint8_t flags = (withStatic ? FL_TELEMBIN_F_STATIC : 0) | (ThreePhase ? FL_TELEMBIN_F_3PHASE : 0) |
+                    (f.clockValid ? FL_TELEMBIN_F_TIME : 0) | (f.ethernet ? FL_TELEMBIN_F_ETH : 0) |
+                    (f.sensor ? FL_TELEMBIN_F_SENSOR : 0);
+    fl_binw_t w;
+    fl_binwBegin(w, buf, cap);
+    fl_binwU8(w, FL_TELEMBIN_SCHEMA);
+    fl_binwU8(w, flags);
+    fl_binwU8(w, N);
+    fl_binwU16(w, seq);
+    fl_binwU32(w, f.uptime);
+    fl_binwU8(w, f.di);
+    fl_binwU8(w, f.dout);
+    if (f.clockValid) {
+      fl_binwU8(w, f.hour);
+      fl_binwU8(w, f.minute);
+      fl_binwU8(w, f.second);
+    }
+    if constexpr (ThreePhase) {
+      for (uint8_t k = 0; k < 3; k++) fl_binwScaled(w, f.V[k], 10);
+      for (uint8_t k = 0; k < 3; k++) fl_binwScaled(w, f.I[k], 100);
+      fl_binwScaled(w, f.avgI, 100);
+      fl_binwScaled(w, f.imbalancePct, 10);
+    }
+    for (uint8_t i = 0; i < N; i++) {
+      const pump_t& p = f.pump[i];
+      if constexpr (!ThreePhase) {
+        fl_binwScaled(w, f.V[i], 10);
+        fl_binwScaled(w, f.I[i], 100);
+      }
+      fl_binwU8(w, p.state);
+      fl_binwU8(w, p.fault);
+      fl_binwU8(w, (p.command ? FL_TELEMBIN_P_CMD : 0) | (p.confirmed ? FL_TELEMBIN_P_CONFIRMED : 0) |
+                   (p.thermal ? FL_TELEMBIN_P_THERMAL : 0));
+      if (p.thermal) {
+        long th = lroundf(p.thermalPct);
+        fl_binwU8(w, th < 0 ? 0 : th > 255 ? 255 : th);
+      }
+    }
+    for (uint8_t k = 0; k < kPhases; k++) fl_binwScaled(w, f.Imax[k], 100);
+    for (uint8_t i = 0; i < N; i++) {
+      const pump_t& p = f.pump[i];
+      fl_binwU32(w, p.centiKwh);
+      fl_binwU32(w, p.centiHours);
+      fl_binwU32(w, p.starts);
+      fl_binwU32(w, p.faults);
+    }
+    if (withStatic) {
+      fl_binwStr(w, f.hwType);
+      fl_binwStr(w, f.fwVersion);
+    }
+    return fl_binwEnd(w);
+  }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""
+Golden check for the binary telemetry decoder
+=============================================
+Decodes every hex frame in the firmware's golden table
+(Main Code/projects/eve-controller/test/test_telemetry/golden.h) with
+fieldlink_telemetry.TelemetryDecoder and compares the result with the JSON
+the firmware encodes for the same frame. The native test test_telemetry
+holds the firmware to the same table.
+
+Usage:
+    python check_telemetry_golden.py [golden.h]
+"""
+
+import os
+import re
+import sys
+
+from fieldlink_telemetry import TelemetryDecoder, DecodeError
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GOLDEN = os.path.join(HERE, '..', 'Main Code', 'projects', 'eve-controller',
+                      'test', 'test_telemetry', 'golden.h')
+
+# { "product", "hex", "json" } with C string escapes in the JSON
+_ENTRY = re.compile(r'\{\s*"(\w+)",\s*"([0-9a-f]*)",\s*"((?:[^"\\]|\\.)*)"\s*\}')
+
+
+def load(path):
+    with open(path) as f:
+        text = f.read()
+    return [(m.group(1), m.group(2), re.sub(r'\\(.)', r'\1', m.group(3)))
+            for m in _ENTRY.finditer(text)]
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else GOLDEN
+    entries = load(path)
+    if not entries:
+        print(f'No golden frames in {path}')
+        sys.exit(1)
+
+    # Frames of one product share a decoder: the static block carries over
+    decoders = {}
+    failed = 0
+    for n, (product, hex_frame, expected) in enumerate(entries):
+        dec = decoders.setdefault(product, TelemetryDecoder())
+        try:
+            got = dec.to_json(bytes.fromhex(hex_frame))
+        except (ValueError, DecodeError) as e:
+            got = f'# {e}'
+        if got != expected:
+            failed += 1
+            print(f'FAIL frame {n} ({product})\n  expected {expected}\n  decoded  {got}')
+
+    print(f'{len(entries)} frames, {failed} mismatches')
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
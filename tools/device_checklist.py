@@ -36,6 +36,7 @@ def check_device(device_id):
     results = {}
     start_time = None
     done = False
+    cmd_id = f'chk-{int(time.time())}'
 
     def on_connect(client, userdata, flags, rc):
         nonlocal start_time
@@ -49,14 +50,19 @@ def check_device(device_id):
         start_time = time.time()
         client.publish(
             f'fieldlink/{device_id}/command',
-            json.dumps({'command': 'GET_SETTINGS'})
+            json.dumps({'command': 'GET_SETTINGS', 'id': cmd_id}),
+            qos=1
         )
 
     def on_message(client, userdata, msg):
         nonlocal done
         try:
             data = json.loads(msg.payload)
-            if data.get('type') == 'settings' and 'settings' not in results:
+            if msg.topic.endswith('/ack'):
+                if data.get('id') == cmd_id and 'ack' not in results:
+                    results['ack'] = data
+                    results['ack_time'] = time.time() - start_time
+            elif data.get('type') == 'settings' and 'settings' not in results:
                 results['settings'] = data
                 results['settings_time'] = time.time() - start_time
             elif 'V1' in data and 'telemetry' not in results:
@@ -109,6 +115,13 @@ def check_device(device_id):
         print(f'  GET_SETTINGS response:      {status} ({st:.1f}s)')
     else:
         print(f'  GET_SETTINGS response:      {FAIL} (no response)')
+    ack = results.get('ack')
+    if ack:
+        status = OK if ack.get('ok') else FAIL
+        print(f'  Command ack:                {status} ({results["ack_time"]:.2f}s, '
+              f'{ack.get("us", 0) / 1000:.1f}ms on device)')
+    else:
+        print(f'  Command ack:                {WARN} (none; firmware without acks?)')
     print()
 
     if not t and not s:
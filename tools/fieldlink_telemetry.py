@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""
+FieldLink Binary Telemetry Decoder
+==================================
+Reference decoder for the compact telemetry a device publishes on
+fieldlink/{id}/telemetry.bin (SET_TELEMETRY "binary" or "both").
+Rebuilds the JSON the device would have sent on fieldlink/{id}/telemetry,
+byte for byte. The frame layout is documented in
+Main Code/shared/FieldLinkCore/src/fl_telembin.h; check_telemetry_golden.py
+holds this decoder to the firmware's golden frames.
+
+Library use:
+    dec = TelemetryDecoder()
+    json_text = dec.to_json(payload)
+
+Usage:
+    python fieldlink_telemetry.py --hex frames.txt          # one hex frame per line ('-' = stdin)
+    python fieldlink_telemetry.py --mqtt FL-22F968          # live, prints JSON lines
+    python fieldlink_telemetry.py --mqtt FL-22F968 --republish
+                                                            # also publish the JSON for the portal
+"""
+
+import sys
+import json
+import struct
+
+SCHEMA = 3          # Schema 1 (no peak currents) and 2 (no counters) frames still decode
+
+F_STATIC = 0x01
+F_3PHASE = 0x02
+F_TIME = 0x04
+F_ETH = 0x08
+F_SENSOR = 0x10
+
+P_CMD = 0x01
+P_CONFIRMED = 0x02
+P_THERMAL = 0x04
+
+NAN = -32768
+
+# fl_motor_state_t / fl_fault_t, as the firmware prints them
+STATES = ['STOPPED', 'RUNNING', 'FAULT']
+FAULTS = ['', 'OVERCURRENT', 'DRY_RUN', 'SENSOR_FAULT', 'IMBALANCE',
+          'PHASE_LOSS', 'UNDERVOLTAGE', 'OVERVOLTAGE']
+
+
+class DecodeError(Exception):
+    pass
+
+
+class _Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.pos + size > len(self.data):
+            raise DecodeError('frame truncated')
+        value = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += size
+        return value[0] if len(value) == 1 else value
+
+    def u8(self):
+        return self.take('<B')
+
+    def scaled(self, scale):
+        # Same text ArduinoJson printed for round(x * scale) / scale
+        raw = self.take('<h')
+        if raw == NAN:
+            return None
+        if raw % scale == 0:
+            return raw // scale
+        return raw / scale
+
+    def counter(self, scale):
+        # u32 already scaled, printed like fl_jsonwScaled()
+        raw = self.take('<I')
+        if raw % scale == 0:
+            return raw // scale
+        return raw / scale
+
+    def string(self):
+        n = self.u8()
+        if self.pos + n > len(self.data):
+            raise DecodeError('frame truncated')
+        s = self.data[self.pos:self.pos + n].decode('utf-8', errors='replace')
+        self.pos += n
+        return s
+
+
+class TelemetryDecoder:
+    """Stateful per device: remembers the static block between frames."""
+
+    def __init__(self):
+        self.hardware_type = None
+        self.firmware_version = None
+        self.last_frame = None
+
+    def decode(self, payload):
+        r = _Reader(bytes(payload))
+        schema = r.u8()
+        if schema not in (1, 2, SCHEMA):
+            raise DecodeError('unknown schema')
+        flags = r.u8()
+        pumps = r.u8()
+        frame = r.take('<H')
+        uptime = r.take('<I')
+        di = r.u8()
+        do = r.u8()
+        time_str = None
+        if flags & F_TIME:
+            h, m, s = r.u8(), r.u8(), r.u8()
+            time_str = f'{h:02d}:{m:02d}:{s:02d}'
+
+        out = {}
+        three_phase = bool(flags & F_3PHASE)
+        if three_phase:
+            for k in ('V1', 'V2', 'V3'):
+                out[k] = r.scaled(10)
+            for k in ('IL1', 'IL2', 'IL3'):
+                out[k] = r.scaled(100)
+            out['avgI'] = r.scaled(100)
+            out['imbalance'] = r.scaled(10)
+
+        for i in range(1, pumps + 1):
+            suffix = '' if pumps == 1 else str(i)
+            if not three_phase:
+                out[f'V{i}'] = r.scaled(10)
+                out[f'I{i}'] = r.scaled(100)
+            state = r.u8()
+            fault = r.u8()
+            bits = r.u8()
+            out['s' + suffix] = STATES[state] if state < len(STATES) else 'STOPPED'
+            out['c' + suffix] = bool(bits & P_CMD)
+            out['f' + suffix] = FAULTS[fault] if fault < len(FAULTS) else ''
+            out['cf' + suffix] = bool(bits & P_CONFIRMED)
+            if bits & P_THERMAL:
+                out['th' + suffix] = r.u8()
+
+        if schema >= 2:
+            # Peak current since the previous frame, per channel
+            channels = 3 if three_phase else pumps
+            prefix = 'IL' if three_phase else 'I'
+            for k in range(1, channels + 1):
+                out[f'{prefix}{k}max'] = r.scaled(100)
+
+        if schema >= 3:
+            # Lifetime counters per pump
+            for i in range(1, pumps + 1):
+                suffix = '' if pumps == 1 else str(i)
+                out['kwh' + suffix] = r.counter(100)
+                out['rh' + suffix] = r.counter(100)
+                out['st' + suffix] = r.counter(1)
+                out['fc' + suffix] = r.counter(1)
+
+        if flags & F_STATIC:
+            self.hardware_type = r.string()
+            self.firmware_version = r.string()
+
+        out['sensor'] = bool(flags & F_SENSOR)
+        out['uptime'] = uptime
+        out['network'] = 'ETH' if flags & F_ETH else 'WiFi'
+        out['di'] = di
+        out['do'] = do
+        # Unknown until the first static block has been seen
+        if self.hardware_type is not None:
+            out['hardware_type'] = self.hardware_type
+            out['firmware_version'] = self.firmware_version
+        if time_str:
+            out['time'] = time_str
+
+        self.last_frame = frame
+        return out
+
+    def to_json(self, payload):
+        return json.dumps(self.decode(payload), separators=(',', ':'), ensure_ascii=False)
+
+
+def _decode_hex(path):
+    dec = TelemetryDecoder()
+    stream = sys.stdin if path == '-' else open(path)
+    with stream:
+        for line in stream:
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                print(dec.to_json(bytes.fromhex(line)))
+            except (ValueError, DecodeError) as e:
+                print(f'# bad frame: {e}', file=sys.stderr)
+
+
+def _decode_mqtt(device_id, republish):
+    import ssl
+    import paho.mqtt.client as mqtt
+    from device_checklist import MQTT_HOST, MQTT_PORT, MQTT_USER, MQTT_PASS
+
+    dec = TelemetryDecoder()
+    bin_topic = f'fieldlink/{device_id}/telemetry.bin'
+    json_topic = f'fieldlink/{device_id}/telemetry'
+
+    def on_connect(client, userdata, flags, rc):
+        if rc != 0:
+            print(f'MQTT connect failed: rc={rc}', file=sys.stderr)
+            return
+        client.subscribe(bin_topic)
+
+    def on_message(client, userdata, msg):
+        try:
+            text = dec.to_json(msg.payload)
+        except DecodeError as e:
+            print(f'# bad frame: {e}', file=sys.stderr)
+            return
+        print(text, flush=True)
+        if republish:
+            client.publish(json_topic, text)
+
+    client = mqtt.Client()
+    client.username_pw_set(MQTT_USER, MQTT_PASS)
+    client.tls_set(cert_reqs=ssl.CERT_REQUIRED)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(MQTT_HOST, MQTT_PORT, 60)
+    client.loop_forever()
+
+
+def main():
+    args = sys.argv[1:]
+    if len(args) >= 2 and args[0] == '--hex':
+        _decode_hex(args[1])
+    elif len(args) >= 2 and args[0] == '--mqtt':
+        _decode_mqtt(args[1], '--republish' in args[2:])
+    else:
+        print(__doc__)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()